@@ -0,0 +1,98 @@
+#include "BatchUpdate.h"
+#include <sstream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+// Constructor: Creates an empty batch.
+BatchUpdate::BatchUpdate() : applied(0), lineNumber(0) {}
+
+// Starts a batch from its header line: "BATCH", optionally followed by the number of operations.
+// The count only reserves space, so a wrong count is harmless. Returns false if the line is not a header.
+bool BatchUpdate::begin(const string& header) {
+    if (header.compare(0, 5, "BATCH") != 0 || (header.size() > 5 && header[5] != ' ')) return false;
+    operations.clear();
+    failures.clear();
+    applied = 0;
+    lineNumber = 1;
+    long count = header.size() > 6 ? strtol(header.c_str() + 6, nullptr, 10) : 0;
+    if (count > 0) {
+        operations.reserve(static_cast<size_t>(min(count, 1L << 20)));
+    }
+    return true;
+}
+
+// Adds one line of the batch body: "device|attribute|value", where the value is a number or on/off.
+// Blank lines and lines starting with '#' are ignored.
+// Returns false once the closing "END" line is reached; malformed lines are recorded as failures.
+bool BatchUpdate::addLine(const string& line) {
+    ++lineNumber;
+    if (line == "END") return false;
+    if (line.empty() || line[0] == '#') return true;
+
+    // The value and attribute are the last two fields, so only those need finding
+    size_t valueBar = line.rfind('|');
+    size_t attributeBar = valueBar == string::npos || valueBar == 0 ? string::npos : line.rfind('|', valueBar - 1);
+    if (attributeBar == string::npos || attributeBar == 0) {
+        fail(lineNumber, "expected device|attribute|value");
+        return true;
+    }
+
+    Operation operation;
+    operation.line = lineNumber;
+    operation.device = line.substr(0, attributeBar);
+    if (!SmartDevice::parseAttribute(line.substr(attributeBar + 1, valueBar - attributeBar - 1), operation.attribute)) {
+        fail(lineNumber, "unknown setting");
+        return true;
+    }
+
+    const char* text = line.c_str() + valueBar + 1;
+    char* end = nullptr;
+    operation.value = strtod(text, &end);
+    if (strcmp(text, "on") == 0) operation.value = 1;
+    else if (strcmp(text, "off") == 0) operation.value = 0;
+    else if (end == text || *end != '\0') {
+        fail(lineNumber, "invalid value");
+        return true;
+    }
+
+    operations.push_back(move(operation));
+    return true;
+}
+
+// Reads one whole batch from a stream: the header, the operations and the closing "END".
+// Returns false if there is no header or the batch is cut off before "END", in which case
+// nothing in it should be applied.
+bool BatchUpdate::read(istream& in) {
+    string line;
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) break;
+    }
+    if (!begin(line)) return false;
+
+    while (getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!addLine(line)) return true;
+    }
+    return false;
+}
+
+// Records a failed line.
+void BatchUpdate::fail(int line, const string& reason) {
+    failures.push_back({ line, reason });
+}
+
+// Returns a summary of the applied batch with one line per failure, in line order.
+string BatchUpdate::report() const {
+    stringstream ss;
+    ss << "Applied " << applied << " of " << applied + failures.size() << " updates.\n";  // Every line either applies or fails
+    vector<Failure> sorted = failures;
+    stable_sort(sorted.begin(), sorted.end(), [](const Failure& a, const Failure& b) { return a.line < b.line; });
+    for (const auto& failure : sorted) {
+        ss << "Line " << failure.line << ": " << failure.reason << "\n";
+    }
+    return ss.str();
+}
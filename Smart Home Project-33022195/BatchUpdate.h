@@ -0,0 +1,36 @@
+#pragma once
+#include "SmartDevice.h"
+#include <vector>
+#include <istream>
+
+using namespace std;
+
+class BatchUpdate {
+public:
+    struct Operation {
+        string device;               // Device name as written (matched ignoring case)
+        DeviceAttribute attribute;
+        double value;
+        int line;                    // Line number within the batch, for error reports
+    };
+
+    struct Failure {
+        int line;
+        string reason;
+    };
+
+    vector<Operation> operations;
+    vector<Failure> failures;        // Lines that were rejected while parsing or applying
+    int applied;                     // Operations applied by SmartHome::applyBatch()
+
+    BatchUpdate();
+
+    bool begin(const string& header);
+    bool addLine(const string& line);
+    bool read(istream& in);
+    void fail(int line, const string& reason);
+    string report() const;
+
+private:
+    int lineNumber;                  // Lines seen so far, counting the header
+};
@@ -0,0 +1,181 @@
+#include "BehaviorRuntime.h"
+#include "VirtualClock.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Constructor: Creates a runtime with no tasks. Nothing runs until start().
+BehaviorRuntime::BehaviorRuntime() : nextSequence(0), guard(nullptr), running(false) {}
+
+// Destructor: Stops the event loop and destroys the tasks still suspended.
+BehaviorRuntime::~BehaviorRuntime() {
+    stop();
+}
+
+// Orders wake-ups so the earliest is at the top of the queue.
+bool BehaviorRuntime::Later::operator()(const Wakeup& a, const Wakeup& b) const {
+    return a.time != b.time ? a.time > b.time : a.sequence > b.sequence;
+}
+
+// Constructor: An awaitable that suspends a task until wakeTime.
+BehaviorRuntime::Sleep::Sleep(BehaviorRuntime& runtime, Clock::TimePoint wakeTime)
+    : runtime(runtime), wakeTime(wakeTime) {}
+
+// A sleep whose time has passed does not suspend the task.
+bool BehaviorRuntime::Sleep::await_ready() const noexcept {
+    return wakeTime <= Clock::current().now();
+}
+
+// Queues the suspended task to be resumed at the wake-up time.
+void BehaviorRuntime::Sleep::await_suspend(Task::Handle handle) {
+    runtime.schedule(handle, wakeTime);
+}
+
+// Starts the event loop on its own thread. Tasks run while holding guard (if given), so they
+// can change devices without racing the threads that hold the same lock for their commands.
+// With a virtual clock there is no event loop: tasks run only when advance() moves time on.
+void BehaviorRuntime::start(recursive_mutex* lock) {
+    if (running) return;
+    guard = lock;
+    running = true;
+    if (!Clock::current().isVirtual()) {
+        loopThread = thread(&BehaviorRuntime::eventLoop, this);
+    }
+}
+
+// Stops the event loop and destroys every suspended task. Safe to call more than once.
+// Must not be called while holding the guard, since the loop may be waiting for it.
+void BehaviorRuntime::stop() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        running = false;
+    }
+    queueChanged.notify_one();
+    if (loopThread.joinable()) {
+        loopThread.join();
+    }
+
+    lock_guard<mutex> lock(queueMutex);
+    while (!sleeping.empty()) {
+        sleeping.top().handle.destroy();
+        sleeping.pop();
+    }
+}
+
+// Returns true while the event loop is running.
+bool BehaviorRuntime::isRunning() const {
+    return running;
+}
+
+// Starts a task: it runs on the event loop thread until its first suspension.
+// Setting *cancelled stops the task the next time it would be resumed; tasks that share a flag
+// (such as all of a device's behaviors) are cancelled together.
+void BehaviorRuntime::spawn(Task task, shared_ptr<atomic<bool>> cancelled) {
+    Task::Handle handle = task.release();
+    handle.promise().cancelled = move(cancelled);
+    schedule(handle, Clock::current().now());
+}
+
+// Returns an awaitable that suspends the task for the given duration.
+BehaviorRuntime::Sleep BehaviorRuntime::sleepFor(Clock::Duration duration) {
+    return Sleep(*this, Clock::current().now() + duration);
+}
+
+// Returns an awaitable that suspends the task until the given time.
+BehaviorRuntime::Sleep BehaviorRuntime::sleepUntil(Clock::TimePoint wakeTime) {
+    return Sleep(*this, wakeTime);
+}
+
+// Moves the virtual clock forward by duration, running every task that falls due on the way.
+// Rather than stepping, the clock jumps straight to each next wake-up, so simulated days pass
+// as fast as the tasks can run. Tasks due at the same moment run in the order they were queued.
+// Returns the number of tasks resumed. Does nothing unless the virtual clock is installed and
+// the runtime is running.
+size_t BehaviorRuntime::advance(Clock::Duration duration) {
+    auto* clock = dynamic_cast<VirtualClock*>(&Clock::current());
+    if (!clock || !running) return 0;
+
+    Clock::TimePoint target = clock->now() + duration;
+    size_t resumed = 0;
+    vector<Task::Handle> due;
+    while (true) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            if (sleeping.empty() || sleeping.top().time > target) break;
+            clock->advanceTo(sleeping.top().time);
+            Clock::TimePoint now = clock->now();
+            while (!sleeping.empty() && sleeping.top().time <= now && due.size() < MAX_BATCH) {
+                due.push_back(sleeping.top().handle);
+                sleeping.pop();
+            }
+        }
+        resume(due);
+        resumed += due.size();
+        due.clear();
+    }
+    clock->advanceTo(target);
+    return resumed;
+}
+
+// Returns the number of suspended tasks, including cancelled ones not yet reclaimed.
+size_t BehaviorRuntime::getTaskCount() {
+    lock_guard<mutex> lock(queueMutex);
+    return sleeping.size();
+}
+
+// Queues a suspended task, waking the event loop if it is now the first due.
+void BehaviorRuntime::schedule(Task::Handle handle, Clock::TimePoint wakeTime) {
+    bool first;
+    {
+        lock_guard<mutex> lock(queueMutex);
+        first = sleeping.empty() || wakeTime < sleeping.top().time;
+        sleeping.push({ wakeTime, nextSequence++, handle });
+    }
+    if (first) {
+        queueChanged.notify_one();
+    }
+}
+
+// Resumes a batch of due tasks with the guard held; cancelled tasks are destroyed instead.
+// A resumed task runs until it next suspends or returns.
+void BehaviorRuntime::resume(const vector<Task::Handle>& due) {
+    unique_lock<recursive_mutex> devicesLock;
+    if (guard) devicesLock = unique_lock<recursive_mutex>(*guard);
+    for (Task::Handle handle : due) {
+        const auto& cancelled = handle.promise().cancelled;
+        if (cancelled && *cancelled) {
+            handle.destroy();
+        }
+        else {
+            handle.resume();
+        }
+    }
+}
+
+// Event loop: sleeps until the earliest wake-up, then resumes the tasks that are due,
+// taking them off the queue in batches.
+void BehaviorRuntime::eventLoop() {
+    Trace::nameThread("behaviors");
+    vector<Task::Handle> due;
+    unique_lock<mutex> lock(queueMutex);
+    while (running) {
+        if (sleeping.empty()) {
+            queueChanged.wait(lock);
+            continue;
+        }
+        Clock::TimePoint now = Clock::current().now();
+        if (sleeping.top().time > now) {
+            queueChanged.wait_for(lock, sleeping.top().time - now);
+            continue;
+        }
+
+        while (!sleeping.empty() && sleeping.top().time <= now && due.size() < MAX_BATCH) {
+            due.push_back(sleeping.top().handle);
+            sleeping.pop();
+        }
+        lock.unlock();
+        resume(due);
+        due.clear();
+        lock.lock();
+    }
+}
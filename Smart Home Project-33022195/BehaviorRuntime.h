@@ -0,0 +1,64 @@
+#pragma once
+#include "Task.h"
+#include "Clock.h"
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <cstdint>
+
+using namespace std;
+
+class BehaviorRuntime {
+public:
+    // Awaitable returned by sleepFor()/sleepUntil(): suspends the task until the given time
+    class Sleep {
+    public:
+        Sleep(BehaviorRuntime& runtime, Clock::TimePoint wakeTime);
+        bool await_ready() const noexcept;
+        void await_suspend(Task::Handle handle);
+        void await_resume() const noexcept {}
+
+    private:
+        BehaviorRuntime& runtime;
+        Clock::TimePoint wakeTime;
+    };
+
+    BehaviorRuntime();
+    ~BehaviorRuntime();
+
+    void start(recursive_mutex* guard);
+    void stop();
+    bool isRunning() const;
+    void spawn(Task task, shared_ptr<atomic<bool>> cancelled);
+    Sleep sleepFor(Clock::Duration duration);
+    Sleep sleepUntil(Clock::TimePoint wakeTime);
+    size_t advance(Clock::Duration duration);
+    size_t getTaskCount();
+
+private:
+    struct Wakeup {
+        Clock::TimePoint time;
+        uint64_t sequence;        // Tasks due at the same time run in the order they were queued
+        Task::Handle handle;
+    };
+
+    struct Later {
+        bool operator()(const Wakeup& a, const Wakeup& b) const;
+    };
+
+    static const size_t MAX_BATCH = 1024;   // Tasks resumed per acquisition of the guard
+
+    priority_queue<Wakeup, vector<Wakeup>, Later> sleeping;  // Suspended tasks by wake-up time
+    uint64_t nextSequence;
+    mutex queueMutex;                       // Guards sleeping and nextSequence
+    condition_variable queueChanged;
+    recursive_mutex* guard;                 // Held while tasks run, so they may change devices
+    atomic<bool> running;
+    thread loopThread;
+
+    void schedule(Task::Handle handle, Clock::TimePoint wakeTime);
+    void resume(const vector<Task::Handle>& due);
+    void eventLoop();
+};
@@ -0,0 +1,69 @@
+#include "BenchmarkRunner.h"
+#include "../SmartHome.h"
+#include "../BatchUpdate.h"
+#include <fstream>
+#include <random>
+#include <cctype>
+
+using namespace std;
+
+static const int DEVICES = 220000;
+static const int UPDATES = 400000;
+
+// Helper function: Returns the name of the device at index, of the type its index gives it.
+static string deviceName(int index) {
+    static const char* const KINDS[] = { "Lamp ", "Plug ", "Speaker " };
+    return KINDS[index % 3] + to_string(index);
+}
+
+// Loading a home of 220,000 lights, plugs and speakers, then reading and applying a bulk update
+// of 400,000 lines naming random devices in any case, checkpoint included. The plugs are only
+// switched on, so the checkpoint writes the segments and no history.
+BENCHMARK(BatchUpdate_fourHundredThousandUpdatesToTwoHundredTwentyThousandDevices) {
+    {
+        ofstream store("smart_home.txt");   // Written as older versions did
+        for (int i = 0; i < DEVICES; ++i) {
+            switch (i % 3) {
+            case 0: store << "LIGHT|" << deviceName(i) << "|0|50\n"; break;
+            case 1: store << "PLUG|" << deviceName(i) << "|0|2.5\n"; break;
+            default: store << "SPEAKER|" << deviceName(i) << "|0|10|0\n"; break;
+            }
+        }
+    }
+    {
+        ofstream updates("updates.txt");
+        updates << "BATCH\n";
+        mt19937 random(5);
+        for (int i = 0; i < UPDATES; ++i) {
+            int index = static_cast<int>(random() % DEVICES);
+            string name = deviceName(index);
+            if (random() % 2) {
+                for (char& c : name) c = static_cast<char>(toupper(static_cast<unsigned char>(c)));
+            }
+            switch (index % 3) {
+            case 0: updates << name << (i % 2 ? "|brightness|" : "|on|") << (i % 2 ? random() % 101 : random() % 2) << "\n"; break;
+            case 1: updates << name << "|on|1\n"; break;
+            default: updates << name << "|volume|" << random() % 101 << "\n"; break;
+            }
+        }
+        updates << "END\n";
+    }
+
+    Stopwatch timer;
+    SmartHome home;
+    BenchmarkRunner::report("load", timer.seconds(), "s");
+    timer.restart();
+    home.saveDevices();   // Moves the store to segments, so the batch's checkpoint is a usual one
+    BenchmarkRunner::report("first save", timer.seconds(), "s");
+
+    timer.restart();
+    BatchUpdate batch;
+    ifstream updates("updates.txt");
+    batch.read(updates);
+    BenchmarkRunner::report("read batch", timer.seconds(), "s");
+
+    timer.restart();
+    home.applyBatch(batch);
+    BenchmarkRunner::report("apply and checkpoint", timer.seconds(), "s");
+    BenchmarkRunner::report("applied", static_cast<double>(batch.applied), "updates");
+}
@@ -0,0 +1,42 @@
+#include "BenchmarkRunner.h"
+#include "../BehaviorRuntime.h"
+#include <chrono>
+
+using namespace std;
+
+// Helper function: A behavior that wakes up once a second for a number of rounds.
+static Task sleeper(BehaviorRuntime& runtime, int rounds, size_t& wakeups) {
+    for (int round = 0; round < rounds; ++round) {
+        co_await runtime.sleepFor(chrono::seconds(1));
+        ++wakeups;
+    }
+}
+
+// A million sleeping behaviors, each resumed once a second for five rounds of virtual time.
+VIRTUAL_TIME_BENCHMARK(BehaviorRuntime_millionSleepingTasks) {
+    const size_t TASKS = 1000000;
+    const int ROUNDS = 5;
+    BehaviorRuntime runtime;
+    runtime.start(nullptr);
+
+    size_t wakeups = 0;
+    size_t frameBytes = 0;
+    Stopwatch timer;
+    for (size_t i = 0; i < TASKS; ++i) {
+        Task task = sleeper(runtime, ROUNDS, wakeups);
+        frameBytes = task.frameSize();
+        runtime.spawn(move(task), nullptr);
+    }
+    runtime.advance(chrono::seconds(0));   // Each runs to its first sleep
+    BenchmarkRunner::report("spawn 1M tasks", timer.seconds(), "s");
+    BenchmarkRunner::report("frame size", static_cast<double>(frameBytes), "bytes");
+
+    timer.restart();
+    for (int round = 0; round < ROUNDS; ++round) {
+        runtime.advance(chrono::seconds(1));
+    }
+    double seconds = timer.seconds();
+    BenchmarkRunner::report("resume 1M tasks x 5 rounds", seconds, "s");
+    BenchmarkRunner::report("per resume", seconds * 1e9 / static_cast<double>(wakeups), "ns");
+    runtime.stop();
+}
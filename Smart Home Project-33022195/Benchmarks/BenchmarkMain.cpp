@@ -0,0 +1,19 @@
+#include "BenchmarkRunner.h"
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// Runs the benchmarks: all of them, or those whose names contain the first argument.
+// Build with optimizations on; the sizes are those of the figures quoted in the commit history.
+int main(int argc, char* argv[]) {
+    string filter = argc > 1 ? argv[1] : "";
+    cout << "Benchmarks on " << thread::hardware_concurrency() << " hardware threads.\n";
+    int run = BenchmarkRunner::runAll(filter);
+    if (run == 0) {
+        cout << "No benchmark matches \"" << filter << "\".\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "BenchmarkRunner.h"
+#include "../VirtualClock.h"
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <system_error>
+#include <memory>
+#include <cmath>
+
+using namespace std;
+
+// Returns the registered benchmarks. A function-local static, so benchmarks in any file can
+// register themselves during static initialization.
+vector<BenchmarkRunner::Benchmark>& BenchmarkRunner::benchmarks() {
+    static vector<Benchmark> registered;
+    return registered;
+}
+
+// Registers a benchmark. Returns true, so BENCHMARK() can run it from a static initializer.
+bool BenchmarkRunner::add(const char* name, BenchmarkBody body, bool virtualTime) {
+    benchmarks().push_back({ name, body, virtualTime });
+    return true;
+}
+
+// Prints one measurement of the benchmark being run.
+void BenchmarkRunner::report(const string& measurement, double value, const string& unit) {
+    int decimals = value == floor(value) ? 0 : value < 10 ? 3 : 1;   // Counts print as whole numbers
+    cout << "  " << left << setw(40) << measurement << right << fixed << setprecision(decimals)
+         << setw(12) << value << " " << unit << "\n" << defaultfloat;
+}
+
+// Runs the matching benchmarks: those on the real clock first, then, with the virtual clock
+// installed, those that simulate time. Each starts in an empty scratch directory, which is
+// removed afterwards since some leave hundreds of megabytes of store and history files.
+int BenchmarkRunner::runAll(const string& filter) {
+    filesystem::path scratch = filesystem::temp_directory_path() / "smart_home_benchmarks";
+    filesystem::path home = filesystem::current_path();
+    error_code ignored;
+    filesystem::remove_all(scratch, ignored);
+    int run = 0;
+    for (bool virtualTime : { false, true }) {
+        for (const Benchmark& benchmark : benchmarks()) {
+            if (benchmark.virtualTime != virtualTime || string(benchmark.name).find(filter) == string::npos) continue;
+            if (virtualTime && !Clock::current().isVirtual()) {
+                Clock::install(make_unique<VirtualClock>());
+            }
+            filesystem::path directory = scratch / benchmark.name;
+            filesystem::create_directories(directory);
+            filesystem::current_path(directory);
+
+            cout << benchmark.name << "\n";
+            Stopwatch total;
+            benchmark.body();
+            report("total", total.seconds(), "s");
+            ++run;
+
+            filesystem::current_path(home);
+            filesystem::remove_all(directory, ignored);
+        }
+    }
+    filesystem::remove_all(scratch, ignored);
+    return run;
+}
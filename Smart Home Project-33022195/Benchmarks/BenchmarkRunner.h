@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <chrono>
+
+using namespace std;
+
+// Runs the benchmarks registered with BENCHMARK() and VIRTUAL_TIME_BENCHMARK() one at a time, each
+// in a scratch directory of its own, and prints the measurements they report.
+// Benchmarks that simulate days of device activity need the virtual clock, which cannot be taken
+// out again once installed, so they run after the ones timed against the real clock.
+class BenchmarkRunner {
+public:
+    using BenchmarkBody = void (*)();
+
+    static bool add(const char* name, BenchmarkBody body, bool virtualTime);
+    static void report(const string& measurement, double value, const string& unit);
+    static int runAll(const string& filter);   // Runs the benchmarks whose names contain filter; returns how many ran
+
+private:
+    struct Benchmark {
+        const char* name;
+        BenchmarkBody body;
+        bool virtualTime;
+    };
+
+    static vector<Benchmark>& benchmarks();
+};
+
+// Measures wall time from its creation or the last restart().
+class Stopwatch {
+private:
+    chrono::steady_clock::time_point start;
+
+public:
+    Stopwatch() : start(chrono::steady_clock::now()) {}
+
+    void restart() { start = chrono::steady_clock::now(); }
+    double seconds() const { return chrono::duration<double>(chrono::steady_clock::now() - start).count(); }
+};
+
+#define BENCHMARK(name) \
+    static void name(); \
+    static const bool name##Registered = BenchmarkRunner::add(#name, name, false); \
+    static void name()
+
+#define VIRTUAL_TIME_BENCHMARK(name) \
+    static void name(); \
+    static const bool name##Registered = BenchmarkRunner::add(#name, name, true); \
+    static void name()
@@ -0,0 +1,56 @@
+#include "BenchmarkRunner.h"
+#include "../SmartHome.h"
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+static const int DEVICES = 200000;
+
+// Sorting by name and by type, listing every device and saving the whole store of a home with
+// 200,000 lights, plugs and speakers under random names: the passes the pool runs in parallel.
+BENCHMARK(BulkPass_sortListAndSaveTwoHundredThousandDevices) {
+    {
+        ofstream store("smart_home.txt");   // Written as older versions did, so the first save writes every segment
+        mt19937 random(3);
+        for (int i = 0; i < DEVICES; ++i) {
+            int number = static_cast<int>(random() % 10000000);
+            switch (random() % 3) {
+            case 0: store << "LIGHT|Lamp " << number << "|0|50\n"; break;
+            case 1: store << "PLUG|Plug " << number << "|1|2.5\n"; break;
+            default: store << "SPEAKER|Speaker " << number << "|0|10|0\n"; break;
+            }
+        }
+    }
+
+    Stopwatch loading;
+    SmartHome home;
+    BenchmarkRunner::report("load", loading.seconds(), "s");
+
+    // What the passes print goes to a file, as it would to a terminal
+    ofstream console("console.txt");
+    streambuf* terminal = cout.rdbuf(console.rdbuf());
+    vector<pair<string, double>> times;
+    Stopwatch passes;
+    Stopwatch timer;
+    home.sortByName();
+    times.emplace_back("sort by name", timer.seconds());
+    timer.restart();
+    home.sortByType();
+    times.emplace_back("sort by type", timer.seconds());
+    timer.restart();
+    home.listDevices();
+    cout.flush();
+    times.emplace_back("list", timer.seconds());
+    timer.restart();
+    home.saveDevices();
+    times.emplace_back("save", timer.seconds());
+    times.emplace_back("sort, sort, list and save", passes.seconds());
+    cout.rdbuf(terminal);
+
+    for (const auto& time : times) {
+        BenchmarkRunner::report(time.first, time.second, "s");
+    }
+}
@@ -0,0 +1,98 @@
+#include "BenchmarkRunner.h"
+#include "../ConsoleWriter.h"
+#include "../SmartHome.h"
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// Helper function: Counts the non-empty lines of a file other than the writer's reports of dropped
+// messages, and adds up the messages those reports give as dropped.
+static size_t countLines(const string& fileName, size_t& droppedMessages) {
+    ifstream file(fileName);
+    string line;
+    size_t lines = 0;
+    droppedMessages = 0;
+    while (getline(file, line)) {
+        if (line.find("console messages were dropped") != string::npos) {
+            droppedMessages += stoull(line.substr(1));   // "(<n> console messages were dropped)"
+        }
+        else if (!line.empty()) {
+            ++lines;
+        }
+    }
+    return lines;
+}
+
+// Four threads posting 250,000 short messages each, as behaviors and the server would: the time
+// a post takes, and how many of the messages the writer printed rather than dropped.
+BENCHMARK(ConsoleWriter_fourThreadsPostingAMillionMessages) {
+    const int THREADS = 4;
+    const int POSTS = 250000;
+    ConsoleWriter& writer = ConsoleWriter::instance();
+    writer.flush();
+    ofstream console("console.txt");
+    streambuf* terminal = cout.rdbuf(console.rdbuf());
+
+    vector<thread> threads;
+    vector<double> seconds(THREADS);
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&writer, &seconds, t]() {
+            Stopwatch timer;
+            for (int i = 0; i < POSTS; ++i) {
+                writer.post("x\n");
+            }
+            seconds[t] = timer.seconds();
+        });
+    }
+    for (thread& poster : threads) {
+        poster.join();
+    }
+    writer.flush();
+    cout.rdbuf(terminal);
+    console.close();
+
+    double slowest = 0;
+    for (double time : seconds) {
+        slowest = max(slowest, time);
+    }
+    size_t dropped = 0;
+    size_t lines = countLines("console.txt", dropped);
+    BenchmarkRunner::report("per post", slowest * 1e9 / POSTS, "ns");
+    BenchmarkRunner::report("printed", static_cast<double>(lines), "messages");
+    BenchmarkRunner::report("dropped", static_cast<double>(dropped), "messages");
+}
+
+// Fast-forwarding past 3,000 one-minute timers that all end together: how many lines the timer
+// notices take once the writer reports the timers finishing in one batch on one line.
+VIRTUAL_TIME_BENCHMARK(ConsoleWriter_threeThousandTimersFinishing) {
+    const int TIMERS = 3000;
+    SmartHome home;
+    for (int i = 0; i < TIMERS; ++i) {
+        string name = "Light " + to_string(i);
+        home.executeCommand("add|LIGHT|" + name);
+        home.executeCommand("toggle|" + name);
+    }
+    home.startBehaviors();
+    for (int i = 0; i < TIMERS; ++i) {
+        home.executeCommand("timer|Light " + to_string(i) + "|60");
+    }
+
+    ConsoleWriter::instance().flush();
+    ofstream console("console.txt");
+    streambuf* terminal = cout.rdbuf(console.rdbuf());
+    string result;
+    Stopwatch timer;
+    home.advanceClock("2m", result);
+    ConsoleWriter::instance().flush();
+    double seconds = timer.seconds();
+    cout.rdbuf(terminal);
+    console.close();
+
+    size_t dropped = 0;
+    BenchmarkRunner::report("fast-forward", seconds, "s");
+    BenchmarkRunner::report("printed", static_cast<double>(countLines("console.txt", dropped)), "lines");
+    BenchmarkRunner::report("dropped", static_cast<double>(dropped), "timer notices");
+}
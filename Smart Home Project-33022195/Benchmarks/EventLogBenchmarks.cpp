@@ -0,0 +1,85 @@
+#include "BenchmarkRunner.h"
+#include "../EventLog.h"
+#include <ostream>
+#include <streambuf>
+#include <filesystem>
+#include <thread>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+// Counts the lines written to it and discards them, so decoding is timed without the terminal
+// or a disk.
+class LineCounter : public streambuf {
+public:
+    size_t lines = 0;
+
+protected:
+    int overflow(int c) override {
+        lines += c == '\n';
+        return c;
+    }
+    streamsize xsputn(const char* text, streamsize count) override {
+        lines += static_cast<size_t>(count_if(text, text + count, [](char c) { return c == '\n'; }));
+        return count;
+    }
+};
+
+// Helper function: Runs the body on a thread of its own, whose buffer belongs to the benchmark's
+// log rather than the program's.
+static void onNewThread(const function<void()>& body) {
+    thread recorder(body);
+    recorder.join();
+}
+
+// A burst of 8,000 events, which fits in the thread's buffer: the best of 50 bursts, flushed
+// between them, so the time is that of recording and not of writing the file.
+BENCHMARK(EventLog_burstOfEightThousandEvents) {
+    const int EVENTS = 8000;
+    const int BURSTS = 50;
+    EventLog log;
+    double best = 1e9;
+    onNewThread([&log, &best]() {
+        for (int burst = 0; burst < BURSTS; ++burst) {
+            Stopwatch timer;
+            for (int i = 0; i < EVENTS; ++i) {
+                log.record(EventLog::Event::PowerOn, 1);
+            }
+            best = min(best, timer.seconds());
+            log.flush();
+        }
+    });
+    BenchmarkRunner::report("per event, best burst", best * 1e9 / EVENTS, "ns");
+}
+
+// Five million events recorded and written to the file, then decoded back. The recording thread
+// flushes whenever its buffer is half full, as the flusher would if it had a core of its own,
+// so no event is dropped however the threads are scheduled.
+BENCHMARK(EventLog_fiveMillionEventsStreamedAndDecoded) {
+    const int EVENTS = 5000000;
+    Stopwatch timer;
+    {
+        EventLog log;
+        log.nameDevice(1, "Lamp");
+        onNewThread([&log]() {
+            for (int i = 0; i < EVENTS; ++i) {
+                log.record(i % 2 ? EventLog::Event::PowerOff : EventLog::Event::PowerOn, 1);
+                if ((i + 1) % (EventLog::THREAD_CAPACITY / 2) == 0) {
+                    log.flush();
+                }
+            }
+        });
+        log.flush();
+    }
+    BenchmarkRunner::report("record and write", timer.seconds(), "s");
+    BenchmarkRunner::report("file size", filesystem::file_size(EventLog::FILE_NAME) / 1e6, "MB");
+
+    LineCounter counter;
+    ostream out(&counter);
+    string error;
+    timer.restart();
+    EventLog::decode(EventLog::FILE_NAME, out, error);
+    BenchmarkRunner::report("decode", timer.seconds(), "s");
+    BenchmarkRunner::report("decoded", static_cast<double>(counter.lines), "lines");
+}
@@ -0,0 +1,53 @@
+#include "BenchmarkRunner.h"
+#include "../SmartHome.h"
+#include "../HistoryLog.h"
+#include <filesystem>
+#include <limits>
+
+using namespace std;
+
+static const int PLUGS = 300;
+static const int SENSORS = 300;
+
+// Exporting the history of 300 plugs on from 7:00 to 22:00 and 300 sensors sampling every five
+// minutes after 90 days of virtual time, to the columnar format and to CSV.
+VIRTUAL_TIME_BENCHMARK(HistoryExport_ninetyDaysOfSixHundredDevices) {
+    SmartHome home;
+    for (int i = 0; i < PLUGS; ++i) {
+        string name = "Plug " + to_string(i);
+        home.executeCommand("add|PLUG|" + name);
+        home.executeCommand("schedule|" + name + "|add|7|0|on");
+        home.executeCommand("schedule|" + name + "|add|22|0|off");
+    }
+    for (int i = 0; i < SENSORS; ++i) {
+        string name = "Sensor " + to_string(i);
+        home.executeCommand("add|TEMP_HUMIDITY|" + name);
+        home.executeCommand("toggle|" + name);
+    }
+    home.startBehaviors();
+
+    string result;
+    Stopwatch timer;
+    home.advanceClock("90d", result);
+    BenchmarkRunner::report("90 days of behaviors", timer.seconds(), "s");
+
+    uintmax_t historyBytes = 0;
+    for (const auto& entry : filesystem::directory_iterator(HistoryLog::DIRECTORY)) {
+        historyBytes += entry.file_size();
+    }
+    BenchmarkRunner::report("history files", historyBytes / 1e6, "MB");
+
+    time_t from = numeric_limits<time_t>::min();
+    time_t to = numeric_limits<time_t>::max();
+    for (const string& fileName : { string("all.shh"), string("all.csv") }) {
+        timer.restart();
+        home.exportHistory(fileName, "", from, to, result);
+        double seconds = timer.seconds();
+        double megabytes = filesystem::file_size(fileName) / 1e6;
+        BenchmarkRunner::report(fileName + " rows", stod(result.substr(result.find(' '))), "readings");   // "Exported <n> readings ..."
+        BenchmarkRunner::report(fileName + " export", seconds, "s");
+        BenchmarkRunner::report(fileName + " size", megabytes, "MB");
+        BenchmarkRunner::report(fileName + " written", megabytes / seconds, "MB/s");
+        BenchmarkRunner::report(fileName + " history read", historyBytes / 1e6 / seconds, "MB/s");
+    }
+}
@@ -0,0 +1,55 @@
+#include "BenchmarkRunner.h"
+#include "../SmartHome.h"
+#include "../ConsoleWriter.h"
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+
+using namespace std;
+
+static const int SENSORS = 1000;
+static const int LINES = 5000000;
+
+// Ingesting a 5,000,000-line file of readings spread over 1,000 sensors, from the start of the
+// ingest until it reports finished, history files included.
+BENCHMARK(SensorIngest_fiveMillionLinesFromAFile) {
+    SmartHome home;
+    for (int i = 0; i < SENSORS; ++i) {
+        home.executeCommand("add|TEMP_HUMIDITY|S" + to_string(i));
+    }
+    {
+        ofstream file("readings.txt", ios::binary);
+        char line[64];
+        for (int i = 0; i < LINES; ++i) {
+            int length = snprintf(line, sizeof(line), "S%d temp=%d.%02d,hum=%d.%02d %d\n", i % SENSORS,
+                15 + i % 13, i % 100, 30 + i % 41, (i / 7) % 100, 1700000000 + i / SENSORS);
+            file.write(line, length);
+        }
+    }
+    double megabytes = filesystem::file_size("readings.txt") / 1e6;
+    BenchmarkRunner::report("file size", megabytes, "MB");
+
+    // The ingest reports finishing on the console, which goes to a file meanwhile
+    ConsoleWriter::instance().flush();
+    ofstream console("console.txt");
+    streambuf* terminal = cout.rdbuf(console.rdbuf());
+    string result;
+    Stopwatch timer;
+    home.startIngest("readings.txt", result);
+    string state;
+    do {
+        this_thread::sleep_for(chrono::milliseconds(10));
+        state = home.describeIngests().front();
+    } while (state.find("running") != string::npos);
+    double seconds = timer.seconds();
+    ConsoleWriter::instance().flush();
+    cout.rdbuf(terminal);
+
+    BenchmarkRunner::report("ingest", seconds, "s");
+    BenchmarkRunner::report("readings per second", LINES / seconds / 1e6, "M/s");
+    BenchmarkRunner::report("read", megabytes / seconds, "MB/s");
+    BenchmarkRunner::report("recorded", stod(state.substr(state.find(' '))), "readings");   // "<source>: <n> readings, ..."
+}
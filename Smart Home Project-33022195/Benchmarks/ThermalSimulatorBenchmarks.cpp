@@ -0,0 +1,56 @@
+#include "BenchmarkRunner.h"
+#include "../ThermalSimulator.h"
+#include "../WorkStealingPool.h"
+
+using namespace std;
+
+static const int ZONES = 20000;
+static const int DAYS = 30;
+
+// Helper function: Builds a simulator with ZONES zones, each with a scheduled radiator valve and
+// every other one with a thermostat, as menu 11 would for a large building.
+static ThermalSimulator makeBuilding() {
+    ThermalSimulator simulator;
+    for (int i = 0; i < ZONES; ++i) {
+        int zone = simulator.addZone("Zone " + to_string(i), 19.0f + static_cast<float>(i % 5));
+        int morning = 300 + i % 120;
+        simulator.addRadiator(zone, false, { { morning, true }, { 1320, false } });
+        if (i % 2 == 0) {
+            simulator.addThermostat(zone, true, { { morning + 30, true }, { 1380, false } });
+        }
+    }
+    return simulator;
+}
+
+// A 30-day heating simulation of 20,000 zones at one-minute steps, on a one-thread pool and on a
+// pool with a thread per core, whose results must be the same.
+BENCHMARK(ThermalSimulator_twentyThousandZonesForThirtyDays) {
+    ThermalSimulator single = makeBuilding();
+    WorkStealingPool singlePool(1);
+    Stopwatch timer;
+    single.run(DAYS, 60, singlePool);
+    double seconds = timer.seconds();
+    BenchmarkRunner::report("1 thread", seconds, "s");
+    BenchmarkRunner::report("zone steps per second, 1 thread", static_cast<double>(ZONES) * DAYS * 1440 / seconds / 1e6, "M/s");
+
+    ThermalSimulator parallel = makeBuilding();
+    WorkStealingPool pool;
+    timer.restart();
+    parallel.run(DAYS, 60, pool);
+    seconds = timer.seconds();
+    string threads = to_string(pool.getThreadCount()) + (pool.getThreadCount() == 1 ? " thread" : " threads");
+    BenchmarkRunner::report("thread per core (" + threads + ")", seconds, "s");
+    BenchmarkRunner::report("zone steps per second, thread per core",
+        static_cast<double>(ZONES) * DAYS * 1440 / seconds / 1e6, "M/s");
+
+    vector<ThermalSimulator::ZoneResult> expected = single.getResults();
+    vector<ThermalSimulator::ZoneResult> actual = parallel.getResults();
+    size_t differing = 0;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        if (expected[i].energyUsed != actual[i].energyUsed || expected[i].coldHours != actual[i].coldHours
+            || expected[i].minTemperature != actual[i].minTemperature) {
+            ++differing;
+        }
+    }
+    BenchmarkRunner::report("zones with differing results", static_cast<double>(differing), "zones");
+}
@@ -0,0 +1,37 @@
+#include "Clock.h"
+
+using namespace std;
+
+// The wall clock, used unless another clock is installed.
+class RealClock : public Clock {
+public:
+    TimePoint now() const override {
+        return chrono::system_clock::now();
+    }
+};
+
+// Helper function: Holds the installed clock.
+static unique_ptr<Clock>& installedClock() {
+    static unique_ptr<Clock> clock = make_unique<RealClock>();
+    return clock;
+}
+
+// Returns true for a clock that only moves when it is told to.
+bool Clock::isVirtual() const {
+    return false;
+}
+
+// Returns the clock used by devices and behaviors.
+Clock& Clock::current() {
+    return *installedClock();
+}
+
+// Replaces the clock. Not synchronized: call it at startup, before devices or behaviors read the time.
+void Clock::install(unique_ptr<Clock> clock) {
+    installedClock() = move(clock);
+}
+
+// Returns the current time in whole seconds, as time(nullptr) would for the real clock.
+time_t Clock::currentTime() {
+    return chrono::system_clock::to_time_t(current().now());
+}
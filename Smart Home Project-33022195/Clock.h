@@ -0,0 +1,22 @@
+#pragma once
+#include <chrono>
+#include <ctime>
+#include <memory>
+
+using namespace std;
+
+// Source of the current time for devices and their behaviors.
+// The program uses the real clock unless a virtual one is installed at startup (see VirtualClock).
+class Clock {
+public:
+    using TimePoint = chrono::system_clock::time_point;
+    using Duration = chrono::system_clock::duration;
+
+    virtual ~Clock() = default;
+    virtual TimePoint now() const = 0;
+    virtual bool isVirtual() const;
+
+    static Clock& current();
+    static void install(unique_ptr<Clock> clock);   // Only before any device is created
+    static time_t currentTime();                    // current().now() as a time_t
+};
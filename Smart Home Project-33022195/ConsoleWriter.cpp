@@ -0,0 +1,146 @@
+#include "ConsoleWriter.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+static_assert((ConsoleWriter::CAPACITY & (ConsoleWriter::CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+// Constructor: Sets up an empty ring and starts the writer thread.
+// Each slot starts out free for the first position that maps to it.
+ConsoleWriter::ConsoleWriter()
+    : slots(new Slot[CAPACITY]), tail(0), head(0), posted(0), printed(0), dropped(0), stopping(false) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+        slots[i].sequence.store(i, memory_order_relaxed);
+    }
+    writerThread = thread(&ConsoleWriter::writerLoop, this);
+}
+
+// Destructor: Prints whatever is still queued, then stops the writer thread.
+ConsoleWriter::~ConsoleWriter() {
+    stopping = true;
+    posted.fetch_add(1, memory_order_release);
+    posted.notify_one();
+    writerThread.join();
+}
+
+// Returns the program's console writer, started on first use.
+ConsoleWriter& ConsoleWriter::instance() {
+    static ConsoleWriter writer;
+    return writer;
+}
+
+// Queues a message on the program's console writer.
+void ConsoleWriter::print(const string& text, Kind kind) {
+    instance().post(text, kind);
+}
+
+// Queues a message without blocking: the caller claims the next position with a compare-and-swap,
+// copies the message into that slot and publishes it by advancing the slot's sequence. If the
+// writer has not yet emptied the slot a full ring ago, the ring is full and the message is dropped.
+void ConsoleWriter::post(const string& text, Kind kind) {
+    size_t position = tail.load(memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+        slot = &slots[position & (CAPACITY - 1)];
+        size_t sequence = slot->sequence.load(memory_order_acquire);
+        intptr_t difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+        if (difference == 0) {
+            if (tail.compare_exchange_weak(position, position + 1, memory_order_relaxed)) break;
+        }
+        else if (difference < 0) {
+            dropped.fetch_add(1, memory_order_relaxed);
+            return;
+        }
+        else {
+            position = tail.load(memory_order_relaxed);  // Another producer took this position
+        }
+    }
+
+    slot->kind = kind;
+    slot->length = static_cast<uint8_t>(min(text.size(), MAX_LENGTH));
+    memcpy(slot->text, text.data(), slot->length);
+    slot->sequence.store(position + 1, memory_order_release);
+
+    posted.fetch_add(1, memory_order_release);
+    posted.notify_one();
+}
+
+// Waits until every message posted before the call has been printed.
+void ConsoleWriter::flush() {
+    size_t target = tail.load(memory_order_acquire);
+    size_t done = printed.load(memory_order_acquire);
+    while (done < target) {
+        printed.wait(done, memory_order_acquire);
+        done = printed.load(memory_order_acquire);
+    }
+}
+
+// Takes the next published message off the ring (writer thread only).
+// Returns false if there is none yet.
+bool ConsoleWriter::take(Kind& kind, string& text) {
+    Slot& slot = slots[head & (CAPACITY - 1)];
+    if (slot.sequence.load(memory_order_acquire) != head + 1) return false;
+    kind = slot.kind;
+    text.assign(slot.text, slot.length);
+    slot.sequence.store(head + CAPACITY, memory_order_release);  // Free for the position a ring later
+    ++head;
+    return true;
+}
+
+// Prints a batch of messages with one write, so it cannot be split by other output. Timers that
+// finished in the same batch (for example during a virtual clock fast-forward) share one line.
+void ConsoleWriter::writeBatch(const vector<pair<Kind, string>>& batch) {
+    string out;
+    vector<const string*> timers;
+    for (const auto& [kind, text] : batch) {
+        if (kind == Kind::TimerFinished) {
+            timers.push_back(&text);
+        }
+        else {
+            out += text;
+        }
+    }
+
+    if (timers.size() == 1) {
+        out += "\nTimer for " + *timers[0] + " has finished. Turning off the device.\n";
+    }
+    else if (timers.size() > 1) {
+        out += "\nTimers finished for " + to_string(timers.size()) + " devices (";
+        for (size_t i = 0; i < timers.size() && i < 5; ++i) {
+            out += (i ? ", " : "") + *timers[i];
+        }
+        out += timers.size() > 5 ? ", ...). Turning them off.\n" : "). Turning them off.\n";
+    }
+
+    size_t lost = dropped.exchange(0, memory_order_relaxed);
+    if (lost) {
+        out += "(" + to_string(lost) + " console messages were dropped)\n";
+    }
+
+    cout.write(out.data(), static_cast<streamsize>(out.size()));
+    cout.flush();
+}
+
+// Writer thread: prints everything queued in batches, and sleeps until more is posted.
+void ConsoleWriter::writerLoop() {
+    vector<pair<Kind, string>> batch;
+    Kind kind;
+    string text;
+    while (true) {
+        uint32_t seen = posted.load(memory_order_acquire);
+        while (batch.size() < CAPACITY && take(kind, text)) {
+            batch.emplace_back(kind, move(text));
+        }
+        if (!batch.empty() || dropped.load(memory_order_relaxed)) {
+            writeBatch(batch);
+            batch.clear();
+            printed.store(head, memory_order_release);
+            printed.notify_all();
+            continue;
+        }
+        if (stopping) break;
+        posted.wait(seen, memory_order_acquire);
+    }
+}
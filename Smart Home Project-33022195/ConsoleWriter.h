@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cstdint>
+
+using namespace std;
+
+// Prints messages from background threads (device behaviors, the control server) on one writer
+// thread, so they never wait on the terminal and never cut into each other. Producers copy their
+// already formatted message into a fixed ring without taking a lock; if the ring is full the
+// message is dropped and counted rather than waited for. The console menus print directly.
+class ConsoleWriter {
+public:
+    enum class Kind : uint8_t {
+        Text,           // Printed as is
+        TimerFinished   // Text is a device name; several finishing together are reported on one line
+    };
+
+    static const size_t CAPACITY = 1024;       // Messages the ring holds (a power of two)
+    static const size_t MAX_LENGTH = 240;      // Longer messages are cut short
+
+    ConsoleWriter();
+    ~ConsoleWriter();
+    ConsoleWriter(const ConsoleWriter&) = delete;
+    ConsoleWriter& operator=(const ConsoleWriter&) = delete;
+
+    static ConsoleWriter& instance();
+    static void print(const string& text, Kind kind = Kind::Text);   // Shortcut for instance().post()
+
+    void post(const string& text, Kind kind = Kind::Text);
+    void flush();                              // Waits until every message posted so far is printed
+
+private:
+    struct Slot {
+        atomic<size_t> sequence;               // Equal to the position when free, position + 1 when full
+        Kind kind;
+        uint8_t length;
+        char text[MAX_LENGTH];
+    };
+
+    unique_ptr<Slot[]> slots;
+    alignas(64) atomic<size_t> tail;           // Next position producers claim
+    alignas(64) size_t head;                   // Next position the writer reads (writer thread only)
+    atomic<uint32_t> posted;                   // Bumped on every post, so the writer can wait on it
+    atomic<size_t> printed;                    // Positions written out so far, for flush()
+    atomic<size_t> dropped;                    // Messages lost because the ring was full
+    atomic<bool> stopping;
+    thread writerThread;
+
+    bool take(Kind& kind, string& text);
+    void writeBatch(const vector<pair<Kind, string>>& batch);
+    void writerLoop();
+};
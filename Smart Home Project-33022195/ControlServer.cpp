@@ -0,0 +1,347 @@
+#include "ControlServer.h"
+#include "SmartHome.h"
+#include "ConsoleWriter.h"
+#include "Trace.h"
+#include <iostream>
+#include <chrono>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+using namespace std;
+
+// Constructor: Creates a server for the given home. Nothing listens until listenTcp()/listenUnix().
+ControlServer::ControlServer(SmartHome& home)
+    : home(home), epollFd(-1), wakeFd(-1), signalFd(-1), running(false) {}
+
+// Destructor: Stops the event loop and closes every socket.
+ControlServer::~ControlServer() {
+    stop();
+}
+
+#ifdef __linux__
+
+// Opens a listening TCP socket on the loopback interface, so only local clients can connect.
+bool ControlServer::listenTcp(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        cout << "Control server: cannot listen on port " << port << ": " << strerror(errno) << "\n";
+        ::close(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+// Opens a listening Unix domain socket at the given path, replacing a stale socket file.
+bool ControlServer::listenUnix(const string& path) {
+    sockaddr_un address = {};
+    if (path.size() >= sizeof(address.sun_path)) {
+        cout << "Control server: socket path is too long.\n";
+        return false;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+
+    if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        cout << "Control server: cannot listen on " << path << ": " << strerror(errno) << "\n";
+        ::close(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    unixPath = path;
+    return true;
+}
+
+// Starts the event loop on its own thread.
+// With stopOnSignal the server owns the process: SIGINT and SIGTERM end the loop instead of
+// killing the program, so the store is checkpointed on the way out. Must be called before any
+// other thread is started for that to apply to the whole process.
+bool ControlServer::start(bool stopOnSignal) {
+    if (listeners.empty() || running) return false;
+
+    // Each client holds a descriptor; allow as many as the system permits
+    rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epollFd < 0 || wakeFd < 0) return false;
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    for (int fd : listeners) {
+        event.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+    }
+    event.data.fd = wakeFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, wakeFd, &event);
+
+    if (stopOnSignal) {
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        event.data.fd = signalFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, signalFd, &event);
+    }
+
+    running = true;
+    loopThread = thread(&ControlServer::eventLoop, this);
+    return true;
+}
+
+// Stops the event loop and closes all sockets. Safe to call more than once.
+void ControlServer::stop() {
+    if (wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = write(wakeFd, &one, sizeof(one));
+        (void)written;
+    }
+    wait();
+
+    for (auto& entry : connections) {
+        ::close(entry.first);
+    }
+    connections.clear();
+    for (int fd : listeners) {
+        ::close(fd);
+    }
+    listeners.clear();
+    if (!unixPath.empty()) {
+        unlink(unixPath.c_str());
+        unixPath.clear();
+    }
+    for (int* fd : { &epollFd, &wakeFd, &signalFd }) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+        }
+    }
+}
+
+// Blocks until the event loop has ended (after stop() or a signal).
+void ControlServer::wait() {
+    if (loopThread.joinable()) {
+        loopThread.join();
+    }
+}
+
+// Event loop: accepts clients, reads their command lines and writes the responses.
+// Commands on a connection are answered in order, so clients may pipeline requests.
+// Changes are checkpointed at most once per second rather than after every command.
+void ControlServer::eventLoop() {
+    Trace::nameThread("control server");
+    const int MAX_EVENTS = 256;
+    epoll_event events[MAX_EVENTS];
+    auto lastCheckpoint = chrono::steady_clock::now();
+
+    while (running) {
+        int ready = epoll_wait(epollFd, events, MAX_EVENTS, 1000);
+        if (ready < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd || fd == signalFd) {
+                running = false;
+                break;
+            }
+            if (find(listeners.begin(), listeners.end(), fd) != listeners.end()) {
+                acceptClients(fd);
+                continue;
+            }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) continue;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) && !(events[i].events & EPOLLIN)) {
+                closeClient(fd);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                flushClient(it->second);  // May close the connection
+                it = connections.find(fd);
+            }
+            if (it != connections.end() && (events[i].events & EPOLLIN)) {
+                readClient(it->second);   // May close the connection
+            }
+        }
+
+        auto now = chrono::steady_clock::now();
+        if (now - lastCheckpoint >= chrono::seconds(1)) {
+            home.saveDevices();  // Only rewrites segments that changed
+            lastCheckpoint = now;
+        }
+    }
+
+    running = false;
+    home.saveDevices();
+}
+
+// Accepts every pending client on a listening socket.
+void ControlServer::acceptClients(int listener) {
+    while (true) {
+        int fd = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                ConsoleWriter::print("Control server: accept failed: " + string(strerror(errno)) + "\n");
+            }
+            return;
+        }
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            continue;
+        }
+        connections[fd] = { fd, "", "", EPOLLIN, nullptr };
+    }
+}
+
+// Reads what a client has sent and answers every complete command line in it.
+// Lines from "BATCH" to "END" form a bulk update, which is applied as a whole once END arrives.
+// A client that sends an over-long line or hangs up is disconnected.
+void ControlServer::readClient(Connection& connection) {
+    char buffer[16 * 1024];
+    ssize_t received = read(connection.fd, buffer, sizeof(buffer));
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) return;
+    if (received <= 0) {
+        closeClient(connection.fd);
+        return;
+    }
+    connection.input.append(buffer, static_cast<size_t>(received));
+
+    size_t start = 0;
+    size_t end;
+    while ((end = connection.input.find('\n', start)) != string::npos) {
+        string line = connection.input.substr(start, end - start);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (connection.batch) {
+            if (!connection.batch->addLine(line)) {
+                home.applyBatch(*connection.batch);
+                connection.output += connection.batch->report() + "OK\n";
+                connection.batch.reset();
+            }
+        }
+        else if (line.compare(0, 5, "BATCH") == 0) {
+            connection.batch = make_unique<BatchUpdate>();
+            if (!connection.batch->begin(line)) {
+                connection.batch.reset();
+                connection.output += "ERR malformed batch header\n";
+            }
+        }
+        else if (!line.empty()) {
+            connection.output += home.executeCommand(line);
+        }
+        start = end + 1;
+    }
+    connection.input.erase(0, start);
+
+    if (connection.input.size() > MAX_LINE) {
+        closeClient(connection.fd);
+        return;
+    }
+    flushClient(connection);
+}
+
+// Writes as much pending output as the socket accepts. While output is left over the
+// connection waits for EPOLLOUT, and a client with too much unread output is not read from.
+void ControlServer::flushClient(Connection& connection) {
+    while (!connection.output.empty()) {
+        ssize_t sent = send(connection.fd, connection.output.data(), connection.output.size(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+            closeClient(connection.fd);
+            return;
+        }
+        connection.output.erase(0, static_cast<size_t>(sent));
+    }
+
+    unsigned wanted = (connection.output.size() < MAX_PENDING_OUTPUT ? unsigned(EPOLLIN) : 0u)
+        | (connection.output.empty() ? 0u : unsigned(EPOLLOUT));
+    if (wanted != connection.events) {
+        epoll_event event = {};
+        event.events = wanted;
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.events = wanted;
+    }
+}
+
+// Disconnects a client and forgets its buffers.
+void ControlServer::closeClient(int fd) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(fd);
+}
+
+#else
+
+// The control server uses epoll and is only available on Linux.
+bool ControlServer::listenTcp(int) {
+    cout << "Control server: not supported on this platform.\n";
+    return false;
+}
+
+// The control server uses epoll and is only available on Linux.
+bool ControlServer::listenUnix(const string&) {
+    cout << "Control server: not supported on this platform.\n";
+    return false;
+}
+
+// The control server uses epoll and is only available on Linux.
+bool ControlServer::start(bool) {
+    return false;
+}
+
+// Nothing to stop without a server.
+void ControlServer::stop() {}
+
+// Nothing to wait for without a server.
+void ControlServer::wait() {}
+
+// Unused without epoll.
+void ControlServer::eventLoop() {}
+void ControlServer::acceptClients(int) {}
+void ControlServer::readClient(Connection&) {}
+void ControlServer::flushClient(Connection&) {}
+void ControlServer::closeClient(int) {}
+
+#endif
@@ -0,0 +1,52 @@
+#pragma once
+#include "BatchUpdate.h"
+#include <string>
+#include <memory>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+
+using namespace std;
+
+class SmartHome;
+
+class ControlServer {
+private:
+    struct Connection {
+        int fd;
+        string input;        // Received bytes not yet forming a whole command line
+        string output;       // Responses not yet accepted by the socket
+        unsigned events;     // Events currently watched on the socket
+        unique_ptr<BatchUpdate> batch;  // Bulk update being received, between BATCH and END
+    };
+
+    static const size_t MAX_LINE = 64 * 1024;           // Longest accepted command line
+    static const size_t MAX_PENDING_OUTPUT = 1 << 20;   // Stop reading a client that does not read its replies
+
+    SmartHome& home;
+    vector<int> listeners;
+    string unixPath;
+    int epollFd;
+    int wakeFd;              // Signalled by stop() to end the event loop
+    int signalFd;            // SIGINT/SIGTERM when the server owns the process
+    unordered_map<int, Connection> connections;
+    thread loopThread;
+    atomic<bool> running;
+
+    void eventLoop();
+    void acceptClients(int listener);
+    void readClient(Connection& connection);
+    void flushClient(Connection& connection);
+    void closeClient(int fd);
+
+public:
+    ControlServer(SmartHome& home);
+    ~ControlServer();
+
+    bool listenTcp(int port);                  // Loopback only
+    bool listenUnix(const string& path);
+    bool start(bool stopOnSignal);
+    void stop();
+    void wait();
+};
@@ -0,0 +1,153 @@
+#include "DeviceIndex.h"
+#include "SmartDevice.h"
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+// Helper function: Returns the lowercase form of an attribute value, used as the index key.
+static string foldValue(const string& value) {
+    string folded = value;
+    transform(folded.begin(), folded.end(), folded.begin(), ::tolower);
+    return folded;
+}
+
+// Returns the bitmap position for a value, adding an empty bitmap the first time it is seen.
+int DeviceIndex::Category::intern(const string& value) {
+    auto result = ids.emplace(foldValue(value), static_cast<int>(bitmaps.size()));
+    if (result.second) {
+        bitmaps.emplace_back();
+    }
+    return result.first->second;
+}
+
+// Returns the bitmap for a value, or nullptr if no device has ever had it.
+const RoaringBitmap* DeviceIndex::Category::find(const string& value) const {
+    auto it = ids.find(foldValue(value));
+    return it == ids.end() ? nullptr : &bitmaps[it->second];
+}
+
+// Indexes a device under its slot, or re-indexes it after a change.
+// Only the bitmaps whose membership changed are touched.
+void DeviceIndex::update(int slot, const SmartDevice& device) {
+    if (slot >= static_cast<int>(entries.size())) {
+        entries.resize(slot + 1, Entry{ false, false, -1, -1, {} });
+    }
+    Entry& entry = entries[slot];
+    uint32_t bit = static_cast<uint32_t>(slot);
+
+    if (!entry.indexed) {
+        entry.indexed = true;
+        entry.type = types.intern(device.getTypeTag());
+        types.bitmaps[entry.type].add(bit);
+        all.add(bit);
+    }
+
+    if (device.getIsOn() != entry.on) {
+        entry.on = device.getIsOn();
+        if (entry.on) powered.add(bit);
+        else powered.remove(bit);
+    }
+
+    int room = device.getRoom().empty() ? -1 : rooms.intern(device.getRoom());
+    if (room != entry.room) {
+        if (entry.room >= 0) rooms.bitmaps[entry.room].remove(bit);
+        if (room >= 0) rooms.bitmaps[room].add(bit);
+        entry.room = room;
+    }
+
+    vector<int> tagIds;
+    for (const string& tag : device.getTags()) {
+        tagIds.push_back(tags.intern(tag));
+    }
+    sort(tagIds.begin(), tagIds.end());
+    tagIds.erase(unique(tagIds.begin(), tagIds.end()), tagIds.end());
+    if (tagIds != entry.tags) {
+        for (int tag : entry.tags) tags.bitmaps[tag].remove(bit);
+        for (int tag : tagIds) tags.bitmaps[tag].add(bit);
+        entry.tags = move(tagIds);
+    }
+}
+
+// Removes a slot from every bitmap.
+void DeviceIndex::remove(int slot) {
+    if (slot >= static_cast<int>(entries.size()) || !entries[slot].indexed) return;
+    Entry& entry = entries[slot];
+    uint32_t bit = static_cast<uint32_t>(slot);
+
+    types.bitmaps[entry.type].remove(bit);
+    if (entry.room >= 0) rooms.bitmaps[entry.room].remove(bit);
+    for (int tag : entry.tags) tags.bitmaps[tag].remove(bit);
+    powered.remove(bit);
+    all.remove(bit);
+    entry = Entry{ false, false, -1, -1, {} };
+}
+
+// Returns the slots of every indexed device.
+const RoaringBitmap& DeviceIndex::allDevices() const {
+    return all;
+}
+
+// Resolves one clause of a query to a bitmap: "on", "off", or "type=", "room=" or "tag=" followed
+// by one or more comma-separated values, any of which may match. A leading '!' negates the clause.
+bool DeviceIndex::matchClause(const string& clause, RoaringBitmap& result, string& error) const {
+    if (!clause.empty() && clause[0] == '!') {
+        RoaringBitmap negated;
+        if (!matchClause(clause.substr(1), negated, error)) return false;
+        result = all - negated;
+        return true;
+    }
+    if (clause == "on") {
+        result = powered;
+        return true;
+    }
+    if (clause == "off") {
+        result = all - powered;
+        return true;
+    }
+
+    size_t equals = clause.find('=');
+    string key = clause.substr(0, equals);
+    const Category* category = key == "type" ? &types : key == "room" ? &rooms : key == "tag" ? &tags : nullptr;
+    if (!category || equals == string::npos) {
+        error = "unknown condition \"" + clause + "\"";
+        return false;
+    }
+
+    result.clear();
+    size_t start = equals + 1;
+    while (start <= clause.size()) {
+        size_t comma = min(clause.find(',', start), clause.size());
+        const RoaringBitmap* values = category->find(clause.substr(start, comma - start));
+        if (values) {
+            result = result | *values;
+        }
+        start = comma + 1;
+    }
+    return true;
+}
+
+// Answers a query over the indexes with bitmap operations, without visiting any device.
+// The expression is a list of clauses joined by '&', all of which must match, for example
+// "type=light&room=kitchen,hall&on". An empty expression matches every device.
+// Returns false and sets error if the expression is malformed.
+bool DeviceIndex::query(const string& expression, RoaringBitmap& result, string& error) const {
+    bool first = true;
+    size_t start = 0;
+    while (start < expression.size()) {
+        size_t amp = min(expression.find('&', start), expression.size());
+        string clause = expression.substr(start, amp - start);
+        start = amp + 1;
+        if (clause.empty()) continue;
+
+        RoaringBitmap matches;
+        if (!matchClause(clause, matches, error)) return false;
+        result = first ? move(matches) : result & matches;
+        first = false;
+        if (result.empty()) return true;
+    }
+    if (first) {
+        result = all;
+    }
+    return true;
+}
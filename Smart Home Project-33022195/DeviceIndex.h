@@ -0,0 +1,43 @@
+#pragma once
+#include "RoaringBitmap.h"
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+using namespace std;
+
+class SmartDevice;
+
+class DeviceIndex {
+private:
+    struct Category {
+        unordered_map<string, int> ids;   // Lowercase value -> position in bitmaps
+        vector<RoaringBitmap> bitmaps;    // Device slots having each value
+
+        int intern(const string& value);
+        const RoaringBitmap* find(const string& value) const;
+    };
+
+    struct Entry {
+        bool indexed;
+        bool on;
+        int type;
+        int room;                         // -1 if the device has no room
+        vector<int> tags;
+    };
+
+    vector<Entry> entries;                // Indexed state of each slot, so old bits can be cleared
+    Category types;
+    Category rooms;
+    Category tags;
+    RoaringBitmap all;
+    RoaringBitmap powered;
+
+    bool matchClause(const string& clause, RoaringBitmap& result, string& error) const;
+
+public:
+    void update(int slot, const SmartDevice& device);
+    void remove(int slot);
+    const RoaringBitmap& allDevices() const;
+    bool query(const string& expression, RoaringBitmap& result, string& error) const;
+};
@@ -0,0 +1,111 @@
+#include "DeviceQuery.h"
+#include "SmartDevice.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cerrno>
+#include <cstdint>
+
+using namespace std;
+
+// Constructor: Creates a query that matches every device in stored order.
+DeviceQuery::DeviceQuery()
+    : needsState(false), sortKey(SortKey::None), descending(false), limit(0) {}
+
+// Helper function: Parses a whole string as a number. Returns false if it is not one.
+static bool parseNumber(const string& text, double& value) {
+    char* end = nullptr;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+// Helper function: Parses a whole string of decimal digits as a count of at least 1. Returns false
+// for signs, spaces, fractions, trailing characters and values too large for a size_t.
+static bool parseCount(const string& text, size_t& count) {
+    if (text.empty() || !isdigit(static_cast<unsigned char>(text[0]))) return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long long value = strtoull(text.c_str(), &end, 10);
+    if (*end != '\0' || errno == ERANGE || value < 1 || value > SIZE_MAX) return false;
+    count = static_cast<size_t>(value);
+    return true;
+}
+
+// Compiles a list expression once, so listing does no parsing per device.
+// The expression is a list of parts joined by '&':
+//   type=, room=, tag=, on, off, !...   resolved through the bitmap indexes (see DeviceIndex::query)
+//   prefix=text                         name starts with text, ignoring case
+//   energy>n, energy<n                  energy used in kWh (plugs and sensors; others use 0)
+//   sort=name|type|room|energy          sort key; a leading '-' sorts in descending order
+//   limit=n                             at most n devices
+// Returns false and sets error if a part is not understood.
+bool DeviceQuery::compile(const string& expression, string& error) {
+    *this = DeviceQuery();
+    vector<function<bool(const SmartDevice&)>> statePredicates;  // Run after the name checks
+
+    size_t start = 0;
+    while (start < expression.size()) {
+        size_t amp = min(expression.find('&', start), expression.size());
+        string part = expression.substr(start, amp - start);
+        start = amp + 1;
+        if (part.empty()) continue;
+
+        size_t equals = part.find('=');
+        string key = part.substr(0, equals);
+        transform(key.begin(), key.end(), key.begin(), ::tolower);
+        string value = equals == string::npos ? "" : part.substr(equals + 1);
+
+        if (key == "prefix") {
+            transform(value.begin(), value.end(), value.begin(), ::tolower);
+            predicates.push_back([value](const SmartDevice& device) {
+                string name = device.getName();
+                if (name.size() < value.size()) return false;
+                return equal(value.begin(), value.end(), name.begin(),
+                    [](char a, char b) { return a == tolower(static_cast<unsigned char>(b)); });
+            });
+        }
+        else if (key == "sort") {
+            descending = !value.empty() && value[0] == '-';
+            string name = descending ? value.substr(1) : value;
+            transform(name.begin(), name.end(), name.begin(), ::tolower);
+            if (name == "name") sortKey = SortKey::Name;
+            else if (name == "type") sortKey = SortKey::Type;
+            else if (name == "room") sortKey = SortKey::Room;
+            else if (name == "energy") sortKey = SortKey::Energy;
+            else {
+                error = "unknown sort key \"" + value + "\"";
+                return false;
+            }
+        }
+        else if (key == "limit") {
+            if (!parseCount(value, limit)) {
+                error = "limit must be a positive integer";
+                return false;
+            }
+        }
+        else if (part.compare(0, 7, "energy>") == 0 || part.compare(0, 7, "energy<") == 0) {
+            double threshold;
+            if (!parseNumber(part.substr(7), threshold)) {
+                error = "invalid energy threshold in \"" + part + "\"";
+                return false;
+            }
+            if (part[6] == '>') {
+                statePredicates.push_back([threshold](const SmartDevice& device) { return device.getEnergyUsage() > threshold; });
+            }
+            else {
+                statePredicates.push_back([threshold](const SmartDevice& device) { return device.getEnergyUsage() < threshold; });
+            }
+            needsState = true;
+        }
+        else {
+            // Left to the bitmap indexes, which report conditions they do not understand
+            indexExpression += (indexExpression.empty() ? "" : "&") + part;
+        }
+    }
+
+    needsState = needsState || sortKey == SortKey::Energy;
+    for (auto& predicate : statePredicates) {
+        predicates.push_back(move(predicate));
+    }
+    return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <functional>
+
+using namespace std;
+
+class SmartDevice;
+
+class DeviceQuery {
+public:
+    enum class SortKey { None, Name, Type, Room, Energy };
+
+    string indexExpression;     // Conditions answered by the home's bitmap indexes (type, room, tag, on/off)
+    vector<function<bool(const SmartDevice&)>> predicates;  // Remaining conditions, cheapest first
+    bool needsState;            // Some predicate or the sort key reads state only a loaded device has
+    SortKey sortKey;
+    bool descending;
+    size_t limit;               // 0 = no limit
+
+    DeviceQuery();
+
+    bool compile(const string& expression, string& error);
+};
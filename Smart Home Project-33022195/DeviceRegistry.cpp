@@ -0,0 +1,128 @@
+#include "DeviceRegistry.h"
+#include "SmartLight.h"
+#include "TempHumiditySensor.h"
+#include "SmartSpeaker.h"
+#include "Thermostat.h"
+#include "SmartPlug.h"
+#include "RadiatorValve.h"
+#include <iostream>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+    // One registered device type: how it is stored, offered in the "Add device" menu and built.
+    struct DeviceType {
+        const char* tag;        // Serialized type tag (first field of the record)
+        int menuIndex;          // Number in the "Add device" menu, 0 if the entry is not offered there
+        const char* label;      // Name shown in the "Add device" menu
+        unique_ptr<SmartDevice>(*create)(const string& name);
+    };
+
+    template <typename Device>
+    unique_ptr<SmartDevice> makeDevice(const string& name) {
+        return make_unique<Device>(name);
+    }
+
+    // The device type table. Adding a device type takes one line here.
+    constexpr DeviceType DEVICE_TYPES[] = {
+        { SmartLight::TAG,         1, "Light",                         makeDevice<SmartLight> },
+        { TempHumiditySensor::TAG, 2, "Temperature & Humidity Sensor", makeDevice<TempHumiditySensor> },
+        { SmartSpeaker::TAG,       3, "Speaker",                       makeDevice<SmartSpeaker> },
+        { Thermostat::TAG,         4, "Thermostat",                    makeDevice<Thermostat> },
+        { SmartPlug::TAG,          5, "Smart Plug",                    makeDevice<SmartPlug> },
+        { RadiatorValve::TAG,      6, "Radiator Valve",                makeDevice<RadiatorValve> },
+        { "TEMPHUMIDITY",          0, nullptr,                         makeDevice<TempHumiditySensor> },  // Written by older versions
+    };
+
+    constexpr size_t TYPE_COUNT = sizeof(DEVICE_TYPES) / sizeof(DEVICE_TYPES[0]);
+
+    // Smallest power of two with at least twice as many slots as there are tags.
+    constexpr size_t tableSize() {
+        size_t size = 1;
+        while (size < TYPE_COUNT * 2) size *= 2;
+        return size;
+    }
+
+    constexpr size_t TABLE_SIZE = tableSize();
+
+    // FNV-1a hash of a tag, varied by a seed.
+    constexpr uint32_t tagHash(string_view tag, uint32_t seed) {
+        uint32_t hash = 2166136261u ^ seed;
+        for (size_t i = 0; i < tag.size(); ++i) {
+            hash ^= static_cast<unsigned char>(tag[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    // Returns true if no two registered tags land in the same slot for this seed.
+    constexpr bool isPerfect(uint32_t seed) {
+        bool used[TABLE_SIZE] = {};
+        for (size_t i = 0; i < TYPE_COUNT; ++i) {
+            size_t slot = tagHash(DEVICE_TYPES[i].tag, seed) & (TABLE_SIZE - 1);
+            if (used[slot]) return false;
+            used[slot] = true;
+        }
+        return true;
+    }
+
+    // Searches for a seed that gives a collision-free (perfect) hash of the registered tags.
+    constexpr uint32_t findSeed() {
+        for (uint32_t seed = 0; seed < 100000; ++seed) {
+            if (isPerfect(seed)) return seed;
+        }
+        return UINT32_MAX;
+    }
+
+    constexpr uint32_t SEED = findSeed();
+    static_assert(SEED != UINT32_MAX, "No perfect hash seed found for the device type tags");
+
+    // Slot -> index into DEVICE_TYPES, or -1 for an empty slot.
+    struct SlotTable {
+        int index[TABLE_SIZE];
+    };
+
+    constexpr SlotTable buildSlots() {
+        SlotTable table = {};
+        for (size_t slot = 0; slot < TABLE_SIZE; ++slot) {
+            table.index[slot] = -1;
+        }
+        for (size_t i = 0; i < TYPE_COUNT; ++i) {
+            table.index[tagHash(DEVICE_TYPES[i].tag, SEED) & (TABLE_SIZE - 1)] = static_cast<int>(i);
+        }
+        return table;
+    }
+
+    constexpr SlotTable SLOTS = buildSlots();
+
+}
+
+// Builds an empty device object for a serialized type tag, or returns nullptr for an unknown tag.
+// The tag is hashed once and checked against the single registered tag in its slot.
+unique_ptr<SmartDevice> DeviceRegistry::create(string_view tag) {
+    int index = SLOTS.index[tagHash(tag, SEED) & (TABLE_SIZE - 1)];
+    if (index < 0 || tag != DEVICE_TYPES[index].tag) return nullptr;
+    return DEVICE_TYPES[index].create("");
+}
+
+// Builds a new named device for a choice in the "Add device" menu, or returns nullptr
+// for an invalid choice.
+unique_ptr<SmartDevice> DeviceRegistry::createFromMenu(int menuIndex, const string& name) {
+    for (const auto& type : DEVICE_TYPES) {
+        if (type.menuIndex != 0 && type.menuIndex == menuIndex) {
+            return type.create(name);
+        }
+    }
+    return nullptr;
+}
+
+// Prints the device types offered in the "Add device" menu.
+void DeviceRegistry::printMenu() {
+    for (const auto& type : DEVICE_TYPES) {
+        if (type.menuIndex != 0) {
+            cout << type.menuIndex << ": " << type.label << "\n";
+        }
+    }
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include "SmartDevice.h"
+#include <memory>
+#include <string_view>
+
+using namespace std;
+
+class DeviceRegistry {
+public:
+    static unique_ptr<SmartDevice> create(string_view tag);
+    static unique_ptr<SmartDevice> createFromMenu(int menuIndex, const string& name);
+    static void printMenu();
+};
@@ -0,0 +1,275 @@
+#include "EventLog.h"
+#include "SmartDevice.h"
+#include "Clock.h"
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+#include <unordered_map>
+#include <cstring>
+#include <ctime>
+
+using namespace std;
+
+// The file is MAGIC followed by chunks, each a type byte, a 32-bit payload size and the payload:
+//   'S' a new run started: int64 time in nanoseconds since 1970 (device slots start over)
+//   'N' a device was named: int64 time, uint32 slot, then the name
+//   'R' records: an array of Record, in time order within the chunk
+//   'D' records dropped because a thread's buffer was full: uint64 count
+// Names are registered the first time a device logs an event and again when it is renamed.
+
+static_assert((EventLog::THREAD_CAPACITY & (EventLog::THREAD_CAPACITY - 1)) == 0, "THREAD_CAPACITY must be a power of two");
+static_assert(sizeof(EventLog::Record) == 32, "records are written as is");
+
+// Helper function: Returns the program clock's time in nanoseconds since 1970.
+static int64_t nowNanoseconds() {
+    return chrono::duration_cast<chrono::nanoseconds>(Clock::current().now().time_since_epoch()).count();
+}
+
+// Helper function: Returns a timestamp later than the thread's last one. A virtual clock stands
+// still between advances, and a rename must still sort between the events before and after it.
+static int64_t nextTimestamp(int64_t& last) {
+    last = max(nowNanoseconds(), last + 1);
+    return last;
+}
+
+// Constructor: Creates an empty per-thread buffer.
+EventLog::ThreadBuffer::ThreadBuffer()
+    : records(new Record[THREAD_CAPACITY]), written(0), read(0), dropped(0), lastTimestamp(0) {}
+
+// Constructor: Opens the event file for appending, marks the start of this run and starts the
+// thread that flushes the buffers.
+EventLog::EventLog() : stopping(false) {
+    error_code ec;
+    bool fresh = !filesystem::exists(FILE_NAME, ec) || filesystem::file_size(FILE_NAME, ec) == 0;
+    file.open(FILE_NAME, ios::binary | ios::app);
+    if (fresh) {
+        file.write(MAGIC, 8);
+    }
+    int64_t start = nowNanoseconds();
+    writeChunk('S', &start, sizeof(start));
+    file.flush();
+    flusherThread = thread(&EventLog::flusherLoop, this);
+}
+
+// Destructor: Stops the flusher and writes whatever is still buffered.
+EventLog::~EventLog() {
+    {
+        lock_guard<mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    flusherThread.join();
+    flush();
+}
+
+// Returns the program's event log, opened on first use.
+EventLog& EventLog::instance() {
+    static EventLog log;
+    return log;
+}
+
+// Returns the calling thread's buffer, registering one on the thread's first event.
+EventLog::ThreadBuffer& EventLog::localBuffer() {
+    thread_local ThreadBuffer* buffer = nullptr;
+    if (!buffer) {
+        lock_guard<mutex> lock(buffersMutex);
+        buffers.push_back(make_unique<ThreadBuffer>());
+        buffer = buffers.back().get();
+    }
+    return *buffer;
+}
+
+// Records an event. Only the calling thread writes its buffer, so this is a timestamp, a copy
+// and a release store; a full buffer drops the event rather than wait for the flusher.
+// The flusher is woken early when a buffer fills up faster than it is flushed.
+void EventLog::record(Event event, uint32_t device, double first, double second) {
+    ThreadBuffer& buffer = localBuffer();
+    uint64_t position = buffer.written.load(memory_order_relaxed);
+    uint64_t used = position - buffer.read.load(memory_order_acquire);
+    if (used >= THREAD_CAPACITY) {
+        buffer.dropped.fetch_add(1, memory_order_relaxed);
+        return;
+    }
+    Record& entry = buffer.records[position & (THREAD_CAPACITY - 1)];
+    entry.timestamp = nextTimestamp(buffer.lastTimestamp);
+    entry.device = device;
+    entry.event = static_cast<uint16_t>(event);
+    entry.reserved = 0;
+    entry.args[0] = first;
+    entry.args[1] = second;
+    buffer.written.store(position + 1, memory_order_release);
+
+    if (used == THREAD_CAPACITY / 2) {
+        wake.notify_one();
+    }
+}
+
+// Registers the name a device slot goes by from now on. Called rarely, so it takes a lock.
+void EventLog::nameDevice(uint32_t device, const string& name) {
+    int64_t timestamp = nextTimestamp(localBuffer().lastTimestamp);
+    lock_guard<mutex> lock(buffersMutex);
+    names.push_back({ timestamp, device, name });
+}
+
+// Writes one chunk to the event file.
+void EventLog::writeChunk(char type, const void* data, size_t size) {
+    uint32_t length = static_cast<uint32_t>(size);
+    file.put(type);
+    file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+    file.write(static_cast<const char*>(data), static_cast<streamsize>(size));
+}
+
+// Moves every buffered record to the file. Records are taken before names, so each record's
+// name is written with it or earlier.
+void EventLog::flush() {
+    lock_guard<mutex> fileLock(fileMutex);
+    vector<ThreadBuffer*> sources;
+    {
+        lock_guard<mutex> lock(buffersMutex);
+        for (auto& buffer : buffers) sources.push_back(buffer.get());
+    }
+
+    batch.clear();
+    uint64_t lost = 0;
+    for (ThreadBuffer* buffer : sources) {
+        uint64_t from = buffer->read.load(memory_order_relaxed);
+        uint64_t to = buffer->written.load(memory_order_acquire);
+        for (uint64_t i = from; i < to; ++i) {
+            batch.push_back(buffer->records[i & (THREAD_CAPACITY - 1)]);
+        }
+        buffer->read.store(to, memory_order_release);
+        lost += buffer->dropped.exchange(0, memory_order_relaxed);
+    }
+    stable_sort(batch.begin(), batch.end(),
+        [](const Record& a, const Record& b) { return a.timestamp < b.timestamp; });
+
+    vector<Name> named;
+    {
+        lock_guard<mutex> lock(buffersMutex);
+        named.swap(names);
+    }
+    for (const Name& entry : named) {
+        string payload(12 + entry.name.size(), '\0');
+        memcpy(&payload[0], &entry.timestamp, 8);
+        memcpy(&payload[8], &entry.device, 4);
+        memcpy(&payload[12], entry.name.data(), entry.name.size());
+        writeChunk('N', payload.data(), payload.size());
+    }
+    if (!batch.empty()) {
+        writeChunk('R', batch.data(), batch.size() * sizeof(Record));
+    }
+    if (lost) {
+        writeChunk('D', &lost, sizeof(lost));
+    }
+    if (!named.empty() || !batch.empty() || lost) {
+        file.flush();
+    }
+}
+
+// Flusher thread: writes the buffers out every FLUSH_MILLISECONDS, or sooner when one fills up.
+void EventLog::flusherLoop() {
+    unique_lock<mutex> lock(wakeMutex);
+    while (!stopping) {
+        wake.wait_for(lock, chrono::milliseconds(FLUSH_MILLISECONDS));
+        lock.unlock();
+        flush();
+        lock.lock();
+    }
+}
+
+// Helper function: Formats nanoseconds since 1970 as local "YYYY-MM-DD HH:MM:SS.mmm".
+static string formatTimestamp(int64_t nanoseconds) {
+    time_t seconds = static_cast<time_t>(nanoseconds / 1000000000);
+    tm local;
+#ifdef _MSC_VER
+    localtime_s(&local, &seconds);
+#else
+    localtime_r(&seconds, &local);
+#endif
+    char text[32];
+    strftime(text, sizeof(text), "%Y-%m-%d %H:%M:%S", &local);
+    char millis[8];
+    snprintf(millis, sizeof(millis), ".%03d", static_cast<int>(nanoseconds / 1000000 % 1000));
+    return string(text) + millis;
+}
+
+// Formats an event file as text, one line per event, for example
+// "2026-10-18 07:30:00.000 Lamp brightness 40". Returns false with a reason in error if the
+// file cannot be read or is not an event file; a cut-off last chunk is ignored.
+bool EventLog::decode(const string& fileName, ostream& out, string& error) {
+    ifstream in(fileName, ios::binary);
+    char magic[8];
+    if (!in.read(magic, 8)) {
+        error = "cannot read " + fileName;
+        return false;
+    }
+    if (memcmp(magic, MAGIC, 8) != 0) {
+        error = fileName + " is not an event log";
+        return false;
+    }
+
+    unordered_map<uint32_t, vector<pair<int64_t, string>>> names;  // Slot -> (from, name) in time order
+    auto nameAt = [&names](uint32_t device, int64_t timestamp, int back) -> string {
+        auto it = names.find(device);
+        if (it == names.end()) return "#" + to_string(device);
+        const auto& history = it->second;
+        size_t i = static_cast<size_t>(upper_bound(history.begin(), history.end(), timestamp,
+            [](int64_t t, const pair<int64_t, string>& entry) { return t < entry.first; }) - history.begin());
+        i = i > 0 ? i - 1 : 0;  // Events just before a device's first name still go by that name
+        return i >= static_cast<size_t>(back) ? history[i - back].second : history[i].second;
+    };
+
+    char type;
+    uint32_t length;
+    string payload;
+    while (in.get(type) && in.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+        payload.resize(length);
+        if (!in.read(&payload[0], length)) break;
+
+        if (type == 'S' && length == 8) {
+            int64_t start;
+            memcpy(&start, payload.data(), 8);
+            names.clear();
+            out << "--- run started " << formatTimestamp(start) << " ---\n";
+        }
+        else if (type == 'N' && length >= 12) {
+            int64_t timestamp;
+            uint32_t device;
+            memcpy(&timestamp, payload.data(), 8);
+            memcpy(&device, payload.data() + 8, 4);
+            auto& history = names[device];
+            history.emplace_back(timestamp, payload.substr(12));
+            stable_sort(history.begin(), history.end(),
+                [](const pair<int64_t, string>& a, const pair<int64_t, string>& b) { return a.first < b.first; });
+        }
+        else if (type == 'D' && length == 8) {
+            uint64_t lost;
+            memcpy(&lost, payload.data(), 8);
+            out << "(" << lost << " events were dropped)\n";
+        }
+        else if (type == 'R' && length % sizeof(Record) == 0) {
+            for (size_t offset = 0; offset < length; offset += sizeof(Record)) {
+                Record record;
+                memcpy(&record, payload.data() + offset, sizeof(Record));
+                out << formatTimestamp(record.timestamp) << " " << nameAt(record.device, record.timestamp, 0) << " ";
+                switch (static_cast<Event>(record.event)) {
+                case Event::PowerOn: out << "on"; break;
+                case Event::PowerOff: out << "off"; break;
+                case Event::Setting:
+                    out << SmartDevice::attributeName(static_cast<DeviceAttribute>(static_cast<int>(record.args[0])))
+                        << " " << record.args[1];
+                    break;
+                case Event::TimerStarted: out << "timer started (" << record.args[0] << " s)"; break;
+                case Event::TimerFinished: out << "timer finished"; break;
+                case Event::Added: out << "added"; break;
+                case Event::Removed: out << "removed"; break;
+                case Event::Renamed: out << "renamed (was " << nameAt(record.device, record.timestamp, 1) << ")"; break;
+                default: out << "event " << record.event; break;
+                }
+                out << "\n";
+            }
+        }
+    }
+    return true;
+}
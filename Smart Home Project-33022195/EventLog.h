@@ -0,0 +1,86 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <fstream>
+#include <iosfwd>
+#include <cstdint>
+
+using namespace std;
+
+// Audit trail of what happened to which device and when. Recording an event copies a fixed-size
+// binary record into a buffer owned by the calling thread, without locks or formatting; a
+// background thread appends the buffers to FILE_NAME, and decode() turns the file into text.
+class EventLog {
+public:
+    enum class Event : uint16_t {
+        PowerOn = 1,
+        PowerOff,
+        Setting,            // args: DeviceAttribute, new value
+        TimerStarted,       // args: seconds
+        TimerFinished,
+        Added,
+        Removed,
+        Renamed             // The device's new name is registered just before
+    };
+
+    struct Record {
+        int64_t timestamp;  // Nanoseconds since 1970 on the program's clock
+        uint32_t device;    // Device slot, named by a name chunk
+        uint16_t event;
+        uint16_t reserved;
+        double args[2];
+    };
+
+    static const size_t THREAD_CAPACITY = 16384;    // Records buffered per thread (a power of two)
+    static const int FLUSH_MILLISECONDS = 200;
+    static constexpr const char* FILE_NAME = "smart_home_events.bin";
+    static constexpr const char* MAGIC = "SHEVTS01";
+
+    EventLog();
+    ~EventLog();
+    EventLog(const EventLog&) = delete;
+    EventLog& operator=(const EventLog&) = delete;
+
+    static EventLog& instance();
+    void record(Event event, uint32_t device, double first = 0, double second = 0);
+    void nameDevice(uint32_t device, const string& name);
+    void flush();                                   // Writes everything recorded so far
+
+    static bool decode(const string& fileName, ostream& out, string& error);
+
+private:
+    struct ThreadBuffer {
+        unique_ptr<Record[]> records;
+        atomic<uint64_t> written;                   // Advanced by the owning thread only
+        atomic<uint64_t> read;                      // Advanced by the flusher only
+        atomic<uint64_t> dropped;                   // Records lost because the buffer was full
+        int64_t lastTimestamp;                      // Owning thread only
+        ThreadBuffer();
+    };
+
+    struct Name {
+        int64_t timestamp;
+        uint32_t device;
+        string name;
+    };
+
+    mutex buffersMutex;                             // Guards buffers and names
+    vector<unique_ptr<ThreadBuffer>> buffers;       // Never freed before the log, so threads may end
+    vector<Name> names;                             // Registered since the last flush
+    mutex fileMutex;                                // Serializes flushes
+    ofstream file;
+    vector<Record> batch;                           // Flusher's scratch space
+    mutex wakeMutex;
+    condition_variable wake;
+    bool stopping;
+    thread flusherThread;
+
+    ThreadBuffer& localBuffer();
+    void writeChunk(char type, const void* data, size_t size);
+    void flusherLoop();
+};
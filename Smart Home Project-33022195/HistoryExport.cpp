@@ -0,0 +1,277 @@
+#include "HistoryExport.h"
+#include <algorithm>
+#include <charconv>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+using namespace std;
+
+// Columnar format (all fixed-size numbers little-endian, varints in LEB128):
+//   "SHHIST01"                                       magic
+//   block...                                         up to BLOCK_ROWS rows each
+//   footer
+//   uint64 footer offset, "SHHIST01"                 trailer, so readers can start from the end
+// A block starts with uint32 rows, int64 min/max timestamp, float32 min/max value and the uint32
+// byte length of each of its four columns, which follow in this order:
+//   source      runs of (varint source, varint run length); a source is one series of one device
+//   timestamp   varint zigzag difference from the previous row (the first row from 0)
+//   value       varint of the float's bits XORed with the previous row's (the first row with 0)
+//   extra       same as value (humidity for sensor readings, otherwise 0)
+// Every block decodes on its own, and its statistics let readers skip blocks outside a time range.
+// The footer lists the sources (varint count, then device, type and series as varint-length
+// strings and a varint row count) and the blocks (varint count, then uint64 offset, uint32 rows,
+// int64 min/max timestamp and float32 min/max value).
+
+static const size_t OUTPUT_CHUNK = 1 << 20;  // Bytes gathered before each write to the file
+
+// Helper function: Writes an unsigned varint and returns the position after it.
+static inline char* putVarint(char* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>(value | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+// Helper function: Appends an unsigned varint to a string.
+static void appendVarint(string& out, uint64_t value) {
+    char bytes[10];
+    out.append(bytes, static_cast<size_t>(putVarint(bytes, value) - bytes));
+}
+
+// Helper function: Appends a fixed-size number in the machine's (little-endian) byte order.
+template <typename T>
+static void appendFixed(string& out, T value) {
+    char bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+// Helper function: Appends a string preceded by its length.
+static void appendString(string& out, const string& text) {
+    appendVarint(out, text.size());
+    out += text;
+}
+
+// Helper function: Maps signed differences to unsigned ones so small negatives stay small.
+static inline uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+// Helper function: Encodes a float column as XORs of neighbouring values' bits.
+// Repeated values cost one byte, and close values share their sign and exponent bits.
+static void encodeFloats(const vector<float>& column, string& out) {
+    out.resize(column.size() * 5);
+    char* end = &out[0];
+    uint32_t previous = 0;
+    for (float value : column) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        end = putVarint(end, bits ^ previous);
+        previous = bits;
+    }
+    out.resize(static_cast<size_t>(end - out.data()));
+}
+
+// Helper function: Quotes a CSV field if it contains a comma, quote or line break.
+static string csvField(const string& text) {
+    if (text.find_first_of(",\"\r\n") == string::npos) return text;
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    return quoted + "\"";
+}
+
+// Constructor: Creates an exporter; call open() to start a file.
+HistoryExport::HistoryExport()
+    : format(Format::Columnar), bytesWritten(0), rowCount(0), failed(false) {}
+
+// Picks the format from the file name: CSV for names ending in ".csv", columnar otherwise.
+HistoryExport::Format HistoryExport::formatFor(const string& fileName) {
+    string lower = fileName.size() >= 4 ? fileName.substr(fileName.size() - 4) : "";
+    transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return lower == ".csv" ? Format::Csv : Format::Columnar;
+}
+
+// Creates the export file and writes its header. Returns false if the file cannot be created.
+bool HistoryExport::open(const string& fileName, Format fileFormat) {
+    format = fileFormat;
+    file.open(fileName, ios::binary | ios::trunc);
+    if (!file) return false;
+
+    output.reserve(OUTPUT_CHUNK + 64 * 1024);
+    if (format == Format::Csv) {
+        output += "device,type,series,timestamp,value,extra\n";
+    }
+    else {
+        output += MAGIC;
+        sourceColumn.reserve(BLOCK_ROWS);
+        timestampColumn.reserve(BLOCK_ROWS);
+        valueColumn.reserve(BLOCK_ROWS);
+        extraColumn.reserve(BLOCK_ROWS);
+    }
+    return true;
+}
+
+// Writes the samples of one series taken between from and to.
+// CSV rows are formatted straight into the output buffer; columnar rows fill the current block.
+void HistoryExport::addSeries(const string& device, const string& type, const string& series,
+    const HistoryLog& log, time_t from, time_t to) {
+    if (format == Format::Csv) {
+        csvPrefix = csvField(device) + "," + type + "," + series + ",";
+        log.forEach(from, to, [this](const HistoryLog::Sample& sample) {
+            char line[96];
+            char* end = line;
+            end = to_chars(end, line + sizeof(line), sample.timestamp).ptr;
+            *end++ = ',';
+            end = to_chars(end, line + sizeof(line), sample.value).ptr;
+            *end++ = ',';
+            end = to_chars(end, line + sizeof(line), sample.extra).ptr;
+            *end++ = '\n';
+            output += csvPrefix;
+            output.append(line, static_cast<size_t>(end - line));
+            ++rowCount;
+            if (output.size() >= OUTPUT_CHUNK) flushOutput(false);
+        });
+        return;
+    }
+
+    uint32_t source = static_cast<uint32_t>(sources.size());
+    sources.push_back({ device, type, series, 0 });
+    log.forEach(from, to, [this, source](const HistoryLog::Sample& sample) {
+        addRow(source, sample);
+    });
+    if (sources.back().rows == 0) {
+        sources.pop_back();  // Nothing in range; no row refers to it
+    }
+}
+
+// Adds a row to the current block, writing the block out once it is full.
+void HistoryExport::addRow(uint32_t source, const HistoryLog::Sample& sample) {
+    sourceColumn.push_back(source);
+    timestampColumn.push_back(sample.timestamp);
+    valueColumn.push_back(sample.value);
+    extraColumn.push_back(sample.extra);
+    ++sources[source].rows;
+    ++rowCount;
+    if (sourceColumn.size() == BLOCK_ROWS) {
+        writeBlock();
+    }
+}
+
+// Encodes the current block's columns with its statistics and empties them.
+void HistoryExport::writeBlock() {
+    size_t rows = sourceColumn.size();
+    if (rows == 0) return;
+
+    BlockInfo info = { bytesWritten + output.size(), static_cast<uint32_t>(rows),
+        numeric_limits<int64_t>::max(), numeric_limits<int64_t>::min(),
+        numeric_limits<float>::max(), numeric_limits<float>::lowest() };
+    for (size_t i = 0; i < rows; ++i) {
+        info.minTimestamp = min(info.minTimestamp, timestampColumn[i]);
+        info.maxTimestamp = max(info.maxTimestamp, timestampColumn[i]);
+        info.minValue = min(info.minValue, valueColumn[i]);
+        info.maxValue = max(info.maxValue, valueColumn[i]);
+    }
+
+    string columns[4];
+    columns[0].resize(rows * 20);
+    char* end = &columns[0][0];
+    for (size_t i = 0; i < rows;) {
+        size_t run = i + 1;
+        while (run < rows && sourceColumn[run] == sourceColumn[i]) ++run;
+        end = putVarint(end, sourceColumn[i]);
+        end = putVarint(end, run - i);
+        i = run;
+    }
+    columns[0].resize(static_cast<size_t>(end - columns[0].data()));
+
+    columns[1].resize(rows * 10);
+    end = &columns[1][0];
+    int64_t previous = 0;
+    for (int64_t timestamp : timestampColumn) {
+        end = putVarint(end, zigzag(timestamp - previous));
+        previous = timestamp;
+    }
+    columns[1].resize(static_cast<size_t>(end - columns[1].data()));
+
+    encodeFloats(valueColumn, columns[2]);
+    encodeFloats(extraColumn, columns[3]);
+
+    appendFixed<uint32_t>(output, info.rows);
+    appendFixed(output, info.minTimestamp);
+    appendFixed(output, info.maxTimestamp);
+    appendFixed(output, info.minValue);
+    appendFixed(output, info.maxValue);
+    for (const string& column : columns) {
+        appendFixed(output, static_cast<uint32_t>(column.size()));
+    }
+    for (const string& column : columns) {
+        output += column;
+    }
+    blocks.push_back(info);
+
+    sourceColumn.clear();
+    timestampColumn.clear();
+    valueColumn.clear();
+    extraColumn.clear();
+    flushOutput(false);
+}
+
+// Writes the source and block tables followed by the trailer.
+void HistoryExport::writeFooter() {
+    uint64_t footerOffset = bytesWritten + output.size();
+    appendVarint(output, sources.size());
+    for (const Source& source : sources) {
+        appendString(output, source.device);
+        appendString(output, source.type);
+        appendString(output, source.series);
+        appendVarint(output, source.rows);
+    }
+    appendVarint(output, blocks.size());
+    for (const BlockInfo& block : blocks) {
+        appendFixed(output, block.offset);
+        appendFixed(output, block.rows);
+        appendFixed(output, block.minTimestamp);
+        appendFixed(output, block.maxTimestamp);
+        appendFixed(output, block.minValue);
+        appendFixed(output, block.maxValue);
+    }
+    appendFixed(output, footerOffset);
+    output += MAGIC;
+}
+
+// Writes the buffered bytes once a chunk has gathered (or always, with force).
+void HistoryExport::flushOutput(bool force) {
+    if (output.empty() || (!force && output.size() < OUTPUT_CHUNK)) return;
+    file.write(output.data(), static_cast<streamsize>(output.size()));
+    bytesWritten += output.size();
+    output.clear();
+    if (!file) failed = true;
+}
+
+// Finishes the file. Returns false if any write failed.
+bool HistoryExport::close() {
+    if (!file.is_open()) return false;
+    if (format == Format::Columnar) {
+        writeBlock();
+        writeFooter();
+    }
+    flushOutput(true);
+    file.close();
+    return !failed && !file.fail();
+}
+
+// Returns the number of rows exported so far.
+uint64_t HistoryExport::getRowCount() const {
+    return rowCount;
+}
+
+// Returns the number of bytes written to the file so far.
+uint64_t HistoryExport::getBytesWritten() const {
+    return bytesWritten;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "HistoryLog.h"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+#include <ctime>
+
+using namespace std;
+
+// Streams device histories into an export file, either CSV or a compact columnar format
+// (described in HistoryExport.cpp). Only one block of rows is held in memory at a time.
+class HistoryExport {
+public:
+    enum class Format { Columnar, Csv };
+
+    static const size_t BLOCK_ROWS = 64 * 1024;      // Rows per columnar block
+    static constexpr const char* MAGIC = "SHHIST01";
+
+    HistoryExport();
+    HistoryExport(const HistoryExport&) = delete;
+    HistoryExport& operator=(const HistoryExport&) = delete;
+
+    static Format formatFor(const string& fileName); // CSV for ".csv" files, columnar otherwise
+    bool open(const string& fileName, Format format);
+    void addSeries(const string& device, const string& type, const string& series,
+        const HistoryLog& log, time_t from, time_t to);
+    bool close();                                    // Writes the last block and the footer
+
+    uint64_t getRowCount() const;
+    uint64_t getBytesWritten() const;
+
+private:
+    struct Source {
+        string device;
+        string type;
+        string series;
+        uint64_t rows;
+    };
+
+    struct BlockInfo {
+        uint64_t offset;
+        uint32_t rows;
+        int64_t minTimestamp;
+        int64_t maxTimestamp;
+        float minValue;
+        float maxValue;
+    };
+
+    Format format;
+    ofstream file;
+    string output;                   // Encoded bytes not yet written to the file
+    uint64_t bytesWritten;
+    uint64_t rowCount;
+    bool failed;
+
+    // Columnar state: the rows of the block being filled, one vector per column
+    vector<Source> sources;
+    vector<uint32_t> sourceColumn;
+    vector<int64_t> timestampColumn;
+    vector<float> valueColumn;
+    vector<float> extraColumn;
+    vector<BlockInfo> blocks;
+    string csvPrefix;                // "device,type,series," of the series being written as CSV
+
+    void addRow(uint32_t source, const HistoryLog::Sample& sample);
+    void writeBlock();
+    void writeFooter();
+    void flushOutput(bool force);
+};
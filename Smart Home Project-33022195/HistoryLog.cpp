@@ -0,0 +1,223 @@
+#include "HistoryLog.h"
+#include "MappedFile.h"
+#include "ConsoleWriter.h"
+#include <fstream>
+#include <filesystem>
+#include <random>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+static_assert(sizeof(HistoryLog::Sample) == 16, "history files store 16-byte samples");
+
+// Constructor: Creates an empty timeline. Nothing is allocated or written until the first sample.
+HistoryLog::HistoryLog(MemoryAccount* account)
+    : account(account), hotCount(0), segmentCount(0), lastSegmentSamples(0), scanned(false) {
+    MemoryAccount::charge(account, MemorySubsystem::History, sizeof(HistoryLog));
+}
+
+// Destructor: Releases the log's memory from the account. Buffered samples not spilled are lost;
+// devices seal their history at checkpoints.
+HistoryLog::~HistoryLog() {
+    freeBuffer();
+    MemoryAccount::charge(account, MemorySubsystem::History, -static_cast<int64_t>(sizeof(HistoryLog)));
+}
+
+// Frees the sample buffer, if allocated, and releases it from the account.
+void HistoryLog::freeBuffer() {
+    if (!hot) return;
+    hot.reset();
+    hotCount = 0;
+    MemoryAccount::charge(account, MemorySubsystem::History, -static_cast<int64_t>(HOT_CAPACITY * sizeof(Sample)));
+}
+
+// Returns the name of one of the history files.
+string HistoryLog::segmentFile(uint32_t segment) const {
+    return string(DIRECTORY) + "/" + id + "_" + to_string(segment) + ".bin";
+}
+
+// Finds the history files of a restored timeline and how full the newest one is.
+// A sample cut short by an interrupted write is dropped, so later samples stay aligned.
+void HistoryLog::scanSegments() const {
+    if (scanned) return;
+    scanned = true;
+    segmentCount = 0;
+    lastSegmentSamples = 0;
+    if (id.empty()) return;
+
+    error_code ec;
+    while (filesystem::exists(segmentFile(segmentCount), ec)) {
+        ++segmentCount;
+    }
+    if (segmentCount == 0) return;
+
+    string last = segmentFile(segmentCount - 1);
+    uintmax_t bytes = filesystem::file_size(last, ec);
+    if (ec) return;
+    lastSegmentSamples = bytes / sizeof(Sample);
+    if (bytes % sizeof(Sample) != 0) {
+        filesystem::resize_file(last, lastSegmentSamples * sizeof(Sample), ec);
+    }
+}
+
+// Adds a sample to the in-memory buffer, spilling the buffer to disk first if it is full.
+// If the spill fails the buffered samples are dropped, so memory use stays bounded.
+void HistoryLog::append(time_t timestamp, float value, float extra) {
+    if (!hot) {
+        hot = make_unique<Sample[]>(HOT_CAPACITY);
+        MemoryAccount::charge(account, MemorySubsystem::History, HOT_CAPACITY * sizeof(Sample));
+    }
+    if (hotCount == HOT_CAPACITY && !spill()) {
+        ConsoleWriter::print("Error: could not write history to " + string(DIRECTORY) + "; "
+            + to_string(hotCount) + " readings were lost.\n");
+        hotCount = 0;
+    }
+    hot[hotCount++] = { static_cast<int64_t>(timestamp), value, extra };
+}
+
+// Adds many samples at once, such as ingested readings. Whatever does not fit in the buffer is
+// written straight to the history files rather than a buffer at a time, and only the last
+// partial buffer's worth is kept in memory. Returns false if samples were lost to a failed write.
+bool HistoryLog::append(const Sample* samples, size_t count) {
+    if (!hot) {
+        hot = make_unique<Sample[]>(HOT_CAPACITY);
+        MemoryAccount::charge(account, MemorySubsystem::History, HOT_CAPACITY * sizeof(Sample));
+    }
+    bool ok = true;
+    if (hotCount + count > HOT_CAPACITY) {
+        size_t direct = count - count % HOT_CAPACITY;
+        size_t written = 0;
+        if (!spill() || !writeSamples(samples, direct, written)) {
+            ConsoleWriter::print("Error: could not write history to " + string(DIRECTORY) + "; "
+                + to_string(hotCount + direct - written) + " readings were lost.\n");
+            hotCount = 0;
+            scanned = false;
+            ok = false;
+        }
+        samples += direct;
+        count -= direct;  // Now fits in the emptied buffer
+    }
+    memcpy(&hot[hotCount], samples, count * sizeof(Sample));
+    hotCount += count;
+    return ok;
+}
+
+// Appends the buffered samples to the history files (see writeSamples()).
+// Returns false (keeping the samples not written) on failure.
+bool HistoryLog::spill() {
+    if (hotCount == 0) return true;
+    size_t written = 0;
+    if (!writeSamples(&hot[0], hotCount, written)) {
+        // Keep what was not written and find out again what reached the disk
+        memmove(&hot[0], &hot[written], (hotCount - written) * sizeof(Sample));
+        hotCount -= written;
+        scanned = false;
+        return false;
+    }
+    hotCount = 0;
+    return true;
+}
+
+// Appends samples to the newest history file, starting a new file whenever one reaches
+// SEGMENT_SAMPLES. Files other than the newest are never written again. The timeline gets its
+// id on the first write. Returns false on failure, with the number written before it in written.
+bool HistoryLog::writeSamples(const Sample* samples, size_t count, size_t& written) {
+    written = 0;
+    if (count == 0) return true;
+
+    error_code ec;
+    filesystem::create_directories(DIRECTORY, ec);
+    if (id.empty()) {
+        static mt19937_64 generator(random_device{}());
+        char text[17];
+        do {
+            snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(generator()));
+            id = text;
+        } while (filesystem::exists(segmentFile(0), ec));
+        scanned = true;
+        segmentCount = 0;
+        lastSegmentSamples = 0;
+    }
+    scanSegments();
+
+    while (written < count) {
+        if (segmentCount == 0 || lastSegmentSamples == SEGMENT_SAMPLES) {
+            ++segmentCount;
+            lastSegmentSamples = 0;
+        }
+        size_t part = min<size_t>(count - written, SEGMENT_SAMPLES - lastSegmentSamples);
+        ofstream file(segmentFile(segmentCount - 1), ios::binary | ios::app);
+        file.write(reinterpret_cast<const char*>(samples + written), static_cast<streamsize>(part * sizeof(Sample)));
+        file.close();
+        if (!file) return false;
+        written += part;
+        lastSegmentSamples += part;
+    }
+    return true;
+}
+
+// Spills the buffered samples and frees the buffer, to give memory back when a cap is exceeded.
+// The buffer is allocated again with the next sample. Returns false (keeping the buffer) if the
+// spill fails.
+bool HistoryLog::evict() {
+    if (!spill()) return false;
+    freeBuffer();
+    return true;
+}
+
+// Deletes the timeline's history files and forgets its samples (the device is being removed).
+void HistoryLog::discard() {
+    scanSegments();
+    error_code ec;
+    for (uint32_t segment = 0; segment < segmentCount; ++segment) {
+        filesystem::remove(segmentFile(segment), ec);
+    }
+    id.clear();
+    freeBuffer();
+    segmentCount = 0;
+    lastSegmentSamples = 0;
+}
+
+// Returns true if the timeline has no samples, in memory or on disk.
+bool HistoryLog::empty() const {
+    scanSegments();
+    return hotCount == 0 && segmentCount == 0;
+}
+
+// Visits the samples taken between from and to (inclusive), oldest first.
+// Spilled samples are read straight from the mapped history files, followed by the buffered ones.
+void HistoryLog::forEach(time_t from, time_t to, const function<void(const Sample&)>& visit) const {
+    scanSegments();
+    Sample sample;
+    for (uint32_t segment = 0; segment < segmentCount; ++segment) {
+        MappedFile file;
+        if (!file.open(segmentFile(segment))) continue;
+        size_t count = file.size() / sizeof(Sample);
+        for (size_t i = 0; i < count; ++i) {
+            memcpy(&sample, file.data() + i * sizeof(Sample), sizeof(Sample));
+            if (sample.timestamp >= from && sample.timestamp <= to) visit(sample);
+        }
+    }
+    for (size_t i = 0; i < hotCount; ++i) {
+        if (hot[i].timestamp >= from && hot[i].timestamp <= to) visit(hot[i]);
+    }
+}
+
+// Visits every sample, oldest first.
+void HistoryLog::forEach(const function<void(const Sample&)>& visit) const {
+    forEach(numeric_limits<time_t>::min(), numeric_limits<time_t>::max(), visit);
+}
+
+// Returns the id naming the history files (empty until the first spill).
+const string& HistoryLog::getId() const {
+    return id;
+}
+
+// Restores the id saved with the device's record; the files are found on first use.
+void HistoryLog::setId(const string& historyId) {
+    id = historyId;
+    scanned = false;
+}
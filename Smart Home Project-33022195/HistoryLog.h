@@ -0,0 +1,56 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <ctime>
+#include "MemoryAccount.h"
+
+using namespace std;
+
+// Timeline of readings for one device: the newest samples are kept in a fixed-size buffer and
+// older ones are spilled to the device's history files, which are mapped when the timeline is read.
+// The log and its buffer are charged to the owning device's History memory.
+class HistoryLog {
+public:
+    struct Sample {
+        int64_t timestamp;   // Time of the reading (time_t)
+        float value;         // Main value, such as energy used or temperature
+        float extra;         // Second value where the reading has one (humidity), otherwise 0
+    };
+
+    static const size_t HOT_CAPACITY = 256;          // Samples held in memory before a spill
+    static const size_t SEGMENT_SAMPLES = 64 * 1024; // Samples per history file before the next one is started
+    static constexpr const char* DIRECTORY = "smart_home_history";
+
+    explicit HistoryLog(MemoryAccount* account = nullptr);
+    ~HistoryLog();
+    HistoryLog(const HistoryLog&) = delete;
+    HistoryLog& operator=(const HistoryLog&) = delete;
+
+    void append(time_t timestamp, float value, float extra = 0.0f);
+    bool append(const Sample* samples, size_t count);  // False if some could not be written
+    bool spill();                                    // Writes the buffered samples to disk
+    bool evict();                                    // Spills and frees the buffer until the next sample
+    void discard();                                  // Deletes the history files and buffered samples
+    bool empty() const;
+    void forEach(time_t from, time_t to, const function<void(const Sample&)>& visit) const;
+    void forEach(const function<void(const Sample&)>& visit) const;
+
+    const string& getId() const;                     // Empty until the first spill
+    void setId(const string& historyId);             // Restores the id from a stored record
+
+private:
+    MemoryAccount* account;            // Charged for the log and its buffer (may be null)
+    string id;                         // Names the history files: DIRECTORY/<id>_<n>.bin
+    unique_ptr<Sample[]> hot;          // Samples not yet spilled (allocated with the first sample)
+    size_t hotCount;
+    mutable uint32_t segmentCount;     // History files on disk (found lazily after a restart)
+    mutable uint64_t lastSegmentSamples; // Samples in the newest history file
+    mutable bool scanned;              // segmentCount and lastSegmentSamples are known
+
+    string segmentFile(uint32_t segment) const;
+    void scanSegments() const;
+    void freeBuffer();
+    bool writeSamples(const Sample* samples, size_t count, size_t& written);
+};
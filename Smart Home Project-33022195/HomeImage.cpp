@@ -0,0 +1,123 @@
+#include "HomeImage.h"
+#include "SmartDevice.h"
+#include "StoreReader.h"
+#include "MemoryAccount.h"
+#include <fstream>
+#include <filesystem>
+
+using namespace std;
+
+// Constructor: Keeps a device's stored text and charges it to the Images memory subsystem.
+HomeImage::Device::Device(int slot, string text) : slot(slot), text(move(text)) {
+    MemoryAccount::charge(nullptr, MemorySubsystem::Images,
+        static_cast<int64_t>(sizeof(Device) + MemoryAccount::heapBytes(this->text)));
+}
+
+// Destructor: Releases the charge once no image or snapshot refers to the device any more.
+HomeImage::Device::~Device() {
+    MemoryAccount::charge(nullptr, MemorySubsystem::Images,
+        -static_cast<int64_t>(sizeof(Device) + MemoryAccount::heapBytes(text)));
+}
+
+// Builds the stored form of a device from its current state. A lazily loaded device that was
+// never used gives back the text it was loaded from.
+shared_ptr<const HomeImage::Device> HomeImage::Device::capture(const SmartDevice& device) {
+    string record = device.getRecord();
+    string schedules = device.getSchedules();
+    string attributes;
+    if (!device.getRoom().empty() || !device.getTags().empty()) {
+        attributes = "@" + device.getRoom() + "|" + device.getTagList() + "\n";
+    }
+    string text;
+    text.reserve(record.size() + 1 + schedules.size() + attributes.size());
+    text.append(record).append(1, '\n').append(schedules).append(attributes);
+    return make_shared<Device>(device.getSlot(), move(text));
+}
+
+// Returns the device's record line.
+string_view HomeImage::Device::getRecord() const {
+    return string_view(text).substr(0, text.find('\n'));
+}
+
+// Returns the device's schedule lines, without their keys.
+string HomeImage::Device::getSchedules() const {
+    size_t start = text.find('\n') + 1;
+    size_t end = text.size();
+    size_t at = text.rfind("\n@");
+    if (at != string::npos && at + 1 >= start) end = at + 1;
+    return text.substr(start, end - start);
+}
+
+// Returns the device's room and tags as "room|tags", or an empty string if neither is set.
+string HomeImage::Device::getAttributes() const {
+    size_t at = text.rfind("\n@");
+    if (at == string::npos || at + 2 > text.size()) return "";
+    size_t start = at + 2;
+    size_t end = text.find('\n', start);
+    return text.substr(start, end == string::npos ? string::npos : end - start);
+}
+
+// Writes a segment in the store's file format: every record first, then each device's schedule
+// and attribute lines under the key for its position (see StoreReader::ownerKey()).
+void HomeImage::writeSegment(const Segment& segment, ostream& out) {
+    for (const auto& device : segment.devices) {
+        out << device->getRecord() << "\n";
+    }
+    for (size_t position = 0; position < segment.devices.size(); ++position) {
+        const string& text = segment.devices[position]->text;
+        string key = StoreReader::ownerKey(position);
+        size_t start = text.find('\n') + 1;
+        while (start < text.size()) {
+            size_t end = text.find('\n', start);
+            if (end == string::npos) end = text.size();
+            if (text[start] == '@') {
+                out << "@" << key << "|";
+                ++start;
+            }
+            else {
+                out << key << "|";
+            }
+            out.write(text.data() + start, static_cast<streamsize>(end - start));
+            out << "\n";
+            start = end + 1;
+        }
+    }
+}
+
+// Writes the image as a complete store in a directory: the manifest ("smart_home.txt") and one
+// file per segment, so the program can be started there. Works from the image alone, so it can
+// run while the live home keeps changing. Returns false with a reason in error on failure.
+bool HomeImage::writeStore(const string& directory, string& error) const {
+    error_code ec;
+    filesystem::create_directories(directory, ec);
+    if (ec) {
+        error = "cannot create " + directory + ": " + ec.message();
+        return false;
+    }
+    filesystem::path base(directory);
+    ofstream manifest(base / "smart_home.txt");
+    for (const auto& segment : segments) {
+        if (!segment) continue;
+        ofstream file(base / segment->file);
+        writeSegment(*segment, file);
+        if (!file) {
+            error = "cannot write " + (base / segment->file).string();
+            return false;
+        }
+        manifest << "SEGMENT|" << segment->file << "\n";
+    }
+    if (!manifest) {
+        error = "cannot write " + (base / "smart_home.txt").string();
+        return false;
+    }
+    return true;
+}
+
+// Returns the number of devices in the image.
+size_t HomeImage::deviceCount() const {
+    size_t count = 0;
+    for (const auto& segment : segments) {
+        if (segment) count += segment->devices.size();
+    }
+    return count;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <iosfwd>
+
+using namespace std;
+
+class SmartDevice;
+
+// The stored form of the whole home as of a checkpoint: for each store segment, its devices as
+// they are written to the segment file. An image never changes once built. A checkpoint builds the
+// next image from the last one, sharing every segment and device that did not change and copying
+// only the rest, so holding on to an image (a snapshot) costs a pointer copy.
+class HomeImage {
+public:
+    // One device as stored: the record line, then the device's schedule lines without keys and,
+    // if it has a room or tags, an "@room|tags" line. Charged to the Images memory subsystem.
+    class Device {
+    public:
+        Device(int slot, string text);
+        ~Device();
+        Device(const Device&) = delete;
+        Device& operator=(const Device&) = delete;
+
+        static shared_ptr<const Device> capture(const SmartDevice& device);
+
+        int getSlot() const { return slot; }
+        string_view getRecord() const;
+        string getSchedules() const;           // Schedule lines, each ending in '\n'
+        string getAttributes() const;          // "room|tags", empty if neither is set
+
+    private:
+        friend class HomeImage;                // Writes the text out line by line
+
+        int slot;                              // Device slot (see SmartHome), fixed for the run
+        string text;
+    };
+
+    struct Segment {
+        string file;
+        vector<shared_ptr<const Device>> devices;   // In store order
+    };
+
+    vector<shared_ptr<const Segment>> segments;     // By segment id; nullptr if not captured yet
+
+    static void writeSegment(const Segment& segment, ostream& out);
+    bool writeStore(const string& directory, string& error) const;
+    size_t deviceCount() const;
+};
@@ -1,13 +1,136 @@
 #include "SmartHome.h"
+#include "ControlServer.h"
+#include "VirtualClock.h"
+#include "EventLog.h"
+#include "Trace.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstdlib>
 
 //Note: Header files aren't commented because I feel they are easier to understand than the cpp files.
 //The cpp files are finely commented
-int main() {
+int main(int argc, char* argv[]) {
 #ifdef _DEBUG
     onexit(_CrtDumpMemoryLeaks);
 #endif
 
-    SmartHome home;
-    home.run();
+    // --lazy: only read device names at startup and load each device when it is first used
+    // --serve <port> / --serve-unix <path>: also accept commands from local clients (see ControlServer)
+    // --headless: serve clients only, without the console menu, until SIGINT/SIGTERM
+    // --batch <file>: apply a bulk update file (- reads it from standard input) and exit
+    // --virtual-clock: time stands still until advanced (menu 12 or advance|duration), for simulations
+    // --decode-events <file>: print an event log (smart_home_events.bin) as text and exit
+    // --trace <file>: write a Chrome trace of startup, commands and shutdown to the file at exit
+    // --mem-cap <history|schedules|device>=<size>: cap memory use (e.g. history=64M), repeatable
+    // --ingest <source>: read sensor readings from a file, FIFO or Unix socket (see SensorIngest), repeatable
+    // --state-mirror <name>: publish device state in shared memory for local dashboards (see StateMirror)
+    // --read-mirror <name>: print the state mirror of a running home and exit
+    int port = 0;
+    string socketPath;
+    bool headless = false;
+    string batchFile;
+    vector<string> memoryCaps;
+    vector<string> ingestSources;
+    string mirrorName;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--lazy") {
+            SmartHome::setLazyLoading(true);
+        }
+        else if (arg == "--serve" && i + 1 < argc) {
+            port = atoi(argv[++i]);
+        }
+        else if (arg == "--serve-unix" && i + 1 < argc) {
+            socketPath = argv[++i];
+        }
+        else if (arg == "--headless") {
+            headless = true;
+        }
+        else if (arg == "--batch" && i + 1 < argc) {
+            batchFile = argv[++i];
+        }
+        else if (arg == "--virtual-clock") {
+            Clock::install(make_unique<VirtualClock>());
+        }
+        else if (arg == "--trace" && i + 1 < argc) {
+            if (!Trace::start(argv[++i])) {
+                cout << "Error: cannot write trace file " << argv[i] << ".\n";
+                return 1;
+            }
+        }
+        else if (arg == "--mem-cap" && i + 1 < argc) {
+            memoryCaps.push_back(argv[++i]);
+        }
+        else if (arg == "--ingest" && i + 1 < argc) {
+            ingestSources.push_back(argv[++i]);
+        }
+        else if (arg == "--state-mirror" && i + 1 < argc) {
+            mirrorName = argv[++i];
+        }
+        else if (arg == "--read-mirror" && i + 1 < argc) {
+            string error;
+            if (!StateMirror::dump(argv[++i], cout, error)) {
+                cout << "Error: " << error << ".\n";
+                return 1;
+            }
+            return 0;
+        }
+        else if (arg == "--decode-events" && i + 1 < argc) {
+            string error;
+            if (!EventLog::decode(argv[++i], cout, error)) {
+                cout << "Error: " << error << ".\n";
+                return 1;
+            }
+            return 0;
+        }
+    }
+
+    // Devices reach the home through getInstance() (e.g. to delete themselves), so the
+    // program must drive that same instance rather than a second one.
+    SmartHome& home = SmartHome::getInstance();
+    for (const string& cap : memoryCaps) {
+        size_t equals = cap.find('=');
+        string result;
+        if (equals == string::npos || !home.setMemoryCap(cap.substr(0, equals), cap.substr(equals + 1), result)) {
+            cout << "Error: invalid memory cap " << cap << (equals == string::npos ? "" : " (" + result + ")") << ".\n";
+            return 1;
+        }
+    }
+    if (!mirrorName.empty()) {
+        string result;
+        if (!home.openStateMirror(mirrorName, result)) {
+            cout << "Error: " << result << ".\n";
+            return 1;
+        }
+    }
+    if (!batchFile.empty()) {
+        home.applyBatchFile(batchFile);
+        return 0;
+    }
+
+    // The server is stopped before main returns, while the home still exists
+    ControlServer server(home);
+    bool serving = false;
+    if (port > 0 || !socketPath.empty()) {
+        bool listening = (port <= 0 || server.listenTcp(port));
+        listening = (socketPath.empty() || server.listenUnix(socketPath)) && listening;
+        serving = listening && server.start(headless);
+    }
+    for (const string& source : ingestSources) {
+        string result;
+        if (!home.startIngest(source, result)) {
+            cout << "Error: " << result << ".\n";
+        }
+    }
+    home.startBehaviors();  // Timers, schedules and sensor sampling; after the server has blocked its signals
+
+    if (headless && serving) {
+        server.wait();
+    }
+    else {
+        home.run();
+    }
+    server.stop();
     return 0;
 }
\ No newline at end of file
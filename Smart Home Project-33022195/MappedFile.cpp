@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Constructor: Creates an empty mapping; call open() to map a file.
+#ifdef _WIN32
+MappedFile::MappedFile()
+    : view(nullptr), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(nullptr) {}
+#else
+MappedFile::MappedFile() : view(nullptr), length(0), fd(-1) {}
+#endif
+
+// Destructor: Unmaps the file and closes its handles.
+MappedFile::~MappedFile() {
+    close();
+}
+
+// Maps a whole file read-only into memory.
+// Returns false if the file cannot be opened or mapped. An empty file opens successfully
+// with size() == 0 and no mapping, since zero-length mappings are not allowed.
+bool MappedFile::open(const string& fileName) {
+    close();
+#ifdef _WIN32
+    fileHandle = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(fileHandle, &fileSize)) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0) return true;
+
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle) {
+        close();
+        return false;
+    }
+    view = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+#else
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(info.st_size);
+    if (length == 0) return true;
+
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapped == MAP_FAILED) {
+        close();
+        return false;
+    }
+    madvise(mapped, length, MADV_SEQUENTIAL);
+    view = static_cast<const char*>(mapped);
+#endif
+    if (!view) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Unmaps the file and releases its handles. Safe to call on an unopened mapping.
+void MappedFile::close() {
+#ifdef _WIN32
+    if (view) UnmapViewOfFile(view);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle = INVALID_HANDLE_VALUE;
+#else
+    if (view) munmap(const_cast<char*>(view), length);
+    if (fd >= 0) ::close(fd);
+    fd = -1;
+#endif
+    view = nullptr;
+    length = 0;
+}
+
+// Returns the start of the mapped contents (nullptr for an empty or unopened file).
+const char* MappedFile::data() const {
+    return view;
+}
+
+// Returns the size of the mapped file in bytes.
+size_t MappedFile::size() const {
+    return length;
+}
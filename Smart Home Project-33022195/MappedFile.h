@@ -0,0 +1,28 @@
+#pragma once
+#include <string>
+#include <cstddef>
+
+using namespace std;
+
+class MappedFile {
+private:
+    const char* view;       // Start of the mapped file contents
+    size_t length;          // Size of the file in bytes
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#else
+    int fd;
+#endif
+
+public:
+    MappedFile();
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const string& fileName);
+    void close();
+    const char* data() const;
+    size_t size() const;
+};
@@ -0,0 +1,190 @@
+#include "MemoryAccount.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cctype>
+
+using namespace std;
+
+// Program-wide totals and caps, per subsystem
+static atomic<int64_t> totals[MemoryAccount::SUBSYSTEMS];
+static atomic<size_t> caps[MemoryAccount::SUBSYSTEMS];
+static atomic<size_t> deviceCap{ 0 };
+static atomic<bool> overCap{ false };
+
+// Constructor: Starts with nothing charged.
+MemoryAccount::MemoryAccount() {
+    for (auto& amount : bytes) {
+        amount.store(0, memory_order_relaxed);
+    }
+}
+
+// Destructor: Releases from the totals whatever is still charged. Containers have given their
+// memory back by now; strings charged by size and behavior frames still waiting to be reclaimed
+// have not. Frames release their own share when they are freed.
+MemoryAccount::~MemoryAccount() {
+    for (int i = 0; i < SUBSYSTEMS; ++i) {
+        if (i != static_cast<int>(MemorySubsystem::Behaviors)) {
+            totals[i].fetch_sub(bytes[i].load(memory_order_relaxed), memory_order_relaxed);
+        }
+    }
+}
+
+// Adds bytes (or releases them, if negative) to the program-wide total and to the account, if
+// there is one. Growth of history or schedules beyond a cap raises the flag the home checks.
+void MemoryAccount::charge(MemoryAccount* account, MemorySubsystem subsystem, int64_t bytes) {
+    int i = static_cast<int>(subsystem);
+    int64_t total = totals[i].fetch_add(bytes, memory_order_relaxed) + bytes;
+    if (account) {
+        account->bytes[i].fetch_add(static_cast<int32_t>(bytes), memory_order_relaxed);
+    }
+    if (bytes <= 0 || (subsystem != MemorySubsystem::History && subsystem != MemorySubsystem::Schedules)) return;
+
+    size_t cap = caps[i].load(memory_order_relaxed);
+    size_t perDevice = deviceCap.load(memory_order_relaxed);
+    if ((cap && total > static_cast<int64_t>(cap)) || (perDevice && account && account->total() > perDevice)) {
+        overCap.store(true, memory_order_relaxed);
+    }
+}
+
+// Sets the amount charged under a subsystem, charging the totals with the difference.
+void MemoryAccount::set(MemorySubsystem subsystem, size_t amount) {
+    int i = static_cast<int>(subsystem);
+    int32_t previous = bytes[i].exchange(static_cast<int32_t>(amount), memory_order_relaxed);
+    totals[i].fetch_add(static_cast<int64_t>(amount) - previous, memory_order_relaxed);
+}
+
+// Takes bytes off the account but not off the totals: the memory is still held, but by something
+// that no longer belongs to the device (such as a cancelled behavior waiting to be reclaimed).
+void MemoryAccount::detach(MemorySubsystem subsystem, size_t amount) {
+    bytes[static_cast<int>(subsystem)].fetch_sub(static_cast<int32_t>(amount), memory_order_relaxed);
+}
+
+// Returns the bytes charged under a subsystem.
+size_t MemoryAccount::get(MemorySubsystem subsystem) const {
+    int32_t amount = bytes[static_cast<int>(subsystem)].load(memory_order_relaxed);
+    return amount > 0 ? static_cast<size_t>(amount) : 0;
+}
+
+// Returns the bytes charged under every subsystem together.
+size_t MemoryAccount::total() const {
+    size_t sum = 0;
+    for (int i = 0; i < SUBSYSTEMS; ++i) {
+        sum += get(static_cast<MemorySubsystem>(i));
+    }
+    return sum;
+}
+
+// Returns the program-wide bytes held by a subsystem.
+size_t MemoryAccount::globalTotal(MemorySubsystem subsystem) {
+    int64_t total = totals[static_cast<int>(subsystem)].load(memory_order_relaxed);
+    return total > 0 ? static_cast<size_t>(total) : 0;
+}
+
+// Caps the program-wide bytes of a subsystem; 0 removes the cap.
+void MemoryAccount::setCap(MemorySubsystem subsystem, size_t bytes) {
+    caps[static_cast<int>(subsystem)] = bytes;
+    if (bytes && globalTotal(subsystem) > bytes) overCap = true;
+}
+
+// Returns a subsystem's cap, or 0 if it has none.
+size_t MemoryAccount::getCap(MemorySubsystem subsystem) {
+    return caps[static_cast<int>(subsystem)];
+}
+
+// Caps the bytes any one device may hold; 0 removes the cap.
+void MemoryAccount::setDeviceCap(size_t bytes) {
+    deviceCap = bytes;
+    if (bytes) overCap = true;  // Devices already over it are only found by looking
+}
+
+// Returns the per-device cap, or 0 if there is none.
+size_t MemoryAccount::getDeviceCap() {
+    return deviceCap;
+}
+
+// Returns true if any subsystem or per-device cap is set.
+bool MemoryAccount::hasCaps() {
+    if (deviceCap.load(memory_order_relaxed)) return true;
+    for (const auto& cap : caps) {
+        if (cap.load(memory_order_relaxed)) return true;
+    }
+    return false;
+}
+
+// Returns true, and clears the flag, if a cap was exceeded since the last call.
+bool MemoryAccount::takeOverCap() {
+    return overCap.load(memory_order_relaxed) && overCap.exchange(false);
+}
+
+// Returns the name of a subsystem as used by the mem command.
+const char* MemoryAccount::subsystemName(MemorySubsystem subsystem) {
+    switch (subsystem) {
+    case MemorySubsystem::History: return "history";
+    case MemorySubsystem::Schedules: return "schedules";
+    case MemorySubsystem::Behaviors: return "behaviors";
+    case MemorySubsystem::Records: return "records";
+    case MemorySubsystem::Attributes: return "attributes";
+    case MemorySubsystem::Images: return "images";
+    default: return "unknown";
+    }
+}
+
+// Parses a subsystem name. Returns false if there is no subsystem of that name.
+bool MemoryAccount::parseSubsystem(const string& text, MemorySubsystem& subsystem) {
+    for (int i = 0; i < SUBSYSTEMS; ++i) {
+        if (text == subsystemName(static_cast<MemorySubsystem>(i))) {
+            subsystem = static_cast<MemorySubsystem>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses a size in bytes with an optional K, M or G suffix (powers of 1024), such as "64M".
+// Returns false if the text is not a size.
+bool MemoryAccount::parseSize(const string& text, size_t& bytes) {
+    if (text.empty()) return false;
+    char* end = nullptr;
+    double value = strtod(text.c_str(), &end);
+    double scale = 1;
+    if (*end) {
+        switch (toupper(static_cast<unsigned char>(*end))) {
+        case 'K': scale = 1024.0; break;
+        case 'M': scale = 1024.0 * 1024; break;
+        case 'G': scale = 1024.0 * 1024 * 1024; break;
+        default: return false;
+        }
+        ++end;
+        if (*end == 'B' || *end == 'b') ++end;
+    }
+    if (*end || end == text.c_str() || value < 0) return false;
+    bytes = static_cast<size_t>(value * scale);
+    return true;
+}
+
+// Formats a size for display, such as "512 B", "4.0 KB" or "1.2 MB".
+string MemoryAccount::formatSize(size_t bytes) {
+    char text[32];
+    if (bytes < 1024) {
+        snprintf(text, sizeof(text), "%zu B", bytes);
+    }
+    else if (bytes < 1024 * 1024) {
+        snprintf(text, sizeof(text), "%.1f KB", bytes / 1024.0);
+    }
+    else if (bytes < 1024ull * 1024 * 1024) {
+        snprintf(text, sizeof(text), "%.1f MB", bytes / (1024.0 * 1024));
+    }
+    else {
+        snprintf(text, sizeof(text), "%.2f GB", bytes / (1024.0 * 1024 * 1024));
+    }
+    return text;
+}
+
+// Returns the heap memory a string holds beyond the string object itself: nothing while the
+// text fits in the object (short-string optimization), otherwise its capacity.
+size_t MemoryAccount::heapBytes(const string& text) {
+    const char* data = text.data();
+    const char* object = reinterpret_cast<const char*>(&text);
+    if (data >= object && data < object + sizeof(string)) return 0;
+    return text.capacity() + 1;
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+enum class MemorySubsystem {
+    History,        // Buffered history samples and the history logs themselves
+    Schedules,      // Schedule entries and recurring rules
+    Behaviors,      // Coroutine frames of running behaviors
+    Records,        // Stored records kept until a lazily loaded device is first used
+    Attributes,     // Room and tags
+    Images,         // Stored device images shared by the store and snapshots (program-wide only)
+    Count
+};
+
+// Heap memory held by one device, per subsystem, plus program-wide totals per subsystem.
+// Containers charge it through AccountedAllocator; a few strings are charged by size instead.
+// Caps on the totals, or on any one device, raise a flag that the home checks periodically
+// (see SmartHome::watchMemory); only history and schedules can be given back.
+class MemoryAccount {
+public:
+    static const int SUBSYSTEMS = static_cast<int>(MemorySubsystem::Count);
+
+    MemoryAccount();
+    ~MemoryAccount();                                     // Releases what is still charged, such as strings
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+    static void charge(MemoryAccount* account, MemorySubsystem subsystem, int64_t bytes);  // Negative to release
+    void set(MemorySubsystem subsystem, size_t bytes);     // Charges the difference from the current amount
+    void detach(MemorySubsystem subsystem, size_t bytes); // No longer this account's; still in the totals
+    size_t get(MemorySubsystem subsystem) const;
+    size_t total() const;
+
+    static size_t globalTotal(MemorySubsystem subsystem);
+    static void setCap(MemorySubsystem subsystem, size_t bytes);  // 0 removes the cap
+    static size_t getCap(MemorySubsystem subsystem);
+    static void setDeviceCap(size_t bytes);
+    static size_t getDeviceCap();
+    static bool hasCaps();                                // True if any cap is set
+    static bool takeOverCap();                            // True once after a cap was exceeded
+
+    static const char* subsystemName(MemorySubsystem subsystem);
+    static bool parseSubsystem(const string& text, MemorySubsystem& subsystem);
+    static bool parseSize(const string& text, size_t& bytes);   // "4096", "64K", "1.5M", "2G"
+    static string formatSize(size_t bytes);
+    static size_t heapBytes(const string& text);          // Heap memory a string holds beyond itself
+
+private:
+    atomic<int32_t> bytes[SUBSYSTEMS];    // 32 bits per device keeps the account small
+};
+
+// Standard allocator that charges what it allocates to a device's account under one subsystem.
+// A null account charges only the program-wide totals.
+template <typename T>
+class AccountedAllocator {
+public:
+    using value_type = T;
+
+    AccountedAllocator(MemoryAccount* account = nullptr, MemorySubsystem subsystem = MemorySubsystem::Schedules) noexcept
+        : account(account), subsystem(subsystem) {}
+    template <typename U>
+    AccountedAllocator(const AccountedAllocator<U>& other) noexcept
+        : account(other.account), subsystem(other.subsystem) {}
+
+    T* allocate(size_t count) {
+        T* memory = allocator<T>().allocate(count);
+        MemoryAccount::charge(account, subsystem, static_cast<int64_t>(count * sizeof(T)));
+        return memory;
+    }
+
+    void deallocate(T* memory, size_t count) noexcept {
+        MemoryAccount::charge(account, subsystem, -static_cast<int64_t>(count * sizeof(T)));
+        allocator<T>().deallocate(memory, count);
+    }
+
+    template <typename U>
+    bool operator==(const AccountedAllocator<U>& other) const noexcept {
+        return account == other.account && subsystem == other.subsystem;
+    }
+
+    MemoryAccount* account;
+    MemorySubsystem subsystem;
+};
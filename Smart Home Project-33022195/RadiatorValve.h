@@ -1,34 +1,32 @@
-#pragma once
-#include "SmartDevice.h"
-#include <vector>
-
-using namespace std;
-
-class RadiatorValve : public SmartDevice {
-private:
-    struct Schedule {
-        int hour;           // Hour in 24-hour format
-        int minute;         // Minute
-        string state;       // "ON" or "OFF"
-    };
-
-    vector<Schedule> schedules;  // List of schedules
-
-    void saveScheduleToFile() const;  // Save to file
-    void loadScheduleFromFile();      // Load from file
-
-public:
-    RadiatorValve(const string& name);
-    ~RadiatorValve();
-
-    void showMenu() const override;
-    void handleMenuChoice(int choice) override;
-    void manageSchedule();  // Schedule management menu
-    void viewSchedule() const;
-    void deleteSchedule();
-    string getQuickView() const override;
-    void oneClickAction() override;
-    string getDeviceType() const override;
-    string serialize() const override;
-    void deserialize(const string& data) override;
-};
+#pragma once
+#include "ScheduledDevice.h"
+#include <vector>
+
+using namespace std;
+
+class RadiatorValve : public ScheduledDevice {
+private:
+    float targetTemperature;     // Target temperature in C
+
+
+public:
+    static constexpr const char* TAG = "RADIATOR";  // Serialized type tag
+
+    RadiatorValve(const string& name);
+    ~RadiatorValve();
+
+    void showMenu() const override;
+    void handleMenuChoice(int choice) override;
+    void manageSchedule();  // Schedule management menu
+    void viewSchedule() const;
+    void deleteSchedule();
+    string getQuickView() const override;
+    void oneClickAction() override;
+    bool applySetting(DeviceAttribute attribute, double value) override;
+    bool getSetting(DeviceAttribute attribute, double& value) const override;
+    float getTargetTemperature() const;
+    string getDeviceType() const override;
+    const char* getTypeTag() const override;
+    string serialize() const override;
+    void deserialize(const string& data) override;
+};
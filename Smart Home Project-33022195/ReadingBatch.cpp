@@ -0,0 +1,198 @@
+#include "ReadingBatch.h"
+#include <cstring>
+#include <cstdlib>
+
+using namespace std;
+
+static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                        1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18 };
+
+// Constructor: Creates an empty batch.
+ReadingBatch::ReadingBatch() : rejected(0), unknown(0) {}
+
+// Empties the batch for the next block, keeping its memory.
+void ReadingBatch::clear() {
+    names.clear();
+    nameOf.clear();
+    readings.clear();
+    nameIndex.clear();
+    escapedNames.clear();
+    rejected = 0;
+    firstError.clear();
+    unknown = 0;
+}
+
+// Counts a malformed line, keeping the reason for the first one.
+void ReadingBatch::reject(const char* reason) {
+    if (rejected++ == 0) firstError = reason;
+}
+
+// Helper function: Returns true if c is a decimal digit, with one comparison.
+static bool isDigit(char c) {
+    return static_cast<unsigned>(c - '0') < 10;
+}
+
+// Helper function: Parses a number such as "-21.4", "48" or "48i" (a line protocol integer),
+// moving p past it. Plain decimals are read digit by digit into an integer and scaled once;
+// anything longer or with an exponent is left to strtod. Returns false if there is no number.
+static bool parseNumber(const char*& p, const char* end, double& value) {
+    const char* start = p;
+    bool negative = p < end && *p == '-';
+    p += (p < end && (*p == '-' || *p == '+')) ? 1 : 0;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int decimals = 0;
+    while (p < end && isDigit(*p)) {
+        mantissa = mantissa * 10 + static_cast<unsigned>(*p++ - '0');
+        ++digits;
+    }
+    if (p < end && *p == '.') {
+        ++p;
+        while (p < end && isDigit(*p)) {
+            mantissa = mantissa * 10 + static_cast<unsigned>(*p++ - '0');
+            ++digits;
+            ++decimals;
+        }
+    }
+    if (digits == 0) return false;
+
+    if (digits > 18 || (p < end && (*p == 'e' || *p == 'E'))) {
+        string text(start, end);                 // Rare, so the copy does not matter
+        char* stop = nullptr;
+        value = strtod(text.c_str(), &stop);
+        p = start + (stop - text.c_str());
+        return true;
+    }
+    value = static_cast<double>(mantissa) / POWERS_OF_TEN[decimals];
+    value = negative ? -value : value;
+    p += (p < end && (*p == 'i' || *p == 'u')) ? 1 : 0;
+    return true;
+}
+
+// Helper function: Converts a timestamp to seconds, going by its size: seconds until the year
+// 5138, then milliseconds, microseconds and nanoseconds.
+static time_t toSeconds(uint64_t timestamp) {
+    if (timestamp < 100000000000ull) return static_cast<time_t>(timestamp);
+    if (timestamp < 100000000000000ull) return static_cast<time_t>(timestamp / 1000);
+    if (timestamp < 100000000000000000ull) return static_cast<time_t>(timestamp / 1000000);
+    return static_cast<time_t>(timestamp / 1000000000);
+}
+
+// Parses the whole lines at the start of data and adds their readings. A last line without its
+// '\n' is left for the next call, with more text after it. Returns the number of bytes used.
+size_t ReadingBatch::parse(const char* data, size_t size, time_t now) {
+    const char* p = data;
+    const char* end = data + size;
+    while (p < end) {
+        const char* newline = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+        if (!newline) break;
+        const char* lineEnd = newline > p && newline[-1] == '\r' ? newline - 1 : newline;
+        if (lineEnd > p && *p != '#') {
+            parseLine(p, lineEnd, now);
+        }
+        p = newline + 1;
+    }
+    return static_cast<size_t>(p - data);
+}
+
+// Parses one non-empty line. Returns false (counting it as rejected) if it is malformed.
+bool ReadingBatch::parseLine(const char* p, const char* end, time_t now) {
+    // The name runs to the first unescaped space; escapes are rare, so they take a slower path
+    const char* space = static_cast<const char*>(memchr(p, ' ', static_cast<size_t>(end - p)));
+    if (!space) {
+        reject("expected a name and fields");
+        return false;
+    }
+    string_view name;
+    if (!memchr(p, '\\', static_cast<size_t>(space - p))) {
+        const char* comma = static_cast<const char*>(memchr(p, ',', static_cast<size_t>(space - p)));
+        name = string_view(p, static_cast<size_t>((comma ? comma : space) - p));
+        p = space + 1;
+    }
+    else {
+        unescaped.clear();
+        bool inTags = false;
+        while (p < end && *p != ' ') {
+            if (*p == '\\' && p + 1 < end) ++p;
+            else if (*p == ',') inTags = true;
+            if (!inTags) unescaped += *p;
+            ++p;
+        }
+        name = unescaped;
+        p += p < end ? 1 : 0;
+    }
+    if (name.empty()) {
+        reject("empty device name");
+        return false;
+    }
+
+    // Fields: key=value pairs separated by commas, up to the next space
+    double temperature = 0;
+    double humidity = 0;
+    bool hasTemperature = false;
+    bool hasHumidity = false;
+    while (p < end) {
+        const char* key = p;
+        const char* equals = static_cast<const char*>(memchr(p, '=', static_cast<size_t>(end - p)));
+        if (!equals) {
+            reject("expected key=value fields");
+            return false;
+        }
+        size_t keyLength = static_cast<size_t>(equals - key);
+        p = equals + 1;
+        double value;
+        bool isTemperature = (keyLength == 4 && memcmp(key, "temp", 4) == 0) || (keyLength == 11 && memcmp(key, "temperature", 11) == 0);
+        bool isHumidity = (keyLength == 3 && memcmp(key, "hum", 3) == 0) || (keyLength == 8 && memcmp(key, "humidity", 8) == 0);
+        if (isTemperature || isHumidity) {
+            if (!parseNumber(p, end, value)) {
+                reject("invalid number");
+                return false;
+            }
+            (isTemperature ? temperature : humidity) = value;
+            (isTemperature ? hasTemperature : hasHumidity) = true;
+        }
+        else {
+            while (p < end && *p != ',' && *p != ' ') ++p;  // A field we do not use
+        }
+        if (p < end && *p == ',') {
+            ++p;
+            continue;
+        }
+        break;
+    }
+    if (!hasTemperature || !hasHumidity) {
+        reject("needs temp and hum fields");
+        return false;
+    }
+
+    time_t timestamp = now;
+    if (p < end && *p == ' ') {
+        ++p;
+        uint64_t value = 0;
+        const char* digits = p;
+        while (p < end && isDigit(*p)) {
+            value = value * 10 + static_cast<unsigned>(*p++ - '0');
+        }
+        if (p == digits || p - digits > 19) {
+            reject("invalid timestamp");
+            return false;
+        }
+        timestamp = toSeconds(value);
+    }
+    if (p != end) {
+        reject("unexpected text after the fields");
+        return false;
+    }
+
+    auto it = nameIndex.find(name);
+    if (it == nameIndex.end()) {
+        if (name.data() == unescaped.data()) {
+            name = escapedNames.emplace_back(name);  // The scratch space is reused by the next line
+        }
+        it = nameIndex.emplace(name, static_cast<uint32_t>(names.size())).first;
+        names.emplace_back(name);
+    }
+    nameOf.push_back(it->second);
+    readings.push_back({ static_cast<int64_t>(timestamp), static_cast<float>(temperature), static_cast<float>(humidity) });
+    return true;
+}
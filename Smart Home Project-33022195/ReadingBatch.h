@@ -0,0 +1,41 @@
+#pragma once
+#include "HistoryLog.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <unordered_map>
+#include <deque>
+#include <cstdint>
+#include <ctime>
+
+using namespace std;
+
+// Sensor readings in line protocol, parsed a block of text at a time for SensorIngest and
+// recorded by SmartHome::applyReadings(). Each line is
+//   <device name> temp=<degrees C>,hum=<percent> [<timestamp>]
+// for example "Hall\ Sensor temp=21.4,hum=48 1700000000". Spaces and commas in the name are
+// escaped with '\'; tags after an unescaped comma in the name and unknown fields are ignored;
+// the timestamp is in seconds, milliseconds, microseconds or nanoseconds since 1970 (told apart
+// by size) and defaults to the time the block is parsed. Blank lines and '#' comments are skipped.
+class ReadingBatch {
+public:
+    vector<string> names;                    // Distinct device names in the batch, in order of first use
+    vector<uint32_t> nameOf;                 // Per reading: index into names
+    vector<HistoryLog::Sample> readings;     // Temperature as the value, humidity as the extra
+    size_t rejected;                         // Malformed lines
+    string firstError;                       // Why the first malformed line was rejected
+    size_t unknown;                          // Readings for names that are not sensors (set when applied)
+
+    ReadingBatch();
+
+    void clear();
+    size_t parse(const char* data, size_t size, time_t now);  // Parses whole lines; returns the bytes used
+
+private:
+    unordered_map<string_view, uint32_t> nameIndex;  // Views into the text being parsed or escapedNames
+    deque<string> escapedNames;                      // Names that had escapes, at stable addresses
+    string unescaped;                                // Scratch space for the name being unescaped
+
+    bool parseLine(const char* p, const char* end, time_t now);
+    void reject(const char* reason);
+};
@@ -0,0 +1,290 @@
+#include "RecurrenceRule.h"
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <climits>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
+
+using namespace std;
+
+static const char* DAY_NAMES[] = { "sun", "mon", "tue", "wed", "thu", "fri", "sat" };
+static const uint8_t EVERY_DAY = 0x7F;
+static const uint8_t WEEKDAYS = 0x3E;
+static const uint8_t WEEKENDS = 0x41;
+
+// Helper function: Returns the calendar date of a number of days since 1970-01-01.
+static void civilFromDays(int32_t days, int& year, int& month, int& day) {
+    days += 719468;
+    int era = (days >= 0 ? days : days - 146096) / 146097;
+    int dayOfEra = days - era * 146097;
+    int yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int shiftedMonth = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shiftedMonth + 2) / 5 + 1;
+    month = shiftedMonth + (shiftedMonth < 10 ? 3 : -9);
+    year = yearOfEra + era * 400 + (month <= 2);
+}
+
+// Helper function: Converts a local date and minute of day to a time.
+static time_t localTime(int32_t days, int minuteOfDay) {
+    tm local = {};
+    civilFromDays(days, local.tm_year, local.tm_mon, local.tm_mday);
+    local.tm_year -= 1900;
+    local.tm_mon -= 1;
+    local.tm_hour = minuteOfDay / 60;
+    local.tm_min = minuteOfDay % 60;
+    local.tm_isdst = -1;  // Let the library work out daylight saving time
+    return mktime(&local);
+}
+
+// Helper function: Parses a "YYYY-MM-DD" date into days since 1970-01-01.
+static bool parseDate(const string& text, int32_t& days) {
+    int year, month, day;
+    char end;
+    if (sscanf(text.c_str(), "%d-%d-%d%c", &year, &month, &day, &end) != 3) return false;
+    if (month < 1 || month > 12 || day < 1 || day > 31) return false;
+    days = RecurrenceRule::daysFromCivil(year, month, day);
+    int checkYear, checkMonth, checkDay;
+    civilFromDays(days, checkYear, checkMonth, checkDay);
+    return checkMonth == month && checkDay == day;  // Rejects dates such as 2026-02-30
+}
+
+// Helper function: Parses an "HH:MM" time into a minute of day.
+static bool parseClock(const string& text, int& minuteOfDay) {
+    int hour, minute;
+    char end;
+    if (sscanf(text.c_str(), "%d:%d%c", &hour, &minute, &end) != 2) return false;
+    if (hour < 0 || hour >= 24 || minute < 0 || minute >= 60) return false;
+    minuteOfDay = hour * 60 + minute;
+    return true;
+}
+
+// Helper function: Parses days such as "daily", "weekdays", "weekends", "mon,wed" or "fri-mon".
+static bool parseDays(const string& text, uint8_t& mask) {
+    if (text == "daily") mask = EVERY_DAY;
+    else if (text == "weekdays") mask = WEEKDAYS;
+    else if (text == "weekends") mask = WEEKENDS;
+    else {
+        mask = 0;
+        stringstream ss(text);
+        string part;
+        while (getline(ss, part, ',')) {
+            size_t dash = part.find('-');
+            string first = part.substr(0, dash);
+            string last = dash == string::npos ? first : part.substr(dash + 1);
+            auto from = find(begin(DAY_NAMES), end(DAY_NAMES), first);
+            auto to = find(begin(DAY_NAMES), end(DAY_NAMES), last);
+            if (from == end(DAY_NAMES) || to == end(DAY_NAMES)) return false;
+            for (int day = static_cast<int>(from - begin(DAY_NAMES)); ; day = (day + 1) % 7) {
+                mask |= static_cast<uint8_t>(1 << day);
+                if (day == to - begin(DAY_NAMES)) break;
+            }
+        }
+    }
+    return mask != 0;
+}
+
+// Helper function: Formats days since 1970-01-01 as "YYYY-MM-DD".
+static string formatDate(int32_t days) {
+    int year, month, day;
+    civilFromDays(days, year, month, day);
+    char text[16];
+    snprintf(text, sizeof(text), "%04d-%02d-%02d", year, month, day);
+    return text;
+}
+
+// Helper function: Formats a minute of day as "HH:MM".
+static string formatClock(int minuteOfDay) {
+    char text[8];
+    snprintf(text, sizeof(text), "%02d:%02d", minuteOfDay / 60, minuteOfDay % 60);
+    return text;
+}
+
+// Constructor: Creates a rule that switches on at midnight every day.
+RecurrenceRule::RecurrenceRule()
+    : on(true), weekdays(EVERY_DAY), firstDay(INT32_MIN), lastDay(INT32_MAX),
+    startMinute(0), endMinute(0), interval(0), once(0) {}
+
+// Parses a rule: "on" or "off", then one of
+//   HH:MM                          once a day
+//   every N[m|h] HH:MM-HH:MM       every N minutes (or hours) between the two times
+//   once YYYY-MM-DD HH:MM          a single time (nothing may follow)
+// optionally followed by the days ("daily", the default, "weekdays", "weekends", or names such
+// as "mon,wed,fri" and "mon-fri"), "from YYYY-MM-DD" and "to YYYY-MM-DD" (both inclusive).
+// Returns false with a reason in error if the text is not a valid rule.
+bool RecurrenceRule::parse(const string& text, RecurrenceRule& rule, string& error) {
+    string lower = text;
+    transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    stringstream ss(lower);
+    vector<string> words;
+    string word;
+    while (ss >> word) words.push_back(word);
+
+    rule = RecurrenceRule();
+    size_t i = 0;
+    if (words.empty() || (words[0] != "on" && words[0] != "off")) {
+        error = "a rule starts with on or off";
+        return false;
+    }
+    rule.on = words[i++] == "on";
+
+    int minute = 0;
+    if (i < words.size() && words[i] == "once") {
+        int32_t day;
+        if (i + 3 != words.size() || !parseDate(words[i + 1], day) || !parseClock(words[i + 2], minute)) {
+            error = "expected once YYYY-MM-DD HH:MM";
+            return false;
+        }
+        rule.once = localTime(day, minute);
+        return true;
+    }
+
+    if (i < words.size() && words[i] == "every") {
+        int count = 0;
+        char unit = 'm', end;
+        int fields = i + 1 < words.size() ? sscanf(words[i + 1].c_str(), "%d%c%c", &count, &unit, &end) : 0;
+        int perUnit = unit == 'h' ? 60 : 1;
+        int first, last;
+        size_t dash = i + 2 < words.size() ? words[i + 2].find('-') : string::npos;
+        if (fields < 1 || fields > 2 || (unit != 'm' && unit != 'h') || count <= 0 || count * perUnit >= 24 * 60
+            || dash == string::npos || !parseClock(words[i + 2].substr(0, dash), first)
+            || !parseClock(words[i + 2].substr(dash + 1), last) || last < first) {
+            error = "expected every N[m|h] HH:MM-HH:MM";
+            return false;
+        }
+        rule.interval = static_cast<uint16_t>(count * perUnit);
+        rule.startMinute = static_cast<uint16_t>(first);
+        rule.endMinute = static_cast<uint16_t>(last);
+        i += 3;
+    }
+    else if (i < words.size() && parseClock(words[i], minute)) {
+        rule.startMinute = rule.endMinute = static_cast<uint16_t>(minute);
+        ++i;
+    }
+    else {
+        error = "expected a time (HH:MM), every or once";
+        return false;
+    }
+
+    while (i < words.size()) {
+        if ((words[i] == "from" || words[i] == "to") && i + 1 < words.size()) {
+            int32_t& bound = words[i] == "from" ? rule.firstDay : rule.lastDay;
+            if (!parseDate(words[i + 1], bound)) {
+                error = "invalid date " + words[i + 1];
+                return false;
+            }
+            i += 2;
+        }
+        else if (!parseDays(words[i++], rule.weekdays)) {
+            error = "invalid days " + words[i - 1];
+            return false;
+        }
+    }
+    if (rule.lastDay < rule.firstDay) {
+        error = "the rule ends before it starts";
+        return false;
+    }
+    return true;
+}
+
+// Formats the rule in the form parse() reads.
+string RecurrenceRule::toString() const {
+    string text = on ? "on" : "off";
+    if (once) {
+        tm local;
+#ifdef _MSC_VER
+        localtime_s(&local, &once);
+#else
+        localtime_r(&once, &local);
+#endif
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M", &local);
+        return text + " once " + stamp;
+    }
+
+    if (interval) {
+        string every = interval % 60 == 0 ? to_string(interval / 60) + "h" : to_string(interval) + "m";
+        text += " every " + every + " " + formatClock(startMinute) + "-" + formatClock(endMinute);
+    }
+    else {
+        text += " " + formatClock(startMinute);
+    }
+    if (weekdays == EVERY_DAY) text += " daily";
+    else if (weekdays == WEEKDAYS) text += " weekdays";
+    else if (weekdays == WEEKENDS) text += " weekends";
+    else {
+        string days;
+        for (int i = 1; i <= 7; ++i) {  // Monday first
+            if ((weekdays >> (i % 7)) & 1) days += (days.empty() ? "" : ",") + string(DAY_NAMES[i % 7]);
+        }
+        text += " " + days;
+    }
+    if (firstDay != INT32_MIN) text += " from " + formatDate(firstDay);
+    if (lastDay != INT32_MAX) text += " to " + formatDate(lastDay);
+    return text;
+}
+
+// Works out the rule's next firing strictly after the given time, or 0 if it never fires again.
+// Only the days from then on are looked at, and a week always contains a day the rule applies
+// on, so the cost does not depend on how long the rule runs for.
+time_t RecurrenceRule::nextAfter(time_t after) const {
+    if (once) return once > after ? once : 0;
+
+    tm local;
+#ifdef _MSC_VER
+    localtime_s(&local, &after);
+#else
+    localtime_r(&after, &local);
+#endif
+    int32_t day = daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday);
+    int fromMinute = local.tm_hour * 60 + local.tm_min + 1;
+    if (day < firstDay) {
+        day = firstDay;
+        fromMinute = 0;
+    }
+
+    // A week covers every weekday; the extra days allow for times skipped by daylight saving
+    for (int tries = 0; tries < 9; ++tries, ++day, fromMinute = 0) {
+        if (day > lastDay) return 0;
+        if (!((weekdays >> weekdayOf(day)) & 1)) continue;
+
+        int minute = max(fromMinute, static_cast<int>(startMinute));
+        if (interval) {
+            minute = startMinute + (minute - startMinute + interval - 1) / interval * interval;
+        }
+        for (; minute <= endMinute; minute += interval ? interval : 24 * 60) {
+            time_t candidate = localTime(day, minute);
+            if (candidate > after) return candidate;
+        }
+    }
+    return 0;
+}
+
+// Returns true if the rule switches the device on, false if it switches it off.
+bool RecurrenceRule::switchesOn() const {
+    return on;
+}
+
+// Returns true if both rules fire at the same times with the same effect.
+bool RecurrenceRule::operator==(const RecurrenceRule& other) const {
+    return on == other.on && weekdays == other.weekdays && firstDay == other.firstDay && lastDay == other.lastDay
+        && startMinute == other.startMinute && endMinute == other.endMinute && interval == other.interval
+        && once == other.once;
+}
+
+// Returns the number of days from 1970-01-01 to a calendar date.
+int32_t RecurrenceRule::daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    int era = (year >= 0 ? year : year - 399) / 400;
+    int yearOfEra = year - era * 400;
+    int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Returns the day of the week (0 = Sunday) of a number of days since 1970-01-01.
+int RecurrenceRule::weekdayOf(int32_t days) {
+    return days >= -4 ? (days + 4) % 7 : (days + 5) % 7 + 6;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <string>
+#include <cstdint>
+#include <ctime>
+
+using namespace std;
+
+// A recurring (or one-off) instruction to switch a device on or off, such as
+// "on 07:30 mon-fri", "on every 15m 08:00-18:00 weekends from 2026-12-01 to 2027-01-06"
+// or "off once 2026-12-24 18:00". Occurrences are never listed out; nextAfter() works out
+// the next one from the rule alone.
+class RecurrenceRule {
+private:
+    bool on;                 // Switches the device on (true) or off
+    uint8_t weekdays;        // Days it applies on, bit 0 = Sunday ... bit 6 = Saturday
+    int32_t firstDay;        // First date it applies on, in days since 1970-01-01 (INT32_MIN: no start)
+    int32_t lastDay;         // Last date it applies on (INT32_MAX: no end)
+    uint16_t startMinute;    // Minute of day of the first firing
+    uint16_t endMinute;      // Latest minute of day a repeating rule fires
+    uint16_t interval;       // Minutes between firings within the day (0: once a day)
+    time_t once;             // Time of a one-off rule (0 for recurring rules)
+
+public:
+    RecurrenceRule();
+
+    static bool parse(const string& text, RecurrenceRule& rule, string& error);
+    string toString() const;
+    time_t nextAfter(time_t after) const;   // Next firing strictly after the given time, 0 if none
+    bool switchesOn() const;
+    bool operator==(const RecurrenceRule& other) const;
+
+    static int32_t daysFromCivil(int year, int month, int day);  // Days since 1970-01-01
+    static int weekdayOf(int32_t days);                          // 0 = Sunday ... 6 = Saturday
+};
@@ -0,0 +1,303 @@
+#include "RoaringBitmap.h"
+#include <algorithm>
+#include <iterator>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+using namespace std;
+
+// Helper function: Counts the set bits in a word.
+// Plain shifts and masks rather than an intrinsic: without a CPU-specific build flag the intrinsic
+// becomes a library call, and this form lets the compiler vectorize whole-container loops.
+static inline uint32_t popCount(uint64_t word) {
+    word = word - ((word >> 1) & 0x5555555555555555ULL);
+    word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+    word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return static_cast<uint32_t>((word * 0x0101010101010101ULL) >> 56);
+}
+
+// Helper function: Counts the set bits in a container's words.
+// Kept apart from the loops that produce the words so both loops stay simple enough to vectorize.
+static uint32_t countWords(const vector<uint64_t>& words) {
+    uint32_t total = 0;
+    for (uint64_t word : words) {
+        total += popCount(word);
+    }
+    return total;
+}
+
+// Helper function: Returns the index of the lowest set bit of a non-zero word.
+static inline uint32_t lowestBit(uint64_t word) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward64(&index, word);
+    return index;
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(word));
+#endif
+}
+
+// Returns the position of the first container whose key is not less than the given key.
+size_t RoaringBitmap::lowerBound(uint16_t key) const {
+    auto it = lower_bound(containers.begin(), containers.end(), key,
+        [](const Container& container, uint16_t k) { return container.key < k; });
+    return static_cast<size_t>(it - containers.begin());
+}
+
+// Converts a sparse container to a bit set.
+void RoaringBitmap::makeDense(Container& container) {
+    container.words.assign(WORD_COUNT, 0);
+    for (uint16_t low : container.values) {
+        container.words[low >> 6] |= uint64_t(1) << (low & 63);
+    }
+    container.values.clear();
+    container.values.shrink_to_fit();
+}
+
+// Converts a bit set back to a sorted array once few enough values are left.
+void RoaringBitmap::makeSparseIfSmall(Container& container) {
+    if (container.words.empty() || container.count > SPARSE_LIMIT) return;
+    container.values.clear();
+    container.values.reserve(container.count);
+    for (size_t i = 0; i < WORD_COUNT; ++i) {
+        for (uint64_t word = container.words[i]; word; word &= word - 1) {
+            container.values.push_back(static_cast<uint16_t>((i << 6) | lowestBit(word)));
+        }
+    }
+    container.words.clear();
+    container.words.shrink_to_fit();
+}
+
+// Returns true if a container holds the given low 16 bits.
+bool RoaringBitmap::containerHas(const Container& container, uint16_t low) {
+    if (!container.words.empty()) {
+        return (container.words[low >> 6] >> (low & 63)) & 1;
+    }
+    return binary_search(container.values.begin(), container.values.end(), low);
+}
+
+// Adds a value to the set.
+void RoaringBitmap::add(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    uint16_t low = static_cast<uint16_t>(value);
+    size_t i = lowerBound(key);
+    if (i == containers.size() || containers[i].key != key) {
+        containers.insert(containers.begin() + i, Container{ key, 0, {}, {} });
+    }
+
+    Container& container = containers[i];
+    if (!container.words.empty()) {
+        uint64_t& word = container.words[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        container.count += (word & bit) ? 0 : 1;
+        word |= bit;
+        return;
+    }
+
+    auto it = lower_bound(container.values.begin(), container.values.end(), low);
+    if (it != container.values.end() && *it == low) return;
+    container.values.insert(it, low);
+    if (++container.count > SPARSE_LIMIT) {
+        makeDense(container);
+    }
+}
+
+// Removes a value from the set. Containers left empty are dropped.
+void RoaringBitmap::remove(uint32_t value) {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    uint16_t low = static_cast<uint16_t>(value);
+    size_t i = lowerBound(key);
+    if (i == containers.size() || containers[i].key != key) return;
+
+    Container& container = containers[i];
+    if (!container.words.empty()) {
+        uint64_t& word = container.words[low >> 6];
+        uint64_t bit = uint64_t(1) << (low & 63);
+        if (!(word & bit)) return;
+        word &= ~bit;
+        --container.count;
+        makeSparseIfSmall(container);
+    }
+    else {
+        auto it = lower_bound(container.values.begin(), container.values.end(), low);
+        if (it == container.values.end() || *it != low) return;
+        container.values.erase(it);
+        --container.count;
+    }
+
+    if (container.count == 0) {
+        containers.erase(containers.begin() + i);
+    }
+}
+
+// Returns true if the value is in the set.
+bool RoaringBitmap::contains(uint32_t value) const {
+    uint16_t key = static_cast<uint16_t>(value >> 16);
+    size_t i = lowerBound(key);
+    return i < containers.size() && containers[i].key == key && containerHas(containers[i], static_cast<uint16_t>(value));
+}
+
+// Returns the number of values in the set.
+size_t RoaringBitmap::cardinality() const {
+    size_t total = 0;
+    for (const auto& container : containers) {
+        total += container.count;
+    }
+    return total;
+}
+
+// Returns true if the set has no values.
+bool RoaringBitmap::empty() const {
+    return containers.empty();
+}
+
+// Removes every value.
+void RoaringBitmap::clear() {
+    containers.clear();
+}
+
+// Intersects two containers with the same key.
+// Two bit sets are ANDed word by word; otherwise the sparse side is filtered.
+// Results of set operations keep whichever form was cheapest to build, even if small: they are
+// usually short-lived query results, and converting to an array costs more than the operation.
+RoaringBitmap::Container RoaringBitmap::intersect(const Container& a, const Container& b) {
+    Container result{ a.key, 0, {}, {} };
+    if (!a.words.empty() && !b.words.empty()) {
+        result.words.resize(WORD_COUNT);
+        for (size_t i = 0; i < WORD_COUNT; ++i) {
+            result.words[i] = a.words[i] & b.words[i];
+        }
+        result.count = countWords(result.words);
+    }
+    else if (!a.words.empty() || !b.words.empty()) {
+        const Container& sparse = a.words.empty() ? a : b;
+        const Container& dense = a.words.empty() ? b : a;
+        for (uint16_t low : sparse.values) {
+            if ((dense.words[low >> 6] >> (low & 63)) & 1) {
+                result.values.push_back(low);
+            }
+        }
+        result.count = static_cast<uint32_t>(result.values.size());
+    }
+    else {
+        set_intersection(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+            back_inserter(result.values));
+        result.count = static_cast<uint32_t>(result.values.size());
+    }
+    return result;
+}
+
+// Unites two containers with the same key, switching to a bit set when the result is large.
+RoaringBitmap::Container RoaringBitmap::unite(const Container& a, const Container& b) {
+    Container result{ a.key, 0, {}, {} };
+    if (a.words.empty() && b.words.empty() && a.count + b.count <= SPARSE_LIMIT) {
+        set_union(a.values.begin(), a.values.end(), b.values.begin(), b.values.end(),
+            back_inserter(result.values));
+        result.count = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+
+    result.words.assign(WORD_COUNT, 0);
+    for (const Container* side : { &a, &b }) {
+        if (!side->words.empty()) {
+            for (size_t i = 0; i < WORD_COUNT; ++i) result.words[i] |= side->words[i];
+        }
+        else {
+            for (uint16_t low : side->values) result.words[low >> 6] |= uint64_t(1) << (low & 63);
+        }
+    }
+    result.count = countWords(result.words);
+    return result;
+}
+
+// Removes the values of container b from container a (same key).
+RoaringBitmap::Container RoaringBitmap::subtract(const Container& a, const Container& b) {
+    Container result{ a.key, 0, {}, {} };
+    if (a.words.empty()) {
+        for (uint16_t low : a.values) {
+            if (!containerHas(b, low)) result.values.push_back(low);
+        }
+        result.count = static_cast<uint32_t>(result.values.size());
+        return result;
+    }
+
+    result.words = a.words;
+    if (!b.words.empty()) {
+        for (size_t i = 0; i < WORD_COUNT; ++i) result.words[i] &= ~b.words[i];
+    }
+    else {
+        for (uint16_t low : b.values) result.words[low >> 6] &= ~(uint64_t(1) << (low & 63));
+    }
+    result.count = countWords(result.words);
+    return result;
+}
+
+// Returns the values in both sets. Only containers whose keys match are visited.
+RoaringBitmap RoaringBitmap::operator&(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < containers.size() && j < other.containers.size()) {
+        if (containers[i].key < other.containers[j].key) ++i;
+        else if (containers[i].key > other.containers[j].key) ++j;
+        else {
+            Container container = intersect(containers[i++], other.containers[j++]);
+            if (container.count) result.containers.push_back(move(container));
+        }
+    }
+    return result;
+}
+
+// Returns the values in either set.
+RoaringBitmap RoaringBitmap::operator|(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    size_t i = 0, j = 0;
+    while (i < containers.size() || j < other.containers.size()) {
+        if (j == other.containers.size() || (i < containers.size() && containers[i].key < other.containers[j].key)) {
+            result.containers.push_back(containers[i++]);
+        }
+        else if (i == containers.size() || other.containers[j].key < containers[i].key) {
+            result.containers.push_back(other.containers[j++]);
+        }
+        else {
+            result.containers.push_back(unite(containers[i++], other.containers[j++]));
+        }
+    }
+    return result;
+}
+
+// Returns the values in this set but not in the other.
+RoaringBitmap RoaringBitmap::operator-(const RoaringBitmap& other) const {
+    RoaringBitmap result;
+    size_t j = 0;
+    for (const auto& container : containers) {
+        while (j < other.containers.size() && other.containers[j].key < container.key) ++j;
+        if (j == other.containers.size() || other.containers[j].key != container.key) {
+            result.containers.push_back(container);
+            continue;
+        }
+        Container remaining = subtract(container, other.containers[j]);
+        if (remaining.count) result.containers.push_back(move(remaining));
+    }
+    return result;
+}
+
+// Returns the values in increasing order.
+vector<uint32_t> RoaringBitmap::toVector() const {
+    vector<uint32_t> result;
+    result.reserve(cardinality());
+    for (const auto& container : containers) {
+        uint32_t high = static_cast<uint32_t>(container.key) << 16;
+        if (container.words.empty()) {
+            for (uint16_t low : container.values) result.push_back(high | low);
+            continue;
+        }
+        for (size_t i = 0; i < WORD_COUNT; ++i) {
+            for (uint64_t word = container.words[i]; word; word &= word - 1) {
+                result.push_back(high | static_cast<uint32_t>(i << 6) | lowestBit(word));
+            }
+        }
+    }
+    return result;
+}
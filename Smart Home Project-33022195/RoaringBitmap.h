@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+class RoaringBitmap {
+private:
+    struct Container {
+        uint16_t key;               // High 16 bits shared by every value in the container
+        uint32_t count;             // Number of values
+        vector<uint16_t> values;    // Sorted low 16 bits while the container is sparse
+        vector<uint64_t> words;     // 65536-bit set once the container is dense (values is then empty)
+    };
+
+    static const uint32_t SPARSE_LIMIT = 4096;   // Above this a bit set is smaller than a sorted array
+    static const size_t WORD_COUNT = 1024;
+
+    vector<Container> containers;   // Sorted by key
+
+    size_t lowerBound(uint16_t key) const;
+    static void makeDense(Container& container);
+    static void makeSparseIfSmall(Container& container);
+    static bool containerHas(const Container& container, uint16_t low);
+    static Container intersect(const Container& a, const Container& b);
+    static Container unite(const Container& a, const Container& b);
+    static Container subtract(const Container& a, const Container& b);
+
+public:
+    void add(uint32_t value);
+    void remove(uint32_t value);
+    bool contains(uint32_t value) const;
+    size_t cardinality() const;
+    bool empty() const;
+    void clear();
+
+    RoaringBitmap operator&(const RoaringBitmap& other) const;
+    RoaringBitmap operator|(const RoaringBitmap& other) const;
+    RoaringBitmap operator-(const RoaringBitmap& other) const;
+
+    vector<uint32_t> toVector() const;
+};
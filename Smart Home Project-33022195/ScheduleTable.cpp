@@ -0,0 +1,224 @@
+#include "ScheduleTable.h"
+#include "Clock.h"
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <cstdlib>
+
+using namespace std;
+
+// Constructor: Creates an empty schedule whose memory is charged to the given account.
+ScheduleTable::ScheduleTable(MemoryAccount* account)
+    : entries(AccountedAllocator<uint16_t>(account, MemorySubsystem::Schedules)),
+      rules(AccountedAllocator<RecurrenceRule>(account, MemorySubsystem::Schedules)) {}
+
+// Packs a time of day and a state into one entry; entries sort by time.
+uint16_t ScheduleTable::pack(int minuteOfDay, bool on) {
+    return static_cast<uint16_t>((minuteOfDay << 1) | (on ? 1 : 0));
+}
+
+// Returns the minute of day of an entry.
+int ScheduleTable::minuteOf(uint16_t entry) {
+    return entry >> 1;
+}
+
+// Returns the state an entry switches to.
+bool ScheduleTable::stateOf(uint16_t entry) {
+    return entry & 1;
+}
+
+// Returns the position of the first entry at or after the given minute of day.
+size_t ScheduleTable::lowerBound(int minuteOfDay) const {
+    return static_cast<size_t>(lower_bound(entries.begin(), entries.end(), pack(minuteOfDay, false)) - entries.begin());
+}
+
+// Drops entries that do not change the scheduled state: an entry with the same state as the one
+// before it (going round midnight) is redundant. A schedule whose entries all have the same
+// state keeps its earliest one, so the device is still switched that way once a day.
+void ScheduleTable::normalize() {
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (kept == 0 || stateOf(entries[kept - 1]) != stateOf(entries[i])) {
+            entries[kept++] = entries[i];
+        }
+    }
+    entries.resize(kept);
+    if (entries.size() > 1 && stateOf(entries.front()) == stateOf(entries.back())) {
+        entries.erase(entries.begin());  // The state already holds from the last entry of the day before
+    }
+}
+
+// Schedules a switch to the given state at a time of day, replacing any entry at the same time.
+// Returns false for an invalid time.
+bool ScheduleTable::add(int hour, int minute, bool on) {
+    if (hour < 0 || hour >= 24 || minute < 0 || minute >= 60) return false;
+    int minuteOfDay = hour * 60 + minute;
+    size_t i = lowerBound(minuteOfDay);
+    if (i < entries.size() && minuteOf(entries[i]) == minuteOfDay) {
+        entries[i] = pack(minuteOfDay, on);
+    }
+    else {
+        entries.insert(entries.begin() + i, pack(minuteOfDay, on));
+    }
+    normalize();
+    return true;
+}
+
+// Adds a recurring or one-off rule given as text (see RecurrenceRule::parse()). A rule that is
+// already there is not added twice. Returns false with a reason in error for an invalid rule or
+// one that will never fire again.
+bool ScheduleTable::addRule(const string& text, string& error) {
+    RecurrenceRule rule;
+    if (!RecurrenceRule::parse(text, rule, error)) return false;
+    if (rule.nextAfter(Clock::currentTime()) == 0) {
+        error = "the rule never fires again";
+        return false;
+    }
+    if (find(rules.begin(), rules.end(), rule) == rules.end()) {
+        rules.push_back(rule);
+    }
+    return true;
+}
+
+// Removes the entry at a 1-based position: the daily entries in time order come first, then the
+// rules in the order they were added. Returns false for an invalid position.
+bool ScheduleTable::remove(int index) {
+    if (index < 1 || index > static_cast<int>(size())) return false;
+    if (index > static_cast<int>(entries.size())) {
+        rules.erase(rules.begin() + (index - 1 - static_cast<int>(entries.size())));
+        return true;
+    }
+    entries.erase(entries.begin() + index - 1);
+    normalize();
+    return true;
+}
+
+// Removes every entry and rule.
+void ScheduleTable::clear() {
+    entries.clear();
+    rules.clear();
+}
+
+// Frees the capacity left over from removed entries and rules.
+void ScheduleTable::compact() {
+    entries.shrink_to_fit();
+    rules.shrink_to_fit();
+}
+
+// Returns true if nothing is scheduled.
+bool ScheduleTable::empty() const {
+    return entries.empty() && rules.empty();
+}
+
+// Returns the number of entries and rules.
+size_t ScheduleTable::size() const {
+    return entries.size() + rules.size();
+}
+
+// Returns the recurring and one-off rules in the order they were added.
+vector<RecurrenceRule> ScheduleTable::getRules() const {
+    return vector<RecurrenceRule>(rules.begin(), rules.end());
+}
+
+// Finds the state the schedule puts the device in at a minute of day, by binary search: the
+// state set by the last entry at or before that minute, or by the day's last entry if none is.
+// Returns false if nothing is scheduled.
+bool ScheduleTable::stateAt(int minuteOfDay, bool& on) const {
+    if (entries.empty()) return false;
+    size_t i = static_cast<size_t>(upper_bound(entries.begin(), entries.end(), pack(minuteOfDay, true)) - entries.begin());
+    on = stateOf(i == 0 ? entries.back() : entries[i - 1]);
+    return true;
+}
+
+// Returns the entries as (minute of day, switch on) pairs in time order.
+vector<pair<int, bool>> ScheduleTable::getTransitions() const {
+    vector<pair<int, bool>> transitions;
+    transitions.reserve(entries.size());
+    for (uint16_t entry : entries) {
+        transitions.emplace_back(minuteOf(entry), stateOf(entry));
+    }
+    return transitions;
+}
+
+// Returns the entries as "HH:MM -> STATE" lines in time order, followed by a "rule: ..." line per rule.
+vector<string> ScheduleTable::getLines() const {
+    vector<string> lines;
+    for (uint16_t entry : entries) {
+        stringstream ss;
+        ss << setw(2) << setfill('0') << minuteOf(entry) / 60 << ":"
+            << setw(2) << setfill('0') << minuteOf(entry) % 60 << " -> " << (stateOf(entry) ? "ON" : "OFF");
+        lines.push_back(ss.str());
+    }
+    for (const RecurrenceRule& rule : rules) {
+        lines.push_back("rule: " + rule.toString());
+    }
+    return lines;
+}
+
+// Writes the schedule as one "420+,1320-" line: each entry is a minute of day followed by
+// + (on) or - (off). Each rule follows as an "R|rule text" line; rules that will never fire again
+// are dropped here. The store puts the owning device's key in front of each line (see HomeImage).
+void ScheduleTable::write(ostream& outFile) const {
+    if (!entries.empty()) {
+        for (size_t i = 0; i < entries.size(); ++i) {
+            outFile << (i ? "," : "") << minuteOf(entries[i]) << (stateOf(entries[i]) ? '+' : '-');
+        }
+        outFile << "\n";
+    }
+    time_t now = Clock::currentTime();
+    for (const RecurrenceRule& rule : rules) {
+        if (rule.nextAfter(now) != 0) {
+            outFile << "R|" << rule.toString() << "\n";
+        }
+    }
+}
+
+// Reads the device's schedule lines, replacing the current schedule. The store reader has already
+// matched the lines to the device and taken their keys off. Besides the compact form written by
+// write(), older "hour|minute|ON" lines are accepted; as with add(), a later entry replaces an
+// earlier one at the same minute.
+void ScheduleTable::read(istream& inFile) {
+    entries.clear();
+    rules.clear();
+    string line, field;
+    while (getline(inFile, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.compare(0, 2, "R|") == 0) {
+            string error;
+            addRule(line.substr(2), error);
+            continue;
+        }
+        stringstream ss(line);
+
+        if (line.find('|') == string::npos) {
+            while (getline(ss, field, ',')) {
+                int minuteOfDay = atoi(field.c_str());
+                if (field.size() < 2 || minuteOfDay < 0 || minuteOfDay >= MINUTES_PER_DAY) continue;
+                entries.push_back(pack(minuteOfDay, field.back() == '+'));
+            }
+            continue;
+        }
+
+        int hour = -1, minute = -1;
+        string state;
+        ss >> hour;
+        ss.ignore();
+        ss >> minute;
+        ss.ignore();
+        getline(ss, state);
+        if (hour >= 0 && hour < 24 && minute >= 0 && minute < 60) {
+            entries.push_back(pack(hour * 60 + minute, state == "ON"));
+        }
+    }
+
+    stable_sort(entries.begin(), entries.end(),
+        [](uint16_t a, uint16_t b) { return minuteOf(a) < minuteOf(b); });
+    size_t kept = 0;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if (kept > 0 && minuteOf(entries[kept - 1]) == minuteOf(entries[i])) --kept;
+        entries[kept++] = entries[i];
+    }
+    entries.resize(kept);
+    normalize();
+}
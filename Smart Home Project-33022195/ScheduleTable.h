@@ -0,0 +1,45 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <iosfwd>
+#include <utility>
+#include <cstdint>
+#include "RecurrenceRule.h"
+#include "MemoryAccount.h"
+
+using namespace std;
+
+// A device's daily ON/OFF schedule, kept as the times of day at which its scheduled state changes,
+// plus any recurring or one-off rules (see RecurrenceRule). Both are charged to the owning
+// device's Schedules memory.
+class ScheduleTable {
+private:
+    vector<uint16_t, AccountedAllocator<uint16_t>> entries;   // (minute of day << 1) | on, in time order, alternating states
+    vector<RecurrenceRule, AccountedAllocator<RecurrenceRule>> rules;
+
+    static uint16_t pack(int minuteOfDay, bool on);
+    static int minuteOf(uint16_t entry);
+    static bool stateOf(uint16_t entry);
+    size_t lowerBound(int minuteOfDay) const;
+    void normalize();
+
+public:
+    static const int MINUTES_PER_DAY = 24 * 60;
+
+    explicit ScheduleTable(MemoryAccount* account = nullptr);
+
+    bool add(int hour, int minute, bool on);
+    bool addRule(const string& text, string& error);
+    bool remove(int index);                                  // 1-based: entries in time order, then rules
+    void clear();
+    void compact();                                          // Frees spare capacity
+    bool empty() const;
+    size_t size() const;
+    bool stateAt(int minuteOfDay, bool& on) const;           // False if there is no schedule
+    vector<pair<int, bool>> getTransitions() const;          // (minute of day, switch on) in time order
+    vector<RecurrenceRule> getRules() const;
+    vector<string> getLines() const;                         // "HH:MM -> ON" in time order, then "rule: ..."
+
+    void write(ostream& outFile) const;                      // Lines without the owner's key
+    void read(istream& inFile);                              // Lines without the owner's key
+};
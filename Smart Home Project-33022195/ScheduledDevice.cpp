@@ -0,0 +1,69 @@
+#include "ScheduledDevice.h"
+#include <iostream>
+
+using namespace std;
+
+// Constructor: The schedule is charged to the device's memory account.
+// Schedules are restored by SmartHome from the device's store segment after deserialization.
+ScheduledDevice::ScheduledDevice(const string& name) : SmartDevice(name), schedules(&memory) {}
+
+// Adds an ON/OFF schedule entry at the given time; an entry that does not change the scheduled
+// state is merged away (see ScheduleTable). Returns false for an invalid time.
+bool ScheduledDevice::addSchedule(int hour, int minute, bool on) {
+    if (!schedules.add(hour, minute, on)) return false;
+    markDirty();
+    schedulesChanged();
+    return true;
+}
+
+// Removes the schedule entry at a 1-based position. Returns false for an invalid position.
+bool ScheduledDevice::removeSchedule(int index) {
+    if (!schedules.remove(index)) return false;
+    markDirty();
+    schedulesChanged();
+    return true;
+}
+
+// Returns the schedule entries as "HH:MM -> STATE" lines in time order.
+vector<string> ScheduledDevice::getScheduleLines() const {
+    return schedules.getLines();
+}
+
+// Returns the schedule as (minute of day, switch on) pairs in time order.
+vector<pair<int, bool>> ScheduledDevice::getScheduleTransitions() const {
+    return schedules.getTransitions();
+}
+
+// Finds the state the schedule puts the device in at a minute of day. Returns false without a schedule.
+bool ScheduledDevice::getScheduledState(int minuteOfDay, bool& on) const {
+    return schedules.stateAt(minuteOfDay, on);
+}
+
+// Adds a recurring or one-off ON/OFF rule (see RecurrenceRule::parse()), which gets a behavior
+// loop of its own. Returns false with a reason in error for an invalid rule.
+bool ScheduledDevice::addRule(const string& text, string& error) {
+    if (!schedules.addRule(text, error)) return false;
+    markDirty();
+    schedulesChanged();
+    return true;
+}
+
+// Returns the recurring and one-off rules in the order they were added.
+vector<RecurrenceRule> ScheduledDevice::getRecurrenceRules() const {
+    return schedules.getRules();
+}
+
+// Saves the schedule to the device's store segment as one compact line (see ScheduleTable::write()).
+void ScheduledDevice::saveScheduleToFile(ostream& outFile) const {
+    schedules.write(outFile);
+}
+
+// Loads the schedule from the lines stored for this device.
+void ScheduledDevice::loadScheduleFromFile(istream& inFile) {
+    schedules.read(inFile);
+}
+
+// Gives back memory when a cap is exceeded: the schedule drops its spare capacity.
+void ScheduledDevice::trimMemory() {
+    schedules.compact();
+}
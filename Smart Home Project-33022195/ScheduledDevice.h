@@ -0,0 +1,27 @@
+#pragma once
+#include "SmartDevice.h"
+#include "ScheduleTable.h"
+#include <vector>
+
+using namespace std;
+
+// A device that switches itself on and off by a schedule: daily ON/OFF times and recurring or
+// one-off rules, kept in a ScheduleTable and followed by the device's behaviors.
+class ScheduledDevice : public SmartDevice {
+protected:
+    ScheduleTable schedules;     // Daily ON/OFF times and rules
+
+public:
+    ScheduledDevice(const string& name);
+
+    bool addSchedule(int hour, int minute, bool on) override;
+    bool removeSchedule(int index) override;
+    vector<string> getScheduleLines() const override;
+    vector<pair<int, bool>> getScheduleTransitions() const override;
+    bool getScheduledState(int minuteOfDay, bool& on) const override;
+    bool addRule(const string& text, string& error) override;
+    vector<RecurrenceRule> getRecurrenceRules() const override;
+    void saveScheduleToFile(ostream& outFile) const override;
+    void loadScheduleFromFile(istream& inFile) override;
+    void trimMemory() override;
+};
@@ -0,0 +1,217 @@
+#include "SensorIngest.h"
+#include "SmartHome.h"
+#include "ReadingBatch.h"
+#include "ConsoleWriter.h"
+#include "Trace.h"
+#include "Clock.h"
+#include <vector>
+#include <chrono>
+#include <cstring>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+#endif
+
+using namespace std;
+
+// Constructor: Prepares to read the given source. Nothing is opened until start().
+SensorIngest::SensorIngest(SmartHome& home, const string& source)
+    : home(home), source(source), fd(-1), stopping(false), finished(false),
+      readings(0), rejected(0), unknown(0) {}
+
+// Destructor: Stops reading.
+SensorIngest::~SensorIngest() {
+    stop();
+}
+
+// Opens the source and starts reading it. Returns false with the reason in error if it cannot be opened.
+bool SensorIngest::start(string& error) {
+    if (!openSource(error)) return false;
+    worker = thread(&SensorIngest::readLoop, this);
+    return true;
+}
+
+// Stops reading (within POLL_MILLISECONDS if the source is waiting for data) and waits for the
+// block being recorded. Safe to call more than once.
+void SensorIngest::stop() {
+    stopping = true;
+    if (worker.joinable()) {
+        worker.join();
+    }
+    closeSource();
+}
+
+// Returns true once the source has been read to its end, failed or been stopped.
+bool SensorIngest::isFinished() const {
+    return finished;
+}
+
+// Describes the ingest on one line, such as "sensors.fifo: 1200000 readings, 3 rejected (first:
+// invalid number), 0 for unknown sensors, running".
+string SensorIngest::describe() const {
+    bool done = finished;  // Read first, so firstError and readError are complete if it is set
+    string text = source + ": " + to_string(readings) + " readings, " + to_string(rejected) + " rejected";
+    if (done && !firstError.empty()) text += " (first: " + firstError + ")";
+    text += ", " + to_string(unknown) + " for unknown sensors, ";
+    if (!done) return text + "running";
+    if (!readError.empty()) return text + "failed: " + readError;
+    return text + (stopping ? "stopped" : "finished");
+}
+
+// Reading thread: reads the source a block at a time and records the readings of the whole
+// lines in it. A line cut off by the end of a block is moved to the front and finished by the
+// next read; a line longer than a block is rejected. The home is checkpointed at most every
+// SAVE_SECONDS while readings arrive, and once more at the end.
+void SensorIngest::readLoop() {
+    Trace::nameThread("ingest " + source);
+    vector<char> buffer(BLOCK_SIZE + 1);  // One spare byte for a missing last '\n'
+    size_t used = 0;
+    ReadingBatch batch;
+    string firstRejection;
+    auto lastSave = chrono::steady_clock::now();
+
+    auto record = [&](size_t size) {
+        size_t consumed = batch.parse(buffer.data(), size, Clock::currentTime());
+        if (!batch.readings.empty()) {
+            home.applyReadings(batch);
+        }
+        readings += batch.readings.size() - batch.unknown;
+        unknown += batch.unknown;
+        rejected += batch.rejected;
+        if (firstRejection.empty()) firstRejection = batch.firstError;
+        batch.clear();
+        return consumed;
+    };
+
+    while (!stopping) {
+        long got = readSource(buffer.data() + used, BLOCK_SIZE - used);
+        if (got <= 0) break;
+        used += static_cast<size_t>(got);
+
+        size_t consumed = record(used);
+        if (consumed == 0 && used == BLOCK_SIZE) {
+            ++rejected;  // No line end in a whole block
+            if (firstRejection.empty()) firstRejection = "line too long";
+            used = 0;
+            continue;
+        }
+        memmove(buffer.data(), buffer.data() + consumed, used - consumed);
+        used -= consumed;
+
+        auto now = chrono::steady_clock::now();
+        if (now - lastSave >= chrono::seconds(SAVE_SECONDS)) {
+            home.saveDevices();
+            lastSave = now;
+        }
+    }
+    if (used > 0 && !stopping) {
+        buffer[used++] = '\n';  // The last line need not end in '\n'
+        record(used);
+    }
+    home.saveDevices();
+
+    firstError = firstRejection;
+    finished = true;
+    if (!stopping) {
+        ConsoleWriter::print("Sensor ingest " + describe() + ".\n");
+    }
+}
+
+#ifdef _WIN32
+
+// Opens the source as a file; named pipes (\\.\pipe\name) can be read the same way.
+// Unix domain sockets are not supported here.
+bool SensorIngest::openSource(string& error) {
+    fd = _open(source.c_str(), _O_RDONLY | _O_BINARY);
+    if (fd < 0) {
+        error = "cannot open " + source;
+        return false;
+    }
+    return true;
+}
+
+// Reads up to size bytes. A blocking read only notices stop() when it returns.
+long SensorIngest::readSource(char* buffer, size_t size) {
+    if (stopping) return -1;
+    int got = _read(fd, buffer, static_cast<unsigned>(size));
+    if (got < 0) readError = "read failed";
+    return got;
+}
+
+// Closes the source.
+void SensorIngest::closeSource() {
+    if (fd >= 0) {
+        _close(fd);
+        fd = -1;
+    }
+}
+
+#else
+
+// Opens the source: a Unix domain socket is connected to, a FIFO is opened for reading and
+// writing (so it does not end when the last writer closes it) and anything else is read as a file.
+bool SensorIngest::openSource(string& error) {
+    struct stat info;
+    if (stat(source.c_str(), &info) != 0) {
+        error = "cannot open " + source + ": " + strerror(errno);
+        return false;
+    }
+    if (S_ISSOCK(info.st_mode)) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (source.size() >= sizeof(address.sun_path)) {
+            error = "socket path too long";
+            return false;
+        }
+        memcpy(address.sun_path, source.c_str(), source.size() + 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    else {
+        fd = open(source.c_str(), (S_ISFIFO(info.st_mode) ? O_RDWR : O_RDONLY) | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        error = "cannot open " + source + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// Reads up to size bytes, waiting at most POLL_MILLISECONDS at a time so stop() is noticed.
+long SensorIngest::readSource(char* buffer, size_t size) {
+    while (!stopping) {
+        pollfd ready = { fd, POLLIN, 0 };
+        int events = poll(&ready, 1, POLL_MILLISECONDS);
+        if (events < 0 && errno != EINTR) break;
+        if (events <= 0) continue;
+        ssize_t got = read(fd, buffer, size);
+        if (got >= 0) return static_cast<long>(got);
+        if (errno != EINTR && errno != EAGAIN) {
+            readError = strerror(errno);
+            break;
+        }
+    }
+    return -1;
+}
+
+// Closes the source.
+void SensorIngest::closeSource() {
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+#endif
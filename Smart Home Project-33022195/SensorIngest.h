@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+class SmartHome;
+
+// Feeds readings from real sensors into the home: reads line protocol text (see ReadingBatch)
+// from a file, FIFO or Unix domain socket on a thread of its own, a large block at a time, and
+// records each block's readings with one SmartHome::applyReadings() call. A file or socket is
+// read to its end; a FIFO is read until the ingest is stopped, so writers may come and go.
+class SensorIngest {
+public:
+    static const size_t BLOCK_SIZE = 1 << 20;       // Bytes read and parsed at a time
+    static const int POLL_MILLISECONDS = 200;       // How often a waiting read checks for stop()
+    static const int SAVE_SECONDS = 1;              // Checkpoints while readings arrive
+
+    SensorIngest(SmartHome& home, const string& source);
+    ~SensorIngest();
+    SensorIngest(const SensorIngest&) = delete;
+    SensorIngest& operator=(const SensorIngest&) = delete;
+
+    bool start(string& error);
+    void stop();
+    bool isFinished() const;
+    string describe() const;                        // Source, counts and state on one line
+
+private:
+    SmartHome& home;
+    string source;
+    int fd;                                         // Source being read (-1 when closed)
+    atomic<bool> stopping;
+    atomic<bool> finished;
+    atomic<uint64_t> readings;                      // Recorded in a sensor's history
+    atomic<uint64_t> rejected;                      // Malformed lines
+    atomic<uint64_t> unknown;                       // Readings for names that are not sensors
+    string firstError;                              // Why the first line was rejected (set before finished)
+    string readError;                               // Why reading stopped early, if it did
+    thread worker;
+
+    bool openSource(string& error);
+    long readSource(char* buffer, size_t size);     // Bytes read; 0 at the end, -1 on error or stop()
+    void closeSource();
+    void readLoop();
+};
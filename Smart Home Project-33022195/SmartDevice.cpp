@@ -1,90 +1,612 @@
-#include "SmartDevice.h"
-#include <iostream>
-
-using namespace std;
-
-// Constructor: Initializes the SmartDevice object with the provided name.
-// Sets the device's initial state to OFF, with no active timer or timer thread running.
-SmartDevice::SmartDevice(const string& name)
-    : name(name), isOn(false), timer(0), timerRunning(false) {}
-
-// Destructor: Ensures proper cleanup of resources.
-// Stops the timer if it is running and joins the timer thread to prevent dangling threads.
-SmartDevice::~SmartDevice() {
-    stopTimer();  // Ensure the timer stops before destruction
-    if (timerThread.joinable()) {
-        timerThread.join();  // Safely join the thread
-    }
-}
-
-// Starts a countdown timer for the SmartDevice.
-// The timer runs on a separate thread and decrements the timer every second while the device is ON.
-// Automatically turns OFF the device when the timer reaches zero.
-void SmartDevice::startTimer(int seconds) {
-    if (!isOn) {
-        cout << "Cannot start timer: " << name << " is currently OFF.\n";
-        return;
-    }
-
-    timer = seconds;         // Set the timer duration
-    timerRunning = true;     // Mark the timer as running
-
-    // Start a new thread to handle the countdown
-    timerThread = thread([this]() {
-        while (timer > 0 && timerRunning && isOn) {
-            this_thread::sleep_for(chrono::seconds(1));  // Pause for one second
-            --timer;  // Decrement the timer
-
-            if (timerRunning && isOn) {
-                // Display the remaining time on the same line
-                cout << "\rTimer for " << name << ": " << timer << " seconds remaining." << flush;
-            }
-        }
-        // Handle timer completion or interruption
-        if (timer == 0 && timerRunning && isOn) {
-            cout << "\nTimer for " << name << " has finished. Turning off the device.\n";
-            isOn = false;  
-            timerRunning = false;
-        }
-        else if (!isOn) {
-            cout << "\nTimer for " << name << " stopped as the device was turned OFF.\n";
-            timerRunning = false;
-        }
-        });
-
-    cout << "Timer started for " << name << "!\n";
-}
-
-// Stops the active timer for the SmartDevice.
-void SmartDevice::stopTimer() {
-    timerRunning = false;  // Stop the timer
-}
-
-// Checks if the timer is currently running for the device.
-bool SmartDevice::isTimerRunning() const {
-    return timerRunning;
-}
-
-// Returns the name of the SmartDevice.
-string SmartDevice::getName() const {
-    return name;
-}
-
-// Updates the name of the SmartDevice to a new name provided by the caller.
-void SmartDevice::setName(const string& newName) {
-    name = newName;  // Update the device name
-}
-
-// Allows the user to manually edit the name of the SmartDevice.
-void SmartDevice::editName() {
-    string newName;
-    cout << "Enter new name for the device: ";
-    getline(cin, newName);  // Get the new name from user input
-    setName(newName);       // Update the device's name
-    cout << "Device name updated to: " << name << "\n";
-}
-
-// Returns the current ON/OFF state of the SmartDevice.
-bool SmartDevice::getIsOn() const {
-    return isOn;
-}
+#include "SmartDevice.h"
+#include "SmartHome.h"
+#include "ConsoleWriter.h"
+#include "SymbolTable.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <ctime>
+
+using namespace std;
+
+// Constructor: Initializes the SmartDevice object with the provided name.
+// Sets the device's initial state to OFF, with no active timer or behaviors running.
+// A new device is not attached to any home until SmartHome places it in a store segment.
+SmartDevice::SmartDevice(const string& name)
+    : name(name), isOn(false), timerRunning(false), timerFrameBytes(0),
+      dirty(false), indexPending(false), eventNamed(false), owner(nullptr), segment(-1), slot(-1),
+      nameSymbol(SymbolTable::NONE) {}
+
+// Destructor: Cancels the device's timer and behaviors. Their suspended coroutines are
+// reclaimed by the runtime without touching the device again.
+SmartDevice::~SmartDevice() {
+    stopTimer();
+    if (behaviorCancel) {
+        *behaviorCancel = true;
+    }
+}
+
+// Returns the home's behavior runtime if it is running, or nullptr.
+BehaviorRuntime* SmartDevice::getRuntime() const {
+    if (!owner || !owner->getBehaviors().isRunning()) return nullptr;
+    return &owner->getBehaviors();
+}
+
+// Starts a countdown timer for the SmartDevice.
+// The countdown is a coroutine on the home's behavior runtime rather than a thread of its own;
+// it sleeps until the timer ends and then turns the device OFF.
+void SmartDevice::startTimer(int seconds) {
+    if (!isOn) {
+        cout << "Cannot start timer: " << name << " is currently OFF.\n";
+        return;
+    }
+    if (!runTimer(seconds)) {
+        cout << "Cannot start timer: device behaviors are not running.\n";
+        return;
+    }
+    cout << "Timer started for " << name << "!\n";
+}
+
+// Starts (or restarts) the countdown timer without console output.
+// Returns false if the device is OFF or the behavior runtime is not running.
+bool SmartDevice::runTimer(int seconds) {
+    BehaviorRuntime* runtime = getRuntime();
+    if (!isOn || !runtime) return false;
+
+    stopTimer();             // Replace any earlier timer
+    timerCancel = make_shared<atomic<bool>>(false);
+    timerEnd = Clock::current().now() + chrono::seconds(seconds);
+    timerRunning = true;     // Mark the timer as running
+    Task task = countdown();
+    timerFrameBytes = static_cast<uint32_t>(task.frameSize());
+    runtime->spawn(move(task), timerCancel);
+    logEvent(EventLog::Event::TimerStarted, seconds);
+    return true;
+}
+
+// Timer behavior: sleeps until the timer ends, then turns the device OFF.
+// Turning the device off earlier cancels it (see setPower()). The notice goes through the
+// console writer, since this runs on the runtime's thread while the menus may be printing.
+Task SmartDevice::countdown() {
+    co_await owner->getBehaviors().sleepUntil(timerEnd);
+    timerRunning = false;
+    if (isOn) {
+        logEvent(EventLog::Event::TimerFinished);
+        ConsoleWriter::print(name, ConsoleWriter::Kind::TimerFinished);
+        setPower(false);
+    }
+}
+
+// Stops the active timer for the SmartDevice.
+// A countdown still waiting is no longer the device's memory; one that has ended settled itself.
+void SmartDevice::stopTimer() {
+    bool wasRunning = timerRunning.exchange(false);  // Stop the timer
+    if (timerCancel) {
+        *timerCancel = true;
+        if (wasRunning) memory.detach(MemorySubsystem::Behaviors, timerFrameBytes);
+    }
+}
+
+// Checks if the timer is currently running for the device.
+bool SmartDevice::isTimerRunning() const {
+    return timerRunning;
+}
+
+// Returns the whole seconds left on the running timer, or 0 if no timer is running.
+int SmartDevice::getTimerRemaining() const {
+    if (!timerRunning) return 0;
+    auto left = chrono::duration_cast<chrono::seconds>(timerEnd - Clock::current().now() + chrono::milliseconds(999));
+    return max(0, static_cast<int>(left.count()));
+}
+
+// Cancels the device's current behaviors and returns a fresh flag for the ones that replace them.
+// The cancelled frames wait to be reclaimed by the runtime, no longer charged to the device.
+shared_ptr<atomic<bool>> SmartDevice::renewBehaviors() {
+    if (behaviorCancel) {
+        *behaviorCancel = true;
+        size_t held = memory.get(MemorySubsystem::Behaviors);
+        size_t timer = timerRunning ? timerFrameBytes : 0;
+        if (held > timer) memory.detach(MemorySubsystem::Behaviors, held - timer);
+    }
+    behaviorCancel = make_shared<atomic<bool>>(false);
+    return behaviorCancel;
+}
+
+// (Re)starts the device's background behaviors if the home's runtime is running.
+// Every device with a schedule follows it, and each recurring rule gets a loop of its own;
+// subclasses add behaviors of their own.
+void SmartDevice::startBehaviors() {
+    BehaviorRuntime* runtime = getRuntime();
+    if (!runtime) return;
+    shared_ptr<atomic<bool>> cancelled = renewBehaviors();
+    vector<pair<int, bool>> transitions = getScheduleTransitions();
+    if (!transitions.empty()) {
+        runtime->spawn(followSchedule(move(transitions)), cancelled);
+    }
+    for (const RecurrenceRule& rule : getRecurrenceRules()) {
+        runtime->spawn(followRule(rule), cancelled);
+    }
+}
+
+// Called by subclasses after their schedule changes, so the schedule loop follows the new one.
+void SmartDevice::schedulesChanged() {
+    startBehaviors();
+}
+
+// Helper function: Returns the number of seconds since local midnight.
+static int secondsSinceMidnight() {
+    time_t now = Clock::currentTime();
+    tm local;
+#ifdef _MSC_VER
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    return local.tm_hour * 3600 + local.tm_min * 60 + local.tm_sec;
+}
+
+// Schedule behavior: sleeps until the next scheduled time of day and switches the device
+// as scheduled, every day. A changed schedule cancels this loop and starts a new one.
+Task SmartDevice::followSchedule(vector<pair<int, bool>> transitions) {
+    BehaviorRuntime& runtime = owner->getBehaviors();
+    while (true) {
+        int second = secondsSinceMidnight();
+        auto next = upper_bound(transitions.begin(), transitions.end(), second,
+            [](int now, const pair<int, bool>& transition) { return now < transition.first * 60; });
+        int wait = next != transitions.end()
+            ? next->first * 60 - second
+            : transitions.front().first * 60 + 24 * 3600 - second;  // First one tomorrow
+        bool on = next != transitions.end() ? next->second : transitions.front().second;
+
+        co_await runtime.sleepFor(chrono::seconds(wait));
+        setPower(on);
+    }
+}
+
+// Rule behavior: sleeps until the rule's next firing only, switches the device, and works out
+// the one after that. A rule that will never fire again ends its loop; the device is marked
+// changed so the next checkpoint drops the rule from the store.
+Task SmartDevice::followRule(RecurrenceRule rule) {
+    BehaviorRuntime& runtime = owner->getBehaviors();
+    while (true) {
+        time_t next = rule.nextAfter(Clock::currentTime());
+        if (next == 0) {
+            markDirty();
+            co_return;
+        }
+        co_await runtime.sleepUntil(chrono::system_clock::from_time_t(next));
+        setPower(rule.switchesOn());
+    }
+}
+
+// Returns the name of the SmartDevice.
+string SmartDevice::getName() const {
+    return name;
+}
+
+// Updates the name of the SmartDevice to a new name provided by the caller.
+// The home is told so its name index follows the rename.
+void SmartDevice::setName(const string& newName) {
+    markDirty();
+    if (owner && slot >= 0 && !eventNamed.exchange(true)) {
+        EventLog::instance().nameDevice(static_cast<uint32_t>(slot), name);  // So the log knows the old name
+    }
+    name = newName;  // Update the device name
+    eventNamed = false;
+    logEvent(EventLog::Event::Renamed);
+    if (owner) {
+        owner->noteRenamed(this);
+    }
+}
+
+// Allows the user to manually edit the name of the SmartDevice.
+void SmartDevice::editName() {
+    string newName;
+    cout << "Enter new name for the device: ";
+    getline(cin, newName);  // Get the new name from user input
+    setName(newName);       // Update the device's name
+    cout << "Device name updated to: " << name << "\n";
+}
+
+// Returns the current ON/OFF state of the SmartDevice.
+bool SmartDevice::getIsOn() const {
+    return isOn;
+}
+
+// Flags the device as changed so the next checkpoint rewrites its store segment.
+// Called before a state change; only the first change since a checkpoint notifies the home.
+void SmartDevice::markDirty() {
+    if (!owner) return;
+    if (!dirty.exchange(true)) {
+        owner->noteDirty(segment);
+    }
+    if (!indexPending.exchange(true)) {
+        owner->noteChanged(slot);
+    }
+}
+
+// Records an event for this device in the event log. The device's name is registered with the
+// log before its first event and again after a rename; detached devices log nothing.
+void SmartDevice::logEvent(EventLog::Event event, double first, double second) {
+    if (!owner || slot < 0) return;
+    EventLog& log = EventLog::instance();
+    if (!eventNamed.load(memory_order_relaxed) && !eventNamed.exchange(true)) {
+        log.nameDevice(static_cast<uint32_t>(slot), name);
+    }
+    log.record(event, static_cast<uint32_t>(slot), first, second);
+}
+
+// Switches the device on or off without any console output.
+// Turning a device off also stops its sleep timer.
+void SmartDevice::setPower(bool on) {
+    if (on == isOn) return;
+    markDirty();
+    isOn = on;
+    logEvent(on ? EventLog::Event::PowerOn : EventLog::Event::PowerOff);
+    if (!isOn) {
+        stopTimer();
+    }
+}
+
+// Performs the device's one-click action without console output.
+// For most devices that is switching them on or off.
+void SmartDevice::toggle() {
+    setPower(!isOn);
+}
+
+// Changes one setting of the device. Returns false if the device has no such setting.
+// Every device can be switched on and off; other settings are handled by the device types.
+bool SmartDevice::applySetting(DeviceAttribute attribute, double value) {
+    if (attribute == DeviceAttribute::Power) {
+        setPower(value != 0);
+        return true;
+    }
+    return false;
+}
+
+// Reads one setting of the device into value. Returns false if the device has no such setting.
+bool SmartDevice::getSetting(DeviceAttribute attribute, double& value) const {
+    if (attribute == DeviceAttribute::Power) {
+        value = isOn ? 1 : 0;
+        return true;
+    }
+    return false;
+}
+
+// Returns the energy used so far in kWh. Devices that do not meter energy report 0.
+double SmartDevice::getEnergyUsage() const {
+    return 0.0;
+}
+
+// Converts a setting name such as "brightness" into a DeviceAttribute.
+// Returns false for an unknown name.
+bool SmartDevice::parseAttribute(const string& key, DeviceAttribute& attribute) {
+    if (key == "on" || key == "power") attribute = DeviceAttribute::Power;
+    else if (key == "brightness") attribute = DeviceAttribute::Brightness;
+    else if (key == "volume") attribute = DeviceAttribute::Volume;
+    else if (key == "playing") attribute = DeviceAttribute::Playing;
+    else if (key == "target") attribute = DeviceAttribute::TargetTemperature;
+    else return false;
+    return true;
+}
+
+// Returns the setting name parseAttribute() accepts for a DeviceAttribute.
+string SmartDevice::attributeName(DeviceAttribute attribute) {
+    switch (attribute) {
+    case DeviceAttribute::Power: return "on";
+    case DeviceAttribute::Brightness: return "brightness";
+    case DeviceAttribute::Volume: return "volume";
+    case DeviceAttribute::Playing: return "playing";
+    case DeviceAttribute::TargetTemperature: return "target";
+    }
+    return "";
+}
+
+// Adds an ON/OFF schedule entry. Devices without schedules reject it.
+bool SmartDevice::addSchedule(int, int, bool) {
+    return false;
+}
+
+// Removes the schedule entry at a 1-based position. Devices without schedules reject it.
+bool SmartDevice::removeSchedule(int) {
+    return false;
+}
+
+// Returns the schedule entries as "HH:MM -> STATE" lines. Empty for devices without schedules.
+vector<string> SmartDevice::getScheduleLines() const {
+    return {};
+}
+
+// Returns the schedule as (minute of day, switch on) pairs in time order.
+// Devices without schedules return nothing.
+vector<pair<int, bool>> SmartDevice::getScheduleTransitions() const {
+    return {};
+}
+
+// Finds the state the schedule puts the device in at a minute of day.
+// Returns false if the device has no schedule.
+bool SmartDevice::getScheduledState(int, bool&) const {
+    return false;
+}
+
+// Adds a recurring or one-off ON/OFF rule (see RecurrenceRule::parse()).
+// Devices without schedules reject it.
+bool SmartDevice::addRule(const string&, string& error) {
+    error = "device has no schedule";
+    return false;
+}
+
+// Returns the device's recurring and one-off rules. Empty for devices without schedules.
+vector<RecurrenceRule> SmartDevice::getRecurrenceRules() const {
+    return {};
+}
+
+// Writes the device's schedule lines to the store, without their keys. Devices without
+// schedules write nothing.
+void SmartDevice::saveScheduleToFile(ostream&) const {}
+
+// Reads the device's schedule lines, without their keys, from the store. Devices without
+// schedules ignore it.
+void SmartDevice::loadScheduleFromFile(istream&) {}
+
+// Spills buffered history readings to disk at a checkpoint. Devices without history do nothing.
+void SmartDevice::sealHistory() {}
+
+// Deletes the device's history files when it is removed. Devices without history do nothing.
+void SmartDevice::discardHistory() {}
+
+// Writes the history readings taken between from and to, one "timestamp|value..." line each.
+// Returns false for devices that keep no history.
+bool SmartDevice::writeHistory(time_t, time_t, ostream&) const {
+    return false;
+}
+
+// Returns the device's history series by name, for exports. Devices without history have none.
+vector<pair<string, const HistoryLog*>> SmartDevice::getHistories() const {
+    return {};
+}
+
+// Records readings taken by a real sensor (see SensorIngest). Only sensors take readings, so
+// other devices refuse them.
+bool SmartDevice::recordReadings(const HistoryLog::Sample*, size_t) {
+    return false;
+}
+
+// Returns the device's memory account.
+MemoryAccount& SmartDevice::getMemory() {
+    return memory;
+}
+
+// Returns the device's memory account.
+const MemoryAccount& SmartDevice::getMemory() const {
+    return memory;
+}
+
+// Gives back memory when a cap is exceeded: subclasses evict buffered history to disk and
+// compact their schedules. Devices with neither have nothing to give back.
+void SmartDevice::trimMemory() {}
+
+// Records which home and store segment hold this device.
+void SmartDevice::attach(SmartHome* home, int segmentId) {
+    owner = home;
+    segment = segmentId;
+}
+
+// Returns the store segment that holds this device's record.
+int SmartDevice::getSegment() const {
+    return segment;
+}
+
+// Records the device's position in the home's device table. Scenes refer to devices by slot,
+// so they keep working when a device is renamed.
+void SmartDevice::setSlot(int slotId) {
+    slot = slotId;
+}
+
+// Returns the device's position in the home's device table.
+int SmartDevice::getSlot() const {
+    return slot;
+}
+
+// Records the interned name the home indexed the device under.
+void SmartDevice::setNameSymbol(uint32_t symbol) {
+    nameSymbol = symbol;
+}
+
+// Returns the interned name the home indexed the device under, or SymbolTable::NONE.
+uint32_t SmartDevice::getNameSymbol() const {
+    return nameSymbol;
+}
+
+// Returns true if the device has changed since it was last written to the store.
+bool SmartDevice::isDirty() const {
+    return dirty;
+}
+
+// Marks the device as written; called by SmartHome once its segment is checkpointed.
+void SmartDevice::clearDirty() {
+    dirty = false;
+}
+
+// Clears the index flag. Called by the home just before it re-reads the device into its indexes.
+void SmartDevice::clearIndexPending() {
+    indexPending = false;
+}
+
+// Returns the room the device is in.
+string SmartDevice::getRoom() const {
+    return room;
+}
+
+// Returns the device's tags.
+const vector<string>& SmartDevice::getTags() const {
+    return tags;
+}
+
+// Returns the tags as a comma-separated list.
+string SmartDevice::getTagList() const {
+    string list;
+    for (const string& tag : tags) {
+        list += (list.empty() ? "" : ",") + tag;
+    }
+    return list;
+}
+
+// Moves the device to a room. '|' and ',' are removed since they separate stored fields.
+void SmartDevice::setRoom(const string& newRoom) {
+    markDirty();
+    room.clear();
+    for (char c : newRoom) {
+        if (c != '|' && c != ',') room += c;
+    }
+    chargeAttributes();
+}
+
+// Helper function: Splits a comma-separated tag list, dropping empty and repeated tags
+// and the '|' character, which separates stored fields.
+static vector<string> splitTags(const string& tagList) {
+    vector<string> tags;
+    stringstream ss(tagList);
+    string tag;
+    while (getline(ss, tag, ',')) {
+        tag.erase(remove(tag.begin(), tag.end(), '|'), tag.end());
+        if (!tag.empty() && find(tags.begin(), tags.end(), tag) == tags.end()) {
+            tags.push_back(tag);
+        }
+    }
+    return tags;
+}
+
+// Replaces the device's tags with a comma-separated list.
+void SmartDevice::setTags(const string& tagList) {
+    markDirty();
+    tags = splitTags(tagList);
+    chargeAttributes();
+}
+
+// Restores the room and tags from a stored "room|tags" pair without marking the device changed.
+// Room and tags are read at startup even in lazy mode so the home can index them.
+void SmartDevice::loadAttributes(const string& fields) {
+    size_t bar = fields.find('|');
+    room = fields.substr(0, bar);
+    tags = splitTags(bar == string::npos ? "" : fields.substr(bar + 1));
+    chargeAttributes();
+}
+
+// Charges the room and tags to the device's Attributes memory.
+void SmartDevice::chargeAttributes() {
+    size_t bytes = MemoryAccount::heapBytes(room) + tags.capacity() * sizeof(string);
+    for (const string& tag : tags) {
+        bytes += MemoryAccount::heapBytes(tag);
+    }
+    memory.set(MemorySubsystem::Attributes, bytes);
+}
+
+// Charges the deferred record and schedule lines to the device's Records memory.
+void SmartDevice::chargeDeferred() {
+    memory.set(MemorySubsystem::Records, MemoryAccount::heapBytes(pendingRecord) + MemoryAccount::heapBytes(pendingSchedules));
+}
+
+// Keeps a stored record for later instead of deserializing it now (lazy loading).
+// Only the name is taken from the record, which is enough to index and list the device.
+void SmartDevice::deferRecord(const string& record) {
+    size_t start = record.find('|') + 1;
+    size_t end = record.find('|', start);
+    name = record.substr(start, end - start);
+    isOn = end != string::npos && record.compare(end + 1, 1, "1") == 0;  // Every record stores isOn third
+    pendingRecord = record;
+    chargeDeferred();
+}
+
+// Keeps the device's stored schedule lines, without their keys, until the device is hydrated.
+void SmartDevice::deferSchedules(const string& scheduleLines) {
+    pendingSchedules = scheduleLines;
+    chargeDeferred();
+}
+
+// Returns true once the device's full state has been restored.
+bool SmartDevice::isHydrated() const {
+    return pendingRecord.empty();
+}
+
+// Returns true if the device has stored schedule lines waiting to be loaded.
+bool SmartDevice::hasDeferredSchedules() const {
+    return !pendingSchedules.empty();
+}
+
+// Restores the full state of a lazily loaded device from its deferred record and schedules.
+// Does nothing if the device is already hydrated.
+void SmartDevice::hydrate() {
+    if (pendingRecord.empty()) return;
+
+    deserialize(pendingRecord);
+    stringstream schedules(pendingSchedules);
+    loadScheduleFromFile(schedules);
+    string().swap(pendingRecord);     // Free the text, not just empty it
+    string().swap(pendingSchedules);
+    chargeDeferred();
+    startBehaviors();  // Behaviors of lazily loaded devices start when the device is first used
+}
+
+// Returns the record to store for this device.
+// A device that was never hydrated cannot have changed, so its original record is kept as is.
+string SmartDevice::getRecord() const {
+    return isHydrated() ? serialize() : pendingRecord;
+}
+
+// Returns the schedule lines to store for this device, without their keys, unchanged if it was
+// never hydrated.
+string SmartDevice::getSchedules() const {
+    if (!isHydrated()) return pendingSchedules;
+    static thread_local ostringstream lines;  // Reused: a checkpoint captures many devices per thread
+    lines.str("");
+    saveScheduleToFile(lines);
+    return lines.str();
+}
+
+// Puts the device back into a stored state: its record, schedule lines and "room|tags" (see
+// SmartHome::rollback()). A device that was never hydrated keeps the state deferred; otherwise it
+// is restored now and its behaviors restart from the restored schedule. The home reindexes it.
+// With logChanges, each restored change of name, power or setting is recorded in the event log
+// as if it had been made by hand; settings of a device that was never hydrated are not known.
+void SmartDevice::restore(const string& record, const string& scheduleLines, const string& attributes, bool logChanges) {
+    bool hydrated = isHydrated();
+    string oldName = name;
+    bool wasOn = isOn;
+    double before[DEVICE_ATTRIBUTE_COUNT];
+    bool had[DEVICE_ATTRIBUTE_COUNT] = {};
+    for (int i = 0; hydrated && i < DEVICE_ATTRIBUTE_COUNT; ++i) {
+        had[i] = getSetting(static_cast<DeviceAttribute>(i), before[i]);
+    }
+
+    if (hydrated) {
+        deserialize(record);
+        stringstream schedules(scheduleLines);
+        loadScheduleFromFile(schedules);
+        startBehaviors();
+    }
+    else {
+        deferRecord(record);
+        deferSchedules(scheduleLines);
+    }
+    loadAttributes(attributes);
+    if (!logChanges) return;
+
+    if (name != oldName) {
+        if (owner && slot >= 0 && !eventNamed.exchange(true)) {
+            EventLog::instance().nameDevice(static_cast<uint32_t>(slot), oldName);  // So the log knows the old name
+        }
+        eventNamed = false;
+        logEvent(EventLog::Event::Renamed);
+    }
+    if (isOn != wasOn) {
+        logEvent(isOn ? EventLog::Event::PowerOn : EventLog::Event::PowerOff);
+    }
+    for (int i = 0; hydrated && i < DEVICE_ATTRIBUTE_COUNT; ++i) {
+        DeviceAttribute attribute = static_cast<DeviceAttribute>(i);
+        double after;
+        if (attribute != DeviceAttribute::Power && had[i] && getSetting(attribute, after) && after != before[i]) {
+            logEvent(EventLog::Event::Setting, static_cast<double>(i), after);
+        }
+    }
+}
@@ -1,40 +1,154 @@
-#pragma once
-#include <string>
-#include <thread>
-#include <atomic>
-#include <chrono>
-
-using namespace std;
-
-class SmartDevice {
-protected:
-    string name;
-    bool isOn;
-
-    // Timer members
-    atomic<int> timer;         // Timer countdown in seconds
-    atomic<bool> timerRunning; // Timer running flag
-    thread timerThread;        // Background timer thread
-
-public:
-    SmartDevice(const string& name);
-    virtual ~SmartDevice();
-
-    virtual string getQuickView() const = 0;
-    virtual void oneClickAction() = 0;
-    virtual void showMenu() const = 0;
-    virtual void handleMenuChoice(int choice) = 0;
-    virtual string getDeviceType() const = 0;
-    virtual string serialize() const = 0;
-    virtual void deserialize(const string& data) = 0;
-
-    // Timer control
-    virtual void startTimer(int seconds);
-    virtual void stopTimer();
-    virtual bool isTimerRunning() const;
-
-    string getName() const;
-    void setName(const string& newName);
-    void editName();
-    bool getIsOn() const;
-};
+#pragma once
+#include "BehaviorRuntime.h"
+#include "RecurrenceRule.h"
+#include "EventLog.h"
+#include "MemoryAccount.h"
+#include "HistoryLog.h"
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <iosfwd>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+class SmartHome;
+
+// Settings that can be changed without the interactive menus (control server, bulk updates)
+enum class DeviceAttribute {
+    Power,              // 1 = on, 0 = off
+    Brightness,         // Light, 0-100
+    Volume,             // Speaker, 0-100
+    Playing,            // Speaker, 1 = playing
+    TargetTemperature   // Radiator valve, degrees C
+};
+static const int DEVICE_ATTRIBUTE_COUNT = 5;
+
+class SmartDevice {
+protected:
+    MemoryAccount memory;      // Heap memory the device holds; declared first so it outlives the rest
+    string name;
+    bool isOn;
+    string room;               // Room the device is in (empty if not set)
+    vector<string> tags;       // Free-form labels such as "downstairs"
+
+    // Behaviors (coroutines run by the home's BehaviorRuntime)
+    atomic<bool> timerRunning; // Timer running flag
+    Clock::TimePoint timerEnd;  // When the running timer turns the device off
+    shared_ptr<atomic<bool>> timerCancel;         // Cancels the timer's countdown
+    uint32_t timerFrameBytes;  // Size of the countdown's coroutine frame
+    shared_ptr<atomic<bool>> behaviorCancel;      // Cancels the schedule loop and other behaviors
+
+    // Persistence tracking
+    atomic<bool> dirty;        // Changed since the last checkpoint
+    atomic<bool> indexPending; // Changed since the home last refreshed its attribute indexes
+    atomic<bool> eventNamed;   // Current name registered with the event log
+    SmartHome* owner;          // Home that stores this device (nullptr while detached)
+    int segment;               // Store segment holding this device's record
+    int slot;                  // Position in the home's device table, fixed for the device's lifetime
+    uint32_t nameSymbol;       // Interned name the home indexes the device under (see SymbolTable)
+
+    // Lazy hydration
+    string pendingRecord;      // Stored record not yet deserialized (empty once hydrated)
+    string pendingSchedules;   // Stored schedule lines not yet loaded, without their keys
+
+    void markDirty();
+    void chargeAttributes();
+    void chargeDeferred();
+    BehaviorRuntime* getRuntime() const;
+    shared_ptr<atomic<bool>> renewBehaviors();
+    void schedulesChanged();
+    Task countdown();
+    Task followSchedule(vector<pair<int, bool>> transitions);
+    Task followRule(RecurrenceRule rule);
+
+public:
+    SmartDevice(const string& name);
+    virtual ~SmartDevice();
+
+    virtual string getQuickView() const = 0;
+    virtual void oneClickAction() = 0;
+    virtual void showMenu() const = 0;
+    virtual void handleMenuChoice(int choice) = 0;
+    virtual string getDeviceType() const = 0;
+    virtual const char* getTypeTag() const = 0;
+    virtual string serialize() const = 0;
+    virtual void deserialize(const string& data) = 0;
+
+    // Non-interactive control (no prompts or console output)
+    virtual void setPower(bool on);
+    virtual void toggle();
+    virtual bool applySetting(DeviceAttribute attribute, double value);
+    virtual bool getSetting(DeviceAttribute attribute, double& value) const;
+    static bool parseAttribute(const string& key, DeviceAttribute& attribute);
+    static string attributeName(DeviceAttribute attribute);
+    virtual double getEnergyUsage() const;
+
+    // Schedules (devices without schedules reject additions and list nothing)
+    virtual bool addSchedule(int hour, int minute, bool on);
+    virtual bool removeSchedule(int index);
+    virtual vector<string> getScheduleLines() const;
+    virtual vector<pair<int, bool>> getScheduleTransitions() const;
+    virtual bool getScheduledState(int minuteOfDay, bool& on) const;
+    virtual bool addRule(const string& text, string& error);
+    virtual vector<RecurrenceRule> getRecurrenceRules() const;
+
+    // Schedule persistence (devices without schedules write and read nothing)
+    virtual void saveScheduleToFile(ostream& outFile) const;
+    virtual void loadScheduleFromFile(istream& inFile);
+
+    // Reading history (devices without history keep and write nothing)
+    virtual void sealHistory();
+    virtual void discardHistory();
+    virtual bool writeHistory(time_t from, time_t to, ostream& out) const;
+    virtual vector<pair<string, const HistoryLog*>> getHistories() const;  // Named series, such as "energy"
+    virtual bool recordReadings(const HistoryLog::Sample* readings, size_t count);  // Measured elsewhere; false if not a sensor
+
+    // Memory accounting (see MemoryAccount); trimMemory() gives back what it can when a cap is exceeded
+    MemoryAccount& getMemory();
+    const MemoryAccount& getMemory() const;
+    virtual void trimMemory();
+
+    // Timer control
+    virtual void startTimer(int seconds);
+    bool runTimer(int seconds);    // startTimer() without console output; false if it cannot start
+    virtual void stopTimer();
+    virtual bool isTimerRunning() const;
+    int getTimerRemaining() const;
+
+    // Background behaviors such as the schedule loop; (re)started when the runtime is running
+    virtual void startBehaviors();
+
+    string getName() const;
+    void setName(const string& newName);
+    void editName();
+    bool getIsOn() const;
+    string getRoom() const;
+    const vector<string>& getTags() const;
+    string getTagList() const;
+    void setRoom(const string& newRoom);
+    void setTags(const string& tagList);
+    void loadAttributes(const string& fields);
+
+    void deferRecord(const string& record);
+    void deferSchedules(const string& scheduleLines);
+    bool isHydrated() const;
+    bool hasDeferredSchedules() const;
+    void hydrate();
+    string getRecord() const;
+    string getSchedules() const;
+    void restore(const string& record, const string& scheduleLines, const string& attributes, bool logChanges);
+
+    void attach(SmartHome* home, int segmentId);
+    int getSegment() const;
+    void setSlot(int slotId);
+    int getSlot() const;
+    void setNameSymbol(uint32_t symbol);
+    uint32_t getNameSymbol() const;
+    bool isDirty() const;
+    void clearDirty();
+    void clearIndexPending();
+    void logEvent(EventLog::Event event, double first = 0, double second = 0);
+};
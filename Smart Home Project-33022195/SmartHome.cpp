@@ -1,274 +1,2083 @@
-#include "SmartHome.h"
-#include "SmartLight.h"
-#include "TempHumiditySensor.h"
-#include "SmartSpeaker.h"
-#include "Thermostat.h"
-#include "SmartPlug.h"
-#include "RadiatorValve.h"
-#include <iostream>
-#include <fstream>
-#include <sstream>
-#include <algorithm>
-#include <cctype>
-
-using namespace std;
-
-// Singleton instance getter for the SmartHome class.
-// Ensures there is only one instance of the SmartHome object in the program.
-SmartHome& SmartHome::getInstance() {
-    static SmartHome instance;  // Static instance, initialized only once
-    return instance;
-}
-
-// Constructor: Initializes the SmartHome object.
-// Automatically loads devices from the saved file into the devices vector.
-SmartHome::SmartHome() {
-    loadDevices();  // Load devices from "smart_home.txt"
-}
-
-// Destructor: Ensures the current state of devices is saved to the file when the object is destroyed.
-SmartHome::~SmartHome() {
-    saveDevices();  // Save devices to "smart_home.txt"
-}
-
-// Loads devices from the "smart_home.txt" file.
-// Reads the serialized data line by line, creates appropriate device objects, and stores them in the devices vector.
-void SmartHome::loadDevices() {
-    ifstream file("smart_home.txt");  // Open the file for reading
-    if (!file) return;               // Exit if the file does not exist
-
-    string line;
-    while (getline(file, line)) {
-        stringstream ss(line);
-        string type;
-        getline(ss, type, '|');
-
-        unique_ptr<SmartDevice> device;  // Pointer to hold the created device
-        if (type == "LIGHT") device = make_unique<SmartLight>("");
-        else if (type == "TEMP_HUMIDITY") device = make_unique<TempHumiditySensor>("");
-        else if (type == "SPEAKER") device = make_unique<SmartSpeaker>("");
-        else if (type == "THERMOSTAT") device = make_unique<Thermostat>("");
-        else if (type == "PLUG") device = make_unique<SmartPlug>("");
-        else if (type == "RADIATOR") device = make_unique<RadiatorValve>("");
-
-        if (device) {
-            device->deserialize(line);  // Restore device state from serialized data
-            devices.push_back(move(device));  // Add the device to the list
-        }
-    }
-}
-
-// Saves the current state of all devices to the "smart_home.txt" file.
-// Iterates through the devices vector and writes serialized data for each device to the file.
-void SmartHome::saveDevices() {
-    ofstream file("smart_home.txt");  // Open the file for writing
-    for (const auto& device : devices) {
-        file << device->serialize() << "\n";  // Serialize each device and write to the file
-    }
-}
-
-// Lists all devices currently stored in the devices vector.
-// Calls the getQuickView() method of each device to display its status.
-void SmartHome::listDevices() const {
-    if (devices.empty()) {
-        cout << "No devices found.\n";  // Inform the user if there are no devices
-        return;
-    }
-
-    for (const auto& device : devices) {
-        cout << device->getQuickView() << "\n";  // Display each device's quick view
-    }
-}
-
-// Helper function: Performs a case-insensitive comparison of two strings for sorting.
-bool caseInsensitiveSortCompare(const string& a, const string& b) {
-    string lowerA = a, lowerB = b;
-    transform(lowerA.begin(), lowerA.end(), lowerA.begin(), ::tolower);
-    transform(lowerB.begin(), lowerB.end(), lowerB.begin(), ::tolower);
-    return lowerA < lowerB;  // Compare lowercase versions of the strings
-}
-
-// Sorts devices in the devices vector alphabetically by name, ignoring case.
-void SmartHome::sortByName() {
-    sort(devices.begin(), devices.end(),
-        [](const unique_ptr<SmartDevice>& a, const unique_ptr<SmartDevice>& b) {
-            return caseInsensitiveSortCompare(a->getName(), b->getName());
-        });
-    cout << "Devices sorted by name.\n";
-}
-
-// Sorts devices in the devices vector by type, and then by name within each type.
-// Sorting is case-insensitive for both type and name.
-void SmartHome::sortByType() {
-    sort(devices.begin(), devices.end(),
-        [](const unique_ptr<SmartDevice>& a, const unique_ptr<SmartDevice>& b) {
-            string typeA = a->getDeviceType();
-            string typeB = b->getDeviceType();
-            if (caseInsensitiveSortCompare(typeA, typeB)) {
-                return true;
-            }
-            if (caseInsensitiveSortCompare(typeB, typeA)) {
-                return false;
-            }
-            return caseInsensitiveSortCompare(a->getName(), b->getName());
-        });
-    cout << "Devices sorted by type and name.\n";
-}
-
-// Helper function: Compares two strings case-insensitively to check if they are equal.
-bool caseInsensitiveCompare(const string& a, const string& b) {
-    if (a.size() != b.size()) return false;
-    for (size_t i = 0; i < a.size(); ++i) {
-        if (tolower(a[i]) != tolower(b[i])) {
-            return false;
-        }
-    }
-    return true;
-}
-
-// Removes a device from the devices vector based on its name.
-// If the device is found, it is deleted from the list and memory is cleaned up.
-// If not found, an error message is displayed.
-// The delete completes after the program ends well. 
-void SmartHome::removeDevice(const string& deviceName) {
-    auto it = find_if(devices.begin(), devices.end(),
-        [&deviceName](const unique_ptr<SmartDevice>& device) {
-            return caseInsensitiveCompare(device->getName(), deviceName);
-        });
-
-    if (it != devices.end()) {
-        cout << "Device \"" << (*it)->getName() << "\" is being deleted.\n";
-        devices.erase(it);  // Safely erase the device from the list
-    }
-    else {
-        cout << "Error: Device \"" << deviceName << "\" not found in the system.\n";
-    }
-}
-
-// Adds a new device to the devices vector based on user input.
-// Prompts the user to select the type of device and provide its name.
-// Creates the device and adds it to the devices list.
-// The added device saves when the program is ended well.
-// so if you use the nuclear stop button after adding a device, when you reboot the program, it won't be there.
-void SmartHome::addDevice() {
-    cout << "\nAvailable device types:\n";
-    cout << "1: Light\n";
-    cout << "2: Temperature & Humidity Sensor\n";
-    cout << "3: Speaker\n";
-    cout << "4: Thermostat\n";
-    cout << "5: Smart Plug\n";
-    cout << "6: Radiator Valve\n";
-
-    int choice;
-    cout << "Select device type: ";
-    cin >> choice;
-    cin.ignore();
-
-    string name;
-    cout << "Enter device name: ";
-    getline(cin, name);
-
-    unique_ptr<SmartDevice> device;
-    switch (choice) {
-    case 1: device = make_unique<SmartLight>(name); break;
-    case 2: device = make_unique<TempHumiditySensor>(name); break;
-    case 3: device = make_unique<SmartSpeaker>(name); break;
-    case 4: device = make_unique<Thermostat>(name); break;
-    case 5: device = make_unique<SmartPlug>(name); break;
-    case 6: device = make_unique<RadiatorValve>(name); break;
-    default:
-        cout << "Invalid choice.\n";
-        return;
-    }
-
-    devices.push_back(move(device));  // Add the new device to the list
-    cout << "Device added successfully.\n";
-}
-
-// Executes the one-click action for a specified device by name.
-// Finds the device and calls its oneClickAction() method.
-void SmartHome::handleOneClickAction(const string& name) {
-    auto it = find_if(devices.begin(), devices.end(),
-        [&name](const unique_ptr<SmartDevice>& device) {
-            return caseInsensitiveCompare(device->getName(), name);
-        });
-
-    if (it != devices.end()) {
-        (*it)->oneClickAction();  // Perform the device's one-click action
-    }
-    else {
-        cout << "Device not found.\n";
-    }
-}
-
-// Allows the user to interact with a specific device by name.
-// Displays the device's menu and handles user input for its options.
-void SmartHome::interactWithDevice(const string& name) {
-    auto it = find_if(devices.begin(), devices.end(),
-        [&name](const unique_ptr<SmartDevice>& device) {
-            return caseInsensitiveCompare(device->getName(), name);
-        });
-
-    if (it != devices.end()) {
-        while (true) {
-            (*it)->showMenu();
-            int choice;
-            cout << "Enter choice: ";
-            cin >> choice;
-            cin.ignore();
-
-            if (choice == 9) break;  // Exit the menu
-            if (choice == 5) {       // Edit the device name
-                (*it)->editName();
-                break;
-            }
-
-            (*it)->handleMenuChoice(choice);  // Execute the selected option
-        }
-    }
-    else {
-        cout << "Device not found.\n";
-    }
-}
-
-// Main loop of the SmartHome system.
-// Displays the main menu and handles user input for listing devices, sorting, adding devices,
-// and interacting with devices by name.
-void SmartHome::run() {
-    while (true) {
-        cout << "\nMenu:\n";
-        cout << "[device name]: Perform device's one-click action\n";
-        cout << "1: List devices\n";
-        cout << "2: Sort by name\n";
-        cout << "3: Sort by device type\n";
-        cout << "4 [device name]: Select device to interact with\n";
-        cout << "5: Add device\n";
-        cout << "9: Exit\n";
-
-        string input;
-        cout << "Enter choice: ";
-        getline(cin, input);
-
-        if (input == "1") {
-            listDevices();
-        }
-        else if (input == "2") {
-            sortByName();
-        }
-        else if (input == "3") {
-            sortByType();
-        }
-        else if (input == "5") {
-            addDevice();
-        }
-        else if (input == "9") {
-            break;  // Exit the program
-        }
-        else if (input.substr(0, 2) == "4 ") {
-            interactWithDevice(input.substr(2));  // Interact with a specific device
-        }
-        else {
-            handleOneClickAction(input);  // Perform a one-click action
-        }
-    }
-}
+#include "SmartHome.h"
+#include "DeviceRegistry.h"
+#include "StoreReader.h"
+#include "MappedFile.h"
+#include "ThermalSimulator.h"
+#include "HistoryExport.h"
+#include "ConsoleWriter.h"
+#include "Trace.h"
+#include "Thermostat.h"
+#include "RadiatorValve.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <unordered_map>
+#include <iomanip>
+#include <ctime>
+
+using namespace std;
+
+bool SmartHome::lazyLoading = false;
+
+// Enables or disables lazy loading. Must be called before the first getInstance() call,
+// since the instance loads its devices when it is created.
+void SmartHome::setLazyLoading(bool enabled) {
+    lazyLoading = enabled;
+}
+
+// Singleton instance getter for the SmartHome class.
+// Ensures there is only one instance of the SmartHome object in the program.
+SmartHome& SmartHome::getInstance() {
+    static SmartHome instance;  // Static instance, initialized only once
+    return instance;
+}
+
+// Constructor: Initializes the SmartHome object.
+// Automatically loads devices from the saved file into the devices vector.
+SmartHome::SmartHome() : scenesDirty(false), watchingMemory(false), manifestDirty(false), image(make_shared<HomeImage>()) {
+    ConsoleWriter::instance();  // Created first so they outlive the home and its behaviors
+    EventLog::instance();
+    TraceScope scope("startup");
+    loadDevices();  // Load devices from "smart_home.txt"
+    loadScenes();   // Scenes refer to the loaded devices
+}
+
+// Destructor: Ensures the current state of devices is saved to the file when the object is destroyed.
+SmartHome::~SmartHome() {
+    TraceScope scope("shutdown");
+    mirror.close();  // Its thread uses the devices and the lock
+    for (auto& ingest : ingests) {
+        ingest->stop();  // Before the lock is needed for anything else
+    }
+    behaviors.stop();  // No behavior may run while the devices are saved and destroyed
+    saveDevices();  // Save devices to "smart_home.txt"
+    for (thread& writer : snapshotWriters) {
+        writer.join();  // Writers only use their snapshot's image, never the devices
+    }
+}
+
+// Returns the runtime that runs the devices' timers, schedules and other behaviors.
+BehaviorRuntime& SmartHome::getBehaviors() {
+    return behaviors;
+}
+
+// Starts the behavior runtime and every device's behaviors.
+// Behaviors run while holding the home's lock, between console and control server commands.
+// Lazily loaded devices with schedules are loaded now so their schedules run; the others start
+// their behaviors when first used.
+void SmartHome::startBehaviors() {
+    TraceScope scope("startBehaviors");
+    lock_guard<recursive_mutex> lock(homeMutex);
+    behaviors.start(&homeMutex);
+    // Each device only loads and starts itself, so the devices are split between the pool's threads
+    pool.parallelFor(devices.size(), 1024, [this](size_t begin, size_t end) {
+        TraceTally tally("start behaviors");
+        for (size_t i = begin; i < end; ++i) {
+            SmartDevice* device = devices[i].get();
+            int64_t started = tally.start();
+            if (device->isHydrated()) {
+                device->startBehaviors();
+            }
+            else if (device->hasDeferredSchedules()) {
+                device->hydrate();  // Starts its behaviors
+            }
+            tally.stop(device->getTypeTag(), started);
+        }
+    });
+    watchMemoryIfCapped();
+}
+
+// Home behavior: every MEMORY_CHECK_SECONDS, gives memory back if a cap was exceeded since the
+// last check. It only runs while a cap is set, so a home without caps (or a long stretch of
+// virtual time) does not wake for it; watchMemoryIfCapped() starts it again.
+Task SmartHome::watchMemory() {
+    while (MemoryAccount::hasCaps()) {
+        co_await behaviors.sleepFor(chrono::seconds(MEMORY_CHECK_SECONDS));
+        if (MemoryAccount::takeOverCap()) {
+            enforceMemoryCaps();
+        }
+    }
+    watchingMemory = false;  // Behaviors run with the home's lock held
+}
+
+// Starts watchMemory() if a cap is set, the behaviors are running and it is not running already.
+void SmartHome::watchMemoryIfCapped() {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    if (watchingMemory || !behaviors.isRunning() || !MemoryAccount::hasCaps()) return;
+    watchingMemory = true;
+    behaviors.spawn(watchMemory(), nullptr);
+}
+
+// Publishes the state of every device in a named shared memory segment (see StateMirror) and
+// keeps it up to date from then on: each change wakes the mirror's thread, which publishes the
+// changed devices once it gets the lock, so after the command or behavior step that made the change.
+// On failure result holds the reason.
+bool SmartHome::openStateMirror(const string& name, string& result) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    if (!mirror.open(name, slots.size(), result)) return false;
+    for (SmartDevice* device : slots) {
+        if (device) {
+            mirror.publish(device->getSlot(), *device);
+        }
+    }
+    mirror.startPublishing([this]() {
+        lock_guard<recursive_mutex> lock(homeMutex);
+        refreshIndex();
+    });
+    result = "publishing device state in shared memory " + name;
+    return true;
+}
+
+// Gives memory back while a cap is exceeded (see MemoryAccount): every device over the
+// per-device cap is trimmed, then the devices holding the most of a capped subsystem, largest
+// first, until the subsystem is back under its cap. Returns the number of devices trimmed.
+size_t SmartHome::enforceMemoryCaps() {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    size_t trimmed = 0;
+    size_t deviceCap = MemoryAccount::getDeviceCap();
+    if (deviceCap) {
+        for (auto& device : devices) {
+            if (device->getMemory().total() > deviceCap) {
+                device->trimMemory();
+                ++trimmed;
+            }
+        }
+    }
+    for (MemorySubsystem subsystem : { MemorySubsystem::History, MemorySubsystem::Schedules }) {
+        size_t cap = MemoryAccount::getCap(subsystem);
+        if (!cap || MemoryAccount::globalTotal(subsystem) <= cap) continue;
+
+        vector<pair<size_t, SmartDevice*>> holders;
+        for (auto& device : devices) {
+            size_t held = device->getMemory().get(subsystem);
+            if (held > 0) holders.emplace_back(held, device.get());
+        }
+        sort(holders.begin(), holders.end(),
+            [](const pair<size_t, SmartDevice*>& a, const pair<size_t, SmartDevice*>& b) { return a.first > b.first; });
+        for (const auto& holder : holders) {
+            if (MemoryAccount::globalTotal(subsystem) <= cap) break;
+            holder.second->trimMemory();
+            ++trimmed;
+        }
+    }
+    return trimmed;
+}
+
+// Helper function: Formats one device's memory use, such as "Lamp: 4.2 KB (history 4.0 KB, schedules 32 B)".
+static string describeDeviceMemory(const SmartDevice* device) {
+    const MemoryAccount& memory = device->getMemory();
+    string line = device->getName() + ": " + MemoryAccount::formatSize(memory.total());
+    string parts;
+    for (int i = 0; i < MemoryAccount::SUBSYSTEMS; ++i) {
+        MemorySubsystem subsystem = static_cast<MemorySubsystem>(i);
+        size_t held = memory.get(subsystem);
+        if (held > 0) {
+            parts += (parts.empty() ? "" : ", ") + string(MemoryAccount::subsystemName(subsystem)) + " " + MemoryAccount::formatSize(held);
+        }
+    }
+    return parts.empty() ? line : line + " (" + parts + ")";
+}
+
+// Describes memory use, one line each: with no name, the program-wide total per subsystem (and
+// its cap) followed by the devices holding the most; otherwise the named device's use per
+// subsystem. Returns false if there is no device of that name.
+bool SmartHome::describeMemory(const string& name, string& report) const {
+    if (!name.empty()) {
+        SmartDevice* device = lookupDevice(name);
+        if (!device) return false;
+        report = describeDeviceMemory(device) + "\n";
+        return true;
+    }
+
+    size_t total = 0;
+    for (int i = 0; i < MemoryAccount::SUBSYSTEMS; ++i) {
+        MemorySubsystem subsystem = static_cast<MemorySubsystem>(i);
+        size_t held = MemoryAccount::globalTotal(subsystem);
+        size_t cap = MemoryAccount::getCap(subsystem);
+        total += held;
+        report += string(MemoryAccount::subsystemName(subsystem)) + ": " + MemoryAccount::formatSize(held)
+            + (cap ? " (cap " + MemoryAccount::formatSize(cap) + ")" : "") + "\n";
+    }
+    report += "total: " + MemoryAccount::formatSize(total) + " in " + to_string(devices.size()) + " devices";
+    size_t deviceCap = MemoryAccount::getDeviceCap();
+    report += deviceCap ? " (cap " + MemoryAccount::formatSize(deviceCap) + " per device)\n" : "\n";
+
+    vector<pair<size_t, const SmartDevice*>> largest;
+    for (const auto& device : devices) {
+        largest.emplace_back(device->getMemory().total(), device.get());
+    }
+    size_t shown = min(largest.size(), MEMORY_REPORT_DEVICES);
+    partial_sort(largest.begin(), largest.begin() + shown, largest.end(),
+        [](const pair<size_t, const SmartDevice*>& a, const pair<size_t, const SmartDevice*>& b) { return a.first > b.first; });
+    for (size_t i = 0; i < shown && largest[i].first > 0; ++i) {
+        report += "  " + describeDeviceMemory(largest[i].second) + "\n";
+    }
+    return true;
+}
+
+// Sets a memory cap: target is "history" or "schedules" for a program-wide cap, or "device" for
+// a cap on each device; a size of 0 removes it. Devices over the new cap are trimmed right away.
+// On success result says how many were; otherwise it holds the reason.
+bool SmartHome::setMemoryCap(const string& target, const string& sizeText, string& result) {
+    size_t bytes;
+    if (!MemoryAccount::parseSize(sizeText, bytes)) {
+        result = "invalid size";
+        return false;
+    }
+    MemorySubsystem subsystem;
+    if (target == "device") {
+        MemoryAccount::setDeviceCap(bytes);
+    }
+    else if (MemoryAccount::parseSubsystem(target, subsystem)
+             && (subsystem == MemorySubsystem::History || subsystem == MemorySubsystem::Schedules)) {
+        MemoryAccount::setCap(subsystem, bytes);
+    }
+    else {
+        result = "only history, schedules and device can be capped";
+        return false;
+    }
+    MemoryAccount::takeOverCap();
+    result = to_string(enforceMemoryCaps()) + " devices trimmed";
+    watchMemoryIfCapped();
+    return true;
+}
+
+// Loads devices from the store.
+// "smart_home.txt" is the manifest: one "SEGMENT|file" line per store segment. Each segment file
+// holds the records of up to SEGMENT_CAPACITY devices followed by their schedule lines, so a
+// checkpoint only has to rewrite the segments that contain changed devices.
+// Segment files are mapped and parsed in parallel; see StoreReader.
+// Saves from older versions kept every record directly in "smart_home.txt"; those records are
+// parsed in parallel chunks, spread over new segments and written back in segmented form at the
+// next checkpoint.
+void SmartHome::loadDevices() {
+    TraceScope scope("loadDevices");
+    manifestDirty = false;
+    MappedFile manifest;
+    if (!manifest.open("smart_home.txt")) return;  // Exit if the file does not exist
+
+    const char* data = manifest.data();
+    size_t size = manifest.size();
+    if (size < 8 || memcmp(data, "SEGMENT|", 8) != 0) {
+        vector<unique_ptr<SmartDevice>> parsed = StoreReader::parse(data, size, lazyLoading, pool);
+        SymbolTable::instance().reserve(parsed.size());
+        for (auto& device : parsed) {
+            placeDevice(device.get());  // New segment placement marks the segment dirty
+            trackDevice(device.get());
+            devices.push_back(move(device));
+        }
+        return;
+    }
+
+    vector<string> fileNames;
+    stringstream lines(string(data, size));
+    string line;
+    while (getline(lines, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.compare(0, 8, "SEGMENT|") == 0) {
+            fileNames.push_back(line.substr(8));
+        }
+    }
+
+    vector<StoreReader::LoadedFile> loaded = StoreReader::parseFiles(fileNames, lazyLoading, pool);
+    TraceScope indexing("index devices");
+    size_t total = 0;
+    for (const auto& file : loaded) total += file.devices.size();
+    SymbolTable::instance().reserve(total);
+    for (size_t i = 0; i < loaded.size(); ++i) {
+        int segmentId = static_cast<int>(segments.size());
+        segments.push_back({ fileNames[i], {}, false });
+        if (!loaded[i].found) {
+            cout << "Warning: store segment " << fileNames[i] << " is missing.\n";
+        }
+
+        for (auto& device : loaded[i].devices) {
+            device->attach(this, segmentId);
+            segments[segmentId].members.push_back(device.get());
+            trackDevice(device.get());
+            devices.push_back(move(device));  // Add the device to the list
+        }
+    }
+}
+
+// Assigns a device to the last store segment, opening a new segment when that one is full.
+void SmartHome::placeDevice(SmartDevice* device) {
+    if (segments.empty() || segments.back().members.size() >= SEGMENT_CAPACITY) {
+        string fileName = "smart_home_seg" + to_string(segments.size()) + ".txt";
+        segments.push_back({ fileName, {}, false });
+        manifestDirty = true;
+    }
+
+    int segmentId = static_cast<int>(segments.size()) - 1;
+    segments[segmentId].members.push_back(device);
+    device->attach(this, segmentId);
+    noteDirty(segmentId);
+}
+
+// Queues a store segment for rewriting at the next checkpoint.
+// Devices call this (through markDirty) from command threads and from their behaviors.
+void SmartHome::noteDirty(int segmentId) {
+    lock_guard<mutex> lock(storeMutex);
+    if (!segments[segmentId].dirty) {
+        segments[segmentId].dirty = true;
+        dirtySegments.push_back(segmentId);
+    }
+}
+
+// Checkpoints the store: rewrites only the segments holding devices changed since the last
+// checkpoint, then the manifest if segments were added.
+// Each rewritten segment gets a new image (see HomeImage) in which only the devices marked
+// changed are serialized again; the others keep their image from the last checkpoint. The new
+// home image shares every other segment with the last one, which snapshots may still hold.
+// Each segment is written to a temporary file first and renamed over the old one, so an
+// interrupted save never leaves a half-written segment behind.
+void SmartHome::saveDevices() {
+    TraceScope scope("saveDevices");
+    lock_guard<recursive_mutex> lock(homeMutex);
+    vector<int> pending;
+    {
+        lock_guard<mutex> lock(storeMutex);
+        pending.swap(dirtySegments);
+        for (int segmentId : pending) {
+            segments[segmentId].dirty = false;
+        }
+    }
+
+    // Segments own disjoint sets of devices, so they are serialized and written in parallel
+    vector<shared_ptr<const HomeImage::Segment>> built(pending.size());
+    vector<string> errors(pending.size());
+    pool.parallelFor(pending.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const Segment& segment = segments[pending[i]];
+            TraceScope segmentScope("save segment", segment.file.c_str());
+            built[i] = captureSegment(pending[i]);
+
+            string tempFile = segment.file + ".tmp";
+            {
+                ofstream file(tempFile);
+                HomeImage::writeSegment(*built[i], file);
+            }
+            error_code ec;
+            filesystem::rename(tempFile, segment.file, ec);
+            if (ec) {
+                errors[i] = ec.message();
+            }
+        }
+    });
+    if (!pending.empty()) {
+        auto next = make_shared<HomeImage>(*image);  // Copies the segment pointers, not the segments
+        next->segments.resize(segments.size());
+        for (size_t i = 0; i < pending.size(); ++i) {
+            next->segments[pending[i]] = built[i];
+        }
+        image = move(next);
+    }
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (!errors[i].empty()) {
+            // Checkpoints also run on the control server's and the ingests' threads
+            ConsoleWriter::print("Error: could not save " + segments[pending[i]].file + ": " + errors[i] + "\n");
+            noteDirty(pending[i]);  // Try again at the next checkpoint
+        }
+    }
+
+    if (scenesDirty) {
+        saveScenes();
+    }
+
+    if (manifestDirty) {
+        {
+            ofstream file("smart_home.txt.tmp");
+            for (const auto& segment : segments) {
+                file << "SEGMENT|" << segment.file << "\n";
+            }
+        }
+        error_code ec;
+        filesystem::rename("smart_home.txt.tmp", "smart_home.txt", ec);
+        manifestDirty = static_cast<bool>(ec);
+    }
+}
+
+// Builds the image of a segment from its members. A device not marked changed keeps its image
+// from the segment's last image; the others are serialized again. If nothing differs, the last
+// image itself is returned, so an unchanged segment stays shared with snapshots.
+shared_ptr<const HomeImage::Segment> SmartHome::captureSegment(int segmentId) {
+    const Segment& segment = segments[segmentId];
+    shared_ptr<const HomeImage::Segment> last;
+    if (static_cast<size_t>(segmentId) < image->segments.size()) {
+        last = image->segments[segmentId];
+    }
+    unordered_map<int, const shared_ptr<const HomeImage::Device>*> kept;  // Slot -> last image
+    if (last) {
+        for (const auto& device : last->devices) {
+            kept.emplace(device->getSlot(), &device);
+        }
+    }
+
+    auto fresh = make_shared<HomeImage::Segment>();
+    fresh->file = segment.file;
+    fresh->devices.reserve(segment.members.size());
+    TraceTally tally("serialize");
+    for (SmartDevice* device : segment.members) {
+        auto it = kept.find(device->getSlot());
+        if (it != kept.end() && !device->isDirty()) {
+            fresh->devices.push_back(*it->second);
+            continue;
+        }
+        int64_t started = tally.start();
+        // Clear the flag before serializing so a change made while writing is caught next time.
+        device->clearDirty();
+        device->sealHistory();  // Spilling may give the device a history id to store
+        fresh->devices.push_back(HomeImage::Device::capture(*device));
+        tally.stop(device->getTypeTag(), started);
+    }
+    if (last && last->file == fresh->file && last->devices == fresh->devices) {
+        return last;
+    }
+    return fresh;
+}
+
+// Reassigns devices to segments in their current list order, so the store keeps the order
+// chosen by a sort. Only segments whose membership actually changes are marked dirty.
+void SmartHome::repackSegments() {
+    size_t segmentCount = (devices.size() + SEGMENT_CAPACITY - 1) / SEGMENT_CAPACITY;
+    while (segments.size() < segmentCount) {
+        segments.push_back({ "smart_home_seg" + to_string(segments.size()) + ".txt", {}, false });
+        manifestDirty = true;
+    }
+
+    for (size_t segmentId = 0; segmentId < segments.size(); ++segmentId) {
+        size_t first = min(devices.size(), segmentId * SEGMENT_CAPACITY);
+        size_t last = min(devices.size(), first + SEGMENT_CAPACITY);
+
+        vector<SmartDevice*> members;
+        for (size_t i = first; i < last; ++i) {
+            members.push_back(devices[i].get());
+        }
+        if (members != segments[segmentId].members) {
+            segments[segmentId].members = move(members);
+            for (SmartDevice* device : segments[segmentId].members) {
+                device->attach(this, static_cast<int>(segmentId));
+            }
+            noteDirty(static_cast<int>(segmentId));
+        }
+    }
+}
+
+// Lists all devices currently stored in the devices vector.
+// Calls the getQuickView() method of each device to display its status.
+void SmartHome::listDevices() const {
+    if (devices.empty()) {
+        cout << "No devices found.\n";  // Inform the user if there are no devices
+        return;
+    }
+
+    describeAll([](const string& lines) { cout << lines; });  // Display each device's quick view
+}
+
+// Passes every device's quick view line to emit, in list order, a block of lines at a time.
+// The lines are formatted in parallel, a window of blocks at once, so memory stays bounded.
+void SmartHome::describeAll(const function<void(const string&)>& emit) const {
+    const size_t BLOCK = 1024;
+    size_t window = pool.getThreadCount() * 8;
+    vector<string> blocks(window);
+    for (size_t first = 0; first < devices.size(); first += BLOCK * window) {
+        size_t count = min(window, (devices.size() - first + BLOCK - 1) / BLOCK);
+        pool.parallelFor(count, 1, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                blocks[b].clear();
+                size_t last = min(devices.size(), first + (b + 1) * BLOCK);
+                for (size_t i = first + b * BLOCK; i < last; ++i) {
+                    blocks[b] += describeDevice(devices[i].get()) + "\n";
+                }
+            }
+        });
+        for (size_t b = 0; b < count; ++b) {
+            emit(blocks[b]);
+        }
+    }
+}
+
+// Returns the quick view of a device.
+// Listing does not load lazily loaded devices; their state is shown once they are used.
+string SmartHome::describeDevice(const SmartDevice* device) const {
+    if (device->isHydrated()) {
+        return device->getQuickView();
+    }
+    return device->getName() + ": " + device->getDeviceType() + " (not loaded yet)";
+}
+
+// Helper function: Returns the lowercase form of a name, used as the name index key.
+static string foldName(const string& name) {
+    string folded = name;
+    transform(folded.begin(), folded.end(), folded.begin(), ::tolower);
+    return folded;
+}
+
+// Helper function: Performs a case-insensitive comparison of two strings for sorting.
+bool caseInsensitiveSortCompare(const string& a, const string& b) {
+    string lowerA = a, lowerB = b;
+    transform(lowerA.begin(), lowerA.end(), lowerA.begin(), ::tolower);
+    transform(lowerB.begin(), lowerB.end(), lowerB.begin(), ::tolower);
+    return lowerA < lowerB;  // Compare lowercase versions of the strings
+}
+
+// Sorts devices in the devices vector alphabetically by name, ignoring case.
+void SmartHome::sortByName() {
+    sortDevices(false);
+    cout << "Devices sorted by name.\n";
+}
+
+// Sorts devices in the devices vector by type, and then by name within each type.
+void SmartHome::sortByType() {
+    sortDevices(true);
+    cout << "Devices sorted by type and name.\n";
+}
+
+// Sorts the devices by name, or by type and then name, ignoring case,
+// and repacks the store segments to follow the new order.
+// Each device's lowercase name is already interned, so the keys point at the symbol table's
+// copy; the type key is built once per device, in parallel. The keys are then sorted in parallel.
+// Equal keys keep their current order.
+void SmartHome::sortDevices(bool byType) {
+    struct SortEntry {
+        string type;         // Lowercase type, empty when sorting by name only
+        const string* name;  // Lowercase name, owned by the symbol table
+        size_t position;     // Current position in the list
+    };
+    const SymbolTable& symbols = SymbolTable::instance();
+    vector<SortEntry> entries(devices.size());
+    pool.parallelFor(devices.size(), 4096, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const SmartDevice& device = *devices[i];
+            if (byType) {
+                entries[i].type = foldName(device.getDeviceType());
+            }
+            entries[i].name = &symbols.text(device.getNameSymbol());
+            entries[i].position = i;
+        }
+    });
+    pool.parallelSort(entries.begin(), entries.end(), [](const SortEntry& a, const SortEntry& b) {
+        if (a.type != b.type) return a.type < b.type;
+        int order = a.name->compare(*b.name);
+        return order != 0 ? order < 0 : a.position < b.position;
+    });
+
+    vector<unique_ptr<SmartDevice>> sorted(devices.size());
+    for (size_t i = 0; i < entries.size(); ++i) {
+        sorted[i] = move(devices[entries[i].position]);
+    }
+    devices = move(sorted);
+    repackSegments();
+}
+
+// Adds a device to the case-insensitive name index, interning its name. The index is keyed by the
+// name's symbol, which the device keeps so it can be unindexed after a rename.
+// Devices sharing a name keep their insertion order; lookups return the first one.
+void SmartHome::indexDevice(SmartDevice* device) {
+    uint32_t symbol = SymbolTable::instance().intern(device->getName());
+    device->setNameSymbol(symbol);
+    nameIndex[symbol].push_back(device);
+}
+
+// Removes a device from the name index entry it was last indexed under.
+void SmartHome::unindexDevice(SmartDevice* device) {
+    if (device->getNameSymbol() == SymbolTable::NONE) return;
+    auto it = nameIndex.find(device->getNameSymbol());
+    if (it == nameIndex.end()) return;
+    auto& bucket = it->second;
+    bucket.erase(remove(bucket.begin(), bucket.end(), device), bucket.end());
+    if (bucket.empty()) {
+        nameIndex.erase(it);
+    }
+}
+
+// Gives a new device its slot in the device table and adds it to the name index.
+void SmartHome::trackDevice(SmartDevice* device) {
+    device->setSlot(static_cast<int>(slots.size()));
+    slots.push_back(device);
+    indexDevice(device);
+    attributeIndex.update(device->getSlot(), *device);
+    mirror.publish(device->getSlot(), *device);
+}
+
+// Queues a changed device to be re-indexed before the next query and, if the state mirror is
+// open, published to it. Devices call this (through markDirty) from command threads and from
+// their behaviors, before the change is made, so the device is read only once the change is done.
+void SmartHome::noteChanged(int slotId) {
+    lock_guard<mutex> lock(storeMutex);
+    changedSlots.push_back(slotId);
+    mirror.notifyChanged();  // Published once the change is done and the lock is free
+}
+
+// Brings the attribute indexes and the state mirror up to date with the devices changed since
+// the last query.
+// Each device's flag is cleared before it is read, so a change made meanwhile queues it again.
+void SmartHome::refreshIndex() {
+    vector<int> pending;
+    {
+        lock_guard<mutex> lock(storeMutex);
+        pending.swap(changedSlots);
+    }
+    for (int slotId : pending) {
+        SmartDevice* device = slots[slotId];
+        if (device) {
+            device->clearIndexPending();
+            attributeIndex.update(slotId, *device);
+            mirror.publish(slotId, *device);
+        }
+    }
+}
+
+// Moves a renamed device to its new name index entry. Called by SmartDevice::setName().
+// Scenes refer to the device by slot and keep working, but the scene file stores names.
+void SmartHome::noteRenamed(SmartDevice* device) {
+    unindexDevice(device);
+    indexDevice(device);
+    scenesDirty = scenesDirty || !scenes.empty();
+}
+
+// Looks up a device by name, ignoring case, without loading it. The name is hashed once to find
+// its symbol; a name that was never interned cannot belong to a device.
+// Returns nullptr if no device has that name.
+SmartDevice* SmartHome::lookupDevice(const string& name) const {
+    return lookupSymbol(SymbolTable::instance().find(name));
+}
+
+// Looks up a device by the symbol of its name, without loading it.
+// Returns nullptr for SymbolTable::NONE or if no device has that name.
+SmartDevice* SmartHome::lookupSymbol(uint32_t symbol) const {
+    if (symbol == SymbolTable::NONE) return nullptr;
+    auto it = nameIndex.find(symbol);
+    return it == nameIndex.end() ? nullptr : it->second.front();
+}
+
+// Looks up a device by name, ignoring case, and hydrates it if it was lazily loaded.
+// Returns nullptr if no device has that name.
+SmartDevice* SmartHome::findDevice(const string& name) {
+    SmartDevice* device = lookupDevice(name);
+    if (device) {
+        device->hydrate();
+    }
+    return device;
+}
+
+// Removes a device from the devices vector based on its name.
+// If the device is found, it is deleted from the list and memory is cleaned up.
+// If not found, an error message is displayed.
+// The device's store segment is marked dirty so the next checkpoint drops its record.
+void SmartHome::removeDevice(const string& deviceName) {
+    SmartDevice* device = lookupDevice(deviceName);
+
+    if (device) {
+        cout << "Device \"" << device->getName() << "\" is being deleted.\n";
+        eraseDevice(device);
+    }
+    else {
+        cout << "Error: Device \"" << deviceName << "\" not found in the system.\n";
+    }
+}
+
+// Removes a device from its store segment, the name index and the devices vector, then deletes it
+// along with its history files. A lazily loaded device is hydrated first to learn which files are its own.
+void SmartHome::eraseDevice(SmartDevice* device) {
+    device->hydrate();
+    device->discardHistory();
+    device->logEvent(EventLog::Event::Removed);
+    int segmentId = device->getSegment();
+    auto& members = segments[segmentId].members;
+    members.erase(remove(members.begin(), members.end(), device), members.end());
+    noteDirty(segmentId);
+    unindexDevice(device);
+    slots[device->getSlot()] = nullptr;  // Scenes skip the removed device from now on
+    attributeIndex.remove(device->getSlot());
+    mirror.remove(device->getSlot());
+    scenesDirty = scenesDirty || !scenes.empty();
+
+    auto it = find_if(devices.begin(), devices.end(),
+        [device](const unique_ptr<SmartDevice>& d) { return d.get() == device; });
+    devices.erase(it);  // Safely erase the device from the list
+}
+
+// Takes ownership of a new device, placing it in a store segment and the name index.
+void SmartHome::adoptDevice(unique_ptr<SmartDevice> device) {
+    placeDevice(device.get());
+    trackDevice(device.get());
+    devices.push_back(move(device));  // Add the new device to the list
+    devices.back()->logEvent(EventLog::Event::Added);
+    devices.back()->startBehaviors();
+}
+
+// Adds a new device to the devices vector based on user input.
+// Prompts the user to select the type of device and provide its name.
+// Creates the device and adds it to the devices list.
+// The added device is placed in a store segment and saved at the next checkpoint.
+void SmartHome::addDevice() {
+    cout << "\nAvailable device types:\n";
+    DeviceRegistry::printMenu();
+
+    int choice;
+    cout << "Select device type: ";
+    cin >> choice;
+    cin.ignore();
+
+    string name;
+    cout << "Enter device name: ";
+    getline(cin, name);
+
+    unique_ptr<SmartDevice> device = DeviceRegistry::createFromMenu(choice, name);
+    if (!device) {
+        cout << "Invalid choice.\n";
+        return;
+    }
+
+    adoptDevice(move(device));
+    cout << "Device added successfully.\n";
+}
+
+// Executes the one-click action for a specified device by name.
+// Finds the device and calls its oneClickAction() method.
+void SmartHome::handleOneClickAction(const string& name) {
+    SmartDevice* device = findDevice(name);
+
+    if (device) {
+        device->oneClickAction();  // Perform the device's one-click action
+    }
+    else {
+        cout << "Device not found.\n";
+    }
+}
+
+// Returns true if the device is still part of the home.
+bool SmartHome::hasDevice(const SmartDevice* device) const {
+    return any_of(devices.begin(), devices.end(),
+        [device](const unique_ptr<SmartDevice>& d) { return d.get() == device; });
+}
+
+// Allows the user to interact with a specific device by name.
+// Displays the device's menu and handles user input for its options.
+void SmartHome::interactWithDevice(const string& name) {
+    SmartDevice* device = findDevice(name);
+
+    if (device) {
+        while (true) {
+            device->showMenu();
+            int choice;
+            cout << "Enter choice: ";
+            cin >> choice;
+            cin.ignore();
+
+            if (choice == 9) break;  // Exit the menu
+            if (choice == 5) {       // Edit the device name
+                device->editName();
+                break;
+            }
+
+            device->handleMenuChoice(choice);  // Execute the selected option
+            if (!hasDevice(device)) break;     // The device was deleted from its own menu
+        }
+    }
+    else {
+        cout << "Device not found.\n";
+    }
+}
+
+// Main loop of the SmartHome system.
+// Displays the main menu and handles user input for listing devices, sorting, adding devices,
+// and interacting with devices by name.
+// After each command the store is checkpointed; only changed segments are rewritten.
+void SmartHome::run() {
+    while (true) {
+        cout << "\nMenu:\n";
+        cout << "[device name]: Perform device's one-click action\n";
+        cout << "1 [query]: List devices (optionally filtered, e.g. type=plug&on&sort=-energy&limit=20)\n";
+        cout << "2: Sort by name\n";
+        cout << "3: Sort by device type\n";
+        cout << "4 [device name]: Select device to interact with\n";
+        cout << "5: Add device\n";
+        cout << "6 [file name]: Apply bulk update file (- to type it)\n";
+        cout << "7 [scene name]: Activate scene\n";
+        cout << "8: Manage scenes and groups\n";
+        cout << "10 [device name]: Set room and tags\n";
+        cout << "11 [days] [outdoor file]: Simulate heating schedules\n";
+        if (Clock::current().isVirtual()) {
+            cout << "12 [duration]: Advance the virtual clock (e.g. 90s, 15m, 36h, 7d)\n";
+        }
+        cout << "13 [file name]: Export reading history (CSV if the name ends in .csv)\n";
+        cout << "14 [device name]: Show memory use\n";
+        cout << "15 [file, FIFO or socket]: Read sensor readings in line protocol (no name: show progress)\n";
+        cout << "16: Snapshots and rollback\n";
+        cout << "9: Exit\n";
+
+        string input;
+        cout << "Enter choice: ";
+        if (!getline(cin, input)) break;  // End of input: exit as if 9 was chosen
+        TraceScope scope("menu", input.c_str());  // Includes any prompts the option shows
+
+        // A simulation can run for a while; it only holds the lock while reading the devices
+        if (input == "11" || input.substr(0, 3) == "11 ") {
+            simulateHeating(input.size() > 3 ? input.substr(3) : "");
+            continue;
+        }
+        // So does an export, one device at a time
+        if (input.substr(0, 3) == "13 ") {
+            exportFromConsole(input.substr(3));
+            continue;
+        }
+
+        // Control server requests wait while a console command (including a device menu) runs
+        lock_guard<recursive_mutex> lock(homeMutex);
+
+        if (input == "1") {
+            listDevices();
+        }
+        else if (input.substr(0, 2) == "1 ") {
+            showMatchingDevices(input.substr(2));
+        }
+        else if (input == "2") {
+            sortByName();
+        }
+        else if (input == "3") {
+            sortByType();
+        }
+        else if (input == "5") {
+            addDevice();
+        }
+        else if (input == "9") {
+            break;  // Exit the program
+        }
+        else if (input.substr(0, 2) == "6 ") {
+            applyBatchFile(input.substr(2));
+        }
+        else if (input.substr(0, 2) == "7 ") {
+            int changed = activateScene(input.substr(2));
+            if (changed < 0) {
+                cout << "Scene not found.\n";
+            }
+            else {
+                cout << "Scene activated: " << changed << " device settings applied.\n";
+            }
+        }
+        else if (input == "8") {
+            manageScenes();
+        }
+        else if (input.substr(0, 3) == "10 ") {
+            editRoomAndTags(input.substr(3));
+        }
+        else if (input.substr(0, 3) == "12 ") {
+            string result;
+            bool ok = advanceClock(input.substr(3), result);
+            cout << (ok ? "" : "Error: ") << result << "\n";
+        }
+        else if (input == "14" || input.substr(0, 3) == "14 ") {
+            string report;
+            if (describeMemory(input.size() > 3 ? input.substr(3) : "", report)) {
+                cout << report;
+            }
+            else {
+                cout << "Device not found.\n";
+            }
+        }
+        else if (input == "15") {
+            vector<string> lines = describeIngests();
+            if (lines.empty()) cout << "No sensor readings are being read.\n";
+            for (const string& line : lines) {
+                cout << line << "\n";
+            }
+        }
+        else if (input.substr(0, 3) == "15 ") {
+            string result;
+            bool ok = startIngest(input.substr(3), result);
+            cout << (ok ? "" : "Error: ") << result << "\n";
+        }
+        else if (input == "16") {
+            manageSnapshots();
+        }
+        else if (input.substr(0, 2) == "4 ") {
+            interactWithDevice(input.substr(2));  // Interact with a specific device
+        }
+        else {
+            handleOneClickAction(input);  // Perform a one-click action
+        }
+
+        saveDevices();  // Checkpoint the segments changed by this command
+    }
+}
+
+// Helper function: Splits a control command into its '|'-separated fields.
+static vector<string> splitCommand(const string& line) {
+    vector<string> fields;
+    stringstream ss(line);
+    string field;
+    while (getline(ss, field, '|')) {
+        fields.push_back(field);
+    }
+    return fields;
+}
+
+// Helper function: Parses a whole string as an integer. Returns false if it is not one.
+static bool parseInt(const string& text, int& value) {
+    try {
+        size_t used = 0;
+        value = stoi(text, &used);
+        return used == text.size();
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
+
+// Helper function: Parses a time given in seconds since 1970. Returns false if it is not a number.
+static bool parseTime(const string& text, time_t& value) {
+    try {
+        size_t used = 0;
+        value = static_cast<time_t>(stoll(text, &used));
+        return used == text.size();
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
+
+// Runs one command from the control server and returns its response.
+// Commands are '|'-separated fields, mirroring the console menu:
+//   list                              list|query (see DeviceQuery)  get|name   toggle|name
+//   set|name|attribute|value          sort|name or sort|type    timer|name|seconds
+//   add|TYPE|name                     remove|name
+//   schedule|name|add|HH|MM|on/off    schedule|name|remove|n    schedule|name|list
+//   schedule|name|at|HH|MM (scheduled state at that time)
+//   schedule|name|rule|text (recurring rule such as "on 07:30 weekdays", see RecurrenceRule::parse())
+//   scenes                            scene|name                scene|name|attribute|value (group action)
+//   room|name|room                    tags|name|tag,tag         find|query   count|query
+//   advance|duration (virtual clock only, e.g. advance|7d)
+//   history|name or history|name|from|to (readings between two times in seconds since 1970)
+//   export|file or export|file|query or export|file|query|from|to (CSV if the file ends in .csv)
+//   mem (memory per subsystem and the largest devices)   mem|name
+//   ingest|source (read sensor readings from a file, FIFO or socket; see SensorIngest)   ingest
+//   mem|cap|history, schedules or device|size (e.g. 64M; 0 removes the cap)
+//   snapshots                         snapshot|name             snapshot|name|drop
+//   snapshot|name|save|directory (write it as a complete store)  rollback|name
+// The response is zero or more data lines followed by "OK" or "ERR <reason>", each ending in '\n'.
+// Changes are saved by the caller's next checkpoint.
+string SmartHome::executeCommand(const string& line) {
+    TraceScope scope("command", line.c_str());
+    lock_guard<recursive_mutex> lock(homeMutex);
+    vector<string> fields = splitCommand(line);
+    if (fields.empty()) return "ERR empty command\n";
+
+    const string& command = fields[0];
+    string reply;
+
+    if (command == "list" && fields.size() == 1) {
+        describeAll([&reply](const string& lines) { reply += lines; });
+        return reply + "OK\n";
+    }
+    if (command == "list" && fields.size() == 2) {
+        DeviceQuery query;
+        string error;
+        bool ok = query.compile(fields[1], error) && listMatching(query,
+            [this, &reply](const SmartDevice* device) { reply += describeDevice(device) + "\n"; }, error);
+        return ok ? reply + "OK\n" : "ERR " + error + "\n";
+    }
+    if (command == "scenes" && fields.size() == 1) {
+        for (const string& scene : listScenes()) {
+            reply += scene + "\n";
+        }
+        return reply + "OK\n";
+    }
+    if (command == "scene" && (fields.size() == 2 || fields.size() == 4)) {
+        int changed;
+        if (fields.size() == 2) {
+            changed = activateScene(fields[1]);
+        }
+        else {
+            DeviceAttribute attribute;
+            if (!SmartDevice::parseAttribute(fields[2], attribute)) return "ERR unknown setting\n";
+            try {
+                changed = applyToScene(fields[1], attribute, stod(fields[3]));
+            }
+            catch (const exception&) {
+                return "ERR invalid value\n";
+            }
+        }
+        if (changed < 0) return "ERR scene not found\n";
+        return to_string(changed) + " applied\nOK\n";
+    }
+    if (command == "snapshots" && fields.size() == 1) {
+        for (const string& snapshot : listSnapshots()) {
+            reply += snapshot + "\n";
+        }
+        return reply + "OK\n";
+    }
+    if (command == "snapshot" && fields.size() == 2) {
+        int count = takeSnapshot(fields[1]);
+        if (count < 0) return "ERR empty snapshot name\n";
+        return to_string(count) + " devices\nOK\n";
+    }
+    if (command == "snapshot" && fields.size() == 3 && fields[2] == "drop") {
+        return dropSnapshot(fields[1]) ? "OK\n" : "ERR snapshot not found\n";
+    }
+    if (command == "snapshot" && fields.size() == 4 && fields[2] == "save") {
+        string result;
+        if (!saveSnapshot(fields[1], fields[3], result)) return "ERR " + result + "\n";
+        return result + "\nOK\n";
+    }
+    if (command == "rollback" && fields.size() == 2) {
+        int changed = rollback(fields[1]);
+        if (changed < 0) return "ERR snapshot not found\n";
+        return to_string(changed) + " changed\nOK\n";
+    }
+    if ((command == "find" || command == "count") && fields.size() <= 2) {
+        RoaringBitmap matches;
+        string error;
+        if (!queryDevices(fields.size() == 2 ? fields[1] : "", matches, error)) return "ERR " + error + "\n";
+        if (command == "count") return to_string(matches.cardinality()) + "\nOK\n";
+        for (const SmartDevice* device : devicesIn(matches)) {
+            reply += device->getName() + "\n";
+        }
+        return reply + "OK\n";
+    }
+    if (command == "ingest" && fields.size() == 1) {
+        for (const string& entry : describeIngests()) {
+            reply += entry + "\n";
+        }
+        return reply + "OK\n";
+    }
+    if (command == "ingest" && fields.size() == 2) {
+        string result;
+        return startIngest(fields[1], result) ? result + "\nOK\n" : "ERR " + result + "\n";
+    }
+    if (command == "mem" && fields.size() <= 2) {
+        if (!describeMemory(fields.size() == 2 ? fields[1] : "", reply)) return "ERR device not found\n";
+        return reply + "OK\n";
+    }
+    if (command == "mem" && fields.size() == 4 && fields[1] == "cap") {
+        string result;
+        bool ok = setMemoryCap(fields[2], fields[3], result);
+        return ok ? result + "\nOK\n" : "ERR " + result + "\n";
+    }
+    if (command == "advance" && fields.size() == 2) {
+        string result;
+        bool ok = advanceClock(fields[1], result);
+        return ok ? result + "\nOK\n" : "ERR " + result + "\n";
+    }
+    if (command == "export" && fields.size() >= 2 && fields.size() <= 5 && fields.size() != 4) {
+        time_t from = numeric_limits<time_t>::min();
+        time_t to = numeric_limits<time_t>::max();
+        if (fields.size() == 5 && (!parseTime(fields[3], from) || !parseTime(fields[4], to))) {
+            return "ERR invalid time\n";
+        }
+        string result;
+        bool ok = exportHistory(fields[1], fields.size() >= 3 ? fields[2] : "", from, to, result);
+        return ok ? result + "\nOK\n" : "ERR " + result + "\n";
+    }
+    if (command == "sort" && fields.size() == 2 && (fields[1] == "name" || fields[1] == "type")) {
+        sortDevices(fields[1] == "type");
+        return "OK\n";
+    }
+    if (command == "add" && fields.size() == 3) {
+        if (fields[2].empty()) return "ERR missing device name\n";
+        unique_ptr<SmartDevice> device = DeviceRegistry::create(fields[1]);
+        if (!device) return "ERR unknown device type\n";
+        device->setName(fields[2]);
+        reply = device->getQuickView() + "\n";
+        adoptDevice(move(device));
+        return reply + "OK\n";
+    }
+    if (fields.size() < 2) return "ERR malformed command\n";
+
+    SmartDevice* device = findDevice(fields[1]);
+    if (!device) return "ERR device not found\n";
+
+    if ((command == "room" || command == "tags") && fields.size() == 3) {
+        if (command == "room") device->setRoom(fields[2]);
+        else device->setTags(fields[2]);
+        return "OK\n";
+    }
+    if (command == "get" && fields.size() == 2) {
+        return device->getQuickView() + "\nOK\n";
+    }
+    if (command == "toggle" && fields.size() == 2) {
+        device->toggle();
+        return device->getQuickView() + "\nOK\n";
+    }
+    if (command == "remove" && fields.size() == 2) {
+        eraseDevice(device);
+        return "OK\n";
+    }
+    if (command == "set" && fields.size() == 4) {
+        DeviceAttribute attribute;
+        if (!SmartDevice::parseAttribute(fields[2], attribute)) return "ERR unknown setting\n";
+        double value;
+        try {
+            value = stod(fields[3]);
+        }
+        catch (const exception&) {
+            return "ERR invalid value\n";
+        }
+        if (!device->applySetting(attribute, value)) return "ERR setting not supported by this device\n";
+        return device->getQuickView() + "\nOK\n";
+    }
+    if (command == "timer" && fields.size() == 3) {
+        int seconds;
+        if (!parseInt(fields[2], seconds) || seconds <= 0) return "ERR invalid duration\n";
+        if (!device->getIsOn()) return "ERR device is off\n";
+        if (!device->runTimer(seconds)) return "ERR behaviors are not running\n";
+        return "OK\n";
+    }
+    if (command == "history" && (fields.size() == 2 || fields.size() == 4)) {
+        time_t from = numeric_limits<time_t>::min();
+        time_t to = numeric_limits<time_t>::max();
+        if (fields.size() == 4 && (!parseTime(fields[2], from) || !parseTime(fields[3], to))) {
+            return "ERR invalid time\n";
+        }
+        ostringstream out;
+        if (!device->writeHistory(from, to, out)) return "ERR device keeps no history\n";
+        return out.str() + "OK\n";
+    }
+    if (command == "schedule" && fields.size() >= 3) {
+        const string& action = fields[2];
+        if (action == "list" && fields.size() == 3) {
+            for (const string& entry : device->getScheduleLines()) {
+                reply += entry + "\n";
+            }
+            return reply + "OK\n";
+        }
+        if (action == "add" && fields.size() == 6) {
+            int hour, minute;
+            if (!parseInt(fields[3], hour) || !parseInt(fields[4], minute)) return "ERR invalid time\n";
+            if (fields[5] != "on" && fields[5] != "off") return "ERR state must be on or off\n";
+            if (!device->addSchedule(hour, minute, fields[5] == "on")) return "ERR schedule rejected\n";
+            return "OK\n";
+        }
+        if (action == "at" && fields.size() == 5) {
+            int hour, minute;
+            bool on;
+            if (!parseInt(fields[3], hour) || !parseInt(fields[4], minute) || hour < 0 || hour >= 24 || minute < 0 || minute >= 60) {
+                return "ERR invalid time\n";
+            }
+            if (!device->getScheduledState(hour * 60 + minute, on)) return "ERR no schedule\n";
+            return string(on ? "on" : "off") + "\nOK\n";
+        }
+        if (action == "remove" && fields.size() == 4) {
+            int index;
+            if (!parseInt(fields[3], index) || !device->removeSchedule(index)) return "ERR invalid schedule number\n";
+            return "OK\n";
+        }
+        if (action == "rule" && fields.size() == 4) {
+            string error;
+            if (!device->addRule(fields[3], error)) return "ERR " + error + "\n";
+            return "OK\n";
+        }
+    }
+    return "ERR malformed command\n";
+}
+
+// Applies a bulk update in one pass under a single lock, then checkpoints once.
+// Each distinct device name is resolved once, however many operations name it, and the operations
+// are then applied in batch order. Operations naming unknown devices or settings a device does
+// not have are recorded as failures without stopping the rest of the batch.
+void SmartHome::applyBatch(BatchUpdate& batch) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    const auto& operations = batch.operations;
+    vector<SmartDevice*> targets = resolveNames(batch);
+    for (SmartDevice* device : targets) {
+        if (device) {
+            device->hydrate();  // Only the first operation on a device loads it
+        }
+    }
+
+    for (size_t i = 0; i < operations.size(); ++i) {
+        if (!targets[i]) {
+            batch.fail(operations[i].line, "device \"" + operations[i].device + "\" not found");
+        }
+        else if (!targets[i]->applySetting(operations[i].attribute, operations[i].value)) {
+            batch.fail(operations[i].line, "setting not supported by " + targets[i]->getName());
+        }
+        else {
+            ++batch.applied;
+        }
+    }
+
+    saveDevices();  // One checkpoint for the whole batch
+}
+
+// Records a block of sensor readings (see SensorIngest). Each distinct name is looked up once,
+// the readings are grouped by device with a counting sort that keeps their order, and each
+// sensor gets its readings in one call. Readings for unknown names or devices that are not
+// sensors are counted in batch.unknown.
+void SmartHome::applyReadings(ReadingBatch& batch) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    size_t names = batch.names.size();
+    vector<size_t> start(names + 1, 0);
+    for (uint32_t name : batch.nameOf) {
+        ++start[name + 1];
+    }
+    for (size_t i = 0; i < names; ++i) {
+        start[i + 1] += start[i];
+    }
+    vector<HistoryLog::Sample> grouped(batch.readings.size());
+    vector<size_t> next(start.begin(), start.end() - 1);
+    for (size_t i = 0; i < batch.readings.size(); ++i) {
+        grouped[next[batch.nameOf[i]]++] = batch.readings[i];
+    }
+
+    for (size_t i = 0; i < names; ++i) {
+        SmartDevice* device = findDevice(batch.names[i]);
+        size_t count = start[i + 1] - start[i];
+        if (!device || !device->recordReadings(&grouped[start[i]], count)) {
+            batch.unknown += count;
+        }
+    }
+}
+
+// Starts reading sensor readings from a file, FIFO or Unix domain socket in the background
+// (see SensorIngest). On success result says so; otherwise it holds the reason.
+bool SmartHome::startIngest(const string& source, string& result) {
+    auto ingest = make_unique<SensorIngest>(*this, source);
+    if (!ingest->start(result)) return false;
+    lock_guard<recursive_mutex> lock(homeMutex);
+    ingests.push_back(move(ingest));
+    result = "Reading sensor readings from " + source + ".";
+    return true;
+}
+
+// Describes each sensor ingest started so far, one line each.
+vector<string> SmartHome::describeIngests() const {
+    vector<string> lines;
+    for (const auto& ingest : ingests) {
+        lines.push_back(ingest->describe());
+    }
+    return lines;
+}
+
+// Resolves the device named by each operation of a batch. Each name is hashed once, without
+// folding a copy, to find its symbol; the rest are integer lookups. Unknown names give nullptr.
+vector<SmartDevice*> SmartHome::resolveNames(const BatchUpdate& batch) const {
+    const SymbolTable& symbols = SymbolTable::instance();
+    vector<SmartDevice*> targets(batch.operations.size(), nullptr);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        targets[i] = lookupSymbol(symbols.find(batch.operations[i].device));
+    }
+    return targets;
+}
+
+// Reads a bulk update from a file, or from the console when the name is "-", applies it and
+// prints the result. A batch that is cut off before its END line is not applied at all.
+void SmartHome::applyBatchFile(const string& fileName) {
+    BatchUpdate batch;
+    bool complete;
+    if (fileName == "-") {
+        cout << "Enter the batch (BATCH, then device|setting|value lines, then END):\n";
+        complete = batch.read(cin);
+    }
+    else {
+        ifstream inFile(fileName);
+        if (!inFile) {
+            cout << "Error: cannot open " << fileName << ".\n";
+            return;
+        }
+        complete = batch.read(inFile);
+    }
+
+    if (!complete) {
+        cout << "Error: the batch must start with BATCH and end with END. Nothing was applied.\n";
+        return;
+    }
+    applyBatch(batch);
+    cout << batch.report();
+}
+
+// Loads the scenes saved in "smart_home_scenes.txt". Each scene is a "SCENE|name" line followed
+// by its settings in bulk update form (BATCH ... END). Device names are resolved to slots here,
+// once; settings for devices that no longer exist are dropped.
+void SmartHome::loadScenes() {
+    TraceScope scope("loadScenes");
+    ifstream inFile("smart_home_scenes.txt");
+    string line;
+    while (getline(inFile, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.compare(0, 6, "SCENE|") != 0) continue;
+
+        BatchUpdate batch;
+        if (!batch.read(inFile)) break;  // Cut-off file: keep the scenes read so far
+        defineScene(line.substr(6), batch);
+        if (!batch.failures.empty()) {
+            cout << "Warning: scene " << line.substr(6) << " lost " << batch.failures.size()
+                << " settings for missing devices.\n";
+        }
+    }
+    scenesDirty = false;
+}
+
+// Writes every scene to "smart_home_scenes.txt" by current device names, through a temporary file.
+void SmartHome::saveScenes() {
+    {
+        ofstream file("smart_home_scenes.txt.tmp");
+        for (const auto& entry : scenes) {
+            const Scene& scene = entry.second;
+            auto live = count_if(scene.actions.begin(), scene.actions.end(),
+                [this](const SceneAction& action) { return slots[action.slot] != nullptr; });
+            file << "SCENE|" << scene.name << "\nBATCH " << live << "\n";
+            for (const SceneAction& action : scene.actions) {
+                if (slots[action.slot]) {
+                    file << slots[action.slot]->getName() << "|" << SmartDevice::attributeName(action.attribute)
+                        << "|" << action.value << "\n";
+                }
+            }
+            file << "END\n";
+        }
+    }
+    error_code ec;
+    filesystem::rename("smart_home_scenes.txt.tmp", "smart_home_scenes.txt", ec);
+    scenesDirty = static_cast<bool>(ec);
+}
+
+// Creates or replaces a scene from the settings in a batch. Device names are resolved to slots
+// now, so activating the scene does no name lookups; unknown names are recorded as batch failures.
+// Returns false if the name is empty.
+bool SmartHome::defineScene(const string& name, BatchUpdate& batch) {
+    if (name.empty()) return false;
+    lock_guard<recursive_mutex> lock(homeMutex);
+
+    Scene scene;
+    scene.name = name;
+    scene.actions.reserve(batch.operations.size());
+    vector<SmartDevice*> targets = resolveNames(batch);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        const auto& operation = batch.operations[i];
+        if (targets[i]) {
+            scene.actions.push_back({ targets[i]->getSlot(), operation.attribute, operation.value });
+            ++batch.applied;
+        }
+        else {
+            batch.fail(operation.line, "device \"" + operation.device + "\" not found");
+        }
+    }
+
+    scenes[SymbolTable::instance().intern(name)] = move(scene);
+    scenesDirty = true;
+    return true;
+}
+
+// Deletes a scene. Returns false if there is no scene with that name.
+bool SmartHome::deleteScene(const string& name) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    if (scenes.erase(SymbolTable::instance().find(name)) == 0) return false;
+    scenesDirty = true;
+    return true;
+}
+
+// Applies every setting of a scene in one loop over device slots, then checkpoints once.
+// Removed devices are skipped. Returns the number of settings applied, or -1 if there is no such scene.
+int SmartHome::activateScene(const string& name) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    auto it = scenes.find(SymbolTable::instance().find(name));
+    if (it == scenes.end()) return -1;
+
+    int applied = 0;
+    for (const SceneAction& action : it->second.actions) {
+        SmartDevice* device = slots[action.slot];
+        if (device) {
+            device->hydrate();
+            applied += device->applySetting(action.attribute, action.value) ? 1 : 0;
+        }
+    }
+    saveDevices();
+    return applied;
+}
+
+// Group action: applies one setting to every device in a scene, ignoring the scene's own values.
+// Devices without that setting are skipped. Returns the number of devices changed, or -1 if there is no such scene.
+int SmartHome::applyToScene(const string& name, DeviceAttribute attribute, double value) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    auto it = scenes.find(SymbolTable::instance().find(name));
+    if (it == scenes.end()) return -1;
+
+    int applied = 0;
+    int lastSlot = -1;
+    for (const SceneAction& action : it->second.actions) {
+        SmartDevice* device = slots[action.slot];
+        if (device && action.slot != lastSlot) {  // A scene may set several things on one device
+            device->hydrate();
+            applied += device->applySetting(attribute, value) ? 1 : 0;
+        }
+        lastSlot = action.slot;
+    }
+    saveDevices();
+    return applied;
+}
+
+// Returns one "name (N settings)" line per scene, sorted by name.
+vector<string> SmartHome::listScenes() const {
+    vector<string> lines;
+    for (const auto& entry : scenes) {
+        lines.push_back(entry.second.name + " (" + to_string(entry.second.actions.size()) + " settings)");
+    }
+    sort(lines.begin(), lines.end(), caseInsensitiveSortCompare);
+    return lines;
+}
+
+// Scene and group menu: lists, creates, applies group settings to and deletes scenes.
+void SmartHome::manageScenes() {
+    while (true) {
+        cout << "\nScenes and Groups:\n";
+        cout << "1: List scenes\n";
+        cout << "2: Create scene from a bulk update file (- to type it)\n";
+        cout << "3: Apply one setting to every device in a scene (group action)\n";
+        cout << "4: Delete scene\n";
+        cout << "9: Back to Main Menu\n";
+        cout << "Enter choice: ";
+
+        int choice;
+        if (!(cin >> choice)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return;
+        }
+        cin.ignore();
+
+        if (choice == 9) return;
+        if (choice == 1) {
+            vector<string> lines = listScenes();
+            if (lines.empty()) cout << "No scenes defined.\n";
+            for (const string& line : lines) cout << line << "\n";
+            continue;
+        }
+        if (choice < 2 || choice > 4) {
+            cout << "Invalid choice.\n";
+            continue;
+        }
+
+        string name;
+        cout << "Enter scene name: ";
+        getline(cin, name);
+
+        if (choice == 2) {
+            string fileName;
+            cout << "Enter file name (- to type it): ";
+            getline(cin, fileName);
+
+            BatchUpdate batch;
+            bool complete;
+            if (fileName == "-") {
+                cout << "Enter the settings (BATCH, then device|setting|value lines, then END):\n";
+                complete = batch.read(cin);
+            }
+            else {
+                ifstream inFile(fileName);
+                complete = inFile && batch.read(inFile);
+            }
+            if (!complete || !defineScene(name, batch)) {
+                cout << "Error: could not read the scene. It was not created.\n";
+                continue;
+            }
+            cout << batch.report();
+        }
+        else if (choice == 3) {
+            string setting;
+            double value;
+            DeviceAttribute attribute;
+            cout << "Enter setting (on, brightness, volume, playing, target) and value: ";
+            cin >> setting >> value;
+            cin.ignore();
+            if (!SmartDevice::parseAttribute(setting, attribute)) {
+                cout << "Unknown setting.\n";
+                continue;
+            }
+            int changed = applyToScene(name, attribute, value);
+            if (changed < 0) cout << "Scene not found.\n";
+            else cout << changed << " devices changed.\n";
+        }
+        else {
+            cout << (deleteScene(name) ? "Scene deleted.\n" : "Scene not found.\n");
+        }
+    }
+}
+
+// Captures every segment not yet in the home image, which after startup is each segment no
+// checkpoint has rewritten. Once all are captured, taking a snapshot only copies a pointer.
+void SmartHome::completeImage() {
+    vector<int> missing;
+    for (size_t segmentId = 0; segmentId < segments.size(); ++segmentId) {
+        if (segmentId >= image->segments.size() || !image->segments[segmentId]) {
+            missing.push_back(static_cast<int>(segmentId));
+        }
+    }
+    if (missing.empty()) return;
+
+    TraceScope scope("completeImage");
+    vector<shared_ptr<const HomeImage::Segment>> built(missing.size());
+    pool.parallelFor(missing.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            built[i] = captureSegment(missing[i]);
+        }
+    });
+    auto next = make_shared<HomeImage>(*image);
+    next->segments.resize(segments.size());
+    for (size_t i = 0; i < missing.size(); ++i) {
+        next->segments[missing[i]] = built[i];
+    }
+    image = move(next);
+}
+
+// Takes a named snapshot of the whole home, replacing any snapshot with that name.
+// The store is checkpointed first, so the snapshot is the image of that checkpoint and shares
+// every segment and device with it; only later changes are copied.
+// Returns the number of devices in the snapshot, or -1 if the name is empty.
+int SmartHome::takeSnapshot(const string& name) {
+    if (name.empty()) return -1;
+    lock_guard<recursive_mutex> lock(homeMutex);
+    saveDevices();
+    completeImage();
+    snapshots[SymbolTable::instance().intern(name)] = { name, Clock::currentTime(), image };
+    return static_cast<int>(image->deviceCount());
+}
+
+// Rolls the home back to a snapshot. Devices added since are removed, devices removed since are
+// recreated in their old slots, the store order is restored and every device whose stored image
+// differs from the snapshot's is restored from it; the others are left alone.
+// History files are not rolled back. Returns the number of devices changed, or -1 if there is
+// no snapshot with that name.
+int SmartHome::rollback(const string& name) {
+    TraceScope scope("rollback", name.c_str());
+    lock_guard<recursive_mutex> lock(homeMutex);
+    auto found = snapshots.find(SymbolTable::instance().find(name));
+    if (found == snapshots.end()) return -1;
+    shared_ptr<const HomeImage> target = found->second.image;
+
+    saveDevices();  // The home image now matches the devices exactly
+    completeImage();
+
+    vector<const HomeImage::Device*> current(slots.size(), nullptr);  // Slot -> image now
+    vector<const HomeImage::Device*> wanted(slots.size(), nullptr);   // Slot -> image in the snapshot
+    for (const auto& segment : image->segments) {
+        if (!segment) continue;
+        for (const auto& device : segment->devices) current[device->getSlot()] = device.get();
+    }
+    for (const auto& segment : target->segments) {
+        if (!segment) continue;
+        for (const auto& device : segment->devices) wanted[device->getSlot()] = device.get();
+    }
+
+    int changed = 0;
+    vector<SmartDevice*> added;
+    for (const auto& device : devices) {
+        if (!wanted[device->getSlot()]) added.push_back(device.get());
+    }
+    for (SmartDevice* device : added) {
+        eraseDevice(device);
+        ++changed;
+    }
+
+    for (size_t slotId = 0; slotId < slots.size(); ++slotId) {
+        if (!wanted[slotId] || slots[slotId]) continue;
+        string_view record = wanted[slotId]->getRecord();
+        unique_ptr<SmartDevice> device = DeviceRegistry::create(record.substr(0, record.find('|')));
+        if (!device) continue;
+        device->setSlot(static_cast<int>(slotId));
+        slots[slotId] = device.get();
+        current[slotId] = nullptr;  // Restored below
+        devices.push_back(move(device));
+        ++changed;
+    }
+
+    // Put the devices back in the snapshot's store order
+    vector<unique_ptr<SmartDevice>> bySlot(slots.size());
+    for (auto& device : devices) {
+        int slotId = device->getSlot();
+        bySlot[slotId] = move(device);
+    }
+    devices.clear();
+    for (size_t segmentId = 0; segmentId < segments.size(); ++segmentId) {
+        vector<SmartDevice*> members;
+        if (segmentId < target->segments.size() && target->segments[segmentId]) {
+            for (const auto& stored : target->segments[segmentId]->devices) {
+                unique_ptr<SmartDevice>& device = bySlot[stored->getSlot()];
+                if (!device) continue;
+                device->attach(this, static_cast<int>(segmentId));
+                members.push_back(device.get());
+                devices.push_back(move(device));
+            }
+        }
+        segments[segmentId].members = move(members);
+    }
+
+    for (auto& device : devices) {
+        int slotId = device->getSlot();
+        if (current[slotId] == wanted[slotId]) continue;
+        const HomeImage::Device* stored = wanted[slotId];
+        unindexDevice(device.get());
+        // A recreated device is logged as added once it has its name; the others log what changed
+        device->restore(string(stored->getRecord()), stored->getSchedules(), stored->getAttributes(), current[slotId] != nullptr);
+        if (!current[slotId]) {
+            device->logEvent(EventLog::Event::Added);
+        }
+        indexDevice(device.get());
+        attributeIndex.update(slotId, *device);
+        mirror.publish(slotId, *device);
+        if (current[slotId]) ++changed;
+    }
+
+    // The snapshot becomes the home image; segments that differ from the files are rewritten
+    auto next = make_shared<HomeImage>(*target);
+    next->segments.resize(segments.size());
+    for (size_t segmentId = 0; segmentId < segments.size(); ++segmentId) {
+        if (segmentId >= image->segments.size() || next->segments[segmentId] != image->segments[segmentId]) {
+            noteDirty(static_cast<int>(segmentId));
+        }
+    }
+    image = move(next);
+    scenesDirty = scenesDirty || !scenes.empty();
+    saveDevices();
+    return changed;
+}
+
+// Deletes a snapshot. Devices and segments it alone shared are freed.
+// Returns false if there is no snapshot with that name.
+bool SmartHome::dropSnapshot(const string& name) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    return snapshots.erase(SymbolTable::instance().find(name)) > 0;
+}
+
+// Writes a snapshot as a complete store in a directory, in the background: the snapshot's image
+// never changes, so the writer needs no lock. The outcome is printed when it is done.
+// Returns false if there is no snapshot with that name; result says what happened.
+bool SmartHome::saveSnapshot(const string& name, const string& directory, string& result) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    auto it = snapshots.find(SymbolTable::instance().find(name));
+    if (it == snapshots.end()) {
+        result = "no snapshot named " + name;
+        return false;
+    }
+    shared_ptr<const HomeImage> saved = it->second.image;
+    string label = it->second.name;
+    snapshotWriters.emplace_back([saved, label, directory]() {
+        string error;
+        if (saved->writeStore(directory, error)) {
+            ConsoleWriter::print("Snapshot \"" + label + "\" saved to " + directory + ".\n");
+        }
+        else {
+            ConsoleWriter::print("Error: could not save snapshot \"" + label + "\": " + error + "\n");
+        }
+    });
+    result = "saving snapshot " + label + " to " + directory;
+    return true;
+}
+
+// Returns one line per snapshot: its name, device count and when it was taken, oldest first.
+vector<string> SmartHome::listSnapshots() const {
+    vector<const Snapshot*> ordered;
+    for (const auto& entry : snapshots) {
+        ordered.push_back(&entry.second);
+    }
+    sort(ordered.begin(), ordered.end(),
+        [](const Snapshot* a, const Snapshot* b) { return a->taken < b->taken || (a->taken == b->taken && a->name < b->name); });
+
+    vector<string> lines;
+    for (const Snapshot* snapshot : ordered) {
+        tm local;
+#ifdef _MSC_VER
+        localtime_s(&local, &snapshot->taken);
+#else
+        localtime_r(&snapshot->taken, &local);
+#endif
+        stringstream ss;
+        ss << snapshot->name << ": " << snapshot->image->deviceCount() << " devices, taken "
+            << put_time(&local, "%Y-%m-%d %H:%M");
+        lines.push_back(ss.str());
+    }
+    return lines;
+}
+
+// Displays the snapshot menu: list, take, roll back to, save and delete named snapshots.
+void SmartHome::manageSnapshots() {
+    while (true) {
+        cout << "\nSnapshots and Rollback:\n";
+        cout << "1: List snapshots\n";
+        cout << "2: Take snapshot\n";
+        cout << "3: Roll back to snapshot\n";
+        cout << "4: Save snapshot to a directory\n";
+        cout << "5: Delete snapshot\n";
+        cout << "9: Back to Main Menu\n";
+        cout << "Enter choice: ";
+
+        int choice;
+        if (!(cin >> choice)) {
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            return;
+        }
+        cin.ignore();
+
+        if (choice == 9) return;
+        if (choice == 1) {
+            vector<string> lines = listSnapshots();
+            if (lines.empty()) cout << "No snapshots taken.\n";
+            for (const string& line : lines) cout << line << "\n";
+            continue;
+        }
+        if (choice < 2 || choice > 5) {
+            cout << "Invalid choice.\n";
+            continue;
+        }
+
+        string name;
+        cout << "Enter snapshot name: ";
+        getline(cin, name);
+
+        if (choice == 2) {
+            int count = takeSnapshot(name);
+            if (count < 0) cout << "Error: the name is empty.\n";
+            else cout << "Snapshot taken of " << count << " devices.\n";
+        }
+        else if (choice == 3) {
+            int changed = rollback(name);
+            if (changed < 0) cout << "Snapshot not found.\n";
+            else cout << "Rolled back; " << changed << " devices changed.\n";
+        }
+        else if (choice == 4) {
+            string directory, result;
+            cout << "Enter directory: ";
+            getline(cin, directory);
+            bool ok = saveSnapshot(name, directory, result);
+            cout << (ok ? "Started " + result + ".\n" : "Error: " + result + ".\n");
+        }
+        else {
+            cout << (dropSnapshot(name) ? "Snapshot deleted.\n" : "Snapshot not found.\n");
+        }
+    }
+}
+
+// Finds the slots of the devices matching a query over type, power, room and tags
+// (see DeviceIndex::query). The query is answered from the bitmap indexes without visiting any device.
+// Returns false and sets error if the query is malformed.
+bool SmartHome::queryDevices(const string& expression, RoaringBitmap& matches, string& error) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    refreshIndex();
+    return attributeIndex.query(foldName(expression), matches, error);
+}
+
+// Returns the devices in a set of slots, in slot order.
+vector<SmartDevice*> SmartHome::devicesIn(const RoaringBitmap& matches) const {
+    vector<SmartDevice*> found;
+    found.reserve(matches.cardinality());
+    for (uint32_t slotId : matches.toVector()) {
+        found.push_back(slots[slotId]);
+    }
+    return found;
+}
+
+// Prompts for a device's room and tags. Leaving an answer empty keeps the current value.
+void SmartHome::editRoomAndTags(const string& name) {
+    SmartDevice* device = findDevice(name);
+    if (!device) {
+        cout << "Device not found.\n";
+        return;
+    }
+
+    string room, tags;
+    cout << "Enter room (currently \"" << device->getRoom() << "\", - to clear): ";
+    getline(cin, room);
+    cout << "Enter comma-separated tags (currently \"" << device->getTagList() << "\", - to clear): ";
+    getline(cin, tags);
+
+    if (!room.empty()) device->setRoom(room == "-" ? "" : room);
+    if (!tags.empty()) device->setTags(tags == "-" ? "" : tags);
+    cout << "Room and tags updated.\n";
+}
+
+// Runs a compiled list query, passing each matching device to emit as soon as it is known.
+// The bitmap indexes narrow the devices down first; the remaining predicates run only on those,
+// loading lazily loaded devices only if a predicate or the sort key needs their state.
+// Without a sort key devices come out in the order they were added, and the walk stops at the limit.
+// With a sort key and a limit, a bounded heap keeps the best devices seen so far, so finding the
+// top k of N devices costs O(N log k) instead of a full sort.
+bool SmartHome::listMatching(const DeviceQuery& query, const function<void(const SmartDevice*)>& emit, string& error) {
+    lock_guard<recursive_mutex> lock(homeMutex);
+    RoaringBitmap matches;
+    if (!queryDevices(query.indexExpression, matches, error)) return false;
+
+    struct Candidate {
+        double number;      // Sort key for energy
+        string text;        // Sort key for name, type and room
+        int slot;           // Ties keep the order devices were added
+        SmartDevice* device;
+    };
+    auto before = [&query](const Candidate& a, const Candidate& b) {
+        bool less = query.sortKey == DeviceQuery::SortKey::Energy ? a.number < b.number : a.text < b.text;
+        bool greater = query.sortKey == DeviceQuery::SortKey::Energy ? b.number < a.number : b.text < a.text;
+        if (less != greater) return query.descending ? greater : less;
+        return a.slot < b.slot;
+    };
+
+    vector<Candidate> best;  // Max-heap under "before": the front is the worst device kept so far
+    size_t emitted = 0;
+    for (uint32_t slotId : matches.toVector()) {
+        SmartDevice* device = slots[slotId];
+        if (query.needsState) {
+            device->hydrate();
+        }
+        bool accepted = all_of(query.predicates.begin(), query.predicates.end(),
+            [device](const function<bool(const SmartDevice&)>& predicate) { return predicate(*device); });
+        if (!accepted) continue;
+
+        if (query.sortKey == DeviceQuery::SortKey::None) {
+            emit(device);
+            if (++emitted == query.limit) break;
+            continue;
+        }
+
+        Candidate candidate{ 0.0, "", static_cast<int>(slotId), device };
+        switch (query.sortKey) {
+        case DeviceQuery::SortKey::Energy: candidate.number = device->getEnergyUsage(); break;
+        case DeviceQuery::SortKey::Type: candidate.text = foldName(device->getDeviceType()); break;
+        case DeviceQuery::SortKey::Room: candidate.text = foldName(device->getRoom()); break;
+        default: candidate.text = foldName(device->getName()); break;
+        }
+
+        if (query.limit == 0 || best.size() < query.limit) {
+            best.push_back(move(candidate));
+            push_heap(best.begin(), best.end(), before);
+        }
+        else if (before(candidate, best.front())) {
+            pop_heap(best.begin(), best.end(), before);
+            best.back() = move(candidate);
+            push_heap(best.begin(), best.end(), before);
+        }
+    }
+
+    sort_heap(best.begin(), best.end(), before);
+    for (const Candidate& candidate : best) {
+        emit(candidate.device);
+    }
+    return true;
+}
+
+// Lists the devices matching a list query with their quick views, printing each as it is found.
+void SmartHome::showMatchingDevices(const string& expression) {
+    DeviceQuery query;
+    string error;
+    size_t found = 0;
+    bool ok = query.compile(expression, error) && listMatching(query,
+        [this, &found](const SmartDevice* device) {
+            cout << describeDevice(device) << "\n";
+            ++found;
+        }, error);
+
+    if (!ok) {
+        cout << "Error: " << error << ".\n";
+        return;
+    }
+    cout << found << " devices found.\n";
+}
+
+// Simulates the home's heating over a number of days (default 365) and prints what it would cost.
+// Each room with radiator valves or thermostats is a zone; a device without a room is a zone of its
+// own. Valves heat towards the highest target temperature in their zone, following their schedules,
+// and a zone with thermostats only heats while one of them is on. The outdoor temperature comes from
+// an hourly profile file if one is given, or from a typical temperate year.
+void SmartHome::simulateHeating(const string& arguments) {
+    int days = 365;
+    string outdoorFile;
+    stringstream ss(arguments);
+    string word;
+    if (ss >> word && !parseInt(word, days)) {
+        cout << "Invalid number of days.\n";
+        return;
+    }
+    ss >> outdoorFile;
+
+    ThermalSimulator simulator;
+    if (!outdoorFile.empty() && !simulator.loadOutdoorProfile(outdoorFile)) {
+        cout << "Could not read outdoor temperatures from " << outdoorFile << ".\n";
+        return;
+    }
+
+    {
+        lock_guard<recursive_mutex> lock(homeMutex);
+        struct Zone {
+            vector<RadiatorValve*> valves;
+            vector<Thermostat*> thermostats;
+        };
+        unordered_map<string, Zone> zones;
+        vector<string> order;  // Zones in the order their first device was added
+        for (const auto& device : devices) {
+            auto* valve = dynamic_cast<RadiatorValve*>(device.get());
+            auto* thermostat = dynamic_cast<Thermostat*>(device.get());
+            if (!valve && !thermostat) continue;
+
+            device->hydrate();
+            string zoneName = device->getRoom().empty() ? device->getName() : device->getRoom();
+            auto inserted = zones.emplace(zoneName, Zone());
+            if (inserted.second) order.push_back(zoneName);
+            if (valve) inserted.first->second.valves.push_back(valve);
+            else inserted.first->second.thermostats.push_back(thermostat);
+        }
+
+        for (const string& zoneName : order) {
+            const Zone& zone = zones[zoneName];
+            float target = 21.0f;
+            if (!zone.valves.empty()) {
+                target = zone.valves.front()->getTargetTemperature();
+                for (RadiatorValve* valve : zone.valves) target = max(target, valve->getTargetTemperature());
+            }
+            int id = simulator.addZone(zoneName, target);
+            for (RadiatorValve* valve : zone.valves) {
+                simulator.addRadiator(id, valve->getIsOn(), valve->getScheduleTransitions());
+            }
+            for (Thermostat* thermostat : zone.thermostats) {
+                simulator.addThermostat(id, thermostat->getIsOn(), thermostat->getScheduleTransitions());
+            }
+        }
+    }
+
+    if (simulator.getZoneCount() == 0) {
+        cout << "No radiator valves or thermostats to simulate.\n";
+        return;
+    }
+
+    auto start = chrono::steady_clock::now();
+    if (!simulator.run(days, 60, pool)) {
+        cout << "Invalid number of days.\n";
+        return;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    vector<ThermalSimulator::ZoneResult> results = simulator.getResults();
+    double totalEnergy = 0;
+    for (const auto& result : results) {
+        totalEnergy += result.energyUsed;
+    }
+    cout << "Simulated " << results.size() << " zones for " << days << " days in " << seconds << "s.\n";
+    cout << "Heating energy: " << totalEnergy << " kWh.\n";
+
+    // The zones that spent longest more than 1C below their target
+    size_t shown = min<size_t>(results.size(), 5);
+    partial_sort(results.begin(), results.begin() + shown, results.end(),
+        [](const ThermalSimulator::ZoneResult& a, const ThermalSimulator::ZoneResult& b) { return a.coldHours > b.coldHours; });
+    cout << "Coldest zones:\n";
+    for (size_t i = 0; i < shown; ++i) {
+        const auto& result = results[i];
+        cout << "  " << result.name << ": " << result.coldHours << " cold hours, minimum " << result.minTemperature
+            << "C, average " << result.meanTemperature << "C, " << result.energyUsed << " kWh\n";
+    }
+}
+
+// Helper function: Parses a duration such as "90", "15m", "36h" or "7d" (seconds without a unit).
+static bool parseDuration(const string& text, Clock::Duration& duration) {
+    try {
+        size_t used = 0;
+        double amount = stod(text, &used);
+        string unit = text.substr(used);
+        double seconds;
+        if (unit.empty() || unit == "s") seconds = amount;
+        else if (unit == "m") seconds = amount * 60;
+        else if (unit == "h") seconds = amount * 3600;
+        else if (unit == "d") seconds = amount * 86400;
+        else return false;
+        if (seconds < 0) return false;
+        duration = chrono::duration_cast<Clock::Duration>(chrono::duration<double>(seconds));
+        return true;
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
+
+// Fast-forwards the virtual clock by a duration such as "7d", running every timer, schedule and
+// sensor reading that falls due on the way (see BehaviorRuntime::advance()).
+// On success result describes the new time; otherwise it holds the reason.
+bool SmartHome::advanceClock(const string& durationText, string& result) {
+    if (!Clock::current().isVirtual()) {
+        result = "the clock is not virtual (start with --virtual-clock)";
+        return false;
+    }
+    Clock::Duration duration;
+    if (!parseDuration(durationText, duration)) {
+        result = "invalid duration";
+        return false;
+    }
+
+    lock_guard<recursive_mutex> lock(homeMutex);
+    size_t resumed = behaviors.advance(duration);
+
+    time_t now = Clock::currentTime();
+    tm local;
+#ifdef _MSC_VER
+    localtime_s(&local, &now);
+#else
+    localtime_r(&now, &local);
+#endif
+    stringstream ss;
+    ss << "Clock advanced to " << put_time(&local, "%Y-%m-%d %H:%M:%S") << "; " << resumed << " behavior steps ran.";
+    result = ss.str();
+    return true;
+}
+
+// Streams the history of the devices matching a query (all devices if it is empty) between two
+// times into an export file (see HistoryExport). The lock is taken for one device at a time, so
+// behaviors and clients keep running during a long export; a device removed meanwhile is skipped.
+// On success result summarizes the export; otherwise it holds the reason.
+bool SmartHome::exportHistory(const string& fileName, const string& expression, time_t from, time_t to, string& result) {
+    RoaringBitmap matches;
+    if (!queryDevices(expression, matches, result)) return false;
+
+    HistoryExport exporter;
+    if (!exporter.open(fileName, HistoryExport::formatFor(fileName))) {
+        result = "cannot create " + fileName;
+        return false;
+    }
+
+    auto started = chrono::steady_clock::now();
+    size_t exportedDevices = 0;
+    for (uint32_t slotId : matches.toVector()) {
+        lock_guard<recursive_mutex> lock(homeMutex);
+        SmartDevice* device = slots[slotId];
+        if (!device) continue;
+        device->hydrate();
+        auto histories = device->getHistories();
+        for (const auto& history : histories) {
+            exporter.addSeries(device->getName(), device->getTypeTag(), history.first, *history.second, from, to);
+        }
+        exportedDevices += histories.empty() ? 0 : 1;
+    }
+    if (!exporter.close()) {
+        result = "could not write " + fileName;
+        return false;
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    stringstream ss;
+    ss << fixed << setprecision(1) << "Exported " << exporter.getRowCount() << " readings of " << exportedDevices
+        << " devices to " << fileName << " (" << exporter.getBytesWritten() / 1e6 << " MB in "
+        << setprecision(2) << seconds << " s).";
+    result = ss.str();
+    return true;
+}
+
+// Asks which devices and times to export, then exports them to the given file.
+void SmartHome::exportFromConsole(const string& fileName) {
+    string expression, range;
+    cout << "Devices to export (query such as type=plug&room=kitchen, empty for all): ";
+    getline(cin, expression);
+    cout << "From and to, in seconds since 1970 (empty for all readings): ";
+    getline(cin, range);
+
+    time_t from = numeric_limits<time_t>::min();
+    time_t to = numeric_limits<time_t>::max();
+    stringstream ss(range);
+    string fromText, toText;
+    if (ss >> fromText && (!(ss >> toText) || !parseTime(fromText, from) || !parseTime(toText, to))) {
+        cout << "Invalid time range.\n";
+        return;
+    }
+
+    string result;
+    bool ok = exportHistory(fileName, expression, from, to, result);
+    cout << (ok ? "" : "Error: ") << result << "\n";
+}
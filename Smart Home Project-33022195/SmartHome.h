@@ -1,28 +1,151 @@
-#pragma once
-#include "SmartDevice.h"
-#include <vector>
-#include <memory>
-
-using namespace std;
-
-class SmartHome {
-private:
-    vector<unique_ptr<SmartDevice>> devices;
-
-public:
-    SmartHome();
-    ~SmartHome();
-
-    static SmartHome& getInstance();
-    void loadDevices();
-    void saveDevices();
-    void listDevices() const;
-    void sortByName();
-    void sortByType();
-    void removeDevice(const string& deviceName);
-    void addDevice();
-    void handleOneClickAction(const string& name);
-    void interactWithDevice(const string& name);
-    void run();
-};
-
+#pragma once
+#include "SmartDevice.h"
+#include "BatchUpdate.h"
+#include "DeviceIndex.h"
+#include "DeviceQuery.h"
+#include "BehaviorRuntime.h"
+#include "WorkStealingPool.h"
+#include "ReadingBatch.h"
+#include "SensorIngest.h"
+#include "SymbolTable.h"
+#include "HomeImage.h"
+#include "StateMirror.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <functional>
+#include <thread>
+#include <ctime>
+
+using namespace std;
+
+class SmartHome {
+private:
+    struct Segment {
+        string file;                    // Segment file holding these devices' records
+        vector<SmartDevice*> members;   // Devices stored in this segment
+        bool dirty;                     // Needs rewriting at the next checkpoint
+    };
+
+    struct SceneAction {
+        int slot;                       // Device slot (see slots)
+        DeviceAttribute attribute;
+        double value;
+    };
+
+    struct Scene {
+        string name;
+        vector<SceneAction> actions;
+    };
+
+    struct Snapshot {
+        string name;
+        time_t taken;
+        shared_ptr<const HomeImage> image;
+    };
+
+    static const size_t SEGMENT_CAPACITY = 256;
+    static const int MEMORY_CHECK_SECONDS = 5;    // How often the memory caps are checked
+    static const size_t MEMORY_REPORT_DEVICES = 10;
+
+    vector<unique_ptr<SmartDevice>> devices;
+    unordered_map<uint32_t, vector<SmartDevice*>> nameIndex;  // Name symbol (see SymbolTable) -> devices with that name
+    vector<SmartDevice*> slots;         // Device table for scenes; a removed device leaves nullptr
+    unordered_map<uint32_t, Scene> scenes;  // Scene name symbol -> scene
+    bool scenesDirty;                   // Scene file needs rewriting at the next checkpoint
+    DeviceIndex attributeIndex;         // Bitmaps of device slots by type, power, room and tag
+    vector<int> changedSlots;           // Devices to re-index before the next query
+    bool watchingMemory;                // watchMemory() is running; guarded by homeMutex
+    StateMirror mirror;                 // Device state in shared memory for local readers (closed unless opened)
+    vector<Segment> segments;
+    vector<int> dirtySegments;          // Segments to rewrite at the next checkpoint
+    bool manifestDirty;                 // Segment list changed since the last checkpoint
+    shared_ptr<const HomeImage> image;  // Store as of the last checkpoint, shared with snapshots
+    unordered_map<uint32_t, Snapshot> snapshots;  // Snapshot name symbol -> snapshot
+    vector<thread> snapshotWriters;     // Background saves of snapshots, joined at shutdown
+    mutex storeMutex;                   // Guards the dirty lists
+    recursive_mutex homeMutex;          // Serializes commands from the console and the control server
+    mutable WorkStealingPool pool;      // Runs passes over many devices or segments in parallel
+    vector<unique_ptr<SensorIngest>> ingests;  // Sensor reading streams, running or finished
+    BehaviorRuntime behaviors;          // Device timers and schedules; declared last so it stops first
+
+    static bool lazyLoading;            // Defer deserializing records until a device is first used
+
+    void placeDevice(SmartDevice* device);
+    void repackSegments();
+    bool hasDevice(const SmartDevice* device) const;
+    void indexDevice(SmartDevice* device);
+    void trackDevice(SmartDevice* device);
+    vector<SmartDevice*> resolveNames(const BatchUpdate& batch) const;
+    void loadScenes();
+    void saveScenes();
+    shared_ptr<const HomeImage::Segment> captureSegment(int segmentId);
+    void completeImage();
+    void refreshIndex();
+    void unindexDevice(SmartDevice* device);
+    SmartDevice* lookupDevice(const string& name) const;
+    SmartDevice* lookupSymbol(uint32_t symbol) const;
+    string describeDevice(const SmartDevice* device) const;
+    void describeAll(const function<void(const string&)>& emit) const;
+    void sortDevices(bool byType);
+    void eraseDevice(SmartDevice* device);
+    void adoptDevice(unique_ptr<SmartDevice> device);
+    Task watchMemory();
+    void watchMemoryIfCapped();
+
+public:
+    SmartHome();
+    ~SmartHome();
+
+    static SmartHome& getInstance();
+    static void setLazyLoading(bool enabled);
+    void loadDevices();
+    void saveDevices();
+    void noteDirty(int segmentId);
+    void noteRenamed(SmartDevice* device);
+    void noteChanged(int slotId);
+    BehaviorRuntime& getBehaviors();
+    bool openStateMirror(const string& name, string& result);
+    void startBehaviors();
+    SmartDevice* findDevice(const string& name);
+    void listDevices() const;
+    void sortByName();
+    void sortByType();
+    void removeDevice(const string& deviceName);
+    void addDevice();
+    void handleOneClickAction(const string& name);
+    void interactWithDevice(const string& name);
+    string executeCommand(const string& line);
+    void applyBatch(BatchUpdate& batch);
+    void applyBatchFile(const string& fileName);
+    void applyReadings(ReadingBatch& batch);
+    bool startIngest(const string& source, string& result);
+    vector<string> describeIngests() const;
+    bool defineScene(const string& name, BatchUpdate& batch);
+    bool deleteScene(const string& name);
+    int activateScene(const string& name);
+    int applyToScene(const string& name, DeviceAttribute attribute, double value);
+    vector<string> listScenes() const;
+    bool queryDevices(const string& expression, RoaringBitmap& matches, string& error);
+    vector<SmartDevice*> devicesIn(const RoaringBitmap& matches) const;
+    void editRoomAndTags(const string& name);
+    bool listMatching(const DeviceQuery& query, const function<void(const SmartDevice*)>& emit, string& error);
+    void showMatchingDevices(const string& expression);
+    void simulateHeating(const string& arguments);
+    bool advanceClock(const string& durationText, string& result);
+    bool exportHistory(const string& fileName, const string& expression, time_t from, time_t to, string& result);
+    void exportFromConsole(const string& fileName);
+    void manageScenes();
+    int takeSnapshot(const string& name);
+    int rollback(const string& name);
+    bool dropSnapshot(const string& name);
+    bool saveSnapshot(const string& name, const string& directory, string& result);
+    vector<string> listSnapshots() const;
+    void manageSnapshots();
+    size_t enforceMemoryCaps();
+    bool describeMemory(const string& name, string& report) const;
+    bool setMemoryCap(const string& target, const string& sizeText, string& result);
+    void run();
+};
+
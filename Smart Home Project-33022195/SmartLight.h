@@ -1,19 +1,24 @@
-#pragma once
-#include "SmartDevice.h"
-
-class SmartLight : public SmartDevice {
-private:
-    int* brightness;
-
-public:
-    SmartLight(const string& name);
-    ~SmartLight();
-
-    string getQuickView() const override;
-    void oneClickAction() override;
-    void showMenu() const override;
-    void handleMenuChoice(int choice) override;
-    string getDeviceType() const override;
-    string serialize() const override;
-    void deserialize(const string& data) override;
-};
+#pragma once
+#include "SmartDevice.h"
+
+class SmartLight : public SmartDevice {
+private:
+    int* brightness;
+
+public:
+    static constexpr const char* TAG = "LIGHT";  // Serialized type tag
+
+    SmartLight(const string& name);
+    ~SmartLight();
+
+    string getQuickView() const override;
+    void oneClickAction() override;
+    bool applySetting(DeviceAttribute attribute, double value) override;
+    bool getSetting(DeviceAttribute attribute, double& value) const override;
+    void showMenu() const override;
+    void handleMenuChoice(int choice) override;
+    string getDeviceType() const override;
+    const char* getTypeTag() const override;
+    string serialize() const override;
+    void deserialize(const string& data) override;
+};
@@ -0,0 +1,356 @@
+#include "StateMirror.h"
+#include "SmartDevice.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <cerrno>
+#include <chrono>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static_assert(sizeof(StateMirror::Header) == 64, "the header layout is shared with other processes");
+static_assert(sizeof(StateMirror::Record) == 128, "the record layout is shared with other processes");
+static_assert(atomic<uint32_t>::is_always_lock_free && atomic<uint64_t>::is_always_lock_free,
+    "counters in shared memory must be lock-free");
+
+// Helper function: Copies text into a fixed-size field, truncating it and ending it with a 0.
+static void copyText(char* field, size_t size, const string& text) {
+    size_t length = min(text.size(), size - 1);
+    memcpy(field, text.data(), length);
+    memset(field + length, 0, size - length);
+}
+
+// Constructor: Creates a closed mirror; call open() to publish.
+#ifdef _WIN32
+StateMirror::StateMirror()
+    : header(nullptr), records(nullptr), mappedBytes(0), changesPending(false), stopping(false),
+      mappingHandle(nullptr), committedBytes(0) {}
+#else
+StateMirror::StateMirror()
+    : header(nullptr), records(nullptr), mappedBytes(0), changesPending(false), stopping(false) {}
+#endif
+
+// Destructor: Closes the mirror, so readers see it is no longer live.
+StateMirror::~StateMirror() {
+    close();
+}
+
+// Returns the name the system knows the segment by: "/name" for shm_open(), "Local\name" on Windows.
+string StateMirror::systemName(const string& name) {
+    string bare = name;
+    bare.erase(0, bare.find_first_not_of("/\\"));
+#ifdef _WIN32
+    return "Local\\" + bare;
+#else
+    return "/" + bare;
+#endif
+}
+
+// Creates the shared memory segment and maps it, sized for slotCount devices with room to grow
+// (at least MIN_CAPACITY records). Memory is only used for records actually written.
+// An existing segment of that name, such as one left behind by a crash, is replaced.
+// Returns false with a reason in error if the segment cannot be created.
+bool StateMirror::open(const string& name, size_t slotCount, string& error) {
+    close();
+    size_t capacity = max<size_t>(MIN_CAPACITY, slotCount * 4);
+    if (capacity > numeric_limits<uint32_t>::max() / sizeof(Record)) {
+        error = "too many devices for a state mirror";
+        return false;
+    }
+    string systemPath = systemName(name);
+    size_t bytes = sizeof(Header) + capacity * sizeof(Record);
+#ifdef _WIN32
+    // A reserved section only takes memory for the pages committed as records are written
+    mappingHandle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE | SEC_RESERVE,
+        static_cast<DWORD>(static_cast<uint64_t>(bytes) >> 32), static_cast<DWORD>(bytes), systemPath.c_str());
+    if (!mappingHandle) {
+        error = "cannot create shared memory " + systemPath;
+        return false;
+    }
+    void* view = MapViewOfFile(mappingHandle, FILE_MAP_WRITE, 0, 0, bytes);
+    if (!view || !VirtualAlloc(view, sizeof(Header), MEM_COMMIT, PAGE_READWRITE)) {
+        if (view) UnmapViewOfFile(view);
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+        error = "cannot map shared memory " + systemPath;
+        return false;
+    }
+    committedBytes = sizeof(Header);
+#else
+    shm_unlink(systemPath.c_str());
+    int fd = shm_open(systemPath.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        error = "cannot create shared memory " + systemPath + ": " + strerror(errno);
+        return false;
+    }
+    // The segment is sparse: ftruncate() allocates nothing until a page is written
+    void* view = ftruncate(fd, static_cast<off_t>(bytes)) == 0
+        ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);  // The mapping keeps the segment
+    if (view == MAP_FAILED) {
+        shm_unlink(systemPath.c_str());
+        error = "cannot map shared memory " + systemPath + ": " + strerror(errno);
+        return false;
+    }
+#endif
+    segmentName = systemPath;
+    mappedBytes = bytes;
+    header = static_cast<Header*>(view);
+    records = reinterpret_cast<Record*>(static_cast<char*>(view) + sizeof(Header));
+
+    header->version = VERSION;
+    header->recordSize = sizeof(Record);
+    header->capacity = static_cast<uint32_t>(capacity);
+    header->count.store(0, memory_order_relaxed);
+    header->generation.store(0, memory_order_relaxed);
+    header->live.store(1, memory_order_relaxed);
+    header->heartbeat.store(0, memory_order_relaxed);
+    beat();
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, MAGIC, sizeof(header->magic));  // Last, so readers never see a half-made header
+    return true;
+}
+
+// Starts the publishing thread. It calls publishChanges, which must copy the changed devices in
+// with publish(), whenever notifyChanged() was called since its last call, and beats the heartbeat
+// every HEARTBEAT_MILLISECONDS of real time.
+void StateMirror::startPublishing(function<void()> publishChanges) {
+    if (!header || publisher.joinable()) return;
+    this->publishChanges = move(publishChanges);
+    stopping = false;
+    publisher = thread(&StateMirror::publishLoop, this);
+}
+
+// Wakes the publishing thread. Only the first call after a publishing pass takes the lock, so a
+// burst of changes costs one wake-up.
+void StateMirror::notifyChanged() {
+    if (changesPending.exchange(true)) return;
+    lock_guard<mutex> lock(wakeMutex);
+    wake.notify_one();
+}
+
+// Publishing thread: waits for changes or the next heartbeat, whichever comes first.
+void StateMirror::publishLoop() {
+    unique_lock<mutex> lock(wakeMutex);
+    while (true) {
+        wake.wait_for(lock, chrono::milliseconds(HEARTBEAT_MILLISECONDS),
+            [this] { return stopping || changesPending.load(); });
+        if (stopping) return;
+        lock.unlock();
+        beat();
+        if (changesPending.exchange(false)) {
+            publishChanges();  // A change noted meanwhile sets the flag again and is published next
+        }
+        lock.lock();
+    }
+}
+
+// Stops the publishing thread, marks the mirror no longer live, unmaps it and removes its name.
+// Readers that have it mapped keep the last state; new readers cannot open it.
+// Must be called while whatever publishChanges uses still exists.
+void StateMirror::close() {
+    if (publisher.joinable()) {
+        {
+            lock_guard<mutex> lock(wakeMutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        publisher.join();
+    }
+    if (!header) return;
+    header->live.store(0, memory_order_release);
+#ifdef _WIN32
+    UnmapViewOfFile(header);
+    CloseHandle(mappingHandle);
+    mappingHandle = nullptr;
+    committedBytes = 0;
+#else
+    munmap(header, mappedBytes);
+    shm_unlink(segmentName.c_str());
+#endif
+    header = nullptr;
+    records = nullptr;
+    mappedBytes = 0;
+    segmentName.clear();
+}
+
+// Writes a device's current state into its slot's record. Devices that were lazily loaded and
+// never used publish only their power state, without loading them.
+// Called with the home's lock held; slots past the capacity are not mirrored.
+void StateMirror::publish(int slot, const SmartDevice& device) {
+    if (!records || slot < 0 || static_cast<uint32_t>(slot) >= header->capacity) return;
+    const double none = numeric_limits<double>::quiet_NaN();
+    State state;
+    state.flags = PRESENT;
+    if (device.getIsOn()) state.flags |= ON;
+    copyText(state.type, sizeof(state.type), device.getTypeTag());
+    copyText(state.name, sizeof(state.name), device.getName());
+    state.energy = none;
+    fill(begin(state.settings), end(state.settings), none);
+    if (device.isHydrated()) {
+        state.flags |= LOADED;
+        state.energy = device.getEnergyUsage();
+        for (int i = 0; i < SETTINGS; ++i) {
+            device.getSetting(static_cast<DeviceAttribute>(i), state.settings[i]);
+        }
+    }
+    else {
+        state.settings[static_cast<int>(DeviceAttribute::Power)] = device.getIsOn() ? 1 : 0;
+    }
+    write(slot, state);
+}
+
+// Clears a removed device's record.
+void StateMirror::remove(int slot) {
+    if (!records || slot < 0 || static_cast<uint32_t>(slot) >= header->capacity) return;
+    State state = {};
+    write(slot, state);
+}
+
+// Records that the home is still running, for readers to tell a live mirror from one left
+// behind by a home that was killed.
+void StateMirror::beat() {
+    if (!header) return;
+    int64_t now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+    header->heartbeat.store(now, memory_order_release);
+}
+
+// Writes one record under its seqlock: the sequence goes odd, the state is stored, and the
+// sequence goes even again. There is only one writer, the thread holding the home's lock.
+void StateMirror::write(int slot, const State& state) {
+#ifdef _WIN32
+    size_t end = sizeof(Header) + (static_cast<size_t>(slot) + 1) * sizeof(Record);
+    if (end > committedBytes) {
+        size_t commit = min(mappedBytes, max(end, committedBytes * 2));
+        if (!VirtualAlloc(header, commit, MEM_COMMIT, PAGE_READWRITE)) return;
+        committedBytes = commit;
+    }
+#endif
+    Record& record = records[slot];
+    uint32_t sequence = record.sequence.load(memory_order_relaxed);
+    record.sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);  // The odd sequence is visible before any new field
+    record.state = state;
+    record.sequence.store(sequence + 2, memory_order_release);
+
+    uint32_t count = header->count.load(memory_order_relaxed);
+    if (static_cast<uint32_t>(slot) >= count) {
+        header->count.store(static_cast<uint32_t>(slot) + 1, memory_order_release);
+    }
+    header->generation.fetch_add(1, memory_order_release);
+}
+
+// Copies a record's state as of one moment, retrying while the home is writing it. A write takes
+// well under a microsecond, so a record still being written after READ_ATTEMPTS tries was left
+// half-written by a home that died, and is reported as Unreadable rather than waited for.
+// Used by readers in other processes.
+StateMirror::ReadResult StateMirror::read(const Record& record, State& state) {
+    for (int attempt = 0; attempt < READ_ATTEMPTS; ++attempt) {
+        uint32_t before = record.sequence.load(memory_order_acquire);
+        if (before & 1) {
+            this_thread::yield();  // A write is in progress
+            continue;
+        }
+        memcpy(&state, &record.state, sizeof(State));
+        atomic_thread_fence(memory_order_acquire);  // The copy completes before the sequence is read again
+        if (record.sequence.load(memory_order_relaxed) == before) {
+            return (state.flags & PRESENT) ? ReadResult::Device : ReadResult::Empty;
+        }
+    }
+    return ReadResult::Unreadable;
+}
+
+// Helper function: Formats a mirrored value, "-" if it is not known.
+static string formatValue(double value) {
+    if (std::isnan(value)) return "-";
+    stringstream ss;
+    ss << fixed << setprecision(2) << value;
+    return ss.str();
+}
+
+// Opens a running home's state mirror read-only and prints one line per device:
+// "slot|type|name|on/off|energy|power,brightness,volume,playing,target", "-" where unknown.
+// A record that stays half-written (see read()) is printed as "slot|unreadable" and counted at the end.
+// This is what a dashboard does; it shows the layout in use. Returns false with a reason in error
+// if the mirror cannot be opened.
+bool StateMirror::dump(const string& name, ostream& out, string& error) {
+    string systemPath = systemName(name);
+    const char* view;
+    size_t bytes;
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, systemPath.c_str());
+    if (!mapping) {
+        error = "no state mirror named " + systemPath;
+        return false;
+    }
+    view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    bytes = view ? sizeof(Header) : 0;  // Records are read only up to the count, which is committed
+#else
+    int fd = shm_open(systemPath.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+        error = "no state mirror named " + systemPath;
+        return false;
+    }
+    struct stat status;
+    bytes = fstat(fd, &status) == 0 ? static_cast<size_t>(status.st_size) : 0;
+    void* mapped = bytes >= sizeof(Header) ? mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    view = mapped == MAP_FAILED ? nullptr : static_cast<const char*>(mapped);
+#endif
+    const Header* mirrorHeader = reinterpret_cast<const Header*>(view);
+    bool valid = view && bytes >= sizeof(Header) && memcmp(mirrorHeader->magic, MAGIC, sizeof(mirrorHeader->magic)) == 0
+        && mirrorHeader->version == VERSION && mirrorHeader->recordSize == sizeof(Record);
+    if (valid) {
+        const Record* mirrorRecords = reinterpret_cast<const Record*>(view + sizeof(Header));
+        uint32_t count = min(mirrorHeader->count.load(memory_order_acquire), mirrorHeader->capacity);
+        int64_t now = chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+        out << "Generation " << mirrorHeader->generation.load(memory_order_acquire) << ", last published "
+            << now - mirrorHeader->heartbeat.load(memory_order_acquire) << " s ago"
+            << (mirrorHeader->live.load(memory_order_acquire) ? "" : " (the home has exited)") << "\n";
+        State state;
+        uint32_t unreadable = 0;
+        for (uint32_t slot = 0; slot < count; ++slot) {
+            ReadResult result = read(mirrorRecords[slot], state);
+            if (result == ReadResult::Unreadable) {
+                out << slot << "|unreadable\n";
+                ++unreadable;
+                continue;
+            }
+            if (result == ReadResult::Empty) continue;
+            out << slot << "|" << state.type << "|" << state.name << "|" << ((state.flags & ON) ? "on" : "off")
+                << "|" << formatValue(state.energy) << "|";
+            for (int i = 0; i < SETTINGS; ++i) {
+                out << (i ? "," : "") << formatValue(state.settings[i]);
+            }
+            out << "\n";
+        }
+        if (unreadable > 0) {
+            out << unreadable << " records were left half-written; the home may have died while updating them.\n";
+        }
+    }
+    else {
+        error = "not a state mirror: " + systemPath;
+    }
+#ifdef _WIN32
+    if (view) UnmapViewOfFile(view);
+    CloseHandle(mapping);
+#else
+    if (view) munmap(const_cast<char*>(view), bytes);
+#endif
+    return valid;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <string>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <iosfwd>
+#include <cstddef>
+#include <cstdint>
+
+using namespace std;
+
+class SmartDevice;
+
+// Publishes the live state of every device (power, settings, energy total) in a named shared
+// memory segment with a fixed layout, so dashboards on the same host can read it without asking
+// the program. Each record is guarded by its own sequence counter (a seqlock): the home writes
+// with plain stores, and a reader copies the record and retries if the counter changed meanwhile,
+// so neither side takes a lock or makes a system call. Record n belongs to device slot n.
+// Changes are published by a thread of the mirror's own, woken when a device changes; the same
+// thread keeps a wall-clock heartbeat in the header, whatever clock the home runs on.
+class StateMirror {
+public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t MIN_CAPACITY = 1 << 20;   // Records; untouched pages take no memory
+    static const int SETTINGS = 5;                  // One value per DeviceAttribute
+    static const int HEARTBEAT_MILLISECONDS = 1000; // Real time between heartbeats
+    static const int READ_ATTEMPTS = 10000;         // Before a record being written counts as unreadable
+    static constexpr const char* MAGIC = "SHMIRROR";
+
+    enum Flags : uint32_t {
+        PRESENT = 1,        // The slot holds a device
+        LOADED = 2,         // Settings and energy are known (lazily loaded devices only have power)
+        ON = 4
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t recordSize;                        // sizeof(Record)
+        uint32_t capacity;                          // Records the segment has room for
+        atomic<uint32_t> count;                     // Records in use: the highest slot published + 1
+        atomic<uint32_t> live;                      // 1 while the home publishes, 0 once it exits
+        uint32_t reserved;
+        atomic<uint64_t> generation;                // Bumped after every record written
+        atomic<int64_t> heartbeat;                  // Wall-clock seconds of the last heartbeat
+        uint8_t padding[16];
+    };
+
+    struct State {
+        uint32_t flags;
+        char type[16];                              // Stored type tag, such as "LIGHT"
+        char name[48];                              // Truncated to 47 bytes
+        double energy;                              // Total energy in kWh; NaN if not loaded
+        double settings[SETTINGS];                  // By DeviceAttribute; NaN if the device has none
+    };
+
+    enum class ReadResult {
+        Empty,              // The slot holds no device
+        Device,
+        Unreadable          // Still being written after READ_ATTEMPTS, e.g. the home died mid-write
+    };
+
+    struct Record {
+        atomic<uint32_t> sequence;                  // Odd while the record is being written
+        uint32_t reserved;
+        State state;                                // Copy it out only through read()
+    };
+
+    StateMirror();
+    ~StateMirror();                                 // Marks the segment no longer live and removes its name
+    StateMirror(const StateMirror&) = delete;
+    StateMirror& operator=(const StateMirror&) = delete;
+
+    bool open(const string& name, size_t slotCount, string& error);
+    bool isOpen() const { return records != nullptr; }
+    void publish(int slot, const SmartDevice& device);
+    void remove(int slot);
+    void startPublishing(function<void()> publishChanges);  // Runs publishChanges after notifyChanged()
+    void notifyChanged();                           // Cheap; may be called with other locks held
+    void close();
+
+    static ReadResult read(const Record& record, State& state);
+    static bool dump(const string& name, ostream& out, string& error);
+
+private:
+    string segmentName;                             // As passed to the system (see systemName())
+    Header* header;
+    Record* records;
+    size_t mappedBytes;
+    function<void()> publishChanges;
+    atomic<bool> changesPending;                    // Set by notifyChanged(), cleared by the publisher
+    mutex wakeMutex;
+    condition_variable wake;
+    bool stopping;
+    thread publisher;
+#ifdef _WIN32
+    void* mappingHandle;
+    size_t committedBytes;                          // Pages are committed as records are first written
+#endif
+
+    void write(int slot, const State& state);
+    void beat();                                    // Readers treat a stale heartbeat as a dead home
+    void publishLoop();
+    static string systemName(const string& name);
+};
@@ -0,0 +1,216 @@
+#include "StoreReader.h"
+#include "MappedFile.h"
+#include "DeviceRegistry.h"
+#include "Trace.h"
+#include <sstream>
+#include <cstring>
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+// Returns the key that starts the schedule and attribute lines of the device at a position in its
+// store file, such as "|12". Lines refer to their device by position rather than by name, so they
+// are matched with an integer compare; no device name is empty, so a key never looks like a name.
+string StoreReader::ownerKey(size_t position) {
+    return "|" + to_string(position);
+}
+
+// Helper function: Parses a "|position|" key at pos. On success sets position and rest, the start
+// of the line after the key.
+static bool parseOwnerKey(const char* pos, const char* end, uint32_t& position, const char*& rest) {
+    if (pos == end || *pos != '|') return false;
+    ++pos;
+    const char* digits = pos;
+    uint64_t value = 0;
+    while (pos < end && *pos >= '0' && *pos <= '9' && pos - digits < 10) {
+        value = value * 10 + static_cast<uint64_t>(*pos - '0');
+        ++pos;
+    }
+    if (pos == digits || pos == end || *pos != '|' || value > UINT32_MAX) return false;
+    position = static_cast<uint32_t>(value);
+    rest = pos + 1;
+    return true;
+}
+
+// Parses the lines in [begin, end) into devices, schedule lines and attribute lines.
+// Lines starting with a device type tag are device records, lines starting with '@' hold a device's
+// room and tags ("@key|room|tags", see HomeImage::writeSegment()), and the others are
+// schedule entries ("key|..." lines written by saveScheduleToFile()). The key is the device's
+// position in the file (see ownerKey()); files written by older versions use its name instead.
+// In lazy mode only the type and name of each record are parsed; the rest is kept on the device
+// and restored when it is first used (see SmartDevice::hydrate).
+void StoreReader::parseChunk(const char* begin, const char* end, bool lazy, Chunk& chunk) {
+    TraceTally tally(lazy ? "defer" : "deserialize");
+    const char* pos = begin;
+    while (pos < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        if (!lineEnd) lineEnd = end;
+        const char* next = lineEnd + 1;
+        if (lineEnd > pos && lineEnd[-1] == '\r') --lineEnd;
+
+        uint32_t position;
+        const char* rest;
+        bool attribute = *pos == '@';
+        if (parseOwnerKey(pos + (attribute ? 1 : 0), lineEnd, position, rest)) {
+            auto& lines = attribute ? chunk.keyedAttributes : chunk.keyedSchedules;
+            lines.emplace_back(position, string(rest, lineEnd));
+            pos = next;
+            continue;
+        }
+
+        const char* bar = static_cast<const char*>(memchr(pos, '|', lineEnd - pos));
+        if (attribute && bar) {
+            chunk.attributeLines.emplace_back(string(pos + 1, bar), string(bar + 1, lineEnd));
+            pos = next;
+            continue;
+        }
+
+        string_view type(pos, (bar ? bar : lineEnd) - pos);
+        unique_ptr<SmartDevice> device = DeviceRegistry::create(type);  // Type dispatch by tag
+        if (device) {
+            int64_t started = tally.start();
+            string line(pos, lineEnd);
+            if (lazy) {
+                device->deferRecord(line);  // Keep the record until the device is used
+            }
+            else {
+                device->deserialize(line);  // Restore device state from serialized data
+            }
+            tally.stop(device->getTypeTag(), started);
+            chunk.devices.push_back(move(device));
+        }
+        else if (bar) {
+            chunk.scheduleLines.emplace_back(string(type), string(bar + 1, lineEnd));
+        }
+        pos = next;
+    }
+}
+
+// Joins parsed chunks in their original order and hands each device its schedule lines,
+// room and tags. Keyed lines go straight to the device at their position; lines from older files
+// are grouped by device name first. Either way each device only reads its own lines, even when
+// they were parsed in a different chunk than the device record.
+// Room and tags are restored even in lazy mode, since the home indexes them at startup.
+vector<unique_ptr<SmartDevice>> StoreReader::merge(vector<Chunk>& chunks, bool lazy) {
+    TraceScope scope("merge");
+    size_t total = 0;
+    bool keyedSchedules = false;
+    for (const auto& chunk : chunks) {
+        total += chunk.devices.size();
+        keyedSchedules = keyedSchedules || !chunk.keyedSchedules.empty();
+    }
+
+    vector<unique_ptr<SmartDevice>> parsed;
+    parsed.reserve(total);
+    vector<string> scheduleText(keyedSchedules ? total : 0);  // Device position -> its schedule lines
+    unordered_map<string, string> scheduleLines;  // Device name -> its schedule lines (older files)
+    unordered_map<string, string> attributeLines; // Device name -> its room and tags (older files)
+    for (auto& chunk : chunks) {
+        for (auto& device : chunk.devices) {
+            parsed.push_back(move(device));
+        }
+        for (auto& entry : chunk.keyedSchedules) {
+            if (entry.first < total) {
+                scheduleText[entry.first] += entry.second + "\n";
+            }
+        }
+        for (auto& entry : chunk.scheduleLines) {
+            scheduleLines[entry.first] += entry.second + "\n";
+        }
+        for (auto& entry : chunk.attributeLines) {
+            attributeLines[entry.first] = move(entry.second);
+        }
+    }
+
+    for (auto& chunk : chunks) {
+        for (auto& entry : chunk.keyedAttributes) {
+            if (entry.first < total) {
+                parsed[entry.first]->loadAttributes(entry.second);
+            }
+        }
+    }
+    if (!attributeLines.empty()) {
+        for (auto& device : parsed) {
+            auto it = attributeLines.find(device->getName());
+            if (it != attributeLines.end()) {
+                device->loadAttributes(it->second);
+            }
+        }
+    }
+
+    if (scheduleText.empty() && scheduleLines.empty()) return parsed;
+    TraceTally tally(lazy ? "defer schedules" : "load schedules");
+    for (size_t i = 0; i < parsed.size(); ++i) {
+        SmartDevice& device = *parsed[i];
+        const string* lines = nullptr;
+        if (!scheduleText.empty() && !scheduleText[i].empty()) {
+            lines = &scheduleText[i];
+        }
+        else if (!scheduleLines.empty()) {
+            auto it = scheduleLines.find(device.getName());
+            if (it != scheduleLines.end()) lines = &it->second;
+        }
+        if (!lines) continue;
+        int64_t started = tally.start();
+        if (lazy) {
+            device.deferSchedules(*lines);
+        }
+        else {
+            stringstream schedules(*lines);
+            device.loadScheduleFromFile(schedules);
+        }
+        tally.stop(device.getTypeTag(), started);
+    }
+    return parsed;
+}
+
+// Parses a block of stored lines into devices.
+// Large blocks are split at newline boundaries into chunks that are parsed in parallel and
+// merged back in their original order, so the result is the same as a single-threaded parse.
+vector<unique_ptr<SmartDevice>> StoreReader::parse(const char* data, size_t size, bool lazy, WorkStealingPool& pool) {
+    size_t threads = pool.getThreadCount();
+    size_t chunkSize = max(MIN_CHUNK_SIZE, size / (threads * 4) + 1);
+
+    // Chunk boundaries always fall just after a newline, so no line is split between chunks.
+    vector<pair<const char*, const char*>> ranges;
+    const char* pos = data;
+    const char* end = data + size;
+    while (pos < end) {
+        const char* split = pos + min(chunkSize, static_cast<size_t>(end - pos));
+        if (split < end) {
+            const char* newline = static_cast<const char*>(memchr(split, '\n', end - split));
+            split = newline ? newline + 1 : end;
+        }
+        ranges.emplace_back(pos, split);
+        pos = split;
+    }
+
+    vector<Chunk> chunks(ranges.size());
+    pool.parallelFor(ranges.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            TraceScope scope("parse chunk");
+            parseChunk(ranges[i].first, ranges[i].second, lazy, chunks[i]);
+        }
+    });
+    return merge(chunks, lazy);
+}
+
+// Loads several store files in parallel, a few files per job.
+// Each file is parsed on its own, so schedule lines only match devices stored in the same file.
+vector<StoreReader::LoadedFile> StoreReader::parseFiles(const vector<string>& fileNames, bool lazy, WorkStealingPool& pool) {
+    vector<LoadedFile> files(fileNames.size());
+    pool.parallelFor(fileNames.size(), 4, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            TraceScope scope("load segment", fileNames[i].c_str());
+            MappedFile file;
+            files[i].found = file.open(fileNames[i]);
+            if (!files[i].found) continue;
+
+            vector<Chunk> chunks(1);
+            parseChunk(file.data(), file.data() + file.size(), lazy, chunks[0]);
+            files[i].devices = merge(chunks, lazy);
+        }
+    });
+    return files;
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include "SmartDevice.h"
+#include "WorkStealingPool.h"
+#include <vector>
+#include <memory>
+#include <utility>
+#include <string>
+#include <cstdint>
+
+using namespace std;
+
+class StoreReader {
+public:
+    struct LoadedFile {
+        bool found;                              // False if the file could not be opened
+        vector<unique_ptr<SmartDevice>> devices; // Devices in file order
+    };
+
+    static vector<unique_ptr<SmartDevice>> parse(const char* data, size_t size, bool lazy, WorkStealingPool& pool);
+    static vector<LoadedFile> parseFiles(const vector<string>& fileNames, bool lazy, WorkStealingPool& pool);
+    static string ownerKey(size_t position);     // Starts the schedule and attribute lines of a file's device
+
+private:
+    struct Chunk {
+        vector<unique_ptr<SmartDevice>> devices;
+        vector<pair<uint32_t, string>> keyedSchedules;   // Device position in the file, schedule line
+        vector<pair<uint32_t, string>> keyedAttributes;  // Device position in the file, "room|tags"
+        vector<pair<string, string>> scheduleLines;      // Device name, schedule line (older files)
+        vector<pair<string, string>> attributeLines;     // Device name, "room|tags" (older files)
+    };
+
+    static const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+    static void parseChunk(const char* begin, const char* end, bool lazy, Chunk& chunk);
+    static vector<unique_ptr<SmartDevice>> merge(vector<Chunk>& chunks, bool lazy);
+};
@@ -0,0 +1,79 @@
+#include "SymbolTable.h"
+#include <algorithm>
+#include <mutex>
+
+using namespace std;
+
+// Helper function: Returns the lowercase form of an ASCII letter; other characters are kept,
+// as ::tolower() does in the "C" locale.
+static inline char foldChar(char c) {
+    return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// FNV-1a hash of the lowercase form of a text.
+size_t SymbolTable::FoldHash::operator()(string_view text) const {
+    uint32_t hash = 2166136261u;
+    for (char c : text) {
+        hash ^= static_cast<unsigned char>(foldChar(c));
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Compares two texts ignoring case.
+bool SymbolTable::FoldEqual::operator()(string_view a, string_view b) const {
+    return a.size() == b.size() &&
+        equal(a.begin(), a.end(), b.begin(), [](char x, char y) { return foldChar(x) == foldChar(y); });
+}
+
+// Returns the program's symbol table.
+SymbolTable& SymbolTable::instance() {
+    static SymbolTable table;
+    return table;
+}
+
+// Returns the symbol for a name, ignoring case, adding its lowercase form the first time.
+// Known names, the common case, only take a shared lock.
+uint32_t SymbolTable::intern(string_view name) {
+    {
+        shared_lock<shared_mutex> lock(tableMutex);
+        auto it = symbols.find(name);
+        if (it != symbols.end()) return it->second;
+    }
+
+    unique_lock<shared_mutex> lock(tableMutex);
+    auto it = symbols.find(name);
+    if (it != symbols.end()) return it->second;
+    uint32_t symbol = static_cast<uint32_t>(texts.size());
+    texts.emplace_back(name);
+    string& lower = texts.back();
+    transform(lower.begin(), lower.end(), lower.begin(), foldChar);
+    symbols.emplace(string_view(lower), symbol);
+    return symbol;
+}
+
+// Returns the symbol for a name, ignoring case, without adding it. Returns NONE if the name was
+// never interned, in which case no device or scene has it.
+uint32_t SymbolTable::find(string_view name) const {
+    shared_lock<shared_mutex> lock(tableMutex);
+    auto it = symbols.find(name);
+    return it == symbols.end() ? NONE : it->second;
+}
+
+// Returns the lowercase text of a symbol.
+const string& SymbolTable::text(uint32_t symbol) const {
+    shared_lock<shared_mutex> lock(tableMutex);
+    return texts[symbol];
+}
+
+// Makes room for count more symbols, so interning them does not rehash along the way.
+void SymbolTable::reserve(size_t count) {
+    unique_lock<shared_mutex> lock(tableMutex);
+    symbols.reserve(symbols.size() + count);
+}
+
+// Returns the number of symbols.
+size_t SymbolTable::size() const {
+    shared_lock<shared_mutex> lock(tableMutex);
+    return texts.size();
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <shared_mutex>
+#include <cstdint>
+#include <cstddef>
+
+using namespace std;
+
+// Program-wide table of interned names (device and scene names), ignoring case. Each distinct
+// name gets a 32-bit symbol once, stored with its lowercase form, so case-insensitive comparisons
+// become integer compares. Symbols are never freed; a renamed device leaves its old name behind.
+class SymbolTable {
+public:
+    static const uint32_t NONE = UINT32_MAX;
+
+    SymbolTable() = default;
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    static SymbolTable& instance();
+
+    uint32_t intern(string_view name);                 // Symbol of the name in any case, added if new
+    uint32_t find(string_view name) const;             // Symbol of the name in any case, or NONE
+    const string& text(uint32_t symbol) const;         // Lowercase form; valid for the program's lifetime
+    void reserve(size_t count);                        // Before interning many names at once
+    size_t size() const;
+
+private:
+    // Hashes and compares ignoring case, so any spelling finds its entry without a lowercase copy.
+    struct FoldHash {
+        size_t operator()(string_view text) const;
+    };
+    struct FoldEqual {
+        bool operator()(string_view a, string_view b) const;
+    };
+
+    mutable shared_mutex tableMutex;
+    deque<string> texts;                               // Symbol -> lowercase text; a deque so views stay valid
+    unordered_map<string_view, uint32_t, FoldHash, FoldEqual> symbols;  // Lowercase text -> symbol
+};
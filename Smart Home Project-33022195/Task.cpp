@@ -0,0 +1,88 @@
+#include "Task.h"
+#include "ConsoleWriter.h"
+#include <exception>
+#include <utility>
+#include <new>
+
+using namespace std;
+
+// Placed in front of every frame, so the frame's size and account are known when it is freed
+struct FrameHeader {
+    MemoryAccount* account;
+    size_t size;
+};
+
+static_assert(sizeof(FrameHeader) % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0, "frames must stay aligned");
+
+// Helper function: Returns the header in front of a frame.
+static FrameHeader* headerOf(void* frame) {
+    return reinterpret_cast<FrameHeader*>(static_cast<char*>(frame) - sizeof(FrameHeader));
+}
+
+// Allocates a coroutine frame and charges it to the account (if any) and the totals.
+void* Task::promise_type::allocateFrame(size_t size, MemoryAccount* account) {
+    char* block = static_cast<char*>(::operator new(sizeof(FrameHeader) + size));
+    new (block) FrameHeader{ account, size };
+    MemoryAccount::charge(account, MemorySubsystem::Behaviors, static_cast<int64_t>(size));
+    return block + sizeof(FrameHeader);
+}
+
+// Frees a coroutine frame and releases it from the totals; the device's share was settled
+// when the promise was destroyed or the task cancelled.
+void Task::promise_type::operator delete(void* frame, size_t size) {
+    MemoryAccount::charge(nullptr, MemorySubsystem::Behaviors, -static_cast<int64_t>(size));
+    ::operator delete(headerOf(frame));
+}
+
+// Destructor: A task that ran to the end did so while its device existed, so it takes its frame
+// off the device's account. A task destroyed while suspended was cancelled (the device has
+// already let go of it, and may be gone) or is being torn down with the runtime.
+Task::promise_type::~promise_type() {
+    FrameHeader* header = headerOf(Handle::from_promise(*this).address());
+    if (finished && header->account) {
+        header->account->detach(MemorySubsystem::Behaviors, header->size);
+    }
+}
+
+// Creates the task object handed to the caller of a coroutine.
+Task Task::promise_type::get_return_object() {
+    return Task(Handle::from_promise(*this));
+}
+
+// Called when a behavior throws. The behavior ends; the rest of the runtime carries on.
+// Runs on the runtime's thread, so the message goes through the console writer.
+void Task::promise_type::unhandled_exception() {
+    finished = true;
+    try {
+        throw;
+    }
+    catch (const exception& error) {
+        ConsoleWriter::print(string("A device behavior stopped after an error: ") + error.what() + "\n");
+    }
+    catch (...) {
+        ConsoleWriter::print("A device behavior stopped after an error.\n");
+    }
+}
+
+// Constructor: Takes ownership of a suspended coroutine.
+Task::Task(Handle handle) : handle(handle) {}
+
+// Move constructor: Takes over the other task's coroutine.
+Task::Task(Task&& other) noexcept : handle(exchange(other.handle, nullptr)) {}
+
+// Destructor: Destroys a coroutine that was never started.
+Task::~Task() {
+    if (handle) {
+        handle.destroy();
+    }
+}
+
+// Gives up ownership of the coroutine; the caller is responsible for running it.
+Task::Handle Task::release() {
+    return exchange(handle, nullptr);
+}
+
+// Returns the number of bytes allocated for the coroutine's frame, or 0 if there is none.
+size_t Task::frameSize() const {
+    return handle ? headerOf(handle.address())->size : 0;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <coroutine>
+#include <memory>
+#include <atomic>
+#include "MemoryAccount.h"
+
+using namespace std;
+
+// A device behavior written as a coroutine, run by BehaviorRuntime.
+// The task starts suspended and is started by BehaviorRuntime::spawn(). Its frame frees itself
+// when the coroutine returns, or is destroyed by the runtime if the task is cancelled.
+// Frames are charged to the Behaviors subsystem (see MemoryAccount): to the device whose member
+// function the behavior is, until it finishes or the device cancels it, and to the totals until freed.
+class Task {
+public:
+    struct promise_type {
+        shared_ptr<atomic<bool>> cancelled;  // Set to stop the task at its next wake-up (may be null)
+        bool finished = false;               // Ran to the end, rather than destroyed while suspended
+
+        ~promise_type();
+        Task get_return_object();
+        suspend_always initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() { finished = true; }
+        void unhandled_exception();
+
+        template <typename Owner, typename... Args>
+        static void* operator new(size_t size, Owner& owner, Args&...) {
+            if constexpr (requires { owner.getMemory(); }) {
+                return allocateFrame(size, &owner.getMemory());
+            }
+            else {
+                return allocateFrame(size, nullptr);
+            }
+        }
+        static void* operator new(size_t size) { return allocateFrame(size, nullptr); }
+        static void operator delete(void* frame, size_t size);
+        static void* allocateFrame(size_t size, MemoryAccount* account);
+    };
+
+    using Handle = coroutine_handle<promise_type>;
+
+    Task(Task&& other) noexcept;
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task();
+
+    Handle release();
+    size_t frameSize() const;        // Bytes allocated for the coroutine's frame
+
+private:
+    Handle handle;
+
+    explicit Task(Handle handle);
+};
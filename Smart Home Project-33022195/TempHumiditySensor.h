@@ -1,43 +1,53 @@
-#pragma once
-#include "SmartDevice.h"
-#include <vector>
-
-using namespace std;
-
-class TempHumiditySensor : public SmartDevice {
-private:
-    struct Reading {
-        float temperature;   // Temperature value
-        float humidity;      // Humidity value
-        time_t timestamp;    // Timestamp of the reading
-    };
-
-    struct EnergyReading {
-        float energyUsed;    // Energy used in kWh
-        time_t timestamp;    // Timestamp of the reading
-    };
-
-    vector<Reading>* historicData;        // Pointer to historic temperature/humidity data
-    vector<EnergyReading>* historicUsage; // Pointer to historic energy usage
-    float totalEnergy;                    // Total energy used in kWh
-    time_t lastUpdateTime;                // Last update time for energy calculations
-
-    void updateEnergyUsage();             // Updates total energy usage
-    void addEnergyReading();              // Adds energy reading to history
-
-public:
-    TempHumiditySensor(const string& name);
-    ~TempHumiditySensor();
-
-    void updateSensorReadings();          // Simulates sensor data
-    string getQuickView() const override;
-    void oneClickAction() override;
-    void showMenu() const override;
-    void handleMenuChoice(int choice) override;
-    string getDeviceType() const override;
-    string serialize() const override;
-    void deserialize(const string& data) override;
-
-    void viewHistoricData() const;        // View temperature/humidity readings
-    void viewEnergyUsage() const;         // View energy usage
-};
+#pragma once
+#include "SmartDevice.h"
+#include "HistoryLog.h"
+
+using namespace std;
+
+class TempHumiditySensor : public SmartDevice {
+private:
+    struct Reading {
+        float temperature;   // Temperature value
+        float humidity;      // Humidity value
+        time_t timestamp;    // Timestamp of the reading
+    };
+
+    HistoryLog* historicData;             // Pointer to historic temperature/humidity data
+    HistoryLog* historicUsage;            // Pointer to historic energy usage (kWh per reading)
+    float totalEnergy;                    // Total energy used in kWh
+    time_t lastUpdateTime;                // Last update time for energy calculations
+
+    void updateEnergyUsage();             // Updates total energy usage
+    void addEnergyReading();              // Adds energy reading to history
+    Reading recordReading();              // Takes a reading without console output
+    Task sampleReadings();                // Periodic sampling behavior
+
+public:
+    static constexpr const char* TAG = "TEMP_HUMIDITY";  // Serialized type tag
+    static const int SAMPLE_SECONDS = 300;                 // Interval between automatic readings
+
+    TempHumiditySensor(const string& name);
+    ~TempHumiditySensor();
+
+    void updateSensorReadings();          // Simulates sensor data
+    void startBehaviors() override;
+    string getQuickView() const override;
+    void oneClickAction() override;
+    void setPower(bool on) override;
+    double getEnergyUsage() const override;
+    void showMenu() const override;
+    void handleMenuChoice(int choice) override;
+    string getDeviceType() const override;
+    const char* getTypeTag() const override;
+    string serialize() const override;
+    void deserialize(const string& data) override;
+    void sealHistory() override;
+    void discardHistory() override;
+    bool writeHistory(time_t from, time_t to, ostream& out) const override;
+    vector<pair<string, const HistoryLog*>> getHistories() const override;
+    bool recordReadings(const HistoryLog::Sample* readings, size_t count) override;
+    void trimMemory() override;
+
+    void viewHistoricData() const;        // View temperature/humidity readings
+    void viewEnergyUsage() const;         // View energy usage
+};
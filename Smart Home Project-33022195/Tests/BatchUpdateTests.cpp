@@ -0,0 +1,93 @@
+#include "TestRunner.h"
+#include "../BatchUpdate.h"
+#include "../SmartHome.h"
+#include <sstream>
+
+using namespace std;
+
+TEST(BatchUpdate_rejectsMalformedHeaders) {
+    BatchUpdate batch;
+    CHECK(batch.begin("BATCH"));
+    CHECK(batch.begin("BATCH 12"));
+    CHECK(!batch.begin("BATCHES"));
+    CHECK(!batch.begin("batch 3"));
+    CHECK(!batch.begin("Lamp|on|1"));
+    CHECK(!batch.begin(""));
+
+    istringstream noHeader("Lamp|on|1\nEND\n");
+    CHECK(!batch.read(noHeader));
+}
+
+TEST(BatchUpdate_parsesOperations) {
+    BatchUpdate batch;
+    istringstream in("\nBATCH 3\r\nLamp|on|on\n# comment\n\nHall|Lamp|brightness|42.5\nRadio|playing|off\nEND\nafter|on|1\n");
+    CHECK(batch.read(in));
+    CHECK_EQUAL(size_t(3), batch.operations.size());
+    CHECK(batch.failures.empty());
+    if (batch.operations.size() != 3) return;
+    CHECK_EQUAL(string("Lamp"), batch.operations[0].device);
+    CHECK(batch.operations[0].attribute == DeviceAttribute::Power);
+    CHECK_EQUAL(1.0, batch.operations[0].value);
+    CHECK_EQUAL(2, batch.operations[0].line);
+    CHECK_EQUAL(string("Hall|Lamp"), batch.operations[1].device);   // Only the last two fields are split off
+    CHECK(batch.operations[1].attribute == DeviceAttribute::Brightness);
+    CHECK_EQUAL(42.5, batch.operations[1].value);
+    CHECK_EQUAL(5, batch.operations[1].line);
+    CHECK_EQUAL(0.0, batch.operations[2].value);
+
+    string rest;
+    getline(in, rest);
+    CHECK_EQUAL(string("after|on|1"), rest);   // Reading stops at END
+}
+
+TEST(BatchUpdate_recordsBadAttributesAndValues) {
+    BatchUpdate batch;
+    CHECK(batch.begin("BATCH"));
+    CHECK(batch.addLine("Lamp|colour|red"));
+    CHECK(batch.addLine("Lamp|brightness|bright"));
+    CHECK(batch.addLine("Lamp|brightness|40%"));
+    CHECK(batch.addLine("Lamp|brightness|"));
+    CHECK(batch.addLine("Lamp|on"));
+    CHECK(batch.addLine("|on|1"));
+    CHECK(batch.addLine("Lamp|brightness|40"));
+    CHECK(!batch.addLine("END"));
+
+    CHECK_EQUAL(size_t(1), batch.operations.size());
+    batch.applied = 1;
+    CHECK_EQUAL(string("Applied 1 of 7 updates.\n"
+                       "Line 2: unknown setting\n"
+                       "Line 3: invalid value\n"
+                       "Line 4: invalid value\n"
+                       "Line 5: invalid value\n"
+                       "Line 6: expected device|attribute|value\n"
+                       "Line 7: expected device|attribute|value\n"), batch.report());
+}
+
+TEST(BatchUpdate_partialBatchIsNotComplete) {
+    BatchUpdate batch;
+    istringstream cutOff("BATCH 3\nLamp|on|1\nLamp|brightness|20\n");
+    CHECK(!batch.read(cutOff));
+    CHECK_EQUAL(size_t(2), batch.operations.size());
+
+    istringstream headerOnly("BATCH\n");
+    CHECK(!batch.read(headerOnly));
+    CHECK(batch.operations.empty());
+}
+
+TEST(BatchUpdate_reportsUnknownDevicesWhenApplied) {
+    SmartHome home;
+    home.executeCommand("add|LIGHT|Lamp");
+    home.executeCommand("add|SPEAKER|Radio");
+    BatchUpdate batch;
+    istringstream in("BATCH\nlamp|brightness|30\nGarage|on|1\nRadio|target|21\nRADIO|volume|55\nEND\n");
+    CHECK(batch.read(in));
+    home.applyBatch(batch);
+
+    CHECK_EQUAL(2, batch.applied);
+    CHECK_EQUAL(string("Applied 2 of 4 updates.\n"
+                       "Line 3: device \"Garage\" not found\n"
+                       "Line 4: setting not supported by Radio\n"), batch.report());
+    double volume = 0;
+    CHECK(home.findDevice("Radio")->getSetting(DeviceAttribute::Volume, volume));
+    CHECK_EQUAL(55.0, volume);
+}
@@ -0,0 +1,101 @@
+#include "TestRunner.h"
+#include "../BehaviorRuntime.h"
+#include "../MemoryAccount.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+// Helper function: A behavior that wakes up once a second for a number of rounds, counting each wake-up.
+static Task sleeper(BehaviorRuntime& runtime, int rounds, size_t& wakeups) {
+    for (int round = 0; round < rounds; ++round) {
+        co_await runtime.sleepFor(chrono::seconds(1));
+        ++wakeups;
+    }
+}
+
+// Helper function: A behavior that records its id once it has slept for the given time.
+static Task recorder(BehaviorRuntime& runtime, int seconds, int id, vector<int>& order) {
+    co_await runtime.sleepFor(chrono::seconds(seconds));
+    order.push_back(id);
+}
+
+// Many sleeping behaviors cost a small frame each and no thread; a second of virtual time
+// resumes every one of them once.
+TEST(BehaviorRuntime_manySleepingTasks) {
+    const size_t TASKS = 200000;
+    const int ROUNDS = 5;
+    BehaviorRuntime runtime;
+    runtime.start(nullptr);
+
+    size_t wakeups = 0;
+    size_t frameBytes = 0;
+    size_t behaviorBytes = MemoryAccount::globalTotal(MemorySubsystem::Behaviors);
+    for (size_t i = 0; i < TASKS; ++i) {
+        Task task = sleeper(runtime, ROUNDS, wakeups);
+        frameBytes = task.frameSize();
+        runtime.spawn(move(task), nullptr);
+    }
+    CHECK(frameBytes > 0 && frameBytes <= 256);
+    CHECK_EQUAL(behaviorBytes + TASKS * frameBytes, MemoryAccount::globalTotal(MemorySubsystem::Behaviors));
+
+    CHECK_EQUAL(TASKS, runtime.advance(chrono::seconds(0)));   // Each runs to its first sleep
+    CHECK_EQUAL(TASKS, runtime.getTaskCount());
+    for (int round = 1; round <= ROUNDS; ++round) {
+        CHECK_EQUAL(TASKS, runtime.advance(chrono::seconds(1)));
+        CHECK_EQUAL(TASKS * round, wakeups);
+    }
+    CHECK_EQUAL(size_t(0), runtime.getTaskCount());
+    CHECK_EQUAL(behaviorBytes, MemoryAccount::globalTotal(MemorySubsystem::Behaviors));
+    runtime.stop();
+}
+
+TEST(BehaviorRuntime_wakesInTimeThenQueueOrder) {
+    BehaviorRuntime runtime;
+    runtime.start(nullptr);
+    vector<int> order;
+    runtime.spawn(recorder(runtime, 3, 1, order), nullptr);
+    runtime.spawn(recorder(runtime, 1, 2, order), nullptr);
+    runtime.spawn(recorder(runtime, 3, 3, order), nullptr);
+    runtime.spawn(recorder(runtime, 2, 4, order), nullptr);
+
+    runtime.advance(chrono::seconds(0));
+    CHECK(order.empty());
+    runtime.advance(chrono::milliseconds(2500));
+    CHECK(order == vector<int>({ 2, 4 }));
+    runtime.advance(chrono::seconds(10));
+    CHECK(order == vector<int>({ 2, 4, 1, 3 }));
+    runtime.stop();
+}
+
+TEST(BehaviorRuntime_cancelledTasksAreDestroyed) {
+    BehaviorRuntime runtime;
+    runtime.start(nullptr);
+    size_t behaviorBytes = MemoryAccount::globalTotal(MemorySubsystem::Behaviors);
+    size_t kept = 0;
+    size_t cancelledWakeups = 0;
+    auto cancel = make_shared<atomic<bool>>(false);
+    for (int i = 0; i < 100; ++i) {
+        runtime.spawn(sleeper(runtime, 3, kept), nullptr);
+        runtime.spawn(sleeper(runtime, 3, cancelledWakeups), cancel);
+    }
+    runtime.advance(chrono::seconds(1));
+    CHECK_EQUAL(size_t(100), cancelledWakeups);
+
+    *cancel = true;
+    runtime.advance(chrono::seconds(5));
+    CHECK_EQUAL(size_t(100), cancelledWakeups);
+    CHECK_EQUAL(size_t(300), kept);
+    CHECK_EQUAL(size_t(0), runtime.getTaskCount());
+    CHECK_EQUAL(behaviorBytes, MemoryAccount::globalTotal(MemorySubsystem::Behaviors));
+
+    // Stopping the runtime frees the tasks still suspended
+    runtime.spawn(sleeper(runtime, 3, kept), nullptr);
+    runtime.advance(chrono::seconds(0));
+    CHECK_EQUAL(size_t(1), runtime.getTaskCount());
+    runtime.stop();
+    CHECK_EQUAL(size_t(0), runtime.getTaskCount());
+    CHECK_EQUAL(behaviorBytes, MemoryAccount::globalTotal(MemorySubsystem::Behaviors));
+}
@@ -0,0 +1,170 @@
+#include "TestRunner.h"
+#include "../ControlServer.h"
+#include "../SmartHome.h"
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstring>
+
+using namespace std;
+
+static const char* const SOCKET_PATH = "control.sock";   // In the test's scratch directory
+static const int TIMEOUT_MS = 5000;
+
+// A client connected to the control server's Unix socket.
+class Client {
+private:
+    int fd;
+
+public:
+    Client() : fd(socket(AF_UNIX, SOCK_STREAM, 0)) {
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        strcpy(address.sun_path, SOCKET_PATH);
+        if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ~Client() {
+        if (fd >= 0) ::close(fd);
+    }
+    Client(const Client&) = delete;
+    Client& operator=(const Client&) = delete;
+
+    bool connected() const {
+        return fd >= 0;
+    }
+
+    // Sends all of text, returning false if the server has hung up.
+    bool send(const string& text) {
+        size_t sent = 0;
+        while (fd >= 0 && sent < text.size()) {
+            ssize_t count = ::send(fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+            if (count <= 0) return false;
+            sent += static_cast<size_t>(count);
+        }
+        return fd >= 0;
+    }
+
+    // Reads until count replies have arrived, each ending with an "OK" or "ERR ..." line, and
+    // returns them in order. Returns fewer if the server hangs up or stops answering.
+    vector<string> readReplies(size_t count) {
+        vector<string> replies;
+        string reply, pending;
+        while (fd >= 0 && replies.size() < count) {
+            size_t newline = pending.find('\n');
+            if (newline == string::npos) {
+                if (!readSome(pending)) break;
+                continue;
+            }
+            string line = pending.substr(0, newline + 1);
+            pending.erase(0, newline + 1);
+            reply += line;
+            if (line == "OK\n" || line.compare(0, 4, "ERR ") == 0) {
+                replies.push_back(reply);
+                reply.clear();
+            }
+        }
+        return replies;
+    }
+
+    // Returns true if the server closes the connection within the timeout.
+    bool closedByServer() {
+        string ignored;
+        while (readSome(ignored)) {}
+        pollfd entry = { fd, POLLIN, 0 };
+        char byte;
+        return poll(&entry, 1, 0) == 1 && recv(fd, &byte, 1, 0) == 0;
+    }
+
+private:
+    // Appends what arrives within the timeout to text; false on timeout or hang-up.
+    bool readSome(string& text) {
+        pollfd entry = { fd, POLLIN, 0 };
+        if (poll(&entry, 1, TIMEOUT_MS) != 1) return false;
+        char buffer[4096];
+        ssize_t received = recv(fd, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (received <= 0) return false;
+        text.append(buffer, static_cast<size_t>(received));
+        return true;
+    }
+};
+
+TEST(ControlServer_answersPipelinedCommandsInOrder) {
+    SmartHome home;
+    ControlServer server(home);
+    CHECK(server.listenUnix(SOCKET_PATH));
+    CHECK(server.start(false));
+    Client client;
+    CHECK(client.connected());
+
+    // All in one write, the last command split across two
+    CHECK(client.send("count\nadd|LIGHT|Lamp\ncount\nadd|PLUG|Kettle\ncount\nbogus\nremove|Lamp\nfind\nco"));
+    CHECK(client.send("unt\n"));
+    vector<string> replies = client.readReplies(9);
+    CHECK_EQUAL(size_t(9), replies.size());
+    if (replies.size() == 9) {
+        CHECK_EQUAL(string("0\nOK\n"), replies[0]);
+        CHECK(replies[1].find("Lamp") != string::npos && replies[1].ends_with("\nOK\n"));
+        CHECK_EQUAL(string("1\nOK\n"), replies[2]);
+        CHECK(replies[3].find("Kettle") != string::npos && replies[3].ends_with("\nOK\n"));
+        CHECK_EQUAL(string("2\nOK\n"), replies[4]);
+        CHECK_EQUAL(string("ERR malformed command\n"), replies[5]);
+        CHECK_EQUAL(string("OK\n"), replies[6]);
+        CHECK_EQUAL(string("Kettle\nOK\n"), replies[7]);
+        CHECK_EQUAL(string("1\nOK\n"), replies[8]);
+    }
+    server.stop();
+}
+
+TEST(ControlServer_appliesBatchBlocks) {
+    SmartHome home;
+    home.executeCommand("add|LIGHT|Lamp");
+    home.executeCommand("add|SPEAKER|Radio");
+    ControlServer server(home);
+    CHECK(server.listenUnix(SOCKET_PATH));
+    CHECK(server.start(false));
+    Client client;
+
+    CHECK(client.send("BATCH 4\nLamp|on|1\nLamp|brightness|30\nRadio|volume|loud\nGarage|on|1\nEND\n"
+                      "BATCHES\ncount|on\n"));
+    vector<string> replies = client.readReplies(3);
+    CHECK_EQUAL(size_t(3), replies.size());
+    if (replies.size() == 3) {
+        CHECK_EQUAL(string("Applied 2 of 4 updates.\nLine 4: invalid value\nLine 5: device \"Garage\" not found\nOK\n"), replies[0]);
+        CHECK_EQUAL(string("ERR malformed batch header\n"), replies[1]);
+        CHECK_EQUAL(string("1\nOK\n"), replies[2]);
+    }
+    double brightness = 0;
+    SmartDevice* lamp = home.findDevice("Lamp");
+    CHECK(lamp && lamp->getIsOn() && lamp->getSetting(DeviceAttribute::Brightness, brightness));
+    CHECK_EQUAL(30.0, brightness);
+    server.stop();
+}
+
+TEST(ControlServer_disconnectsClientSendingOverlongLine) {
+    SmartHome home;
+    ControlServer server(home);
+    CHECK(server.listenUnix(SOCKET_PATH));
+    CHECK(server.start(false));
+    {
+        Client client;
+        CHECK(client.send("count\n"));
+        CHECK_EQUAL(size_t(1), client.readReplies(1).size());
+        client.send(string(100 * 1024, 'x'));   // Over the 64 KB line limit, with no newline
+        CHECK(client.closedByServer());
+    }
+
+    // Other clients are still served
+    Client next;
+    CHECK(next.send("count\n"));
+    vector<string> replies = next.readReplies(1);
+    CHECK(replies == vector<string>{ "0\nOK\n" });
+    server.stop();
+}
+
+#endif
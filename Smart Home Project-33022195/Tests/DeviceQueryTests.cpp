@@ -0,0 +1,39 @@
+#include "TestRunner.h"
+#include "../DeviceQuery.h"
+
+using namespace std;
+
+TEST(DeviceQuery_splitsIndexConditionsFromPredicates) {
+    DeviceQuery query;
+    string error;
+    CHECK(query.compile("type=light&prefix=hall&on&sort=-name&limit=3", error));
+    CHECK_EQUAL(string("type=light&on"), query.indexExpression);
+    CHECK_EQUAL(size_t(1), query.predicates.size());
+    CHECK(query.sortKey == DeviceQuery::SortKey::Name);
+    CHECK(query.descending);
+    CHECK_EQUAL(size_t(3), query.limit);
+    CHECK(!query.needsState);
+
+    CHECK(query.compile("energy>1.5&sort=room", error));
+    CHECK(query.needsState);
+    CHECK_EQUAL(size_t(0), query.limit);
+
+    CHECK(!query.compile("sort=colour", error));
+    CHECK_EQUAL(string("unknown sort key \"colour\""), error);
+    CHECK(!query.compile("energy>lots", error));
+}
+
+TEST(DeviceQuery_limitMustBeAPositiveInteger) {
+    DeviceQuery query;
+    string error;
+    CHECK(query.compile("limit=1", error));
+    CHECK_EQUAL(size_t(1), query.limit);
+    CHECK(query.compile("limit=18446744073709551615", error) == (sizeof(size_t) == 8));
+
+    for (const char* bad : { "limit=", "limit=0", "limit=-1", "limit=+5", "limit= 5", "limit=2.5", "limit=1e3",
+                             "limit=5x", "limit=0x10", "limit=nan", "limit=inf", "limit=18446744073709551616" }) {
+        error.clear();
+        CHECK(!query.compile(bad, error));
+        CHECK_EQUAL(string("limit must be a positive integer"), error);
+    }
+}
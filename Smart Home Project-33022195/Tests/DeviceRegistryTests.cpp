@@ -0,0 +1,84 @@
+#include "TestRunner.h"
+#include "../DeviceRegistry.h"
+#include "../StoreReader.h"
+#include "../TempHumiditySensor.h"
+#include "../WorkStealingPool.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+// Helper function: Gives a device some state to store: name, power, every setting it
+// supports and a schedule entry where it takes one.
+static void giveState(SmartDevice& device, int index) {
+    device.setName("Registered " + to_string(index));
+    device.setPower(true);
+    for (int i = 0; i < DEVICE_ATTRIBUTE_COUNT; ++i) {
+        DeviceAttribute attribute = static_cast<DeviceAttribute>(i);
+        if (attribute != DeviceAttribute::Power) {
+            device.applySetting(attribute, attribute == DeviceAttribute::TargetTemperature ? 22.5 : 40);
+        }
+    }
+    device.addSchedule(6, 30, true);
+}
+
+TEST(DeviceRegistry_everyTypeRoundTripsThroughItsTag) {
+    ostringstream menu;
+    streambuf* saved = cout.rdbuf(menu.rdbuf());
+    DeviceRegistry::printMenu();
+    cout.rdbuf(saved);
+    string listed = menu.str();
+
+    int types = 0;
+    for (int index = 1; unique_ptr<SmartDevice> device = DeviceRegistry::createFromMenu(index, ""); ++index) {
+        ++types;
+        giveState(*device, index);
+        string record = device->serialize();
+        CHECK_EQUAL(string(device->getTypeTag()) + "|", record.substr(0, record.find('|') + 1));
+
+        unique_ptr<SmartDevice> loaded = DeviceRegistry::create(device->getTypeTag());
+        CHECK(loaded != nullptr);
+        if (!loaded) continue;
+        CHECK_EQUAL(string(device->getTypeTag()), string(loaded->getTypeTag()));
+        loaded->deserialize(record);
+        CHECK_EQUAL(record, loaded->serialize());
+        CHECK_EQUAL(device->getName(), loaded->getName());
+        CHECK(loaded->getIsOn());
+    }
+    CHECK_EQUAL(count(listed.begin(), listed.end(), '\n'), ptrdiff_t(types));
+    CHECK(types >= 6);
+}
+
+TEST(DeviceRegistry_unknownTagsCreateNothing) {
+    CHECK(DeviceRegistry::create("") == nullptr);
+    CHECK(DeviceRegistry::create("LIGH") == nullptr);
+    CHECK(DeviceRegistry::create("LIGHTS") == nullptr);
+    CHECK(DeviceRegistry::create("light") == nullptr);
+    CHECK(DeviceRegistry::createFromMenu(0, "Legacy") == nullptr);
+}
+
+TEST(DeviceRegistry_legacyTempHumidityRecordLoadsAsSensor) {
+    TempHumiditySensor sensor("Hall sensor");
+    sensor.setPower(true);
+    string record = sensor.serialize();
+    CHECK_EQUAL(string("TEMP_HUMIDITY|"), record.substr(0, 14));
+    string legacy = "TEMPHUMIDITY" + record.substr(13);
+
+    unique_ptr<SmartDevice> device = DeviceRegistry::create("TEMPHUMIDITY");
+    CHECK(dynamic_cast<TempHumiditySensor*>(device.get()) != nullptr);
+    if (!device) return;
+    device->deserialize(legacy);
+    CHECK_EQUAL(string("Hall sensor"), device->getName());
+    CHECK_EQUAL(string("TEMP_HUMIDITY"), string(device->getTypeTag()));
+    CHECK_EQUAL(record, device->serialize());   // Saved under the current tag
+
+    // Read from a store file too
+    string store = legacy + "\n";
+    WorkStealingPool pool(1);
+    vector<unique_ptr<SmartDevice>> parsed = StoreReader::parse(store.data(), store.size(), false, pool);
+    CHECK_EQUAL(size_t(1), parsed.size());
+    if (parsed.size() != 1) return;
+    CHECK(dynamic_cast<TempHumiditySensor*>(parsed[0].get()) != nullptr);
+    CHECK_EQUAL(record, parsed[0]->serialize());
+}
@@ -0,0 +1,104 @@
+#include "TestRunner.h"
+#include "../EventLog.h"
+#include "../SmartDevice.h"
+#include <sstream>
+#include <fstream>
+#include <thread>
+#include <functional>
+
+using namespace std;
+
+// Helper function: Records events on a thread of their own. A thread's buffer belongs to the
+// first log it records into, and other tests' devices record into the program's log.
+static void onNewThread(const function<void()>& body) {
+    thread recorder(body);
+    recorder.join();
+}
+
+// Helper function: Decodes an event file into lines without their timestamps, which the virtual
+// clock leaves near 1970 in whichever time zone runs the tests.
+static vector<string> decodeLines(const string& fileName) {
+    ostringstream out;
+    string error;
+    CHECK(EventLog::decode(fileName, out, error));
+    CHECK_EQUAL(string(), error);
+    istringstream in(out.str());
+    vector<string> lines;
+    string line;
+    while (getline(in, line)) {
+        if (line.compare(0, 4, "--- ") == 0) {
+            lines.push_back("--- run started ---");
+        }
+        else {
+            lines.push_back(line.size() > 24 ? line.substr(24) : line);   // "YYYY-MM-DD HH:MM:SS.mmm "
+        }
+    }
+    return lines;
+}
+
+// Events recorded, flushed and decoded come back in order under the names the devices had when
+// they happened, though the virtual clock does not move between them.
+TEST(EventLog_recordFlushDecode) {
+    {
+        EventLog log;
+        onNewThread([&log]() {
+            log.nameDevice(1, "Lamp");
+            log.nameDevice(2, "Speaker");
+            log.record(EventLog::Event::Added, 1);
+            log.record(EventLog::Event::PowerOn, 1);
+            log.record(EventLog::Event::Setting, 1, static_cast<int>(DeviceAttribute::Brightness), 80);
+            log.record(EventLog::Event::TimerStarted, 2, 30);
+            log.nameDevice(1, "Desk Lamp");
+            log.record(EventLog::Event::Renamed, 1);
+            log.record(EventLog::Event::PowerOff, 1);
+            log.nameDevice(1, "Reading Lamp");
+            log.record(EventLog::Event::Renamed, 1);
+            log.record(EventLog::Event::Removed, 1);
+            log.record(EventLog::Event::TimerFinished, 2);
+        });
+        log.flush();
+    }
+
+    vector<string> expected = {
+        "--- run started ---",
+        "Lamp added",
+        "Lamp on",
+        "Lamp brightness 80",
+        "Speaker timer started (30 s)",
+        "Desk Lamp renamed (was Lamp)",
+        "Desk Lamp off",
+        "Reading Lamp renamed (was Desk Lamp)",
+        "Reading Lamp removed",
+        "Speaker timer finished",
+    };
+    CHECK(decodeLines(EventLog::FILE_NAME) == expected);
+}
+
+// A later run appends to the file; names registered in an earlier run do not carry over.
+TEST(EventLog_laterRunsAppend) {
+    {
+        EventLog log;
+        onNewThread([&log]() {
+            log.nameDevice(4, "Plug");
+            log.record(EventLog::Event::PowerOn, 4);
+        });
+    }
+    {
+        EventLog log;
+        onNewThread([&log]() {
+            log.record(EventLog::Event::PowerOff, 4);
+        });
+    }
+
+    vector<string> expected = { "--- run started ---", "Plug on", "--- run started ---", "#4 off" };
+    CHECK(decodeLines(EventLog::FILE_NAME) == expected);
+}
+
+TEST(EventLog_decodeRejectsOtherFiles) {
+    ofstream("other.bin", ios::binary) << "SMARTHOME";
+    ostringstream out;
+    string error;
+    CHECK(!EventLog::decode("other.bin", out, error));
+    CHECK_EQUAL(string("other.bin is not an event log"), error);
+    CHECK(!EventLog::decode("missing.bin", out, error));
+}
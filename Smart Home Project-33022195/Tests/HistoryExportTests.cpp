@@ -0,0 +1,330 @@
+#include "TestRunner.h"
+#include "../HistoryExport.h"
+#include "../HistoryLog.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+struct ExportedRow {
+    string device;
+    string type;
+    string series;
+    int64_t timestamp;
+    float value;
+    float extra;
+
+    bool operator==(const ExportedRow& other) const {
+        return device == other.device && type == other.type && series == other.series && timestamp == other.timestamp
+            && memcmp(&value, &other.value, sizeof(value)) == 0 && memcmp(&extra, &other.extra, sizeof(extra)) == 0;
+    }
+};
+
+// Reads a columnar export back (the format is described in HistoryExport.cpp), independently of
+// the writer, checking each block against its statistics and the footer against the blocks.
+class ColumnarReader {
+public:
+    vector<ExportedRow> rows;
+    size_t blockCount = 0;
+    bool valid = true;
+    string problem;                 // What made the file invalid
+
+    explicit ColumnarReader(const string& fileName) {
+        ifstream file(fileName, ios::binary);
+        data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+        read();
+    }
+
+private:
+    struct Source {
+        string device;
+        string type;
+        string series;
+        uint64_t rows;
+    };
+
+    string data;
+    size_t position = 0;
+
+    void fail(const string& reason) {
+        if (valid) problem = reason;
+        valid = false;
+        position = data.size();
+    }
+
+    template <typename T>
+    T fixed() {
+        T value{};
+        if (position + sizeof(T) > data.size()) {
+            fail("truncated number");
+            return value;
+        }
+        memcpy(&value, data.data() + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (position >= data.size()) break;
+            uint8_t byte = static_cast<uint8_t>(data[position++]);
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        fail("truncated varint");
+        return 0;
+    }
+
+    string text() {
+        uint64_t length = varint();
+        if (position + length > data.size()) {
+            fail("truncated string");
+            return "";
+        }
+        string value = data.substr(position, static_cast<size_t>(length));
+        position += static_cast<size_t>(length);
+        return value;
+    }
+
+    static float floatOf(uint32_t bits) {
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void read() {
+        const size_t magicLength = strlen(HistoryExport::MAGIC);
+        if (data.size() < 2 * magicLength + 8 || data.compare(0, magicLength, HistoryExport::MAGIC) != 0
+            || data.compare(data.size() - magicLength, magicLength, HistoryExport::MAGIC) != 0) {
+            fail("missing magic");
+            return;
+        }
+        position = data.size() - magicLength - 8;
+        position = static_cast<size_t>(fixed<uint64_t>());
+
+        vector<Source> sources(static_cast<size_t>(varint()));
+        for (Source& source : sources) {
+            source.device = text();
+            source.type = text();
+            source.series = text();
+            source.rows = varint();
+        }
+        struct BlockEntry {
+            uint64_t offset;
+            uint32_t rows;
+            int64_t minTimestamp;
+            int64_t maxTimestamp;
+            float minValue;
+            float maxValue;
+        };
+        vector<BlockEntry> blocks(static_cast<size_t>(varint()));
+        for (BlockEntry& block : blocks) {
+            block.offset = fixed<uint64_t>();
+            block.rows = fixed<uint32_t>();
+            block.minTimestamp = fixed<int64_t>();
+            block.maxTimestamp = fixed<int64_t>();
+            block.minValue = fixed<float>();
+            block.maxValue = fixed<float>();
+        }
+        if (!valid) return;
+        blockCount = blocks.size();
+
+        vector<uint64_t> sourceRows(sources.size(), 0);
+        for (const BlockEntry& entry : blocks) {
+            position = static_cast<size_t>(entry.offset);
+            uint32_t rowCount = fixed<uint32_t>();
+            int64_t minTimestamp = fixed<int64_t>();
+            int64_t maxTimestamp = fixed<int64_t>();
+            float minValue = fixed<float>();
+            float maxValue = fixed<float>();
+            uint32_t lengths[4];
+            for (uint32_t& length : lengths) length = fixed<uint32_t>();
+            if (rowCount != entry.rows || minTimestamp != entry.minTimestamp || maxTimestamp != entry.maxTimestamp
+                || minValue != entry.minValue || maxValue != entry.maxValue) {
+                fail("block header does not match the footer");
+                return;
+            }
+            size_t columnStart[4];
+            for (int i = 0; i < 4; ++i) {
+                columnStart[i] = i == 0 ? position : columnStart[i - 1] + lengths[i - 1];
+            }
+
+            size_t first = rows.size();
+            rows.resize(first + rowCount);
+            position = columnStart[0];
+            for (size_t row = first; row < rows.size();) {
+                uint64_t source = varint();
+                uint64_t run = varint();
+                if (source >= sources.size() || run == 0 || row + run > rows.size()) {
+                    fail("bad source run");
+                    return;
+                }
+                sourceRows[source] += run;
+                for (; run > 0; --run, ++row) {
+                    rows[row].device = sources[source].device;
+                    rows[row].type = sources[source].type;
+                    rows[row].series = sources[source].series;
+                }
+            }
+            if (position != columnStart[1]) fail("source column length");
+
+            int64_t timestamp = 0;
+            for (size_t row = first; row < rows.size(); ++row) {
+                uint64_t zigzag = varint();
+                timestamp += static_cast<int64_t>((zigzag >> 1) ^ (~(zigzag & 1) + 1));
+                rows[row].timestamp = timestamp;
+            }
+            if (position != columnStart[2]) fail("timestamp column length");
+
+            uint32_t bits = 0;
+            for (size_t row = first; row < rows.size(); ++row) {
+                bits ^= static_cast<uint32_t>(varint());
+                rows[row].value = floatOf(bits);
+            }
+            if (position != columnStart[3]) fail("value column length");
+
+            bits = 0;
+            for (size_t row = first; row < rows.size(); ++row) {
+                bits ^= static_cast<uint32_t>(varint());
+                rows[row].extra = floatOf(bits);
+            }
+            if (position != columnStart[3] + lengths[3]) fail("extra column length");
+
+            for (size_t row = first; row < rows.size(); ++row) {
+                const ExportedRow& r = rows[row];
+                if (r.timestamp < minTimestamp || r.timestamp > maxTimestamp || r.value < minValue || r.value > maxValue) {
+                    fail("row outside its block's statistics");
+                }
+            }
+        }
+        for (size_t i = 0; i < sources.size(); ++i) {
+            if (sourceRows[i] != sources[i].rows) fail("footer row count for " + sources[i].device);
+        }
+    }
+};
+
+// Helper function: Splits one CSV line, undoing quoting.
+static vector<string> csvFields(const string& line) {
+    vector<string> fields(1);
+    bool quoted = false;
+    for (size_t i = 0; i < line.size(); ++i) {
+        char c = line[i];
+        if (quoted && c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+            fields.back() += '"';
+            ++i;
+        }
+        else if (c == '"') quoted = !quoted;
+        else if (c == ',' && !quoted) fields.emplace_back();
+        else fields.back() += c;
+    }
+    return fields;
+}
+
+// Helper function: Reads a CSV export back. Returns false if a line is malformed.
+static bool readCsv(const string& fileName, vector<ExportedRow>& rows) {
+    ifstream file(fileName);
+    string line;
+    if (!getline(file, line) || line != "device,type,series,timestamp,value,extra") return false;
+    while (getline(file, line)) {
+        vector<string> fields = csvFields(line);
+        if (fields.size() != 6) return false;
+        rows.push_back({ fields[0], fields[1], fields[2], strtoll(fields[3].c_str(), nullptr, 10),
+            strtof(fields[4].c_str(), nullptr), strtof(fields[5].c_str(), nullptr) });
+    }
+    return true;
+}
+
+struct ExportedSeries {
+    string device;
+    string type;
+    string series;
+    HistoryLog* log;
+};
+
+// Helper function: Exports the series to a file in the given format. Returns the rows written.
+static uint64_t exportSeries(const string& fileName, const vector<ExportedSeries>& series, time_t from, time_t to) {
+    HistoryExport exporter;
+    TestRunner::check(exporter.open(fileName, HistoryExport::formatFor(fileName)), "open " + fileName, __FILE__, __LINE__);
+    for (const ExportedSeries& item : series) {
+        exporter.addSeries(item.device, item.type, item.series, *item.log, from, to);
+    }
+    TestRunner::check(exporter.close(), "close " + fileName, __FILE__, __LINE__);
+    return exporter.getRowCount();
+}
+
+// A columnar export decodes to the same rows as the CSV export of the same histories, across
+// several blocks, spilled and buffered samples, and a device name that needs quoting.
+TEST(HistoryExport_columnarMatchesCsv) {
+    const time_t START = 1700000000;
+    HistoryLog energy;
+    HistoryLog climate;
+    HistoryLog unused;
+    for (int i = 0; i < 150000; ++i) {
+        energy.append(START + i * 60, static_cast<float>((i % 97) * 0.0125), 0.0f);
+    }
+    for (int i = 0; i < 20000; ++i) {
+        climate.append(START + i * 300 + (i % 7), 18.0f + static_cast<float>(i % 50) / 10.0f, 40.0f + static_cast<float>(i % 23));
+    }
+    climate.append(START - 100, -4.5f, 99.0f);   // Out of order: still exported as recorded
+
+    vector<ExportedSeries> series = {
+        { "Plug 1", "PLUG", "energy", &energy },
+        { "Hall, \"upstairs\"", "TEMP_HUMIDITY", "climate", &climate },
+        { "Spare", "PLUG", "energy", &unused },
+    };
+    time_t all[2] = { numeric_limits<time_t>::min(), numeric_limits<time_t>::max() };
+    CHECK_EQUAL(uint64_t(170001), exportSeries("history.bin", series, all[0], all[1]));
+    CHECK_EQUAL(uint64_t(170001), exportSeries("history.csv", series, all[0], all[1]));
+
+    ColumnarReader columnar("history.bin");
+    CHECK(columnar.valid);
+    CHECK_EQUAL(string(), columnar.problem);
+    CHECK_EQUAL(size_t(3), columnar.blockCount);   // 64k rows per block
+    vector<ExportedRow> csv;
+    CHECK(readCsv("history.csv", csv));
+    CHECK_EQUAL(csv.size(), columnar.rows.size());
+    CHECK(columnar.rows == csv);
+    CHECK_EQUAL(string("Hall, \"upstairs\""), csv.back().device);
+    CHECK_EQUAL(int64_t(START - 100), csv.back().timestamp);
+
+    // A time range keeps only the rows inside it (both ends included)
+    time_t from = START + 3600;
+    time_t to = START + 7200;
+    exportSeries("hour.bin", series, from, to);
+    exportSeries("hour.csv", series, from, to);
+    ColumnarReader hour("hour.bin");
+    vector<ExportedRow> hourCsv;
+    CHECK(readCsv("hour.csv", hourCsv));
+    CHECK(hour.valid);
+    CHECK(hour.rows == hourCsv);
+    CHECK_EQUAL(size_t(61 + 12), hour.rows.size());
+    bool inRange = true;
+    for (const ExportedRow& row : hour.rows) {
+        inRange = inRange && row.timestamp >= from && row.timestamp <= to;
+    }
+    CHECK(inRange);
+
+    // Nothing in range still gives a readable, empty file
+    exportSeries("none.bin", series, 0, 1);
+    ColumnarReader none("none.bin");
+    CHECK(none.valid);
+    CHECK(none.rows.empty());
+    CHECK_EQUAL(size_t(0), none.blockCount);
+
+    energy.discard();
+    climate.discard();
+}
+
+TEST(HistoryExport_formatFor) {
+    CHECK(HistoryExport::formatFor("export.csv") == HistoryExport::Format::Csv);
+    CHECK(HistoryExport::formatFor("EXPORT.CSV") == HistoryExport::Format::Csv);
+    CHECK(HistoryExport::formatFor("export.bin") == HistoryExport::Format::Columnar);
+    CHECK(HistoryExport::formatFor("csv") == HistoryExport::Format::Columnar);
+}
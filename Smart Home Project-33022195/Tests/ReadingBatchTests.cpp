@@ -0,0 +1,111 @@
+#include "TestRunner.h"
+#include "../ReadingBatch.h"
+#include <string>
+
+using namespace std;
+
+static const time_t NOW = 1800000000;
+
+// Helper function: Parses text into a fresh batch and checks all of it was used.
+static void parseAll(ReadingBatch& batch, const string& text) {
+    batch.clear();
+    size_t used = batch.parse(text.data(), text.size(), NOW);
+    TestRunner::check(used == text.size(), "parse() used " + to_string(used) + " of " + to_string(text.size()) + " bytes",
+        __FILE__, __LINE__);
+}
+
+TEST(ReadingBatch_parsesReadings) {
+    ReadingBatch batch;
+    parseAll(batch, "Hall temp=21.4,hum=48 1700000000\nAttic temperature=-3.25,humidity=91i\nHall hum=50,temp=22\n");
+    CHECK(batch.names == vector<string>({ "Hall", "Attic" }));
+    CHECK(batch.nameOf == vector<uint32_t>({ 0, 1, 0 }));
+    CHECK_EQUAL(size_t(3), batch.readings.size());
+    CHECK_EQUAL(size_t(0), batch.rejected);
+
+    CHECK_EQUAL(int64_t(1700000000), batch.readings[0].timestamp);
+    CHECK_EQUAL(21.4f, batch.readings[0].value);
+    CHECK_EQUAL(48.0f, batch.readings[0].extra);
+    CHECK_EQUAL(int64_t(NOW), batch.readings[1].timestamp);   // No timestamp: the time of parsing
+    CHECK_EQUAL(-3.25f, batch.readings[1].value);
+    CHECK_EQUAL(91.0f, batch.readings[1].extra);
+    CHECK_EQUAL(22.0f, batch.readings[2].value);
+    CHECK_EQUAL(50.0f, batch.readings[2].extra);
+}
+
+TEST(ReadingBatch_timestampUnits) {
+    ReadingBatch batch;
+    parseAll(batch, "A temp=1,hum=1 1700000000\nA temp=1,hum=1 1700000000123\nA temp=1,hum=1 1700000000123456\n"
+        "A temp=1,hum=1 1700000000123456789\n");
+    CHECK_EQUAL(size_t(4), batch.readings.size());
+    for (const HistoryLog::Sample& reading : batch.readings) {
+        CHECK_EQUAL(int64_t(1700000000), reading.timestamp);
+    }
+}
+
+TEST(ReadingBatch_namesTagsAndFields) {
+    ReadingBatch batch;
+    parseAll(batch, "Hall\\ Sensor,site=home temp=20,hum=40\nAttic,floor=2 temp=2.1e1,hum=+40.5,battery=3.1\n"
+        "Hall\\ Sensor temp=19.5,hum=41,rssi=-60i 1700000000\nComma\\,Name temp=1,hum=2\n");
+    CHECK(batch.names == vector<string>({ "Hall Sensor", "Attic", "Comma,Name" }));
+    CHECK(batch.nameOf == vector<uint32_t>({ 0, 1, 0, 2 }));
+    CHECK_EQUAL(21.0f, batch.readings[1].value);
+    CHECK_EQUAL(40.5f, batch.readings[1].extra);
+    CHECK_EQUAL(19.5f, batch.readings[2].value);
+    CHECK_EQUAL(size_t(0), batch.rejected);
+}
+
+TEST(ReadingBatch_skipsCommentsAndBlankLines) {
+    ReadingBatch batch;
+    parseAll(batch, "# exported readings\n\nA temp=1,hum=2\r\n\r\n#B temp=1,hum=2\n");
+    CHECK_EQUAL(size_t(1), batch.readings.size());
+    CHECK_EQUAL(size_t(0), batch.rejected);
+    CHECK(batch.names == vector<string>({ "A" }));
+}
+
+TEST(ReadingBatch_leavesPartialLines) {
+    ReadingBatch batch;
+    string text = "A temp=1,hum=2\nB temp=3,h";
+    CHECK_EQUAL(size_t(15), batch.parse(text.data(), text.size(), NOW));
+    CHECK_EQUAL(size_t(1), batch.readings.size());
+
+    // The caller passes the rest again once the line is complete
+    string rest = text.substr(15) + "um=4\n";
+    CHECK_EQUAL(rest.size(), batch.parse(rest.data(), rest.size(), NOW));
+    CHECK(batch.names == vector<string>({ "A", "B" }));
+    CHECK_EQUAL(4.0f, batch.readings[1].extra);
+}
+
+TEST(ReadingBatch_rejectsMalformedLines) {
+    ReadingBatch batch;
+    parseAll(batch, "NoFields\nX temp=abc,hum=1\nX temp=1\nX temp=1,hum=2 12x\nX temp=1,hum=2 x\n,tag=1 temp=1,hum=2\n"
+        "X temp\nGood temp=1,hum=2\n");
+    CHECK_EQUAL(size_t(7), batch.rejected);
+    CHECK_EQUAL(string("expected a name and fields"), batch.firstError);
+    CHECK(batch.names == vector<string>({ "Good" }));
+    CHECK_EQUAL(size_t(1), batch.readings.size());
+
+    parseAll(batch, "X temp=1\n");
+    CHECK_EQUAL(string("needs temp and hum fields"), batch.firstError);
+    parseAll(batch, "X temp=1,hum=2 12x\n");
+    CHECK_EQUAL(string("unexpected text after the fields"), batch.firstError);
+    parseAll(batch, "X temp=1,hum=2 x\n");
+    CHECK_EQUAL(string("invalid timestamp"), batch.firstError);
+    parseAll(batch, ",tag=1 temp=1,hum=2\n");
+    CHECK_EQUAL(string("empty device name"), batch.firstError);
+    parseAll(batch, "X temp=,hum=2\n");
+    CHECK_EQUAL(string("invalid number"), batch.firstError);
+}
+
+TEST(ReadingBatch_clearKeepsNothing) {
+    ReadingBatch batch;
+    parseAll(batch, "Hall\\ Sensor temp=1,hum=2\nbad\n");
+    batch.clear();
+    CHECK(batch.names.empty());
+    CHECK(batch.readings.empty());
+    CHECK_EQUAL(size_t(0), batch.rejected);
+    CHECK(batch.firstError.empty());
+
+    // Names seen before the clear are new again
+    parseAll(batch, "Hall\\ Sensor temp=1,hum=2\n");
+    CHECK(batch.nameOf == vector<uint32_t>({ 0 }));
+}
@@ -0,0 +1,249 @@
+#include "TestRunner.h"
+#include "../RecurrenceRule.h"
+#include <cstdlib>
+#include <ctime>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Switches the process to US Eastern time while in scope, and back afterwards. Daylight saving
+// time starts on 2026-03-08 at 02:00 (02:00-02:59 does not exist) and ends on 2026-11-01 at
+// 02:00 (01:00-01:59 happens twice).
+class EasternTime {
+public:
+    EasternTime() {
+        const char* current = getenv("TZ");
+        hadZone = current != nullptr;
+        previous = current ? current : "";
+#ifdef _WIN32
+        set("EST5EDT");
+#else
+        set("EST5EDT,M3.2.0,M11.1.0");
+#endif
+    }
+
+    ~EasternTime() {
+        if (hadZone) {
+            set(previous.c_str());
+            return;
+        }
+#ifdef _WIN32
+        _putenv_s("TZ", "");
+        _tzset();
+#else
+        unsetenv("TZ");
+        tzset();
+#endif
+    }
+
+private:
+    bool hadZone;
+    string previous;
+
+    static void set(const char* zone) {
+#ifdef _WIN32
+        _putenv_s("TZ", zone);
+        _tzset();
+#else
+        setenv("TZ", zone, 1);
+        tzset();
+#endif
+    }
+};
+
+// Helper function: Converts a local date and time to a time_t.
+static time_t localTime(int year, int month, int day, int hour, int minute) {
+    tm local = {};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+// Helper function: Splits a time_t into local calendar fields.
+static tm localParts(time_t time) {
+    tm local;
+#ifdef _MSC_VER
+    localtime_s(&local, &time);
+#else
+    localtime_r(&time, &local);
+#endif
+    return local;
+}
+
+// Helper function: Parses a rule that must be valid.
+static RecurrenceRule rule(const string& text) {
+    RecurrenceRule parsed;
+    string error;
+    TestRunner::check(RecurrenceRule::parse(text, parsed, error), "parse(\"" + text + "\"): " + error, __FILE__, __LINE__);
+    return parsed;
+}
+
+// Helper function: Returns the error for a rule that must be rejected ("" if it was accepted).
+static string rejection(const string& text) {
+    RecurrenceRule parsed;
+    string error;
+    return RecurrenceRule::parse(text, parsed, error) ? string() : error;
+}
+
+TEST(RecurrenceRule_daysFromCivil) {
+    CHECK_EQUAL(0, RecurrenceRule::daysFromCivil(1970, 1, 1));
+    CHECK_EQUAL(-1, RecurrenceRule::daysFromCivil(1969, 12, 31));
+    CHECK_EQUAL(11017, RecurrenceRule::daysFromCivil(2000, 3, 1));
+    CHECK_EQUAL(20744, RecurrenceRule::daysFromCivil(2026, 10, 18));
+    CHECK_EQUAL(-25567, RecurrenceRule::daysFromCivil(1900, 1, 1));
+    CHECK_EQUAL(157113, RecurrenceRule::daysFromCivil(2400, 2, 29));
+}
+
+TEST(RecurrenceRule_weekdayOf) {
+    CHECK_EQUAL(4, RecurrenceRule::weekdayOf(0));                                        // Thursday 1970-01-01
+    CHECK_EQUAL(3, RecurrenceRule::weekdayOf(-1));                                       // Wednesday
+    CHECK_EQUAL(0, RecurrenceRule::weekdayOf(-4));                                       // Sunday 1969-12-28
+    CHECK_EQUAL(6, RecurrenceRule::weekdayOf(-5));                                       // Saturday
+    CHECK_EQUAL(1, RecurrenceRule::weekdayOf(RecurrenceRule::daysFromCivil(1900, 1, 1)));
+    CHECK_EQUAL(2, RecurrenceRule::weekdayOf(RecurrenceRule::daysFromCivil(2000, 2, 29)));
+    CHECK_EQUAL(0, RecurrenceRule::weekdayOf(RecurrenceRule::daysFromCivil(2026, 10, 18)));
+
+    bool consecutive = true;
+    for (int32_t day = -3000; day < 3000; ++day) {
+        int weekday = RecurrenceRule::weekdayOf(day);
+        consecutive = consecutive && weekday >= 0 && weekday < 7 && RecurrenceRule::weekdayOf(day + 1) == (weekday + 1) % 7;
+    }
+    CHECK(consecutive);
+}
+
+TEST(RecurrenceRule_parseFormatsCanonically) {
+    CHECK_EQUAL(string("on 07:30 daily"), rule("on 07:30").toString());
+    CHECK_EQUAL(string("off 22:00 weekdays"), rule("OFF 22:00 Weekdays").toString());
+    CHECK_EQUAL(string("on 08:00 weekdays"), rule("on 08:00 mon-fri").toString());
+    CHECK_EQUAL(string("on 08:00 weekends"), rule("on 08:00 sat,sun").toString());
+    CHECK_EQUAL(string("on 08:00 daily"), rule("on 08:00 sun-sat").toString());
+    CHECK_EQUAL(string("on 08:00 tue"), rule("on 08:00 tue-tue").toString());
+    CHECK_EQUAL(string("on 08:00 mon,wed,fri"), rule("on 08:00 fri,mon,wed").toString());
+    CHECK_EQUAL(string("on every 90m 08:00-20:00 daily"), rule("on every 90m 08:00-20:00").toString());
+    CHECK_EQUAL(string("on every 2h 08:00-20:00 daily"), rule("on every 120m 08:00-20:00").toString());
+    CHECK_EQUAL(string("on every 2h 08:00-20:00 weekends from 2026-12-01 to 2027-01-06"),
+        rule("on every 2h 08:00-20:00 sat,sun from 2026-12-01 to 2027-01-06").toString());
+    CHECK_EQUAL(string("on 07:00 daily to 2026-12-31"), rule("on 07:00 to 2026-12-31").toString());
+    CHECK(!rule("off 07:00").switchesOn());
+
+    for (const char* text : { "on 07:30 mon,fri,sat,sun", "off every 15m 00:00-23:45 tue,thu from 2026-01-01",
+        "on once 2030-06-01 12:00" }) {
+        RecurrenceRule original = rule(text);
+        CHECK(rule(original.toString()) == original);
+    }
+}
+
+TEST(RecurrenceRule_wrappingWeekdayRange) {
+    RecurrenceRule longWeekend = rule("on 08:00 fri-mon");
+    CHECK_EQUAL(string("on 08:00 mon,fri,sat,sun"), longWeekend.toString());
+    CHECK(rule("on 08:00 fri,sat,sun,mon") == longWeekend);
+
+    // 2026-10-19 is a Monday
+    CHECK_EQUAL(localTime(2026, 10, 19, 8, 0), longWeekend.nextAfter(localTime(2026, 10, 19, 7, 0)));
+    CHECK_EQUAL(localTime(2026, 10, 23, 8, 0), longWeekend.nextAfter(localTime(2026, 10, 19, 8, 0)));
+    CHECK_EQUAL(localTime(2026, 10, 24, 8, 0), longWeekend.nextAfter(localTime(2026, 10, 23, 8, 0)));
+    CHECK_EQUAL(localTime(2026, 10, 26, 8, 0), longWeekend.nextAfter(localTime(2026, 10, 25, 8, 0)));
+
+    CHECK_EQUAL(string("on 08:00 mon,tue,sat,sun"), rule("on 08:00 sat-tue").toString());
+    CHECK_EQUAL(string("invalid days fri-xyz"), rejection("on 08:00 fri-xyz"));
+}
+
+TEST(RecurrenceRule_everyRoundsUpToTheNextSlot) {
+    RecurrenceRule every45 = rule("on every 45m 08:00-10:00");
+    CHECK_EQUAL(localTime(2026, 10, 20, 8, 0), every45.nextAfter(localTime(2026, 10, 20, 7, 0)));
+    CHECK_EQUAL(localTime(2026, 10, 20, 8, 45), every45.nextAfter(localTime(2026, 10, 20, 8, 0)));
+    CHECK_EQUAL(localTime(2026, 10, 20, 8, 45), every45.nextAfter(localTime(2026, 10, 20, 8, 1)));
+    CHECK_EQUAL(localTime(2026, 10, 20, 8, 45), every45.nextAfter(localTime(2026, 10, 20, 8, 44) + 59));
+    CHECK_EQUAL(localTime(2026, 10, 20, 9, 30), every45.nextAfter(localTime(2026, 10, 20, 8, 45) + 30));
+    // 10:15 is past the end of the window, so the day is over
+    CHECK_EQUAL(localTime(2026, 10, 21, 8, 0), every45.nextAfter(localTime(2026, 10, 20, 9, 30)));
+
+    RecurrenceRule hourly = rule("off every 1h 08:30-09:00");
+    CHECK_EQUAL(localTime(2026, 10, 20, 8, 30), hourly.nextAfter(localTime(2026, 10, 20, 0, 0)));
+    CHECK_EQUAL(localTime(2026, 10, 21, 8, 30), hourly.nextAfter(localTime(2026, 10, 20, 8, 30)));
+
+    CHECK_EQUAL(string("expected every N[m|h] HH:MM-HH:MM"), rejection("on every 0m 08:00-09:00"));
+    CHECK(!rejection("on every 24h 00:00-23:59").empty());
+    CHECK(!rejection("on every 15s 08:00-09:00").empty());
+    CHECK(!rejection("on every 15m 09:00-08:00").empty());
+    CHECK(!rejection("on every 15m 08:00").empty());
+    CHECK(!rejection("on every 15m").empty());
+}
+
+TEST(RecurrenceRule_validatesDates) {
+    CHECK(rejection("on once 2028-02-29 10:00").empty());
+    CHECK_EQUAL(string("expected once YYYY-MM-DD HH:MM"), rejection("on once 2026-02-29 10:00"));
+    CHECK(!rejection("on once 2026-04-31 10:00").empty());
+    CHECK(!rejection("on once 2026-13-01 10:00").empty());
+    CHECK(!rejection("on once 2026-12-24 24:00").empty());
+    CHECK(!rejection("on once 2026-12-24 18:00 daily").empty());   // Nothing may follow a one-off time
+    CHECK(!rejection("on once 2026-12-24").empty());
+    CHECK_EQUAL(string("invalid date 2026-02-30"), rejection("on 07:00 from 2026-02-30"));
+    CHECK_EQUAL(string("invalid date 2026-1-x"), rejection("on 07:00 to 2026-1-x"));
+    CHECK_EQUAL(string("the rule ends before it starts"), rejection("on 07:00 from 2027-01-01 to 2026-12-31"));
+    CHECK_EQUAL(string("a rule starts with on or off"), rejection("toggle 07:00"));
+    CHECK_EQUAL(string("expected a time (HH:MM), every or once"), rejection("on 7.30"));
+}
+
+TEST(RecurrenceRule_dateRangeAndOnce) {
+    RecurrenceRule december = rule("on 07:00 from 2026-12-01 to 2026-12-03");
+    CHECK_EQUAL(localTime(2026, 12, 1, 7, 0), december.nextAfter(localTime(2026, 11, 1, 12, 0)));
+    CHECK_EQUAL(localTime(2026, 12, 3, 7, 0), december.nextAfter(localTime(2026, 12, 2, 7, 0)));
+    CHECK_EQUAL(time_t(0), december.nextAfter(localTime(2026, 12, 3, 7, 0)));
+
+    // 2026-12-01 to 03 is Tuesday to Thursday
+    CHECK_EQUAL(time_t(0), rule("on 07:00 sat from 2026-12-01 to 2026-12-03").nextAfter(localTime(2026, 11, 1, 0, 0)));
+
+    RecurrenceRule once = rule("off once 2026-12-24 18:00");
+    time_t when = localTime(2026, 12, 24, 18, 0);
+    CHECK_EQUAL(when, once.nextAfter(when - 1));
+    CHECK_EQUAL(time_t(0), once.nextAfter(when));
+}
+
+TEST(RecurrenceRule_daylightSavingTime) {
+    EasternTime zone;
+
+    // A daily time keeps its local hour, so the day it changes is 23 or 25 hours long
+    RecurrenceRule daily = rule("on 07:00 daily");
+    time_t beforeSpring = localTime(2026, 3, 7, 7, 0);
+    time_t spring = daily.nextAfter(beforeSpring);
+    CHECK_EQUAL(7, localParts(spring).tm_hour);
+    CHECK_EQUAL(8, localParts(spring).tm_mday);
+    CHECK_EQUAL(time_t(23 * 3600), spring - beforeSpring);
+
+    time_t beforeAutumn = localTime(2026, 10, 31, 7, 0);
+    time_t autumn = daily.nextAfter(beforeAutumn);
+    CHECK_EQUAL(7, localParts(autumn).tm_hour);
+    CHECK_EQUAL(1, localParts(autumn).tm_mday);
+    CHECK_EQUAL(time_t(25 * 3600), autumn - beforeAutumn);
+
+    // 02:30 does not exist on 2026-03-08: the rule still fires that day, once, and goes on the next
+    RecurrenceRule skipped = rule("on 02:30 daily");
+    time_t missing = skipped.nextAfter(localTime(2026, 3, 7, 2, 30));
+    CHECK_EQUAL(8, localParts(missing).tm_mday);
+    time_t following = skipped.nextAfter(missing);
+    CHECK_EQUAL(9, localParts(following).tm_mday);
+    CHECK_EQUAL(2, localParts(following).tm_hour);
+    CHECK_EQUAL(30, localParts(following).tm_min);
+
+    // Each slot fires once on 2026-11-01, the repeated 01:00 and 01:30 included, always moving forward
+    RecurrenceRule every30 = rule("on every 30m 00:00-03:00");
+    vector<time_t> firings;
+    for (time_t at = every30.nextAfter(localTime(2026, 10, 31, 23, 59)); localParts(at).tm_mday == 1 && firings.size() < 20;
+        at = every30.nextAfter(at)) {
+        firings.push_back(at);
+    }
+    bool increasing = true;
+    for (size_t i = 1; i < firings.size(); ++i) {
+        increasing = increasing && firings[i] > firings[i - 1];
+    }
+    CHECK(increasing);
+    CHECK_EQUAL(size_t(7), firings.size());
+    CHECK_EQUAL(localTime(2026, 11, 1, 0, 0), firings.front());
+    CHECK_EQUAL(localTime(2026, 11, 1, 3, 0), firings.back());
+}
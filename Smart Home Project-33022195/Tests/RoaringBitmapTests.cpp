@@ -0,0 +1,160 @@
+#include "TestRunner.h"
+#include "../RoaringBitmap.h"
+#include <algorithm>
+#include <iterator>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace std;
+
+// Helper function: Builds a bitmap from values.
+static RoaringBitmap bitmapOf(const vector<uint32_t>& values) {
+    RoaringBitmap bitmap;
+    for (uint32_t value : values) {
+        bitmap.add(value);
+    }
+    return bitmap;
+}
+
+// Helper function: Returns the distinct values in sorted order, as toVector() should.
+static vector<uint32_t> sortedSet(const vector<uint32_t>& values) {
+    set<uint32_t> distinct(values.begin(), values.end());
+    return vector<uint32_t>(distinct.begin(), distinct.end());
+}
+
+// Helper function: Draws values that fill some containers densely and others sparsely:
+// key 0 gets most of its range, key 1 a few thousand values, key 7 a handful, and a few
+// values are spread over the whole range.
+static vector<uint32_t> mixedValues(uint32_t seed, double denseShare) {
+    mt19937 random(seed);
+    vector<uint32_t> values;
+    for (uint32_t low = 0; low < 65536; ++low) {
+        if (random() % 1000 < denseShare * 1000) values.push_back(low);
+    }
+    for (int i = 0; i < 3000; ++i) values.push_back(65536 + random() % 65536);
+    for (int i = 0; i < 20; ++i) values.push_back(7 * 65536 + random() % 65536);
+    for (int i = 0; i < 50; ++i) values.push_back(static_cast<uint32_t>(random()));
+    return values;
+}
+
+TEST(RoaringBitmap_addRemoveContains) {
+    RoaringBitmap bitmap;
+    CHECK(bitmap.empty());
+    for (uint32_t value : { 5u, 0u, 65535u, 65536u, 1u << 31, 0xFFFFFFFFu, 5u }) {
+        bitmap.add(value);
+    }
+    CHECK_EQUAL(size_t(6), bitmap.cardinality());
+    CHECK(bitmap.toVector() == vector<uint32_t>({ 0, 5, 65535, 65536, 1u << 31, 0xFFFFFFFFu }));
+    CHECK(bitmap.contains(65536));
+    CHECK(!bitmap.contains(65537));
+    CHECK(!bitmap.contains(4));
+
+    bitmap.remove(65536);
+    bitmap.remove(65536);
+    bitmap.remove(12345678);
+    CHECK_EQUAL(size_t(5), bitmap.cardinality());
+    CHECK(!bitmap.contains(65536));
+
+    bitmap.clear();
+    CHECK(bitmap.empty());
+    CHECK(bitmap.toVector().empty());
+}
+
+TEST(RoaringBitmap_switchesContainers) {
+    // 4097 values in one container is past the sparse limit, so it becomes a bit set
+    RoaringBitmap bitmap;
+    vector<uint32_t> expected;
+    for (uint32_t value = 0; value <= 8192; value += 2) {
+        bitmap.add(value);
+        expected.push_back(value);
+    }
+    CHECK_EQUAL(size_t(4097), bitmap.cardinality());
+    CHECK(bitmap.toVector() == expected);
+    CHECK(bitmap.contains(8192));
+    CHECK(!bitmap.contains(8191));
+    bitmap.add(8192);
+    CHECK_EQUAL(size_t(4097), bitmap.cardinality());
+
+    // Removing values takes it back under the limit and to a sorted array
+    for (uint32_t value = 0; value <= 8192; value += 4) {
+        bitmap.remove(value);
+        expected.erase(find(expected.begin(), expected.end(), value));
+    }
+    CHECK_EQUAL(size_t(2048), bitmap.cardinality());
+    CHECK(bitmap.toVector() == expected);
+    CHECK(bitmap.contains(2));
+    CHECK(!bitmap.contains(4));
+
+    // And past it again, then empty
+    for (uint32_t value = 10000; value < 13000; ++value) {
+        bitmap.add(value);
+        expected.push_back(value);
+    }
+    CHECK_EQUAL(size_t(5048), bitmap.cardinality());
+    CHECK(bitmap.toVector() == expected);
+    for (uint32_t value : expected) {
+        bitmap.remove(value);
+    }
+    CHECK(bitmap.empty());
+}
+
+TEST(RoaringBitmap_setOperations) {
+    // Dense and sparse containers on both sides, so every pairing is combined
+    for (double aShare : { 0.01, 0.5 }) {
+        for (double bShare : { 0.02, 0.6 }) {
+            vector<uint32_t> a = sortedSet(mixedValues(1, aShare));
+            vector<uint32_t> b = sortedSet(mixedValues(2, bShare));
+            RoaringBitmap left = bitmapOf(a);
+            RoaringBitmap right = bitmapOf(b);
+
+            vector<uint32_t> both, either, onlyLeft;
+            set_intersection(a.begin(), a.end(), b.begin(), b.end(), back_inserter(both));
+            set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(either));
+            set_difference(a.begin(), a.end(), b.begin(), b.end(), back_inserter(onlyLeft));
+
+            CHECK((left & right).toVector() == both);
+            CHECK((left | right).toVector() == either);
+            CHECK((left - right).toVector() == onlyLeft);
+            CHECK_EQUAL(both.size(), (left & right).cardinality());
+            CHECK_EQUAL(either.size(), (left | right).cardinality());
+            CHECK_EQUAL(onlyLeft.size(), (left - right).cardinality());
+        }
+    }
+}
+
+TEST(RoaringBitmap_operationResultsChangeContainers) {
+    // Two dense containers whose intersection and difference are small
+    vector<uint32_t> evens, lowOdds;
+    for (uint32_t value = 0; value < 20000; value += 2) evens.push_back(value);
+    for (uint32_t value = 1; value < 20000; value += 2) lowOdds.push_back(value);
+    lowOdds.push_back(100);
+    lowOdds.push_back(200);
+    RoaringBitmap even = bitmapOf(evens);
+    RoaringBitmap odd = bitmapOf(lowOdds);
+
+    RoaringBitmap both = even & odd;
+    CHECK(both.toVector() == vector<uint32_t>({ 100, 200 }));
+    both.add(102);
+    CHECK_EQUAL(size_t(3), both.cardinality());
+
+    RoaringBitmap rest = even - odd;
+    CHECK_EQUAL(size_t(9998), rest.cardinality());
+    CHECK(!rest.contains(100));
+    RoaringBitmap few = even - (even - bitmapOf({ 4, 6, 8 }));
+    CHECK(few.toVector() == vector<uint32_t>({ 4, 6, 8 }));
+
+    // Two sparse containers whose union is dense
+    vector<uint32_t> low, high;
+    for (uint32_t value = 0; value < 3000; ++value) low.push_back(value);
+    for (uint32_t value = 3000; value < 6000; ++value) high.push_back(value);
+    RoaringBitmap all = bitmapOf(low) | bitmapOf(high);
+    CHECK_EQUAL(size_t(6000), all.cardinality());
+    all.remove(0);
+    CHECK(!all.contains(0));
+    CHECK(all.contains(5999));
+
+    CHECK((even & RoaringBitmap()).empty());
+    CHECK_EQUAL(even.cardinality(), (even | RoaringBitmap()).cardinality());
+    CHECK((RoaringBitmap() - even).empty());
+}
@@ -0,0 +1,98 @@
+#include "TestRunner.h"
+#include "../ScheduleTable.h"
+#include <sstream>
+#include <string>
+#include <vector>
+#include <utility>
+
+using namespace std;
+
+// Helper function: Reads schedule lines into a new table.
+static ScheduleTable readTable(const string& lines) {
+    ScheduleTable table;
+    istringstream in(lines);
+    table.read(in);
+    return table;
+}
+
+// Helper function: Returns (minute of day, switch on) pairs for the transitions expected.
+static vector<pair<int, bool>> transitions(initializer_list<pair<int, bool>> expected) {
+    return vector<pair<int, bool>>(expected);
+}
+
+TEST(ScheduleTable_readsLegacyLines) {
+    ScheduleTable table = readTable("7|30|ON\n22|0|OFF\n");
+    CHECK(table.getTransitions() == transitions({ { 450, true }, { 1320, false } }));
+    CHECK(table.getLines() == vector<string>({ "07:30 -> ON", "22:00 -> OFF" }));
+
+    // Windows line endings, out-of-order lines and invalid times
+    table = readTable("22|0|OFF\r\n25|00|ON\r\n7|60|ON\r\n-1|0|ON\r\n6|15|ON\r\n");
+    CHECK(table.getTransitions() == transitions({ { 375, true }, { 1320, false } }));
+}
+
+TEST(ScheduleTable_legacyLinesAreNormalized) {
+    // A later line replaces an earlier one at the same minute
+    CHECK(readTable("7|30|ON\n7|30|OFF\n22|0|ON\n").getTransitions() == transitions({ { 450, false }, { 1320, true } }));
+
+    // Entries that do not change the state are dropped, going round midnight
+    CHECK(readTable("7|0|ON\n8|0|ON\n22|0|OFF\n23|0|OFF\n").getTransitions() == transitions({ { 420, true }, { 1320, false } }));
+    CHECK(readTable("1|0|OFF\n7|0|ON\n22|0|OFF\n").getTransitions() == transitions({ { 420, true }, { 1320, false } }));
+
+    // A schedule that only ever switches one way keeps its earliest entry
+    CHECK(readTable("9|0|ON\n7|0|ON\n").getTransitions() == transitions({ { 420, true } }));
+}
+
+TEST(ScheduleTable_readsCompactLinesAndRules) {
+    ScheduleTable table = readTable("420+,1320-\nR|on 07:30 weekdays\nR|off once 2020-01-01 10:00\n");
+    CHECK(table.getTransitions() == transitions({ { 420, true }, { 1320, false } }));
+    CHECK_EQUAL(size_t(1), table.getRules().size());   // The expired one-off rule is dropped
+    CHECK_EQUAL(size_t(3), table.size());
+    CHECK_EQUAL(string("rule: on 07:30 weekdays"), table.getLines().back());
+
+    // Minutes outside the day are skipped
+    CHECK(readTable("1500+,60+,1439-\n").getTransitions() == transitions({ { 60, true }, { 1439, false } }));
+
+    // Reading replaces what was there
+    istringstream in("600+\n");
+    table.read(in);
+    CHECK(table.getTransitions() == transitions({ { 600, true } }));
+    CHECK(table.getRules().empty());
+}
+
+TEST(ScheduleTable_writeReadRoundTrip) {
+    ScheduleTable table;
+    CHECK(table.add(7, 30, true));
+    CHECK(table.add(22, 0, false));
+    CHECK(!table.add(24, 0, true));
+    string error;
+    CHECK(table.addRule("on every 15m 08:00-09:00 weekends from 2030-01-01", error));
+    CHECK(table.addRule("off once 2030-06-01 12:00", error));
+    CHECK(!table.addRule("on once 2020-06-01 12:00", error));
+    CHECK_EQUAL(string("the rule never fires again"), error);
+
+    ostringstream out;
+    table.write(out);
+    CHECK_EQUAL(string("450+,1320-\nR|on every 15m 08:00-09:00 weekends from 2030-01-01\nR|off once 2030-06-01 12:00\n"), out.str());
+
+    ScheduleTable copy = readTable(out.str());
+    CHECK(copy.getTransitions() == table.getTransitions());
+    CHECK(copy.getRules() == table.getRules());
+}
+
+TEST(ScheduleTable_stateAt) {
+    ScheduleTable table = readTable("7|30|ON\n22|0|OFF\n");
+    bool on = true;
+    CHECK(table.stateAt(0, on));
+    CHECK(!on);                         // Still off from 22:00 the day before
+    CHECK(table.stateAt(450, on));
+    CHECK(on);
+    CHECK(table.stateAt(1319, on));
+    CHECK(on);
+    CHECK(table.stateAt(1320, on));
+    CHECK(!on);
+    CHECK(!ScheduleTable().stateAt(0, on));
+
+    CHECK(table.remove(1));
+    CHECK(table.getTransitions() == transitions({ { 1320, false } }));
+    CHECK(!table.remove(2));
+}
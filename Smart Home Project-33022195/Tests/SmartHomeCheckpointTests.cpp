@@ -0,0 +1,78 @@
+#include "TestRunner.h"
+#include "StoreFixture.h"
+#include "../SmartHome.h"
+#include <functional>
+
+using namespace std;
+
+static const int DEVICE_COUNT = 600;   // Three segments
+
+// Helper function: Loads the fixture store, changes one device and checkpoints. Checks that
+// only the segment holding that device was written, and that the other segments and the
+// manifest are unchanged.
+static void checkOnlyItsSegmentSaved(int index, const function<void(SmartHome&, SmartDevice&)>& change) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    vector<string> files = StoreFixture::segmentFiles();
+    CHECK_EQUAL(size_t(3), files.size());
+    vector<string> before;
+    for (const string& file : files) {
+        before.push_back(StoreFixture::readFile(file));
+    }
+    vector<string> stored = files;
+    stored.push_back("smart_home.txt");
+    StoreFixture::backdate(stored);
+
+    SmartHome home;
+    SmartDevice* device = home.findDevice(StoreFixture::deviceName(index));
+    CHECK(device != nullptr);
+    if (!device) return;
+    int segment = device->getSegment();
+    change(home, *device);
+    home.saveDevices();
+
+    vector<string> written = StoreFixture::rewritten(stored);
+    CHECK(written == vector<string>{ files[segment] });
+    for (size_t i = 0; i < files.size(); ++i) {
+        if (static_cast<int>(i) == segment) {
+            CHECK(StoreFixture::readFile(files[i]) != before[i]);
+        }
+        else {
+            CHECK(StoreFixture::readFile(files[i]) == before[i]);
+        }
+    }
+}
+
+TEST(Checkpoint_toggleRewritesOnlyItsSegment) {
+    checkOnlyItsSegmentSaved(300, [](SmartHome& home, SmartDevice& device) {
+        CHECK_EQUAL(string("LIGHT"), string(device.getTypeTag()));
+        CHECK(home.executeCommand("toggle|" + device.getName()).ends_with("OK\n"));
+    });
+}
+
+TEST(Checkpoint_setpointRewritesOnlyItsSegment) {
+    checkOnlyItsSegmentSaved(5, [](SmartHome& home, SmartDevice& device) {
+        CHECK_EQUAL(string("RADIATOR"), string(device.getTypeTag()));
+        CHECK(home.executeCommand("set|" + device.getName() + "|target|23.5").ends_with("OK\n"));
+    });
+}
+
+TEST(Checkpoint_renameRewritesOnlyItsSegment) {
+    checkOnlyItsSegmentSaved(550, [](SmartHome& home, SmartDevice& device) {
+        device.setName("Renamed speaker");
+        CHECK(home.findDevice("Renamed speaker") == &device);
+    });
+}
+
+TEST(Checkpoint_scheduleEditRewritesOnlyItsSegment) {
+    checkOnlyItsSegmentSaved(242, [](SmartHome& home, SmartDevice& device) {
+        CHECK(home.executeCommand("schedule|" + device.getName() + "|add|7|30|on") == "OK\n");
+    });
+}
+
+TEST(Checkpoint_historyAppendRewritesOnlyItsSegment) {
+    checkOnlyItsSegmentSaved(261, [](SmartHome&, SmartDevice& device) {
+        CHECK_EQUAL(string("TEMP_HUMIDITY"), string(device.getTypeTag()));
+        HistoryLog::Sample readings[] = { { 1700000000, 21.5f, 40.0f }, { 1700000060, 21.6f, 41.0f } };
+        CHECK(device.recordReadings(readings, 2));
+    });
+}
@@ -0,0 +1,132 @@
+#include "TestRunner.h"
+#include "StoreFixture.h"
+#include "../SmartHome.h"
+#include "../RoaringBitmap.h"
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+static const int DEVICE_COUNT = 600;
+
+// Turns lazy loading on for the homes a test creates, and off again when the test ends.
+struct LazyLoading {
+    LazyLoading() { SmartHome::setLazyLoading(true); }
+    ~LazyLoading() { SmartHome::setLazyLoading(false); }
+};
+
+// Sends what the console menus print to a string, and feeds them input, while it exists.
+struct ConsoleCapture {
+    ostringstream output;
+    istringstream input;
+    streambuf* savedOutput;
+    streambuf* savedInput;
+
+    explicit ConsoleCapture(const string& typed = "")
+        : input(typed), savedOutput(cout.rdbuf(output.rdbuf())), savedInput(cin.rdbuf(input.rdbuf())) {}
+    ~ConsoleCapture() {
+        cout.rdbuf(savedOutput);
+        cin.rdbuf(savedInput);
+    }
+};
+
+// Helper function: Returns every device of the home without looking any of them up by name.
+static vector<SmartDevice*> allDevices(SmartHome& home) {
+    RoaringBitmap matches;
+    string error;
+    home.queryDevices("", matches, error);
+    return home.devicesIn(matches);
+}
+
+// Helper function: Returns the device with the given name among devices, or nullptr.
+static SmartDevice* named(const vector<SmartDevice*>& devices, const string& name) {
+    auto found = find_if(devices.begin(), devices.end(), [&name](SmartDevice* device) { return device->getName() == name; });
+    return found == devices.end() ? nullptr : *found;
+}
+
+// Helper function: Counts the devices that have been hydrated.
+static size_t hydratedCount(const vector<SmartDevice*>& devices) {
+    return count_if(devices.begin(), devices.end(), [](SmartDevice* device) { return device->isHydrated(); });
+}
+
+TEST(LazyLoading_listsAndFindsWithoutHydrating) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    LazyLoading lazy;
+    SmartHome home;
+    vector<SmartDevice*> devices = allDevices(home);
+    CHECK_EQUAL(size_t(DEVICE_COUNT), devices.size());
+
+    string listed = home.executeCommand("list");
+    CHECK(listed.find("Device 0: Smart Light (not loaded yet)\n") != string::npos);
+    CHECK_EQUAL(size_t(DEVICE_COUNT), size_t(count(listed.begin(), listed.end(), '\n')) - 1);
+    CHECK_EQUAL(string("Device 12: Smart Light (not loaded yet)\nDevice 120: Smart Light (not loaded yet)\n"
+        "Device 126: Smart Light (not loaded yet)\nOK\n"), home.executeCommand("list|prefix=device 12&type=light"));
+    CHECK_EQUAL(string("100\nOK\n"), home.executeCommand("count|type=thermostat"));
+    CHECK(home.executeCommand("find|type=radiator").starts_with("Device 5\nDevice 11\n"));
+    CHECK_EQUAL(size_t(0), hydratedCount(devices));
+}
+
+TEST(LazyLoading_hydratesOnLookup) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    LazyLoading lazy;
+    SmartHome home;
+    vector<SmartDevice*> devices = allDevices(home);
+    SmartDevice* device = home.findDevice("device 7");
+    CHECK(device == named(devices, "Device 7"));
+    CHECK(device && device->isHydrated());
+    CHECK_EQUAL(size_t(1), hydratedCount(devices));
+}
+
+TEST(LazyLoading_hydratesOnOneClick) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    LazyLoading lazy;
+    SmartHome home;
+    vector<SmartDevice*> devices = allDevices(home);
+    SmartDevice* light = named(devices, "Device 6");
+    CHECK(light && !light->isHydrated());
+    if (!light) return;
+    {
+        ConsoleCapture console;
+        home.handleOneClickAction("Device 6");
+        CHECK_EQUAL(string("Device 6 is now ON.\n"), console.output.str());
+    }
+    CHECK(light->isHydrated());
+    CHECK(light->getIsOn());
+    CHECK_EQUAL(size_t(1), hydratedCount(devices));
+}
+
+TEST(LazyLoading_hydratesInDeviceMenu) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    LazyLoading lazy;
+    SmartHome home;
+    vector<SmartDevice*> devices = allDevices(home);
+    SmartDevice* thermostat = named(devices, "Device 13");
+    CHECK(thermostat && !thermostat->isHydrated());
+    if (!thermostat) return;
+    {
+        ConsoleCapture console("9\n");   // Leave the menu straight away
+        home.interactWithDevice("Device 13");
+        CHECK(console.output.str().find("Enter choice: ") != string::npos);
+    }
+    CHECK(thermostat->isHydrated());
+    CHECK_EQUAL(size_t(1), hydratedCount(devices));
+}
+
+TEST(LazyLoading_untouchedDevicesSaveByteIdentical) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    vector<string> files = StoreFixture::segmentFiles();
+    string before = StoreFixture::readFile(files[0]);
+    StoreFixture::backdate(files);
+    {
+        LazyLoading lazy;
+        SmartHome home;
+        // Toggled twice, so its own record ends up as it was, but the segment is rewritten
+        CHECK(home.executeCommand("toggle|Device 0").ends_with("OK\n"));
+        CHECK(home.executeCommand("toggle|Device 0").ends_with("OK\n"));
+        home.saveDevices();
+        CHECK_EQUAL(size_t(1), hydratedCount(allDevices(home)));
+    }
+    CHECK(StoreFixture::rewritten(files) == vector<string>{ files[0] });
+    CHECK(StoreFixture::readFile(files[0]) == before);
+}
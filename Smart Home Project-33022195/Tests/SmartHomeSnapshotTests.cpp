@@ -0,0 +1,97 @@
+#include "TestRunner.h"
+#include "StoreFixture.h"
+#include "../SmartHome.h"
+
+using namespace std;
+
+static const int DEVICE_COUNT = 600;   // Three segments
+
+// What a device looked like when the snapshot was taken.
+struct DeviceState {
+    string record;
+    int slot;
+    int segment;
+};
+
+// Helper function: Returns the state of every fixture device, in fixture order.
+static vector<DeviceState> captureStates(SmartHome& home) {
+    vector<DeviceState> states;
+    for (int i = 0; i < DEVICE_COUNT; ++i) {
+        SmartDevice* device = home.findDevice(StoreFixture::deviceName(i));
+        CHECK(device != nullptr);
+        if (!device) return states;
+        states.push_back({ device->getRecord(), device->getSlot(), device->getSegment() });
+    }
+    return states;
+}
+
+// Helper function: Returns the contents of the store's segment files.
+static vector<string> readSegments() {
+    vector<string> contents;
+    for (const string& file : StoreFixture::segmentFiles()) {
+        contents.push_back(StoreFixture::readFile(file));
+    }
+    return contents;
+}
+
+// Rolling back undoes a rename, a power change, a setting, an added device and a removed one:
+// every device is back in its slot and segment with its old record, the name index and the
+// attribute index find what the snapshot had, and the segment files are as they were.
+TEST(Snapshot_rollbackRestoresDevicesAndStore) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    SmartHome home;
+    CHECK_EQUAL(DEVICE_COUNT, home.takeSnapshot("before"));
+    vector<DeviceState> before = captureStates(home);
+    vector<string> segmentsBefore = readSegments();
+    CHECK_EQUAL(size_t(3), segmentsBefore.size());
+
+    SmartDevice* light = home.findDevice(StoreFixture::deviceName(12));
+    CHECK(light != nullptr);
+    if (!light) return;
+    CHECK_EQUAL(string("LIGHT"), string(light->getTypeTag()));
+    light->setName("Porch light");
+    CHECK(home.executeCommand("toggle|Porch light").ends_with("OK\n"));
+    CHECK(home.executeCommand("set|Porch light|brightness|80").ends_with("OK\n"));
+    CHECK(home.executeCommand("add|PLUG|Newcomer").ends_with("OK\n"));
+    CHECK(home.executeCommand("remove|" + StoreFixture::deviceName(400)) == "OK\n");
+    home.saveDevices();
+    CHECK(readSegments() != segmentsBefore);
+
+    CHECK_EQUAL(3, home.rollback("before"));   // The new plug, the removed speaker and the light
+    vector<DeviceState> after = captureStates(home);
+    CHECK_EQUAL(before.size(), after.size());
+    for (size_t i = 0; i < before.size() && i < after.size(); ++i) {
+        CHECK_EQUAL(before[i].record, after[i].record);
+        CHECK_EQUAL(before[i].slot, after[i].slot);
+        CHECK_EQUAL(before[i].segment, after[i].segment);
+    }
+    CHECK(home.findDevice("Porch light") == nullptr);
+    CHECK(home.findDevice("Newcomer") == nullptr);
+    CHECK_EQUAL(string("100\nOK\n"), home.executeCommand("count|type=plug"));
+    CHECK_EQUAL(string("100\nOK\n"), home.executeCommand("count|type=speaker"));
+    CHECK(readSegments() == segmentsBefore);
+
+    CHECK_EQUAL(-1, home.rollback("missing"));
+}
+
+// A rolled-back home saves and loads as the snapshot did.
+TEST(Snapshot_rollbackSurvivesReload) {
+    StoreFixture::writeStore(DEVICE_COUNT);
+    vector<DeviceState> before;
+    {
+        SmartHome home;
+        home.takeSnapshot("before");
+        before = captureStates(home);
+        home.executeCommand("toggle|" + StoreFixture::deviceName(0));
+        home.executeCommand("remove|" + StoreFixture::deviceName(599));
+        home.rollback("before");
+    }
+
+    SmartHome reloaded;
+    vector<DeviceState> after = captureStates(reloaded);
+    CHECK_EQUAL(before.size(), after.size());
+    for (size_t i = 0; i < before.size() && i < after.size(); ++i) {
+        CHECK_EQUAL(before[i].record, after[i].record);
+        CHECK_EQUAL(before[i].segment, after[i].segment);
+    }
+}
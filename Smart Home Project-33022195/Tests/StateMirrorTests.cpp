@@ -0,0 +1,145 @@
+#include "TestRunner.h"
+#include "../StateMirror.h"
+#include "../SmartDevice.h"
+#include "../DeviceRegistry.h"
+#include <sstream>
+#include <cmath>
+#include <cstring>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+TEST(StateMirror_readEmptyAndHalfWrittenRecords) {
+    StateMirror::Record record{};
+    StateMirror::State state;
+    CHECK(StateMirror::read(record, state) == StateMirror::ReadResult::Empty);
+    record.sequence.store(1);   // A write that never finished
+    CHECK(StateMirror::read(record, state) == StateMirror::ReadResult::Unreadable);
+}
+
+#ifndef _WIN32
+static const char* const MIRROR_NAME = "smart_home_tests_mirror";
+
+// Maps a mirror read-write, as a reader would map it read-only, so a test can look at its records
+// and damage one.
+class MirrorView {
+private:
+    void* view;
+    size_t bytes;
+
+public:
+    explicit MirrorView(const string& name) : view(MAP_FAILED), bytes(0) {
+        int fd = shm_open(("/" + name).c_str(), O_RDWR, 0);
+        struct stat status;
+        if (fd >= 0 && fstat(fd, &status) == 0) {
+            bytes = static_cast<size_t>(status.st_size);
+            view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (fd >= 0) ::close(fd);
+    }
+    ~MirrorView() {
+        if (view != MAP_FAILED) munmap(view, bytes);
+    }
+    MirrorView(const MirrorView&) = delete;
+    MirrorView& operator=(const MirrorView&) = delete;
+
+    bool mapped() const {
+        return view != MAP_FAILED && bytes >= sizeof(StateMirror::Header);
+    }
+    StateMirror::Header& header() const {
+        return *static_cast<StateMirror::Header*>(view);
+    }
+    StateMirror::Record& record(int slot) const {
+        return reinterpret_cast<StateMirror::Record*>(static_cast<char*>(view) + sizeof(StateMirror::Header))[slot];
+    }
+};
+
+// Helper function: Returns the lines of a dump of the mirror after its "Generation ..." line.
+static vector<string> dumpLines(const string& name) {
+    ostringstream out;
+    string error;
+    CHECK(StateMirror::dump(name, out, error));
+    CHECK_EQUAL(string(), error);
+    istringstream in(out.str());
+    vector<string> lines;
+    string line;
+    getline(in, line);
+    CHECK(line.compare(0, 11, "Generation ") == 0);
+    while (getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+// Devices published into a mirror read back as they are, through read() and dump(); a record
+// whose sequence stays odd reads as Unreadable and is reported rather than waited for.
+TEST(StateMirror_publishReadAndDump) {
+    {
+        StateMirror mirror;
+        string error;
+        CHECK(mirror.open(MIRROR_NAME, 4, error));
+        unique_ptr<SmartDevice> light = DeviceRegistry::create("LIGHT");
+        light->setName("Kitchen light");
+        CHECK(light->applySetting(DeviceAttribute::Power, 1));
+        CHECK(light->applySetting(DeviceAttribute::Brightness, 40));
+        unique_ptr<SmartDevice> speaker = DeviceRegistry::create("SPEAKER");
+        speaker->setName("Den speaker");
+        CHECK(speaker->applySetting(DeviceAttribute::Volume, 25));
+        mirror.publish(0, *light);
+        mirror.publish(3, *speaker);
+
+        MirrorView view(MIRROR_NAME);
+        CHECK(view.mapped());
+        if (!view.mapped()) return;
+        CHECK_EQUAL(0, memcmp(view.header().magic, StateMirror::MAGIC, 8));
+        CHECK_EQUAL(4u, view.header().count.load());
+        CHECK_EQUAL(uint64_t(2), view.header().generation.load());
+        CHECK_EQUAL(1u, view.header().live.load());
+
+        StateMirror::State state;
+        CHECK(StateMirror::read(view.record(0), state) == StateMirror::ReadResult::Device);
+        CHECK_EQUAL(string("LIGHT"), string(state.type));
+        CHECK_EQUAL(string("Kitchen light"), string(state.name));
+        CHECK_EQUAL(uint32_t(StateMirror::PRESENT | StateMirror::LOADED | StateMirror::ON), state.flags);
+        CHECK_EQUAL(40.0, state.settings[static_cast<int>(DeviceAttribute::Brightness)]);
+        CHECK(std::isnan(state.settings[static_cast<int>(DeviceAttribute::Volume)]));
+        CHECK(StateMirror::read(view.record(1), state) == StateMirror::ReadResult::Empty);
+        CHECK(StateMirror::read(view.record(3), state) == StateMirror::ReadResult::Device);
+        CHECK_EQUAL(uint32_t(StateMirror::PRESENT | StateMirror::LOADED), state.flags);
+
+        vector<string> expected = {
+            "0|LIGHT|Kitchen light|on|0.00|1.00,40.00,-,-,-",
+            "3|SPEAKER|Den speaker|off|0.00|0.00,-,25.00,0.00,-",
+        };
+        CHECK(dumpLines(MIRROR_NAME) == expected);
+
+        // A home that died mid-write leaves the sequence odd
+        view.record(0).sequence.fetch_add(1);
+        CHECK(StateMirror::read(view.record(0), state) == StateMirror::ReadResult::Unreadable);
+        expected = {
+            "0|unreadable",
+            "3|SPEAKER|Den speaker|off|0.00|0.00,-,25.00,0.00,-",
+            "1 records were left half-written; the home may have died while updating them.",
+        };
+        CHECK(dumpLines(MIRROR_NAME) == expected);
+
+        // Once the write completes the record reads again
+        view.record(0).sequence.fetch_add(1);
+        CHECK(StateMirror::read(view.record(0), state) == StateMirror::ReadResult::Device);
+        mirror.remove(3);
+        CHECK(StateMirror::read(view.record(3), state) == StateMirror::ReadResult::Empty);
+    }
+
+    // Closing the mirror removes its name
+    ostringstream out;
+    string error;
+    CHECK(!StateMirror::dump(MIRROR_NAME, out, error));
+    CHECK_EQUAL(string("no state mirror named /") + MIRROR_NAME, error);
+}
+#endif
@@ -0,0 +1,65 @@
+#include "StoreFixture.h"
+#include "../SmartHome.h"
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <chrono>
+
+using namespace std;
+
+const char* const StoreFixture::TYPES[] = { "LIGHT", "THERMOSTAT", "PLUG", "TEMP_HUMIDITY", "SPEAKER", "RADIATOR" };
+const int StoreFixture::TYPE_COUNT = sizeof(TYPES) / sizeof(TYPES[0]);
+
+// Adds the devices to an empty home, which saves them in segments when it is destroyed.
+void StoreFixture::writeStore(int deviceCount) {
+    SmartHome home;
+    for (int i = 0; i < deviceCount; ++i) {
+        home.executeCommand(string("add|") + TYPES[i % TYPE_COUNT] + "|" + deviceName(i));
+    }
+}
+
+// Returns the name writeStore() gives the device at index.
+string StoreFixture::deviceName(int index) {
+    return "Device " + to_string(index);
+}
+
+// Returns the segment files the manifest lists.
+vector<string> StoreFixture::segmentFiles() {
+    vector<string> files;
+    ifstream manifest("smart_home.txt");
+    string line;
+    while (getline(manifest, line)) {
+        if (line.compare(0, 8, "SEGMENT|") == 0) {
+            files.push_back(line.substr(8));
+        }
+    }
+    return files;
+}
+
+// Returns the contents of a file, or "" if it cannot be read.
+string StoreFixture::readFile(const string& fileName) {
+    ifstream file(fileName, ios::binary);
+    ostringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+// Moves the files' modification time an hour back, so a file written afterwards is newer.
+void StoreFixture::backdate(const vector<string>& fileNames) {
+    auto past = filesystem::file_time_type::clock::now() - chrono::hours(1);
+    for (const string& fileName : fileNames) {
+        filesystem::last_write_time(fileName, past);
+    }
+}
+
+// Returns the files written since backdate() was called on them.
+vector<string> StoreFixture::rewritten(const vector<string>& fileNames) {
+    auto cutoff = filesystem::file_time_type::clock::now() - chrono::minutes(30);
+    vector<string> written;
+    for (const string& fileName : fileNames) {
+        if (filesystem::last_write_time(fileName) > cutoff) {
+            written.push_back(fileName);
+        }
+    }
+    return written;
+}
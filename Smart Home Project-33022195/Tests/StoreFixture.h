@@ -0,0 +1,19 @@
+#pragma once
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Builds device stores in the current directory for tests that load a whole SmartHome.
+class StoreFixture {
+public:
+    static const char* const TYPES[];           // Tags of the types writeStore() cycles through
+    static const int TYPE_COUNT;
+
+    static void writeStore(int deviceCount);    // Saves "Device 0", "Device 1", ... cycling through TYPES
+    static string deviceName(int index);
+    static vector<string> segmentFiles();       // From the manifest, in segment order
+    static string readFile(const string& fileName);
+    static void backdate(const vector<string>& fileNames);   // Sets their modification time an hour back
+    static vector<string> rewritten(const vector<string>& fileNames);   // Those written since backdate()
+};
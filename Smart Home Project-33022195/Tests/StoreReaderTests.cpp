@@ -0,0 +1,173 @@
+#include "TestRunner.h"
+#include "../StoreReader.h"
+#include "../HomeImage.h"
+#include "../DeviceRegistry.h"
+#include "../WorkStealingPool.h"
+#include <sstream>
+#include <memory>
+
+using namespace std;
+
+static const size_t MIN_CHUNK_SIZE = 1 << 20;  // As in StoreReader
+static const size_t THREADS = 4;
+static const int DEVICE_COUNT = 12000;         // Over 4 MB, so one thread and THREADS cut it into different chunks
+static const char* const TYPES[] = { "LIGHT", "THERMOSTAT", "PLUG", "TEMP_HUMIDITY", "SPEAKER", "RADIATOR" };
+
+// Helper function: Creates devices of every type with long names, a room, tags on every other
+// one and a schedule on those that take one.
+static vector<unique_ptr<SmartDevice>> makeDevices() {
+    vector<unique_ptr<SmartDevice>> devices;
+    for (int i = 0; i < DEVICE_COUNT; ++i) {
+        unique_ptr<SmartDevice> device = DeviceRegistry::create(TYPES[i % 6]);
+        device->setName("Device " + to_string(i) + " " + string(200, 'n'));
+        device->setRoom("Room " + to_string(i % 40) + " " + string(120, 'r'));
+        if (i % 2) device->setTags("tag" + to_string(i % 7) + ",tag" + to_string(i % 11));
+        device->addSchedule(i % 24, i % 60, true);
+        device->addSchedule((i + 12) % 24, 0, false);
+        devices.push_back(move(device));
+    }
+    return devices;
+}
+
+// Helper function: Writes the devices as one store file keyed by position, as checkpoints do:
+// every record first, then the schedule and attribute lines.
+static string keyedStore(const vector<unique_ptr<SmartDevice>>& devices) {
+    HomeImage::Segment segment;
+    for (const auto& device : devices) {
+        segment.devices.push_back(HomeImage::Device::capture(*device));
+    }
+    ostringstream out;
+    HomeImage::writeSegment(segment, out);
+    return out.str();
+}
+
+// Helper function: Writes the devices as older versions did: each record followed by its
+// schedule and attribute lines, keyed by the device name.
+static string namedStore(const vector<unique_ptr<SmartDevice>>& devices) {
+    string text;
+    for (const auto& device : devices) {
+        text += device->serialize() + "\n";
+        istringstream schedules(device->getSchedules());
+        string line;
+        while (getline(schedules, line)) {
+            text += device->getName() + "|" + line + "\n";
+        }
+        text += "@" + device->getName() + "|" + device->getRoom() + "|" + device->getTagList() + "\n";
+    }
+    return text;
+}
+
+// Helper function: Returns the offsets where StoreReader::parse() cuts the text into chunks
+// for a pool of the given size, before it moves each cut on to the next newline.
+static vector<size_t> chunkCuts(const string& text, size_t threads) {
+    size_t chunkSize = max(MIN_CHUNK_SIZE, text.size() / (threads * 4) + 1);
+    vector<size_t> cuts;
+    size_t pos = 0;
+    while (pos + chunkSize < text.size()) {
+        cuts.push_back(pos + chunkSize);
+        size_t newline = text.find('\n', pos + chunkSize);
+        pos = newline == string::npos ? text.size() : newline + 1;
+    }
+    return cuts;
+}
+
+// Helper function: Returns the line of text containing offset.
+static string lineAt(const string& text, size_t offset) {
+    size_t start = text.rfind('\n', offset - 1);
+    start = start == string::npos ? 0 : start + 1;
+    return text.substr(start, text.find('\n', offset) - start);
+}
+
+// Helper function: Returns true if a line is a device record rather than a schedule or attribute line.
+static bool isRecord(const string& line) {
+    return DeviceRegistry::create(line.substr(0, line.find('|'))) != nullptr;
+}
+
+// Helper function: Describes a device's full loaded state.
+static string describe(const SmartDevice& device) {
+    string text = device.serialize() + "\n" + device.getRoom() + "|" + device.getTagList() + "\n";
+    for (const string& line : device.getScheduleLines()) {
+        text += line + "\n";
+    }
+    return text;
+}
+
+// Helper function: Parses text with one thread and with THREADS, and checks both give the
+// original devices in their original order.
+static void checkSameWithAnyThreadCount(const string& text, const vector<unique_ptr<SmartDevice>>& original) {
+    WorkStealingPool single(1);
+    WorkStealingPool several(THREADS);
+    CHECK_EQUAL(THREADS, several.getThreadCount());
+    vector<unique_ptr<SmartDevice>> one = StoreReader::parse(text.data(), text.size(), false, single);
+    vector<unique_ptr<SmartDevice>> many = StoreReader::parse(text.data(), text.size(), false, several);
+    CHECK_EQUAL(original.size(), one.size());
+    CHECK_EQUAL(original.size(), many.size());
+    if (one.size() != original.size() || many.size() != original.size()) return;
+
+    size_t mismatched = 0;
+    for (size_t i = 0; i < original.size(); ++i) {
+        string expected = describe(*original[i]);
+        if (describe(*one[i]) != expected || describe(*many[i]) != expected) ++mismatched;
+    }
+    CHECK_EQUAL(size_t(0), mismatched);
+}
+
+TEST(StoreReader_keyedStoreParsesTheSameOnAnyThreadCount) {
+    vector<unique_ptr<SmartDevice>> devices = makeDevices();
+    string text = keyedStore(devices);
+
+    // The cuts fall inside record lines, and inside the keyed lines after them, whose devices
+    // were parsed in earlier chunks
+    bool inRecord = false, inKeyedLine = false;
+    for (size_t threads : { size_t(1), THREADS }) {
+        for (size_t cut : chunkCuts(text, threads)) {
+            if (text[cut - 1] == '\n') continue;
+            string line = lineAt(text, cut);
+            inRecord = inRecord || isRecord(line);
+            inKeyedLine = inKeyedLine || line[0] == '|' || line[0] == '@';
+        }
+    }
+    CHECK(inRecord);
+    CHECK(inKeyedLine);
+    CHECK(chunkCuts(text, 1) != chunkCuts(text, THREADS));
+
+    checkSameWithAnyThreadCount(text, devices);
+}
+
+TEST(StoreReader_namedStoreParsesTheSameOnAnyThreadCount) {
+    vector<unique_ptr<SmartDevice>> devices = makeDevices();
+    string text = namedStore(devices);
+
+    // Some chunk ends with a record whose schedule or attribute lines start the next chunk
+    bool splitFromItsLines = false;
+    for (size_t threads : { size_t(1), THREADS }) {
+        for (size_t cut : chunkCuts(text, threads)) {
+            size_t split = text.find('\n', cut) + 1;
+            if (split < text.size() && isRecord(lineAt(text, cut)) && !isRecord(lineAt(text, split))) {
+                splitFromItsLines = true;
+            }
+        }
+    }
+    CHECK(splitFromItsLines);
+
+    checkSameWithAnyThreadCount(text, devices);
+}
+
+TEST(StoreReader_lazyParseKeepsRecordsAndSchedules) {
+    vector<unique_ptr<SmartDevice>> devices = makeDevices();
+    string text = keyedStore(devices);
+    WorkStealingPool pool(THREADS);
+    vector<unique_ptr<SmartDevice>> parsed = StoreReader::parse(text.data(), text.size(), true, pool);
+    CHECK_EQUAL(devices.size(), parsed.size());
+    if (parsed.size() != devices.size()) return;
+
+    size_t mismatched = 0;
+    for (size_t i = 0; i < devices.size(); ++i) {
+        if (parsed[i]->isHydrated() || parsed[i]->getName() != devices[i]->getName()
+            || parsed[i]->getRecord() != devices[i]->getRecord() || parsed[i]->getSchedules() != devices[i]->getSchedules()
+            || parsed[i]->getRoom() != devices[i]->getRoom()) {
+            ++mismatched;
+        }
+    }
+    CHECK_EQUAL(size_t(0), mismatched);
+}
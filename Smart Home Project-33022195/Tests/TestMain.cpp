@@ -0,0 +1,14 @@
+#include "TestRunner.h"
+#include "../VirtualClock.h"
+#include <string>
+#include <memory>
+
+using namespace std;
+
+// Runs the unit tests: all of them, or those whose names contain the first argument.
+// The virtual clock is installed first, so behaviors only run when a test advances time.
+int main(int argc, char* argv[]) {
+    Clock::install(make_unique<VirtualClock>());
+    string filter = argc > 1 ? argv[1] : "";
+    return TestRunner::runAll(filter) == 0 ? 0 : 1;
+}
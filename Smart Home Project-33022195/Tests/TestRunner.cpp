@@ -0,0 +1,62 @@
+#include "TestRunner.h"
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <system_error>
+
+using namespace std;
+
+static int failedChecks = 0;   // Failed checks in the test being run
+
+// Returns the registered tests. A function-local static, so tests in any file can register
+// themselves during static initialization.
+vector<TestRunner::Test>& TestRunner::tests() {
+    static vector<Test> registered;
+    return registered;
+}
+
+// Registers a test. Returns true, so TEST() can run it from a static initializer.
+bool TestRunner::add(const char* name, TestBody body) {
+    tests().push_back({ name, body });
+    return true;
+}
+
+// Records the result of a check, printing where it failed.
+void TestRunner::check(bool passed, const string& expression, const char* file, int line) {
+    if (passed) return;
+    ++failedChecks;
+    cout << "  " << filesystem::path(file).filename().string() << ":" << line << ": failed: " << expression << "\n";
+}
+
+// Runs the matching tests and prints a line per test and a summary.
+// Each test starts in an empty scratch directory of its own, since some write store or history files.
+// Files a test leaves open (the event log and console writer live until exit) are left behind
+// rather than failing the run, so cleanup errors are ignored.
+int TestRunner::runAll(const string& filter) {
+    filesystem::path scratch = filesystem::temp_directory_path() / "smart_home_tests";
+    filesystem::path home = filesystem::current_path();
+    error_code ignored;
+    filesystem::remove_all(scratch, ignored);
+    int failedTests = 0;
+    int run = 0;
+    for (const Test& test : tests()) {
+        if (string(test.name).find(filter) == string::npos) continue;
+        filesystem::path directory = scratch / test.name;
+        filesystem::create_directories(directory);
+        filesystem::current_path(directory);
+
+        failedChecks = 0;
+        auto start = chrono::steady_clock::now();
+        test.body();
+        double milliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        cout << (failedChecks ? "FAIL " : "ok   ") << test.name << " (" << milliseconds << " ms)\n";
+        failedTests += failedChecks ? 1 : 0;
+        ++run;
+
+        filesystem::current_path(home);
+        filesystem::remove_all(directory, ignored);
+    }
+    filesystem::remove_all(scratch, ignored);
+    cout << run - failedTests << " of " << run << " tests passed.\n";
+    return failedTests;
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <sstream>
+
+using namespace std;
+
+// Runs the unit tests registered with TEST(); a test fails if any of its CHECKs fails.
+// Tests run one at a time in the order they were registered, in a scratch directory of their own.
+class TestRunner {
+public:
+    using TestBody = void (*)();
+
+    static bool add(const char* name, TestBody body);
+    static void check(bool passed, const string& expression, const char* file, int line);
+    static int runAll(const string& filter);   // Runs the tests whose names contain filter; returns the failures
+
+private:
+    struct Test {
+        const char* name;
+        TestBody body;
+    };
+
+    static vector<Test>& tests();
+};
+
+// Helper function: Formats a value for a failed CHECK_EQUAL.
+template <typename T>
+string describe(const T& value) {
+    ostringstream out;
+    out << value;
+    return out.str();
+}
+
+#define TEST(name) \
+    static void name(); \
+    static const bool name##Registered = TestRunner::add(#name, name); \
+    static void name()
+
+#define CHECK(expression) TestRunner::check((expression), #expression, __FILE__, __LINE__)
+
+#define CHECK_EQUAL(expected, actual) \
+    do { \
+        const auto checkedExpected = (expected); \
+        const auto checkedActual = (actual); \
+        TestRunner::check(checkedExpected == checkedActual, string(#actual " == " #expected " (got ") \
+            + describe(checkedActual) + ", expected " + describe(checkedExpected) + ")", __FILE__, __LINE__); \
+    } while (false)
@@ -0,0 +1,70 @@
+#include "TestRunner.h"
+#include "../WorkStealingPool.h"
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+static const size_t THREAD_COUNTS[] = { 1, 2, 4, 8 };
+
+// Helper function: Returns true if every counter is exactly one.
+static bool allOnce(const vector<atomic<int>>& counters) {
+    return all_of(counters.begin(), counters.end(), [](const atomic<int>& count) { return count == 1; });
+}
+
+TEST(WorkStealingPool_runsEveryIndexOnce) {
+    for (size_t threads : THREAD_COUNTS) {
+        WorkStealingPool pool(threads);
+        CHECK_EQUAL(threads, pool.getThreadCount());
+        for (size_t count : { size_t(1), size_t(7), size_t(1000), size_t(100003) }) {
+            for (size_t grain : { size_t(1), size_t(64), size_t(5000) }) {
+                vector<atomic<int>> hits(count);
+                atomic<bool> inRange(true);
+                pool.parallelFor(count, grain, [&](size_t begin, size_t end) {
+                    if (begin >= end || end > count) inRange = false;
+                    for (size_t i = begin; i < end; ++i) ++hits[i];
+                });
+                CHECK(inRange);
+                CHECK(allOnce(hits));
+            }
+        }
+        pool.parallelFor(0, 1, [](size_t, size_t) {});
+    }
+}
+
+TEST(WorkStealingPool_nestedPasses) {
+    for (size_t threads : THREAD_COUNTS) {
+        WorkStealingPool pool(threads);
+        const size_t OUTER = 64;
+        const size_t INNER = 2000;
+        vector<atomic<int>> hits(OUTER * INNER);
+        pool.parallelFor(OUTER, 1, [&](size_t begin, size_t end) {
+            for (size_t outer = begin; outer < end; ++outer) {
+                pool.parallelFor(INNER, 50, [&](size_t innerBegin, size_t innerEnd) {
+                    for (size_t inner = innerBegin; inner < innerEnd; ++inner) ++hits[outer * INNER + inner];
+                });
+            }
+        });
+        CHECK(allOnce(hits));
+    }
+}
+
+TEST(WorkStealingPool_parallelSortMatchesSort) {
+    mt19937 random(42);
+    for (size_t threads : THREAD_COUNTS) {
+        WorkStealingPool pool(threads);
+        for (size_t count : { size_t(0), size_t(10), size_t(5000), size_t(200000) }) {
+            vector<uint32_t> values(count);
+            for (uint32_t& value : values) value = random() % 50000;   // Plenty of equal keys
+            vector<uint32_t> expected = values;
+            sort(expected.begin(), expected.end());
+            pool.parallelSort(values.begin(), values.end(), less<uint32_t>());
+            CHECK(values == expected);
+
+            pool.parallelSort(values.begin(), values.end(), greater<uint32_t>());
+            CHECK(is_sorted(values.begin(), values.end(), greater<uint32_t>()));
+        }
+    }
+}
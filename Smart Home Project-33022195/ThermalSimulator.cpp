@@ -0,0 +1,206 @@
+#include "ThermalSimulator.h"
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+// Adds a zone (a room) heated towards the given target temperature. Returns its index.
+// Zones start the run at their target temperature.
+int ThermalSimulator::addZone(const string& name, float targetTemperature) {
+    names.push_back(name);
+    temperature.push_back(targetTemperature);
+    target.push_back(targetTemperature);
+    comfort.push_back(targetTemperature - 1.0f);
+    power.push_back(0.0f);
+    minTemperature.push_back(targetTemperature);
+    dayEnergy.push_back(0.0f);
+    dayCold.push_back(0.0f);
+    dayTemperature.push_back(0.0f);
+    energyUsed.push_back(0.0);
+    coldSteps.push_back(0.0);
+    temperatureSum.push_back(0.0);
+    openValves.push_back(0);
+    thermostats.push_back(0);
+    callingThermostats.push_back(0);
+    return static_cast<int>(names.size() - 1);
+}
+
+// Adds a radiator valve to a zone. An open valve heats the zone while it is below target.
+void ThermalSimulator::addRadiator(int zone, bool isOn, const vector<pair<int, bool>>& transitions) {
+    addDevice(zone, false, isOn, transitions);
+}
+
+// Adds a thermostat to a zone. A zone with thermostats only heats while one of them calls for heat.
+void ThermalSimulator::addThermostat(int zone, bool isOn, const vector<pair<int, bool>>& transitions) {
+    addDevice(zone, true, isOn, transitions);
+}
+
+// Records a device's state over the day as switch events.
+// A device without schedules keeps its current state. With schedules the day repeats: the state
+// at midnight is the one left by the last transition of the previous day.
+void ThermalSimulator::addDevice(int zone, bool thermostat, bool isOn, const vector<pair<int, bool>>& transitions) {
+    bool state = transitions.empty() ? isOn : transitions.back().second;
+    if (thermostat) {
+        ++thermostats[zone];
+        callingThermostats[zone] += state ? 1 : 0;
+    }
+    else {
+        openValves[zone] += state ? 1 : 0;
+    }
+
+    for (const auto& transition : transitions) {
+        if (transition.second == state) continue;
+        state = transition.second;
+        events.push_back({ transition.first, zone, thermostat, state ? 1 : -1 });
+    }
+}
+
+// Loads an hourly outdoor temperature profile, one value in C per line.
+// The profile repeats if it is shorter than the run. Returns false if no value could be read.
+bool ThermalSimulator::loadOutdoorProfile(const string& fileName) {
+    ifstream file(fileName);
+    vector<float> profile;
+    float value;
+    while (file >> value) {
+        profile.push_back(value);
+    }
+    if (profile.empty()) return false;
+    outdoor = move(profile);
+    return true;
+}
+
+// Returns the outdoor temperature for an hour of the run.
+// Without a loaded profile a typical temperate climate is used: 10C on average, coldest in
+// mid-January and at 4am, with 7C of seasonal and 4C of daily swing.
+float ThermalSimulator::outdoorAt(int hour) const {
+    if (!outdoor.empty()) {
+        return outdoor[static_cast<size_t>(hour) % outdoor.size()];
+    }
+    const double pi = 3.14159265358979323846;
+    double day = hour / 24.0;
+    return static_cast<float>(10.0 - 7.0 * cos(2.0 * pi * (day - 15.0) / 365.0)
+        - 4.0 * cos(2.0 * pi * ((hour % 24) - 4) / 24.0));
+}
+
+// Applies a switch event to its zone and recomputes the heating power available there.
+void ThermalSimulator::applyEvent(const Event& event) {
+    int zone = event.zone;
+    if (event.thermostat) {
+        callingThermostats[zone] += event.change;
+    }
+    else {
+        openValves[zone] += event.change;
+    }
+    bool allowed = thermostats[zone] == 0 || callingThermostats[zone] > 0;
+    power[zone] = allowed ? openValves[zone] * RADIATOR_POWER : 0.0f;
+}
+
+// Helper function: Advances LANES zones by one step of dtHours.
+// Every zone gets the same branch-free arithmetic over its own array entries, and the count is
+// fixed, so the compiler turns the loop into SIMD instructions without a scalar remainder loop.
+static inline void stepLanes(float* __restrict t, float* __restrict minimum, float* __restrict energy,
+    float* __restrict cold, float* __restrict sum, const float* __restrict goal, const float* __restrict low,
+    const float* __restrict available, float outdoorTemperature, float rate, float dtHours) {
+    for (size_t i = 0; i < ThermalSimulator::LANES; ++i) {
+        float current = t[i];
+        float supply = available[i];
+        float heat = current < goal[i] ? supply : 0.0f;
+        float next = current + rate * (heat - ThermalSimulator::HEAT_LOSS * (current - outdoorTemperature));
+        t[i] = next;
+        energy[i] += heat * dtHours;
+        cold[i] += next < low[i] ? 1.0f : 0.0f;
+        minimum[i] = min(next, minimum[i]);
+        sum[i] += next;
+    }
+}
+
+// Advances the zones in [begin, end) by one step of dtHours, LANES zones at a time
+// (the arrays are padded to a multiple of LANES). Sums are kept in float for the day only.
+void ThermalSimulator::step(size_t begin, size_t end, float outdoorTemperature, float dtHours) {
+    const float rate = dtHours / HEAT_CAPACITY;
+    for (size_t i = begin; i < end; i += LANES) {
+        stepLanes(&temperature[i], &minTemperature[i], &dayEnergy[i], &dayCold[i], &dayTemperature[i],
+            &target[i], &comfort[i], &power[i], outdoorTemperature, rate, dtHours);
+    }
+}
+
+// Simulates the zones in [begin, end) for the whole run.
+// Events are applied at the first step starting at or after their minute; only the block's own
+// zones are touched, so blocks run in parallel without sharing any state.
+void ThermalSimulator::simulateBlock(size_t begin, size_t end, int days, int stepSeconds) {
+    const int stepsPerDay = 86400 / stepSeconds;
+    const float dtHours = stepSeconds / 3600.0f;
+
+    for (int day = 0; day < days; ++day) {
+        size_t next = 0;
+        for (int s = 0; s < stepsPerDay; ++s) {
+            int second = s * stepSeconds;
+            for (; next < events.size() && events[next].minute * 60 <= second; ++next) {
+                size_t zone = static_cast<size_t>(events[next].zone);
+                if (zone >= begin && zone < end) applyEvent(events[next]);
+            }
+            step(begin, end, outdoorAt(day * 24 + second / 3600), dtHours);
+        }
+        // Events after the last step of the day still count for the next day
+        for (; next < events.size(); ++next) {
+            size_t zone = static_cast<size_t>(events[next].zone);
+            if (zone >= begin && zone < end) applyEvent(events[next]);
+        }
+
+        for (size_t i = begin; i < min(end, names.size()); ++i) {
+            energyUsed[i] += dayEnergy[i];
+            coldSteps[i] += dayCold[i];
+            temperatureSum[i] += dayTemperature[i];
+            dayEnergy[i] = dayCold[i] = dayTemperature[i] = 0.0f;
+        }
+    }
+}
+
+// Runs the simulation for a number of days with a fixed step.
+// The step must divide a day and be at most an hour, so outdoor hours and days line up with steps.
+// Zones are split into blocks that are simulated in parallel on the pool. Returns false for invalid arguments.
+bool ThermalSimulator::run(int days, int stepSeconds, WorkStealingPool& pool) {
+    if (days <= 0 || stepSeconds <= 0 || stepSeconds > 3600 || 86400 % stepSeconds != 0) return false;
+
+    stable_sort(events.begin(), events.end(),
+        [](const Event& a, const Event& b) { return a.minute < b.minute; });
+
+    // Padding zones never heat and are left out of the results
+    size_t padded = (names.size() + LANES - 1) / LANES * LANES;
+    for (vector<float>* column : { &temperature, &target, &comfort, &power, &minTemperature, &dayEnergy, &dayCold, &dayTemperature }) {
+        column->resize(padded, 0.0f);
+    }
+    for (size_t zone = 0; zone < names.size(); ++zone) {
+        bool allowed = thermostats[zone] == 0 || callingThermostats[zone] > 0;
+        power[zone] = allowed ? openValves[zone] * RADIATOR_POWER : 0.0f;
+    }
+
+    size_t blockCount = (padded + BLOCK_ZONES - 1) / BLOCK_ZONES;
+    pool.parallelFor(blockCount, 1, [&](size_t first, size_t last) {
+        for (size_t block = first; block < last; ++block) {
+            size_t begin = block * BLOCK_ZONES;
+            simulateBlock(begin, min(begin + BLOCK_ZONES, padded), days, stepSeconds);
+        }
+    });
+
+    simulatedSteps += static_cast<double>(days) * (86400 / stepSeconds);
+    stepHours = stepSeconds / 3600.0;
+    return true;
+}
+
+// Returns each zone's totals for the run.
+vector<ThermalSimulator::ZoneResult> ThermalSimulator::getResults() const {
+    vector<ZoneResult> results;
+    results.reserve(names.size());
+    for (size_t i = 0; i < names.size(); ++i) {
+        float mean = simulatedSteps > 0 ? static_cast<float>(temperatureSum[i] / simulatedSteps) : temperature[i];
+        results.push_back({ names[i], energyUsed[i], coldSteps[i] * stepHours, minTemperature[i], mean });
+    }
+    return results;
+}
+
+// Returns the number of zones.
+size_t ThermalSimulator::getZoneCount() const {
+    return names.size();
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <utility>
+#include "WorkStealingPool.h"
+
+using namespace std;
+
+class ThermalSimulator {
+public:
+    struct ZoneResult {
+        string name;
+        double energyUsed;        // kWh delivered by the zone's radiators
+        double coldHours;         // Hours spent more than 1C below target
+        float minTemperature;
+        float meanTemperature;
+    };
+
+    // Zone parameters used for every zone
+    static constexpr float HEAT_CAPACITY = 1.0f;   // kWh per C
+    static constexpr float HEAT_LOSS = 0.1f;       // kW per C of indoor/outdoor difference
+    static constexpr float RADIATOR_POWER = 1.5f;  // kW per open radiator valve
+    static const size_t LANES = 8;                 // Zones updated together by SIMD instructions
+
+    int addZone(const string& name, float targetTemperature);
+    void addRadiator(int zone, bool isOn, const vector<pair<int, bool>>& transitions);
+    void addThermostat(int zone, bool isOn, const vector<pair<int, bool>>& transitions);
+    bool loadOutdoorProfile(const string& fileName);
+    bool run(int days, int stepSeconds, WorkStealingPool& pool);
+    vector<ZoneResult> getResults() const;
+    size_t getZoneCount() const;
+
+private:
+    struct Event {
+        int minute;               // Minute of the day
+        int zone;
+        bool thermostat;          // Thermostat call for heat, or radiator valve
+        int change;               // +1 switches on, -1 switches off
+    };
+
+    // Zone state, one entry per zone in each array so the step loop runs over contiguous floats.
+    // The float arrays are padded to a multiple of LANES when a run starts.
+    vector<string> names;
+    vector<float> temperature;
+    vector<float> target;
+    vector<float> comfort;        // Target - 1C
+    vector<float> power;          // kW available right now: open valves, gated by the thermostats
+    vector<float> minTemperature;
+    vector<float> dayEnergy;      // Per-day float accumulators, folded into doubles once a day
+    vector<float> dayCold;
+    vector<float> dayTemperature;
+    vector<double> energyUsed;
+    vector<double> coldSteps;
+    vector<double> temperatureSum;
+
+    // Schedule bookkeeping, updated per event rather than per step
+    vector<int> openValves;
+    vector<int> thermostats;
+    vector<int> callingThermostats;
+    vector<Event> events;         // Sorted by minute when the run starts
+    vector<float> outdoor;        // Outdoor temperature for each hour, repeated if shorter than the run
+    double simulatedSteps = 0;
+    double stepHours = 0;
+
+    static const size_t BLOCK_ZONES = 1024;   // Zones simulated together by one pool task (a multiple of LANES)
+
+    void addDevice(int zone, bool thermostat, bool isOn, const vector<pair<int, bool>>& transitions);
+    void applyEvent(const Event& event);
+    void simulateBlock(size_t begin, size_t end, int days, int stepSeconds);
+    void step(size_t begin, size_t end, float outdoorTemperature, float dtHours);
+    float outdoorAt(int hour) const;
+};
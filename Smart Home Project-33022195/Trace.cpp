@@ -0,0 +1,170 @@
+#include "Trace.h"
+#include <chrono>
+#include <mutex>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+// A finished span, named "name detail"
+struct TraceSpan {
+    string name;
+    int64_t begin;
+    int64_t end;
+    int64_t count;       // -1: no count argument
+    int thread;
+};
+
+// The trace being collected. Created by Trace::start() before the home, so it is destroyed
+// (and the file written) after the home has saved its devices at exit.
+struct TraceFile {
+    string fileName;
+    int64_t origin = 0;
+    mutex lock;
+    vector<TraceSpan> spans;
+    vector<pair<int, string>> threadNames;
+    atomic<int> nextThread{ 0 };
+
+    ~TraceFile();
+};
+
+// Helper function: Returns the trace being collected.
+static TraceFile& traceFile() {
+    static TraceFile file;
+    return file;
+}
+
+// Helper function: Returns the calling thread's trace id, numbered in order of first use.
+static int threadId() {
+    thread_local int id = traceFile().nextThread.fetch_add(1);
+    return id;
+}
+
+// Helper function: Appends a string to JSON output as a quoted, escaped string.
+static void appendJson(string& out, const string& text) {
+    out += '"';
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        }
+        else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        }
+        else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Destructor: Writes the collected spans as a Chrome trace-event JSON file, times in microseconds
+// from the start of tracing.
+TraceFile::~TraceFile() {
+    if (fileName.empty()) return;
+    lock_guard<mutex> guard(lock);
+    string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    char number[64];
+    for (const auto& [thread, threadName] : threadNames) {
+        out += "{\"ph\":\"M\",\"pid\":1,\"tid\":" + to_string(thread) + ",\"name\":\"thread_name\",\"args\":{\"name\":";
+        appendJson(out, threadName);
+        out += "}},\n";
+    }
+    for (const TraceSpan& span : spans) {
+        out += "{\"ph\":\"X\",\"pid\":1,\"tid\":" + to_string(span.thread) + ",\"cat\":\"smarthome\",\"name\":";
+        appendJson(out, span.name);
+        snprintf(number, sizeof(number), ",\"ts\":%.3f,\"dur\":%.3f", (span.begin - origin) / 1000.0, (span.end - span.begin) / 1000.0);
+        out += number;
+        if (span.count >= 0) {
+            out += ",\"args\":{\"count\":" + to_string(span.count) + "}";
+        }
+        out += "},\n";
+    }
+    out += "{}]}\n";  // Empty last event, so every real one can end with a comma
+
+    ofstream file(fileName, ios::binary);
+    file << out;
+}
+
+// Turns tracing on; the trace is written to the file when the program exits.
+// Returns false if the file cannot be created.
+bool Trace::start(const string& fileName) {
+    if (!ofstream(fileName)) return false;
+    TraceFile& file = traceFile();
+    file.fileName = fileName;
+    file.origin = now();
+    enabled = true;
+    nameThread("main");
+    return true;
+}
+
+// Returns the time in nanoseconds on a steady clock.
+int64_t Trace::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Records a finished span on the calling thread, named "name detail".
+void Trace::complete(const char* name, const char* detail, int64_t begin, int64_t end, int64_t count) {
+    if (!isEnabled()) return;
+    string fullName = name;
+    if (detail && *detail) {
+        fullName += ' ';
+        fullName.append(detail, min<size_t>(strlen(detail), 80));
+    }
+    TraceFile& file = traceFile();
+    int thread = threadId();
+    lock_guard<mutex> guard(file.lock);
+    file.spans.push_back({ move(fullName), begin, end, count, thread });
+}
+
+// Names the calling thread in the trace viewer.
+void Trace::nameThread(const string& threadName) {
+    if (!isEnabled()) return;
+    TraceFile& file = traceFile();
+    int thread = threadId();
+    lock_guard<mutex> guard(file.lock);
+    file.threadNames.emplace_back(thread, threadName);
+}
+
+// Constructor: Notes the start time if tracing is on.
+TraceScope::TraceScope(const char* name, const char* detail)
+    : name(name), detail(detail), begin(Trace::isEnabled() ? Trace::now() : -1) {}
+
+// Destructor: Records the span.
+TraceScope::~TraceScope() {
+    if (begin >= 0) {
+        Trace::complete(name, detail, begin, Trace::now());
+    }
+}
+
+// Constructor: Notes the start time if tracing is on.
+TraceTally::TraceTally(const char* name)
+    : name(name), begin(Trace::isEnabled() ? Trace::now() : -1) {}
+
+// Destructor: Records one span per kind, laid end to end from the tally's start.
+TraceTally::~TraceTally() {
+    if (begin < 0) return;
+    int64_t at = begin;
+    for (const Kind& kind : kinds) {
+        Trace::complete(name, kind.kind, at, at + kind.total, kind.count);
+        at += kind.total;
+    }
+}
+
+// Adds the time since started to the given kind. Kinds are few, so a linear search is enough.
+void TraceTally::stop(const char* kind, int64_t started) {
+    if (begin < 0) return;
+    int64_t elapsed = Trace::now() - started;
+    for (Kind& entry : kinds) {
+        if (entry.kind == kind) {
+            entry.total += elapsed;
+            ++entry.count;
+            return;
+        }
+    }
+    kinds.push_back({ kind, elapsed, 1 });
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+using namespace std;
+
+// Opt-in tracing of startup, shutdown and command phases, written as Chrome trace-event JSON
+// (open it in chrome://tracing or ui.perfetto.dev). Tracing is off unless start() is called;
+// until then a TraceScope or TraceTally costs one relaxed load.
+class Trace {
+public:
+    static bool start(const string& fileName);   // Once, before the home is created; written at exit
+    static bool isEnabled() { return enabled.load(memory_order_relaxed); }
+    static int64_t now();                        // Nanoseconds on a steady clock
+    static void complete(const char* name, const char* detail, int64_t begin, int64_t end, int64_t count = -1);
+    static void nameThread(const string& threadName);
+
+private:
+    inline static atomic<bool> enabled{ false };
+};
+
+// Traces the enclosing block as one span, named "name detail".
+class TraceScope {
+public:
+    explicit TraceScope(const char* name, const char* detail = nullptr);
+    ~TraceScope();
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* name;
+    const char* detail;
+    int64_t begin;       // -1 when tracing is off
+};
+
+// Adds up time spent per kind of item (such as per device type) in a loop too fine-grained to
+// trace item by item. emit() shows each kind as one span, the kinds laid end to end from the
+// tally's start, with the number of items as an argument.
+class TraceTally {
+public:
+    explicit TraceTally(const char* name);
+    ~TraceTally();                               // Emits the spans
+    TraceTally(const TraceTally&) = delete;
+    TraceTally& operator=(const TraceTally&) = delete;
+
+    int64_t start() const { return begin < 0 ? 0 : Trace::now(); }
+    void stop(const char* kind, int64_t started);
+
+private:
+    struct Kind {
+        const char* kind;                        // Static string, compared by address
+        int64_t total;
+        int64_t count;
+    };
+
+    const char* name;
+    int64_t begin;                               // -1 when tracing is off
+    vector<Kind> kinds;
+};
@@ -0,0 +1,23 @@
+#include "VirtualClock.h"
+
+using namespace std;
+
+// Constructor: Starts the clock at the real current time, so timestamps stay meaningful.
+VirtualClock::VirtualClock() : ticks(chrono::system_clock::now().time_since_epoch().count()) {}
+
+// Returns the simulated time.
+Clock::TimePoint VirtualClock::now() const {
+    return TimePoint(Duration(ticks.load()));
+}
+
+// A virtual clock only moves when advanced.
+bool VirtualClock::isVirtual() const {
+    return true;
+}
+
+// Moves the clock forward to the given time. The clock never goes back.
+void VirtualClock::advanceTo(TimePoint time) {
+    Duration::rep target = time.time_since_epoch().count();
+    Duration::rep current = ticks.load();
+    while (current < target && !ticks.compare_exchange_weak(current, target)) {}
+}
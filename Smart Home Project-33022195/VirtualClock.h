@@ -0,0 +1,17 @@
+#pragma once
+#include "Clock.h"
+#include <atomic>
+
+using namespace std;
+
+class VirtualClock : public Clock {
+private:
+    atomic<Duration::rep> ticks;   // Time since the epoch, in system_clock ticks
+
+public:
+    VirtualClock();                // Starts at the real current time
+
+    TimePoint now() const override;
+    bool isVirtual() const override;
+    void advanceTo(TimePoint time);
+};
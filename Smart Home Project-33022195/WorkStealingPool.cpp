@@ -0,0 +1,130 @@
+#include "WorkStealingPool.h"
+#include "Trace.h"
+
+using namespace std;
+
+// Constructor: Starts the worker threads. The thread calling parallelFor() works too, so a pool
+// for n threads starts n - 1 workers; on a single core it runs everything on the caller.
+WorkStealingPool::WorkStealingPool(size_t threadCount) : queuedJobs(0), stopping(false) {
+    if (threadCount == 0) {
+        threadCount = max(1u, thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < threadCount; ++i) {
+        queues.push_back(make_unique<Queue>());  // The last queue is for calling threads
+    }
+    for (size_t i = 0; i + 1 < threadCount; ++i) {
+        workers.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+// Destructor: Stops the workers once they are idle.
+WorkStealingPool::~WorkStealingPool() {
+    {
+        lock_guard<mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workQueued.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+// Returns the number of threads that run a parallel pass, counting the caller.
+size_t WorkStealingPool::getThreadCount() const {
+    return queues.size();
+}
+
+// Runs body over [0, count) in ranges of at most grain indexes, in parallel, and returns once
+// every index is done. Each index is given to exactly one thread, so a pass over devices (or over
+// store segments, which own their devices) never has two threads working on the same device.
+// The range is dealt out as one contiguous piece per thread, so each thread starts on a range of
+// its own; a thread that runs out of work steals the largest piece left in another's queue.
+// The body must not throw. Passes may be nested: a thread waiting for a pass helps run it.
+void WorkStealingPool::parallelFor(size_t count, size_t grain, const RangeBody& body) {
+    if (count == 0) return;
+    grain = max<size_t>(1, grain);
+    if (count <= grain || queues.size() == 1) {
+        body(0, count);
+        return;
+    }
+
+    Pass pass{ &body, count };
+    size_t caller = queues.size() - 1;
+    size_t pieces = min(queues.size(), (count + grain - 1) / grain);
+    for (size_t i = 1; i < pieces; ++i) {
+        push(i - 1, { &pass, count * i / pieces, count * (i + 1) / pieces, grain });
+    }
+    run(caller, { &pass, 0, count / pieces, grain });  // The caller's own piece
+
+    while (pass.remaining > 0) {
+        if (!runOne(caller)) {
+            this_thread::yield();  // The last pieces are running on other threads
+        }
+    }
+}
+
+// Adds a job to a queue and wakes a sleeping worker.
+void WorkStealingPool::push(size_t queue, const Job& job) {
+    {
+        lock_guard<mutex> lock(queues[queue]->lock);
+        queues[queue]->jobs.push_back(job);
+    }
+    ++queuedJobs;
+    {
+        lock_guard<mutex> lock(sleepMutex);  // Pairs with the check in workerLoop(), so no wake-up is lost
+    }
+    workQueued.notify_one();
+}
+
+// Runs one job: the newest from the thread's own queue, or else the oldest (and so largest)
+// from another queue. Returns false if every queue was empty.
+bool WorkStealingPool::runOne(size_t self) {
+    Job job;
+    bool found = false;
+    {
+        lock_guard<mutex> lock(queues[self]->lock);
+        if (!queues[self]->jobs.empty()) {
+            job = queues[self]->jobs.back();
+            queues[self]->jobs.pop_back();
+            found = true;
+        }
+    }
+    for (size_t offset = 1; !found && offset < queues.size(); ++offset) {
+        Queue& victim = *queues[(self + offset) % queues.size()];
+        lock_guard<mutex> lock(victim.lock);
+        if (!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            found = true;
+        }
+    }
+    if (!found) return false;
+
+    --queuedJobs;
+    run(self, job);
+    return true;
+}
+
+// Runs a job, first splitting off its upper halves into the thread's queue until it is no larger
+// than the grain, so other threads can steal them.
+void WorkStealingPool::run(size_t self, Job job) {
+    while (job.end - job.begin > job.grain) {
+        size_t middle = job.begin + (job.end - job.begin) / 2;
+        push(self, { job.pass, middle, job.end, job.grain });
+        job.end = middle;
+    }
+    (*job.pass->body)(job.begin, job.end);
+    job.pass->remaining -= job.end - job.begin;  // The pass may end (and its caller return) here
+}
+
+// Worker thread: runs jobs while there are any and sleeps otherwise.
+void WorkStealingPool::workerLoop(size_t self) {
+    Trace::nameThread("worker " + to_string(self + 1));
+    while (true) {
+        if (runOne(self)) continue;
+
+        unique_lock<mutex> lock(sleepMutex);
+        workQueued.wait(lock, [this]() { return stopping || queuedJobs > 0; });
+        if (stopping) return;
+    }
+}
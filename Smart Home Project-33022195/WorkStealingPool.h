@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+
+using namespace std;
+
+class WorkStealingPool {
+public:
+    using RangeBody = function<void(size_t begin, size_t end)>;
+
+    explicit WorkStealingPool(size_t threadCount = 0);   // 0: one thread per core, counting the caller
+    ~WorkStealingPool();
+
+    size_t getThreadCount() const;                       // Workers plus the calling thread
+    void parallelFor(size_t count, size_t grain, const RangeBody& body);
+
+    // Sorts [first, last) with the pool: slices are sorted in parallel, then merged pairwise.
+    template <typename Iterator, typename Compare>
+    void parallelSort(Iterator first, Iterator last, Compare compare);
+
+private:
+    struct Pass {
+        const RangeBody* body;
+        atomic<size_t> remaining;        // Indexes not yet processed
+    };
+
+    struct Job {
+        Pass* pass;
+        size_t begin;
+        size_t end;
+        size_t grain;
+    };
+
+    struct Queue {
+        mutex lock;
+        deque<Job> jobs;                 // The owner works at the back, thieves take from the front
+    };
+
+    vector<unique_ptr<Queue>> queues;    // One per worker, then one shared by calling threads
+    vector<thread> workers;
+    atomic<size_t> queuedJobs;
+    mutex sleepMutex;
+    condition_variable workQueued;
+    bool stopping;
+
+    void push(size_t queue, const Job& job);
+    bool runOne(size_t self);
+    void run(size_t self, Job job);
+    void workerLoop(size_t self);
+};
+
+// Sorts slices of the range in parallel, then merges neighbouring slices in rounds, each round's
+// merges running in parallel. Every element belongs to exactly one slice or merge at a time.
+template <typename Iterator, typename Compare>
+void WorkStealingPool::parallelSort(Iterator first, Iterator last, Compare compare) {
+    size_t count = static_cast<size_t>(last - first);
+    size_t slices = min(getThreadCount() * 2, max<size_t>(1, count / 4096));
+    if (slices <= 1) {
+        sort(first, last, compare);
+        return;
+    }
+
+    vector<size_t> bounds;
+    for (size_t i = 0; i <= slices; ++i) {
+        bounds.push_back(count * i / slices);
+    }
+    parallelFor(slices, 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            sort(first + bounds[i], first + bounds[i + 1], compare);
+        }
+    });
+
+    for (size_t width = 1; width < slices; width *= 2) {
+        size_t merges = (slices + 2 * width - 1) / (2 * width);
+        parallelFor(merges, 1, [&](size_t begin, size_t end) {
+            for (size_t m = begin; m < end; ++m) {
+                size_t low = m * 2 * width;
+                size_t middle = min(low + width, slices);
+                size_t high = min(low + 2 * width, slices);
+                if (middle < high) {
+                    inplace_merge(first + bounds[low], first + bounds[middle], first + bounds[high], compare);
+                }
+            }
+        });
+    }
+}